@@ -0,0 +1,115 @@
+#include "AudioCodec.h"
+#include "LosslessCodec.h"
+#include "MdctCodec.h"
+#include "SampleConversion.h"
+
+#include <vector>
+
+namespace
+{
+    /**
+     * @brief Interleaved PCM in the stream's sample format, with optional TPDF dither
+    */
+    class PcmCodec : public AudioCodec
+    {
+    public:
+        explicit PcmCodec(SampleFormat format) : mFormat(format) {}
+
+        CodecId getId() const override { return CodecId::Pcm; }
+
+        void prepare(double, int numChannels, int maxFrames) override
+        {
+            mScratch.assign((size_t) numChannels * (size_t) maxFrames, 0.0f);
+        }
+
+        size_t getMaxEncodedSize(int numChannels, int numFrames) const override
+        {
+            return SampleConversion::getBytesPerSample(mFormat) * (size_t) numChannels * (size_t) numFrames;
+        }
+
+        void setDitherEnabled(bool enabled) override { mDither.enabled = enabled; }
+
+        size_t encode(const float* const* src, int numChannels, int numFrames, uint8_t* dest, size_t capacity, int& numEncodedFrames) override
+        {
+            numEncodedFrames = 0;
+            const auto size = getMaxEncodedSize(numChannels, numFrames);
+            if (size > capacity || (size_t) numChannels * (size_t) numFrames > mScratch.size())
+                return 0;
+
+            SampleConversion::pack(src, numChannels, numFrames, mFormat, &mDither, mScratch.data(), dest);
+            numEncodedFrames = numFrames;
+            return size;
+        }
+
+        bool decode(const uint8_t* src, size_t size, int numChannels, int numFrames, float* const* dest) override
+        {
+            if (size != getMaxEncodedSize(numChannels, numFrames) || (size_t) numChannels * (size_t) numFrames > mScratch.size())
+                return false;
+
+            SampleConversion::unpack(src, numChannels, numFrames, mFormat, mScratch.data(), dest);
+            return true;
+        }
+
+    private:
+        SampleFormat mFormat;
+        Dither mDither;
+        std::vector<float> mScratch;
+    };
+
+    /**
+     * @brief Adapts LosslessCodec; float input is quantized to the stream's 16- or 24-bit format
+    */
+    class LosslessAudioCodec : public AudioCodec
+    {
+    public:
+        explicit LosslessAudioCodec(SampleFormat format) : mBitsPerSample(format == SampleFormat::Int16 ? 16 : 24) {}
+
+        CodecId getId() const override { return CodecId::Lossless; }
+
+        void prepare(double, int numChannels, int maxFrames) override
+        {
+            mCodec.prepare(numChannels, maxFrames);
+        }
+
+        size_t getMaxEncodedSize(int numChannels, int numFrames) const override
+        {
+            return LosslessCodec::getMaxEncodedSize(numChannels, numFrames, mBitsPerSample);
+        }
+
+        size_t encode(const float* const* src, int numChannels, int numFrames, uint8_t* dest, size_t capacity, int& numEncodedFrames) override
+        {
+            const auto size = mCodec.encode(src, numChannels, numFrames, mBitsPerSample, dest, capacity);
+            numEncodedFrames = size > 0 ? numFrames : 0;
+            return size;
+        }
+
+        bool decode(const uint8_t* src, size_t size, int numChannels, int numFrames, float* const* dest) override
+        {
+            int decodedChannels = 0, decodedFrames = 0;
+            return mCodec.decode(src, size, dest, numChannels, numFrames, decodedChannels, decodedFrames)
+                && decodedChannels == numChannels && decodedFrames == numFrames;
+        }
+
+    private:
+        int mBitsPerSample;
+        LosslessCodec mCodec;
+    };
+}
+
+/**
+ * @brief Creates the codec a StreamFormat describes, or nullptr for an unknown codec id
+*/
+std::unique_ptr<AudioCodec> AudioCodec::create(const StreamFormat& format)
+{
+    switch (format.codec)
+    {
+        case CodecId::Pcm:
+            return std::make_unique<PcmCodec>(format.sampleFormat);
+        case CodecId::Lossless:
+            return std::make_unique<LosslessAudioCodec>(format.sampleFormat);
+        case CodecId::Mdct:
+            return std::make_unique<MdctCodec>(format.bitrate);
+        default:
+            return nullptr;
+    }
+}
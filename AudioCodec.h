@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "PacketHeader.h"
+
+/**
+ * @brief Payload codec for one audio stream
+ *
+ * The sender creates one codec per stream from the StreamFormat it announces in the
+ * createSender metadata, so both ends agree on the codec, sample format and bitrate. prepare()
+ * allocates everything; encode and decode are called from one thread each and do not allocate.
+ *
+ * Codecs with a frame size above 1 buffer input internally and only emit whole frames, so one
+ * encode() call may produce no output or several frames. A lossy codec may also delay its
+ * decoded output by getDecoderDelay() samples relative to the encoded input.
+*/
+class AudioCodec
+{
+public:
+    virtual ~AudioCodec() = default;
+
+    static std::unique_ptr<AudioCodec> create(const StreamFormat& format);
+
+    virtual CodecId getId() const = 0;
+    virtual void prepare(double sampleRate, int numChannels, int maxFrames) = 0;
+    virtual void reset() {}
+
+    /** Granularity of encoded output in samples per channel */
+    virtual int getFrameSize() const { return 1; }
+    virtual int getDecoderDelay() const { return 0; }
+    /** Worst case delay from a sample entering encode() to it leaving decode() */
+    int getAlgorithmicDelay() const { return getFrameSize() - 1 + getDecoderDelay(); }
+    /** Samples accepted by encode() but not yet emitted, per channel */
+    virtual int getNumBufferedFrames() const { return 0; }
+
+    virtual size_t getMaxEncodedSize(int numChannels, int numFrames) const = 0;
+    virtual void setDitherEnabled(bool) {}
+
+    /**
+     * @brief Encodes numFrames of planar input. Returns the payload size, or 0 if nothing was
+     * emitted; numEncodedFrames is the number of samples per channel the payload decodes to
+    */
+    virtual size_t encode(const float* const* src, int numChannels, int numFrames, uint8_t* dest, size_t capacity, int& numEncodedFrames) = 0;
+    virtual bool decode(const uint8_t* src, size_t size, int numChannels, int numFrames, float* const* dest) = 0;
+};
@@ -0,0 +1,180 @@
+#include "AudioFrameRing.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+    // With DropOldest the producer can reclaim and rewrite a slot the consumer is still copying.
+    // The consumer's CAS then fails and the copy is discarded, but both sides go through relaxed
+    // atomics so the overlap is not a data race. On common targets these are plain moves
+    template <typename T>
+    void storeRelaxed(T& dest, T value)
+    {
+        std::atomic_ref<T>(dest).store(value, std::memory_order_relaxed);
+    }
+
+    template <typename T>
+    T loadRelaxed(const T& src)
+    {
+        return std::atomic_ref<T>(const_cast<T&>(src)).load(std::memory_order_relaxed);
+    }
+}
+
+void AudioFrame::allocate(int newMaxChannels, int newMaxSamples)
+{
+    maxChannels = newMaxChannels;
+    maxSamples = newMaxSamples;
+    numChannels = 0;
+    numSamples = 0;
+    samples.assign((size_t) maxChannels * (size_t) maxSamples, 0.0f);
+}
+
+/**
+ * @brief Allocates the slots. Must not be called while a producer or consumer is active
+*/
+void AudioFrameRing::prepare(int numFrames, int maxChannels, int maxSamples)
+{
+    size_t capacity = 1;
+    while (capacity < (size_t) std::max(numFrames, 2))
+        capacity <<= 1;
+
+    mSlots.resize(capacity);
+    for (auto& slot : mSlots)
+        slot.allocate(maxChannels, maxSamples);
+
+    mMask = capacity - 1;
+    mMaxChannels = maxChannels;
+    mMaxSamples = maxSamples;
+    mWriteIndex.store(0, std::memory_order_relaxed);
+    mReadIndex.store(0, std::memory_order_relaxed);
+    mDropped.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Copies one block into the ring. Called from the audio thread only
+*/
+bool AudioFrameRing::push(const float* const* channels, int numChannels, int numSamples, uint64_t samplePosition)
+{
+    if (mSlots.empty())
+        return false;
+
+    const auto w = mWriteIndex.load(std::memory_order_relaxed);
+    auto r = mReadIndex.load(std::memory_order_acquire);
+
+    if (w - r > mMask)
+    {
+        if (mPolicy.load(std::memory_order_relaxed) == OverflowPolicy::DropNewest)
+        {
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // If the CAS fails the consumer has just freed a slot, so there is room either way
+        if (mReadIndex.compare_exchange_strong(r, r + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    auto& slot = mSlots[w & mMask];
+    const int slotChannels = std::min(numChannels, mMaxChannels);
+    const int slotSamples = std::min(numSamples, mMaxSamples);
+    storeRelaxed(slot.numChannels, slotChannels);
+    storeRelaxed(slot.numSamples, slotSamples);
+    storeRelaxed(slot.samplePosition, samplePosition);
+
+    for (int ch = 0; ch < slotChannels; ++ch)
+    {
+        float* dest = slot.getWritePointer(ch);
+        for (int i = 0; i < slotSamples; ++i)
+            storeRelaxed(dest[i], channels[ch][i]);
+    }
+
+    // seq_cst pairs with the consumer registering as a sleeper before it re-checks the index
+    mWriteIndex.store(w + 1, std::memory_order_seq_cst);
+    if (mSleepers.load(std::memory_order_seq_cst) > 0)
+    {
+        mSignal.fetch_add(1);
+        mSignal.notify_one();
+    }
+    return true;
+}
+
+/**
+ * @brief Copies the oldest frame into dest. Called from the consumer thread only
+*/
+bool AudioFrameRing::pop(AudioFrame& dest)
+{
+    auto r = mReadIndex.load(std::memory_order_acquire);
+
+    for (;;)
+    {
+        if (r == mWriteIndex.load(std::memory_order_acquire))
+            return false;
+
+        const auto& slot = mSlots[r & mMask];
+        // Clamped to both sizes, so a half-rewritten slot still cannot overrun either buffer
+        dest.numChannels = std::clamp(loadRelaxed(slot.numChannels), 0, std::min(dest.maxChannels, mMaxChannels));
+        dest.numSamples = std::clamp(loadRelaxed(slot.numSamples), 0, std::min(dest.maxSamples, mMaxSamples));
+        dest.samplePosition = loadRelaxed(slot.samplePosition);
+
+        for (int ch = 0; ch < dest.numChannels; ++ch)
+        {
+            const float* src = slot.getReadPointer(ch);
+            float* out = dest.getWritePointer(ch);
+            for (int i = 0; i < dest.numSamples; ++i)
+                out[i] = loadRelaxed(src[i]);
+        }
+
+        // A failed CAS means the producer reclaimed this slot (DropOldest) while we copied it
+        if (mReadIndex.compare_exchange_strong(r, r + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+            return true;
+    }
+}
+
+uint32_t AudioFrameRing::getSignal() const
+{
+    return mSignal.load();
+}
+
+/**
+ * @brief Blocks the consumer until a frame is published or wakeConsumer() is called
+ *
+ * lastSignal must be read with getSignal() before the consumer last checked its exit
+ * condition, otherwise a wake-up issued in between would be lost.
+*/
+void AudioFrameRing::waitForData(uint32_t lastSignal)
+{
+    mSleepers.fetch_add(1, std::memory_order_seq_cst);
+    // Checked after registering as a sleeper, so a frame published in between is either seen
+    // here or its producer sees the sleeper and changes the signal before this waits on it
+    if (mWriteIndex.load(std::memory_order_seq_cst) == mReadIndex.load(std::memory_order_seq_cst))
+        mSignal.wait(lastSignal);
+    mSleepers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void AudioFrameRing::wakeConsumer()
+{
+    mSignal.fetch_add(1);
+    mSignal.notify_all();
+}
+
+void AudioFrameRing::setOverflowPolicy(OverflowPolicy policy)
+{
+    mPolicy.store(policy, std::memory_order_relaxed);
+}
+
+OverflowPolicy AudioFrameRing::getOverflowPolicy() const
+{
+    return mPolicy.load(std::memory_order_relaxed);
+}
+
+size_t AudioFrameRing::getNumReady() const
+{
+    const auto r = mReadIndex.load(std::memory_order_acquire);
+    return (size_t) (mWriteIndex.load(std::memory_order_acquire) - r);
+}
+
+uint64_t AudioFrameRing::getNumDropped() const
+{
+    return mDropped.load(std::memory_order_relaxed);
+}
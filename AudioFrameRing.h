@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+enum class OverflowPolicy
+{
+    DropOldest,
+    DropNewest
+};
+
+/**
+ * @brief One block of planar audio, preallocated for a fixed channel count and length
+*/
+struct AudioFrame
+{
+    int numChannels = 0;
+    int numSamples = 0;
+    uint64_t samplePosition = 0;
+    int maxChannels = 0;
+    int maxSamples = 0;
+    std::vector<float> samples;
+
+    void allocate(int newMaxChannels, int newMaxSamples);
+    float* getWritePointer(int channel) { return samples.data() + (size_t) channel * (size_t) maxSamples; }
+    const float* getReadPointer(int channel) const { return samples.data() + (size_t) channel * (size_t) maxSamples; }
+};
+
+/**
+ * @brief Wait-free single-producer/single-consumer ring of preallocated audio frames
+ *
+ * The producer (the audio thread) only copies into a free slot and publishes it with an
+ * atomic store. When the ring is full the overflow policy decides whether the incoming
+ * frame or the oldest queued frame is discarded. The consumer copies a slot out and then
+ * commits the read with a CAS, so a slot reclaimed by DropOldest while being copied is
+ * detected and skipped.
+ *
+ * The producer only makes the wake-up call (a futex syscall) when the consumer is parked
+ * in waitForData(), so a consumer that keeps up costs the audio thread no system calls.
+*/
+class AudioFrameRing
+{
+public:
+    AudioFrameRing() = default;
+
+    void prepare(int numFrames, int maxChannels, int maxSamples);
+
+    bool push(const float* const* channels, int numChannels, int numSamples, uint64_t samplePosition);
+    bool pop(AudioFrame& dest);
+
+    uint32_t getSignal() const;
+    void waitForData(uint32_t lastSignal);
+    void wakeConsumer();
+
+    void setOverflowPolicy(OverflowPolicy policy);
+    OverflowPolicy getOverflowPolicy() const;
+
+    int getMaxChannels() const { return mMaxChannels; }
+    int getMaxSamples() const { return mMaxSamples; }
+    size_t getNumReady() const;
+    uint64_t getNumDropped() const;
+
+private:
+    std::vector<AudioFrame> mSlots;
+    size_t mMask = 0;
+    int mMaxChannels = 0;
+    int mMaxSamples = 0;
+
+    alignas(64) std::atomic<uint64_t> mWriteIndex { 0 };
+    alignas(64) std::atomic<uint64_t> mReadIndex { 0 };
+    alignas(64) std::atomic<uint32_t> mSignal { 0 };
+    std::atomic<uint32_t> mSleepers { 0 };
+    std::atomic<uint64_t> mDropped { 0 };
+    std::atomic<OverflowPolicy> mPolicy { OverflowPolicy::DropOldest };
+};
@@ -0,0 +1,48 @@
+#include "AudioSenderThread.h"
+
+AudioSenderThread::AudioSenderThread(AudioFrameRing& ring, FrameCallback callback)
+    : juce::Thread("Corelink Audio Sender"), mRing(ring), mCallback(std::move(callback))
+{
+}
+
+AudioSenderThread::~AudioSenderThread()
+{
+    stop();
+}
+
+/**
+ * @brief Sizes the scratch frame. Only call while the thread is stopped
+*/
+void AudioSenderThread::prepare(int maxChannels, int maxSamples)
+{
+    jassert(!isThreadRunning());
+    mScratch.allocate(maxChannels, maxSamples);
+}
+
+void AudioSenderThread::start()
+{
+    if (!isThreadRunning())
+        startThread(juce::Thread::Priority::high);
+}
+
+void AudioSenderThread::stop()
+{
+    signalThreadShouldExit();
+    mRing.wakeConsumer();
+    stopThread(2000);
+}
+
+void AudioSenderThread::run()
+{
+    for (;;)
+    {
+        const auto signal = mRing.getSignal();
+        if (threadShouldExit())
+            break;
+
+        if (mRing.pop(mScratch))
+            mCallback(mScratch);
+        else
+            mRing.waitForData(signal);
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include "AudioFrameRing.h"
+#include <functional>
+
+/**
+ * @brief Persistent network thread that drains the frame ring filled by processBlock
+*/
+class AudioSenderThread : public juce::Thread
+{
+public:
+    using FrameCallback = std::function<void(const AudioFrame&)>;
+
+    AudioSenderThread(AudioFrameRing& ring, FrameCallback callback);
+    ~AudioSenderThread() override;
+
+    void prepare(int maxChannels, int maxSamples);
+    void start();
+    void stop();
+
+    void run() override;
+
+private:
+    AudioFrameRing& mRing;
+    FrameCallback mCallback;
+    AudioFrame mScratch;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioSenderThread)
+};
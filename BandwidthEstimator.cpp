@@ -0,0 +1,185 @@
+#include "BandwidthEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+void BandwidthEstimator::reset()
+{
+    *this = BandwidthEstimator();
+}
+
+void BandwidthEstimator::onProbe(int train, size_t size, uint64_t sentNs, uint64_t arrivalNs, double rttNs, uint64_t nowNs)
+{
+    // Echoes of a group already closed are too late to place
+    if (train < mTrain)
+        return;
+    if (mHasGroup && train > mTrain)
+        finishGroup(nowNs);
+
+    if (!mHasGroup)
+    {
+        mHasGroup = true;
+        mTrain = train;
+        mGroupCount = 0;
+        mGroupBytes = 0;
+
+        // The rest of a train queues behind its own first probe, so only the first one measures the path.
+        // The smallest round trip of the last window is the empty-queue path; anything above it is queuing
+        if (!mHasRtt || rttNs <= mMinRttNs || (double) (nowNs - mMinRttTimeNs) > BANDWIDTH_MIN_RTT_WINDOW_MS * 1e6)
+        {
+            mMinRttNs = rttNs;
+            mMinRttTimeNs = nowNs;
+        }
+        mSmoothedRttNs = mHasRtt ? mSmoothedRttNs + (rttNs - mSmoothedRttNs) / 8.0 : rttNs;
+        mHasRtt = true;
+        mEstimate.queuingDelayMs = std::max(0.0, mSmoothedRttNs - mMinRttNs) / 1e6;
+    }
+
+    if (mGroupCount == 0 || arrivalNs < mFirstArrivalNs)
+    {
+        mFirstArrivalNs = arrivalNs;
+        mFirstArrivalSize = size;
+    }
+    if (mGroupCount == 0 || arrivalNs > mLastArrivalNs)
+        mLastArrivalNs = arrivalNs;
+    if (mGroupCount == 0 || sentNs > mGroupLastSendNs)
+        mGroupLastSendNs = sentNs;
+    mGroupBytes += size;
+    ++mGroupCount;
+}
+
+/**
+ * @brief Closes the group being collected: a dispersion sample if it was a train, a delay-gradient sample against the previous group
+*/
+void BandwidthEstimator::finishGroup(uint64_t nowNs)
+{
+    mHasGroup = false;
+
+    // The first arrival only marks the start; the bytes behind it are what the bottleneck spread out
+    if (mGroupCount >= 2 && mLastArrivalNs > mFirstArrivalNs)
+    {
+        mDispersion[(size_t) mNextDispersion] = (double) (mGroupBytes - mFirstArrivalSize) * 1e9 / (double) (mLastArrivalNs - mFirstArrivalNs);
+        mNextDispersion = (mNextDispersion + 1) % BANDWIDTH_DISPERSION_HISTORY;
+        mNumDispersion = std::min(mNumDispersion + 1, BANDWIDTH_DISPERSION_HISTORY);
+        mEstimate.dispersionBytesPerSecond = getMedianDispersion();
+        ++mEstimate.numTrains;
+    }
+
+    if (mHasPrevious)
+    {
+        const double sendDeltaMs = ((double) mGroupLastSendNs - (double) mPreviousSendNs) / 1e6;
+        const double arrivalDeltaMs = ((double) mLastArrivalNs - (double) mPreviousArrivalNs) / 1e6;
+        updateTrend(sendDeltaMs, arrivalDeltaMs, ((double) mLastArrivalNs - (double) mOriginArrivalNs) / 1e6, nowNs);
+    }
+    else
+    {
+        mOriginArrivalNs = mLastArrivalNs;
+    }
+    mHasPrevious = true;
+    mPreviousSendNs = mGroupLastSendNs;
+    mPreviousArrivalNs = mLastArrivalNs;
+
+    updateRate(nowNs);
+}
+
+/**
+ * @brief Trendline filter over the accumulated delay variation, with GCC's adaptive threshold
+*/
+void BandwidthEstimator::updateTrend(double sendDeltaMs, double arrivalDeltaMs, double arrivalMs, uint64_t nowNs)
+{
+    mAccumulatedDelayMs += arrivalDeltaMs - sendDeltaMs;
+    mSmoothedDelayMs = BANDWIDTH_TREND_SMOOTHING * mSmoothedDelayMs + (1.0 - BANDWIDTH_TREND_SMOOTHING) * mAccumulatedDelayMs;
+    ++mNumDeltas;
+
+    mTrend[(size_t) mNextTrend] = { arrivalMs, mSmoothedDelayMs };
+    mNextTrend = (mNextTrend + 1) % BANDWIDTH_TREND_WINDOW;
+    mNumTrend = std::min(mNumTrend + 1, BANDWIDTH_TREND_WINDOW);
+    if (mNumTrend < BANDWIDTH_TREND_WINDOW)
+        return;
+
+    double meanX = 0.0, meanY = 0.0;
+    for (const auto& point : mTrend)
+    {
+        meanX += point.arrivalMs;
+        meanY += point.delayMs;
+    }
+    meanX /= BANDWIDTH_TREND_WINDOW;
+    meanY /= BANDWIDTH_TREND_WINDOW;
+
+    double covariance = 0.0, variance = 0.0;
+    for (const auto& point : mTrend)
+    {
+        covariance += (point.arrivalMs - meanX) * (point.delayMs - meanY);
+        variance += (point.arrivalMs - meanX) * (point.arrivalMs - meanX);
+    }
+    if (variance <= 0.0)
+        return;
+
+    const double slope = covariance / variance;
+    const double trend = std::min(mNumDeltas, 60) * slope * BANDWIDTH_TREND_GAIN;
+    mEstimate.delayTrend = slope;
+
+    // The threshold follows the trend slowly upwards and quickly back down, so that a path with
+    // steady jitter is not read as congested; outliers well beyond it do not move it
+    const double magnitude = std::abs(trend);
+    if (magnitude <= mThresholdMs + 15.0)
+    {
+        const double elapsedMs = mLastThresholdNs == 0 ? 0.0 : std::min((double) (nowNs - mLastThresholdNs) / 1e6, 100.0);
+        const double gain = magnitude < mThresholdMs ? BANDWIDTH_THRESHOLD_DOWN : BANDWIDTH_THRESHOLD_UP;
+        mThresholdMs = std::clamp(mThresholdMs + gain * (magnitude - mThresholdMs) * elapsedMs,
+                                  BANDWIDTH_THRESHOLD_MIN_MS, BANDWIDTH_THRESHOLD_MAX_MS);
+    }
+    mLastThresholdNs = nowNs;
+
+    if (trend > mThresholdMs)
+        mEstimate.usage = BandwidthUsage::Overuse;
+    else if (trend < -mThresholdMs)
+        mEstimate.usage = BandwidthUsage::Underuse;
+    else
+        mEstimate.usage = BandwidthUsage::Normal;
+}
+
+/**
+ * @brief Moves the estimate by the detector's verdict, never above the dispersion rate
+*/
+void BandwidthEstimator::updateRate(uint64_t nowNs)
+{
+    const double ceiling = mEstimate.dispersionBytesPerSecond;
+    if (ceiling <= 0.0)
+        return;
+
+    auto& rate = mEstimate.availableBytesPerSecond;
+    const double elapsedSeconds = rate > 0.0 ? std::min((double) (nowNs - mLastRateNs) / 1e9, 1.0) : 0.0;
+    mLastRateNs = nowNs;
+    if (rate <= 0.0)
+    {
+        rate = ceiling;
+        return;
+    }
+
+    switch (mEstimate.usage)
+    {
+        case BandwidthUsage::Overuse:
+            // The queue needs a round trip to show a decrease; cutting again before that overshoots
+            if ((double) (nowNs - mLastDecreaseNs) >= mSmoothedRttNs)
+            {
+                rate *= BANDWIDTH_DECREASE_FACTOR;
+                mLastDecreaseNs = nowNs;
+            }
+            break;
+        case BandwidthUsage::Underuse:
+            break;
+        case BandwidthUsage::Normal:
+            rate *= std::pow(BANDWIDTH_INCREASE_PER_SECOND, elapsedSeconds);
+            break;
+    }
+    rate = std::min(rate, ceiling);
+}
+
+double BandwidthEstimator::getMedianDispersion() const
+{
+    std::array<double, BANDWIDTH_DISPERSION_HISTORY> samples = mDispersion;
+    const auto middle = samples.begin() + mNumDispersion / 2;
+    std::nth_element(samples.begin(), middle, samples.begin() + mNumDispersion);
+    return *middle;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#define BANDWIDTH_DISPERSION_HISTORY 8
+#define BANDWIDTH_TREND_WINDOW 20
+#define BANDWIDTH_TREND_SMOOTHING 0.9
+#define BANDWIDTH_TREND_GAIN 4.0
+#define BANDWIDTH_THRESHOLD_INITIAL_MS 12.5
+#define BANDWIDTH_THRESHOLD_MIN_MS 6.0
+#define BANDWIDTH_THRESHOLD_MAX_MS 600.0
+#define BANDWIDTH_THRESHOLD_UP 0.0087
+#define BANDWIDTH_THRESHOLD_DOWN 0.039
+#define BANDWIDTH_DECREASE_FACTOR 0.85
+#define BANDWIDTH_INCREASE_PER_SECOND 1.08
+#define BANDWIDTH_MIN_RTT_WINDOW_MS 10000.0
+
+enum class BandwidthUsage
+{
+    Normal,
+    Underuse,
+    Overuse
+};
+
+/**
+ * @brief Current view of the path, as produced by BandwidthEstimator
+*/
+struct BandwidthEstimate
+{
+    // 0 until the first packet train has come back
+    double availableBytesPerSecond = 0.0;
+    // Median rate at which recent trains arrived; the available bandwidth cannot be above it
+    double dispersionBytesPerSecond = 0.0;
+    // Smoothed round-trip time above the smallest one seen recently
+    double queuingDelayMs = 0.0;
+    // Filtered growth of the one-way delay between probe groups, in ms of delay per ms
+    double delayTrend = 0.0;
+    BandwidthUsage usage = BandwidthUsage::Normal;
+    int numTrains = 0;
+};
+
+/**
+ * @brief Available bandwidth and queuing delay from the echoes of probe trains
+ *
+ * Each train of probes leaves back to back, so the bottleneck spreads it out: the rate at
+ * which a train comes back (its bytes after the first probe over the time between the first
+ * and the last arrival) is the asymptotic dispersion rate, an upper bound of what the path
+ * has available. The median over the last BANDWIDTH_DISPERSION_HISTORY trains is the ceiling
+ * of the estimate.
+ *
+ * Within that ceiling the estimate follows the delay gradient, as Google Congestion Control
+ * does. Each probe group (a train, or a single probe) gives the change in one-way delay since
+ * the previous group. The accumulated change is smoothed and fitted with a line over the last
+ * BANDWIDTH_TREND_WINDOW groups. A slope above an adaptive threshold is overuse: the queue is
+ * growing, and the estimate drops by BANDWIDTH_DECREASE_FACTOR, at most once per round trip.
+ * A slope below minus the threshold is underuse, and the estimate holds. Otherwise it grows by
+ * BANDWIDTH_INCREASE_PER_SECOND.
+ *
+ * Only differences of arrival times are used, so arrivalNs may be on any clock: the peer's own
+ * receive stamp when it answers with ProbeEngine::stampReply(), which gives the forward path
+ * alone, or the echo's arrival here, which folds in the return path.
+ *
+ * Not thread-safe; ProbeEngine feeds it and reads it under its lock.
+*/
+class BandwidthEstimator
+{
+public:
+    BandwidthEstimator() = default;
+
+    void reset();
+
+    /** One echoed probe; nowNs is when its echo arrived here */
+    void onProbe(int train, size_t size, uint64_t sentNs, uint64_t arrivalNs, double rttNs, uint64_t nowNs);
+
+    const BandwidthEstimate& getEstimate() const { return mEstimate; }
+
+private:
+    void finishGroup(uint64_t nowNs);
+    void updateTrend(double sendDeltaMs, double arrivalDeltaMs, double arrivalMs, uint64_t nowNs);
+    void updateRate(uint64_t nowNs);
+    double getMedianDispersion() const;
+
+    BandwidthEstimate mEstimate;
+
+    // Group being collected
+    bool mHasGroup = false;
+    int mTrain = -1;
+    int mGroupCount = 0;
+    uint64_t mGroupLastSendNs = 0;
+    uint64_t mFirstArrivalNs = 0;
+    uint64_t mLastArrivalNs = 0;
+    size_t mGroupBytes = 0;
+    size_t mFirstArrivalSize = 0;
+
+    // Previous finished group
+    bool mHasPrevious = false;
+    uint64_t mPreviousSendNs = 0;
+    uint64_t mPreviousArrivalNs = 0;
+    uint64_t mOriginArrivalNs = 0;
+
+    std::array<double, BANDWIDTH_DISPERSION_HISTORY> mDispersion {};
+    int mNumDispersion = 0;
+    int mNextDispersion = 0;
+
+    struct TrendPoint
+    {
+        double arrivalMs = 0.0;
+        double delayMs = 0.0;
+    };
+
+    std::array<TrendPoint, BANDWIDTH_TREND_WINDOW> mTrend {};
+    int mNumTrend = 0;
+    int mNextTrend = 0;
+    int mNumDeltas = 0;
+    double mAccumulatedDelayMs = 0.0;
+    double mSmoothedDelayMs = 0.0;
+    double mThresholdMs = BANDWIDTH_THRESHOLD_INITIAL_MS;
+    uint64_t mLastThresholdNs = 0;
+
+    uint64_t mLastRateNs = 0;
+    uint64_t mLastDecreaseNs = 0;
+
+    bool mHasRtt = false;
+    double mSmoothedRttNs = 0.0;
+    double mMinRttNs = 0.0;
+    uint64_t mMinRttTimeNs = 0;
+};
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Maps signed values to unsigned so small magnitudes of either sign get short codes
+*/
+inline uint32_t zigzagEncode(int32_t v)
+{
+    return ((uint32_t) v << 1) ^ (uint32_t) (v >> 31);
+}
+
+inline int32_t zigzagDecode(uint32_t u)
+{
+    return (int32_t) (u >> 1) ^ -(int32_t) (u & 1u);
+}
+
+/**
+ * @brief MSB-first bit writer over a caller-owned buffer, used by the in-tree codecs
+ *
+ * Writing past the capacity is recorded rather than checked per call; finish() then returns 0.
+*/
+class BitWriter
+{
+public:
+    BitWriter(uint8_t* data, size_t capacity) : mData(data), mCapacity(capacity) {}
+
+    void write(uint32_t value, int bits)
+    {
+        if (bits == 0)
+            return;
+        mAcc = (mAcc << bits) | (value & mask(bits));
+        mBits += bits;
+        while (mBits >= 8)
+        {
+            mBits -= 8;
+            put((uint8_t) (mAcc >> mBits));
+        }
+    }
+
+    void writeUnary(uint32_t zeros)
+    {
+        while (zeros >= 32)
+        {
+            write(0, 32);
+            zeros -= 32;
+        }
+        write(1, (int) zeros + 1);
+    }
+
+    void writeRice(int32_t value, int k)
+    {
+        const auto u = zigzagEncode(value);
+        writeUnary(u >> k);
+        write(u, k);
+    }
+
+    size_t getNumBitsWritten() const { return mPos * 8 + (size_t) mBits; }
+
+    /** Pads to a whole byte and returns the number of bytes written, or 0 on overflow */
+    size_t finish()
+    {
+        if (mBits > 0)
+            write(0, 8 - mBits);
+        return mOverflow ? 0 : mPos;
+    }
+
+    static uint32_t mask(int bits)
+    {
+        return bits >= 32 ? 0xffffffffu : ((1u << bits) - 1u);
+    }
+
+private:
+    void put(uint8_t byte)
+    {
+        if (mPos < mCapacity)
+            mData[mPos++] = byte;
+        else
+            mOverflow = true;
+    }
+
+    uint8_t* mData;
+    size_t mCapacity;
+    size_t mPos = 0;
+    uint64_t mAcc = 0;
+    int mBits = 0;
+    bool mOverflow = false;
+};
+
+/**
+ * @brief Reader for BitWriter streams. Reading past the end sets an error flag and returns zeros
+*/
+class BitReader
+{
+public:
+    BitReader(const uint8_t* data, size_t size) : mData(data), mSize(size) {}
+
+    uint32_t read(int bits)
+    {
+        if (bits == 0)
+            return 0;
+        if (!fill(bits))
+        {
+            mError = true;
+            return 0;
+        }
+        mBits -= bits;
+        return (uint32_t) (mAcc >> mBits) & BitWriter::mask(bits);
+    }
+
+    int32_t readSigned(int bits)
+    {
+        auto v = read(bits);
+        if (bits < 32 && ((v >> (bits - 1)) & 1u) != 0)
+            v |= ~BitWriter::mask(bits);
+        return (int32_t) v;
+    }
+
+    uint32_t readUnary()
+    {
+        uint32_t zeros = 0;
+        for (;;)
+        {
+            if (mBits == 0 && !fill(1))
+            {
+                mError = true;
+                return 0;
+            }
+
+            const auto window = mAcc & ((uint64_t(1) << mBits) - 1);
+            if (window == 0)
+            {
+                zeros += (uint32_t) mBits;
+                mBits = 0;
+                if (zeros > 0x7fffffffu)
+                {
+                    mError = true;
+                    return 0;
+                }
+                continue;
+            }
+
+            const int top = 63 - std::countl_zero(window);
+            zeros += (uint32_t) (mBits - 1 - top);
+            mBits = top;
+            return zeros;
+        }
+    }
+
+    int32_t readRice(int k)
+    {
+        const uint64_t u = ((uint64_t) readUnary() << k) | read(k);
+        if (u > 0xffffffffu)
+        {
+            mError = true;
+            return 0;
+        }
+        return zigzagDecode((uint32_t) u);
+    }
+
+    size_t getNumBitsRead() const { return mPos * 8 - (size_t) mBits; }
+    bool hasError() const { return mError; }
+
+private:
+    bool fill(int bits)
+    {
+        while (mBits < bits)
+        {
+            if (mPos >= mSize)
+                return false;
+            mAcc = (mAcc << 8) | mData[mPos++];
+            mBits += 8;
+        }
+        return true;
+    }
+
+    const uint8_t* mData;
+    size_t mSize;
+    size_t mPos = 0;
+    uint64_t mAcc = 0;
+    int mBits = 0;
+    bool mError = false;
+};
@@ -0,0 +1,230 @@
+#include "ClockSync.h"
+
+#include <algorithm>
+#include <cmath>
+
+int64_t ClockSample::getOffsetNs() const
+{
+    return (((int64_t) receiveNs - (int64_t) originNs) + ((int64_t) transmitNs - (int64_t) destinationNs)) / 2;
+}
+
+int64_t ClockSample::getDelayNs() const
+{
+    return ((int64_t) destinationNs - (int64_t) originNs) - ((int64_t) transmitNs - (int64_t) receiveNs);
+}
+
+/**
+ * @brief Reference minus local time at localNs: the fitted line plus whatever slew is in progress
+*/
+double ClockSync::Estimate::offsetAt(uint64_t localNs) const
+{
+    const auto elapsed = (double) ((int64_t) localNs - (int64_t) baseNs);
+    const auto slewed = (double) ((int64_t) std::min(localNs, slewEndNs) - (int64_t) baseNs);
+    return baseOffsetNs + skew * elapsed + slewRate * slewed;
+}
+
+ClockSync::ClockSync()
+{
+    mPoints.resize(CLOCK_SKEW_POINTS);
+    reset();
+}
+
+/**
+ * @brief Forgets every exchange. Must not run concurrently with addSample()
+*/
+void ClockSync::reset()
+{
+    mHasInterval = false;
+    mNumPoints = 0;
+    mNextPoint = 0;
+    mEstimate = Estimate();
+    publish(mEstimate);
+    mMinDelayNs.store(0, std::memory_order_relaxed);
+    mNumSamples.store(0, std::memory_order_relaxed);
+}
+
+void ClockSync::setReference(bool isReference)
+{
+    mIsReference.store(isReference, std::memory_order_relaxed);
+}
+
+bool ClockSync::addSample(const ClockSample& sample)
+{
+    if (sample.destinationNs < sample.originNs || sample.transmitNs < sample.receiveNs || sample.getDelayNs() < 0)
+        return false;
+
+    mNumSamples.store(mNumSamples.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    // The least queued exchange of each interval is the most symmetric one and becomes a point
+    if (mHasInterval && sample.destinationNs >= mIntervalStartNs + (uint64_t) (CLOCK_POINT_INTERVAL_MS * 1e6))
+    {
+        mPoints[mNextPoint] = { mIntervalBest.originNs + (mIntervalBest.destinationNs - mIntervalBest.originNs) / 2, (double) mIntervalBest.getOffsetNs() };
+        mNextPoint = (mNextPoint + 1) % mPoints.size();
+        mNumPoints = std::min(mNumPoints + 1, mPoints.size());
+        mHasInterval = false;
+    }
+
+    if (!mHasInterval)
+    {
+        mHasInterval = true;
+        mIntervalStartNs = sample.destinationNs;
+    }
+    else if (sample.getDelayNs() >= mIntervalBest.getDelayNs())
+    {
+        return true;
+    }
+
+    mIntervalBest = sample;
+    mMinDelayNs.store(sample.getDelayNs(), std::memory_order_relaxed);
+    update(sample.destinationNs);
+    return true;
+}
+
+/**
+ * @brief Refits the line and publishes it, stepping or slewing from the current mapping
+*/
+void ClockSync::update(uint64_t nowNs)
+{
+    double target = 0.0, skew = 0.0;
+    fit(nowNs, target, skew);
+
+    Estimate next;
+    next.synchronized = true;
+    next.baseNs = nowNs;
+    next.skew = skew;
+    next.slewEndNs = nowNs;
+    const double current = mEstimate.offsetAt(nowNs);
+    const double error = target - current;
+    if (!mEstimate.synchronized || std::abs(error) > CLOCK_STEP_THRESHOLD_MS * 1e6)
+    {
+        next.baseOffsetNs = target;
+    }
+    else
+    {
+        // Continues from where the mapping is now and closes the gap at the slew rate
+        const double rate = CLOCK_SLEW_PPM * 1e-6;
+        next.baseOffsetNs = current;
+        next.slewRate = error > 0.0 ? rate : -rate;
+        next.slewEndNs = nowNs + (uint64_t) std::llround(std::abs(error) / rate);
+    }
+
+    mEstimate = next;
+    publish(next);
+}
+
+/**
+ * @brief Offset at nowNs and skew of the line through the points and the interval's best exchange
+*/
+void ClockSync::fit(uint64_t nowNs, double& offsetNs, double& skew) const
+{
+    const size_t numPoints = mNumPoints + 1;
+    auto getPoint = [&](size_t i)
+    {
+        if (i == mNumPoints)
+            return Point { mIntervalBest.originNs + (mIntervalBest.destinationNs - mIntervalBest.originNs) / 2, (double) mIntervalBest.getOffsetNs() };
+        return mPoints[i];
+    };
+
+    offsetNs = (double) mIntervalBest.getOffsetNs();
+    skew = 0.0;
+
+    // Relative to nowNs so the sums keep their precision
+    double meanX = 0.0, meanY = 0.0, minX = 0.0, maxX = 0.0;
+    for (size_t i = 0; i < numPoints; ++i)
+    {
+        const auto point = getPoint(i);
+        const auto x = (double) ((int64_t) point.localNs - (int64_t) nowNs);
+        meanX += x;
+        meanY += point.offsetNs;
+        minX = i == 0 ? x : std::min(minX, x);
+        maxX = i == 0 ? x : std::max(maxX, x);
+    }
+    if (numPoints < CLOCK_MIN_SKEW_POINTS || maxX - minX < CLOCK_MIN_SKEW_SPAN_MS * 1e6)
+        return;
+
+    meanX /= (double) numPoints;
+    meanY /= (double) numPoints;
+    double sxx = 0.0, sxy = 0.0;
+    for (size_t i = 0; i < numPoints; ++i)
+    {
+        const auto point = getPoint(i);
+        const double dx = (double) ((int64_t) point.localNs - (int64_t) nowNs) - meanX;
+        sxx += dx * dx;
+        sxy += dx * (point.offsetNs - meanY);
+    }
+
+    const double maxSkew = CLOCK_MAX_SKEW_PPM * 1e-6;
+    skew = std::clamp(sxy / sxx, -maxSkew, maxSkew);
+    offsetNs = meanY - skew * meanX;
+}
+
+void ClockSync::publish(const Estimate& estimate)
+{
+    const uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+    mSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    mSynchronized.store(estimate.synchronized, std::memory_order_relaxed);
+    mBaseNs.store(estimate.baseNs, std::memory_order_relaxed);
+    mBaseOffsetNs.store(estimate.baseOffsetNs, std::memory_order_relaxed);
+    mSkew.store(estimate.skew, std::memory_order_relaxed);
+    mSlewRate.store(estimate.slewRate, std::memory_order_relaxed);
+    mSlewEndNs.store(estimate.slewEndNs, std::memory_order_relaxed);
+
+    mSequence.store(sequence + 2, std::memory_order_release);
+}
+
+ClockSync::Estimate ClockSync::load() const
+{
+    Estimate estimate;
+    for (;;)
+    {
+        const uint32_t before = mSequence.load(std::memory_order_acquire);
+        if ((before & 1) == 0)
+        {
+            estimate.synchronized = mSynchronized.load(std::memory_order_relaxed);
+            estimate.baseNs = mBaseNs.load(std::memory_order_relaxed);
+            estimate.baseOffsetNs = mBaseOffsetNs.load(std::memory_order_relaxed);
+            estimate.skew = mSkew.load(std::memory_order_relaxed);
+            estimate.slewRate = mSlewRate.load(std::memory_order_relaxed);
+            estimate.slewEndNs = mSlewEndNs.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (mSequence.load(std::memory_order_relaxed) == before)
+                return estimate;
+        }
+    }
+}
+
+bool ClockSync::isSynchronized() const
+{
+    return mIsReference.load(std::memory_order_relaxed) || mSynchronized.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Our monotonic time localNs on the reference's clock; the identity until synchronized
+*/
+uint64_t ClockSync::toReferenceNs(uint64_t localNs) const
+{
+    if (mIsReference.load(std::memory_order_relaxed))
+        return localNs;
+
+    const auto estimate = load();
+    if (!estimate.synchronized)
+        return localNs;
+    return (uint64_t) ((int64_t) localNs + std::llround(estimate.offsetAt(localNs)));
+}
+
+double ClockSync::getOffsetMs() const
+{
+    return mIsReference.load(std::memory_order_relaxed) ? 0.0 : load().baseOffsetNs / 1e6;
+}
+
+double ClockSync::getSkewPpm() const
+{
+    return mIsReference.load(std::memory_order_relaxed) ? 0.0 : load().skew * 1e6;
+}
+
+double ClockSync::getMinDelayMs() const
+{
+    return (double) mMinDelayNs.load(std::memory_order_relaxed) / 1e6;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define CLOCK_POINT_INTERVAL_MS 200.0
+#define CLOCK_SKEW_POINTS 64
+#define CLOCK_MIN_SKEW_POINTS 4
+#define CLOCK_MIN_SKEW_SPAN_MS 1000.0
+#define CLOCK_MAX_SKEW_PPM 500.0
+#define CLOCK_SLEW_PPM 500.0
+#define CLOCK_STEP_THRESHOLD_MS 10.0
+
+/**
+ * @brief One request/response exchange, NTP style. Origin and destination are on our clock,
+ * receive and transmit on the reference's
+*/
+struct ClockSample
+{
+    uint64_t originNs = 0;
+    uint64_t receiveNs = 0;
+    uint64_t transmitNs = 0;
+    uint64_t destinationNs = 0;
+
+    int64_t getOffsetNs() const;
+    int64_t getDelayNs() const;
+};
+
+/**
+ * @brief Estimates the offset and skew of a reference clock from timestamped probe exchanges
+ *
+ * Each exchange gives the offset ((receive - origin) + (transmit - destination)) / 2, which is
+ * exact when both directions take equally long, and the round-trip delay without the
+ * reference's turnaround time. Queueing makes the paths asymmetric, so, much like NTP's clock
+ * filter, only the exchange with the smallest delay in each CLOCK_POINT_INTERVAL_MS is kept.
+ * A least-squares line through the last CLOCK_SKEW_POINTS of these, and the best exchange of
+ * the interval in progress, gives the skew once they span CLOCK_MIN_SKEW_SPAN_MS; until then
+ * the latest one is used as is.
+ *
+ * toReferenceNs() maps our monotonic clock onto the reference's. The first estimate, and any
+ * correction larger than CLOCK_STEP_THRESHOLD_MS, is stepped in; smaller ones are slewed in at
+ * CLOCK_SLEW_PPM so that once synchronized the mapping never runs backwards. Both clocks being
+ * monotonic, wall-clock steps on either side do not disturb it. A peer that answers the probes
+ * can instead be made the reference itself, whose mapping is the identity.
+ *
+ * addSample() is called from one thread. The estimate is published through a sequence lock, so
+ * toReferenceNs() and the getters are wait-free for readers on any thread and never see half
+ * an update. Nothing allocates after construction.
+*/
+class ClockSync
+{
+public:
+    ClockSync();
+
+    void reset();
+    /** Marks our own clock as the reference every other peer synchronizes to */
+    void setReference(bool isReference);
+
+    /** Takes one exchange; returns false if its timestamps are inconsistent */
+    bool addSample(const ClockSample& sample);
+
+    bool isSynchronized() const;
+    uint64_t toReferenceNs(uint64_t localNs) const;
+
+    double getOffsetMs() const;
+    double getSkewPpm() const;
+    /** Round-trip delay of the exchange the estimate currently rests on */
+    double getMinDelayMs() const;
+    int getNumSamples() const { return mNumSamples.load(std::memory_order_relaxed); }
+
+private:
+    struct Estimate
+    {
+        bool synchronized = false;
+        uint64_t baseNs = 0;
+        double baseOffsetNs = 0.0;
+        double skew = 0.0;
+        double slewRate = 0.0;
+        uint64_t slewEndNs = 0;
+
+        double offsetAt(uint64_t localNs) const;
+    };
+
+    struct Point
+    {
+        uint64_t localNs = 0;
+        double offsetNs = 0.0;
+    };
+
+    Estimate load() const;
+    void publish(const Estimate& estimate);
+    void update(uint64_t nowNs);
+    void fit(uint64_t nowNs, double& offsetNs, double& skew) const;
+
+    // Writer state
+    bool mHasInterval = false;
+    uint64_t mIntervalStartNs = 0;
+    ClockSample mIntervalBest;
+    std::vector<Point> mPoints;
+    size_t mNumPoints = 0;
+    size_t mNextPoint = 0;
+    Estimate mEstimate;
+
+    // Published estimate, readable from any thread
+    std::atomic<uint32_t> mSequence { 0 };
+    std::atomic<bool> mSynchronized { false };
+    std::atomic<uint64_t> mBaseNs { 0 };
+    std::atomic<double> mBaseOffsetNs { 0.0 };
+    std::atomic<double> mSkew { 0.0 };
+    std::atomic<double> mSlewRate { 0.0 };
+    std::atomic<uint64_t> mSlewEndNs { 0 };
+    std::atomic<bool> mIsReference { false };
+    std::atomic<int64_t> mMinDelayNs { 0 };
+    std::atomic<int> mNumSamples { 0 };
+};
@@ -1,8 +1,11 @@
 #include "CorelinkClient.h"
-#include "PluginProcessor.h"
+
+#include <cstdio>
 
 CorelinkClient::CorelinkClient() {
     std::cout << "Corelink Client Contructor called." << std::endl;
+    mFragment.resize(UDP_BATCH_MAX_DATAGRAM);
+    mTransmitStamps.reserve(UDP_TX_STAMP_HISTORY);
 }
 
 CorelinkClient::~CorelinkClient() {
@@ -13,15 +16,15 @@ bool CorelinkClient::initProtocols() {
     return mClient.init_protocols();
 }
 
-void CorelinkClient::addControlChannel(SenderAudioProcessor* senderAudioProcessor) {
+void CorelinkClient::addControlChannel(ErrorCallback onError, ChannelCallback onInit, ChannelCallback onUninit) {
     auto controlChannelId = mClient.add_control_channel(
         mInfo.protocol,
         mInfo.hostname,
         mInfo.port_number,
         mInfo.client_certificate_path,
-        std::bind(&SenderAudioProcessor::onError, senderAudioProcessor, std::placeholders::_1, std::placeholders::_2),
-        std::bind(&SenderAudioProcessor::onChannelInit, senderAudioProcessor, std::placeholders::_1),
-        std::bind(&SenderAudioProcessor::onChannelUninit, senderAudioProcessor, std::placeholders::_1));
+        std::move(onError),
+        std::move(onInit),
+        std::move(onUninit));
 
     setControlChannelId(controlChannelId);
 }
@@ -60,19 +63,41 @@ void CorelinkClient::disconnectChannel(std::vector<corelink::core::network::chan
 
 
 
-void CorelinkClient::addOnSubscribe(const std::function<void(int)>& cb) {
+void CorelinkClient::addOnSubscribe(const SubscribeCallback& cb) {
     mClient.request(
         mControlChannelId,
         corelink::client::corelink_functions::server_callback_on_subscribed, nullptr,
         [cb](corelink::core::network::channel_id_type hostId, in<std::string>,
             in<std::shared_ptr<corelink::client::request_response::responses::corelink_server_response_base>> response)
         {
-            cb(response->status_code);
+            int streamId = -1;
+            if (response->status_code == 0) {
+                corelink::utils::json subscribed(response->message);
+                streamId = subscribed.get_int("streamID");
+            }
+            cb(response->status_code, streamId);
+        }
+    );
+}
+
+/**
+ * @brief Passes on the server's alerts about streams created after a receiver, which carry their meta
+*/
+void CorelinkClient::addOnUpdate(const AnnounceCallback& cb) {
+    mClient.request(
+        mControlChannelId,
+        corelink::client::corelink_functions::server_callback_on_update, nullptr,
+        [cb](corelink::core::network::channel_id_type hostId, in<std::string>,
+            in<std::shared_ptr<corelink::client::request_response::responses::corelink_server_response_base>> response)
+        {
+            if (response->status_code == 0) {
+                cb(response->message);
+            }
         }
     );
 }
 
-void CorelinkClient::createSender(const juce::String& workspace, const juce::String& stream_type, const std::function<void(int)> cb) {
+void CorelinkClient::createSender(const juce::String& workspace, const juce::String& stream_type, const StreamFormat& format, const StreamCallback cb) {
     auto request =
     std::make_shared<corelink::client::request_response::requests::modify_sender_stream_request>(corelink::core::network::constants::protocols::udp);
 
@@ -83,9 +108,17 @@ void CorelinkClient::createSender(const juce::String& workspace, const juce::Str
     request->stream_type             = stream_type.toStdString();
 
     auto ts = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    // Fields that never change for the lifetime of the stream are sent once here rather than per packet
     request->meta                    = "{ \"username\": \"" + mUsername + "\",\n"
                                        "  \"timestamp\": \"" + std::to_string(ts) + "\",\n"
-                                       "  \"type\": \"audio\" }";
+                                       "  \"type\": \"audio\",\n"
+                                       "  \"header_version\": " + std::to_string(PACKET_HEADER_VERSION) + ",\n"
+                                       "  \"sample_rate\": " + std::to_string((int) format.sampleRate) + ",\n"
+                                       "  \"num_channel\": " + std::to_string(format.numChannels) + ",\n"
+                                       "  \"sample_format\": " + std::to_string((int) format.sampleFormat) + ",\n"
+                                       "  \"codec\": " + std::to_string((int) format.codec) + ",\n"
+                                       "  \"bitrate\": " + std::to_string(format.bitrate) + ",\n"
+                                       "  \"codec_delay\": " + std::to_string(format.codecDelay) + " }";
 
     request->on_error                = [](
                             corelink::core::network::channel_id_type hostId,
@@ -106,28 +139,216 @@ void CorelinkClient::createSender(const juce::String& workspace, const juce::Str
         mControlChannelId,
         corelink::client::corelink_functions::create_sender,
         request,
-        [&, cb](corelink::core::network::channel_id_type hostId,
+        [this, cb](corelink::core::network::channel_id_type hostId,
             in<std::string> /*msg*/,
             in<std::shared_ptr<corelink::client::request_response::responses::corelink_server_response_base>> response)
         {
             corelink::utils::json receiver_response(response->message);
-            mStreamId = receiver_response.get_int("streamID");
-            
-            mHostId = hostId;
-            cb(response->status_code);
+            const int streamId = receiver_response.get_int("streamID");
+            if (response->status_code == 0 && mDataPlane.load() == DataPlane::UdpBatch) {
+                openDirectStream(hostId, streamId, receiver_response.get_int("port"));
+            }
+            cb(response->status_code, hostId, streamId);
+    });
+}
+
+/**
+ * @brief Creates a UDP receiver for stream_type in workspace. Every datagram from a subscribed stream is passed to onReceive
+*/
+void CorelinkClient::createReceiver(const juce::String& workspace, const juce::String& stream_type, ReceiveCallback onReceive, const StreamCallback cb, const AnnounceCallback onStreams) {
+    auto request =
+    std::make_shared<corelink::client::request_response::requests::modify_receiver_stream_request>(corelink::core::network::constants::protocols::udp);
+
+    request->client_certificate_path = mCertPath;
+    request->alert                   = true;
+    // Our own stream comes back too, for the echo monitor
+    request->echo                    = true;
+    request->workspace               = workspace.toStdString();
+    request->stream_types            = { stream_type.toStdString() };
+    request->meta                    = "{ \"username\": \"" + mUsername + "\",\n"
+                                       "  \"type\": \"audio\" }";
+
+    request->on_error                = [](
+                            corelink::core::network::channel_id_type hostId,
+                            in<std::string> err)
+    {
+        DBG("Error while receiving data on the data channel: " << err);
+    };
+    request->
+        on_receive = [onReceive](corelink::core::network::channel_id_type hostId, in<std::vector<uint8_t>> header, in<std::vector<uint8_t>> data)
+    {
+        // Stamped before anything else so queueing delays inside the plugin do not count as network jitter
+        const auto arrivalNs = getMonotonicTimeNs();
+        int sourceStreamId = -1;
+        if (StreamIngest::parseSourceStreamId(header.data(), header.size(), sourceStreamId)) {
+            onReceive(sourceStreamId, data.data(), data.size(), arrivalNs);
+        }
+    };
+
+    mClient.request(
+        mControlChannelId,
+        corelink::client::corelink_functions::create_receiver,
+        request,
+        [cb, onStreams](corelink::core::network::channel_id_type hostId,
+            in<std::string> /*msg*/,
+            in<std::shared_ptr<corelink::client::request_response::responses::corelink_server_response_base>> response)
+        {
+            corelink::utils::json receiver_response(response->message);
+            cb(response->status_code, hostId, receiver_response.get_int("streamID"));
+            // The answer lists the streams already in the workspace, with their meta
+            if (response->status_code == 0 && onStreams) {
+                onStreams(response->message);
+            }
     });
 }
 
+/**
+ * @brief Subscribes the receiver to a remote stream. Streams present when the receiver is created are subscribed by the server
+*/
+void CorelinkClient::subscribe(corelink::core::network::channel_id_type receiverStreamId, corelink::core::network::channel_id_type streamId, const std::function<void(int)>& cb) {
+    auto request = std::make_shared<corelink::client::request_response::requests::subscribe_to_stream_request>(receiverStreamId, streamId);
+
+    mClient.request(
+        mControlChannelId,
+        corelink::client::corelink_functions::subscribe,
+        request,
+        [cb](corelink::core::network::channel_id_type hostId, in<std::string>,
+            in<std::shared_ptr<corelink::client::request_response::responses::corelink_server_response_base>> response)
+        {
+            cb(response->status_code);
+        }
+    );
+}
+
 void CorelinkClient::sendData(corelink::core::network::channel_id_type hostId, std::vector<uint8_t> mData, corelink::utils::json meta) {
     mClient.send_data(hostId, std::move(mData), std::move(meta));
 }
 
+/**
+ * @brief Hands a pooled packet, binary header included, to the transport. The handle is released once the transport is done with it
+ *
+ * Packets larger than maxDatagramSize are split into FragmentHeader fragments so that no datagram
+ * relies on IP fragmentation, where one lost piece loses the whole packet.
+*/
+void CorelinkClient::sendData(corelink::core::network::channel_id_type hostId, PacketHandle packet, size_t maxDatagramSize) {
+    const int numFragments = PacketFragmenter::getNumFragments(packet.size(), maxDatagramSize);
+
+    if (mDataPlane.load(std::memory_order_relaxed) == DataPlane::UdpBatch) {
+        std::lock_guard<std::mutex> lock(mDirectLock);
+        const auto direct = mDirectStreams.find(hostId);
+        if (direct != mDirectStreams.end()) {
+            // Audio packets are tagged with their stream and sequence number, so their transmit
+            // stamps find their way back; a fragmented one by its first fragment
+            PacketHeader header;
+            const uint64_t tag = PacketHeader::decode(packet.data(), packet.size(), header)
+                               ? (uint64_t) direct->second << 48 | (header.sequence & 0xffffffffffffull) : UDP_UNTRACKED;
+            if (numFragments <= 1) {
+                queueDirect(direct->second, packet.data(), packet.size(), tag);
+                return;
+            }
+            const uint32_t messageId = mNextMessageId++;
+            for (int i = 0; i < numFragments; i++) {
+                const size_t size = PacketFragmenter::writeFragment(packet.data(), packet.size(), messageId, i, maxDatagramSize, mFragment.data(), mFragment.size());
+                queueDirect(direct->second, mFragment.data(), size, i == 0 ? tag : UDP_UNTRACKED);
+            }
+            return;
+        }
+    }
+
+    // corelink_classic_client takes ownership of a vector per datagram and never hands it back, so
+    // the classic data plane costs one allocation and one copy per datagram; this is the minimum
+    // its API allows. The batched data plane above sends from the pooled packet without either.
+    // Per-packet metadata lives in the binary PacketHeader, so the json is always empty.
+    if (numFragments <= 1) {
+        mClient.send_data(hostId, std::vector<uint8_t>(packet.data(), packet.data() + packet.size()), meta);
+        return;
+    }
+
+    // Each fragment is written straight into the vector handed over, so splitting adds no copy of its own
+    const uint32_t messageId = mNextMessageId++;
+    for (int i = 0; i < numFragments; i++) {
+        std::vector<uint8_t> fragment(maxDatagramSize);
+        const size_t size = PacketFragmenter::writeFragment(packet.data(), packet.size(), messageId, i, maxDatagramSize, fragment.data(), fragment.size());
+        fragment.resize(size);
+        mClient.send_data(hostId, std::move(fragment), meta);
+    }
+}
+
+/**
+ * @brief Selects the data plane for senders created from now on. Existing senders keep theirs
+*/
+void CorelinkClient::setDataPlane(DataPlane dataPlane) {
+    mDataPlane.store(dataPlane, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Sends whatever the batched data plane is holding. Called by the sending thread whenever it runs out of packets
+*/
+void CorelinkClient::flush() {
+    mTransmitStamps.clear();
+    {
+        std::lock_guard<std::mutex> lock(mDirectLock);
+        mTransport.flush();
+        // Stamps of this batch usually come in by the next flush
+        mTransport.readTransmitStamps([this](uint64_t tag, uint64_t kernelSendNs) {
+            if (mTransmitStamps.size() < mTransmitStamps.capacity()) {
+                mTransmitStamps.emplace_back(tag, kernelSendNs);
+            }
+        });
+    }
+    if (mTransmitCallback) {
+        for (const auto& [tag, kernelSendNs] : mTransmitStamps) {
+            mTransmitCallback((int) (tag >> 48), tag & 0xffffffffffffull, kernelSendNs);
+        }
+    }
+}
+
+void CorelinkClient::setTransmitCallback(TransmitCallback callback) {
+    mTransmitCallback = std::move(callback);
+}
+
+/**
+ * @brief Returns the SocketTimestamping::Capability bits of the batched data plane's socket, 0 while it is not open
+*/
+unsigned CorelinkClient::getDataPlaneTimestamping() const {
+    std::lock_guard<std::mutex> lock(mDirectLock);
+    return mTransport.getTimestamping();
+}
+
+/**
+ * @brief Routes the sender on hostId through the batched transport, opened on the server's data port the first time
+*/
+void CorelinkClient::openDirectStream(corelink::core::network::channel_id_type hostId, int streamId, int port) {
+    std::lock_guard<std::mutex> lock(mDirectLock);
+    if (!mTransport.isOpen() && !mTransport.open(mInfo.hostname, port)) {
+        DBG("Batched data plane unavailable, stream " << streamId << " stays on Corelink");
+        return;
+    }
+    mDirectStreams[hostId] = streamId;
+}
+
+/**
+ * @brief Frames one datagram the way the Corelink server expects and queues it on the batch
+ *
+ * Corelink datagrams start with the JSON header's length and the data's length, both 16-bit
+ * little-endian, followed by the header naming the stream and then the data.
+*/
+void CorelinkClient::queueDirect(int streamId, const uint8_t* data, size_t size, uint64_t tag) {
+    uint8_t prefix[48];
+    const int headerSize = std::snprintf(reinterpret_cast<char*>(prefix + 4), sizeof(prefix) - 4, "{\"id\":%d}", streamId);
+    prefix[0] = (uint8_t) (headerSize & 0xff);
+    prefix[1] = (uint8_t) (headerSize >> 8);
+    prefix[2] = (uint8_t) (size & 0xff);
+    prefix[3] = (uint8_t) (size >> 8);
+    mTransport.queue(prefix, 4 + (size_t) headerSize, data, size, tag);
+}
+
 void CorelinkClient::setControlChannelId(corelink::core::network::channel_id_type controlChannelId){
     mControlChannelId = controlChannelId;
 }
 
 void CorelinkClient::setInfo(const juce::String& hostId, const juce::String& username) {
     mInfo.set_hostname(hostId.toStdString());
-    mInfo.set_port_number(20010);
+    mInfo.set_port_number(CORELINK_SERVER_PORT);
     mUsername = username.toStdString();
 }
@@ -22,8 +22,16 @@
 
 #include "BinaryData.h"
 #include "corelink_all.hpp"
+#include "PacketFragmenter.h"
+#include "PacketHeader.h"
+#include "PacketPool.h"
+#include "StreamIngest.h"
+#include "UdpBatchTransport.h"
 #include <cstdint>
-class SenderAudioProcessor;
+#include <mutex>
+#include <unordered_map>
+
+#define CORELINK_SERVER_PORT 20010
 
 template<typename t> using in = corelink::in<t>;
 template<typename t> using out = corelink::out<t>;
@@ -34,26 +42,63 @@ public:
     std::string mCertPath;
     corelink::client::corelink_client_connection_info mInfo = corelink::client::corelink_client_connection_info(corelink::core::network::constants::protocols::tcp).set_certificate_path(mCertPath);
     corelink::client::corelink_classic_client mClient;
-    corelink::core::network::channel_id_type mHostId;
-    corelink::core::network::channel_id_type mStreamId;
     corelink::core::network::channel_id_type mControlChannelId;
 
+    // Called on the network thread with the sending stream's id and the datagram's payload
+    using ReceiveCallback = std::function<void(int sourceStreamId, const uint8_t* data, size_t size, uint64_t arrivalNs)>;
+    // Called once a data stream exists, with the data channel it is sent on and its server-side id
+    using StreamCallback = std::function<void(int statusCode, corelink::core::network::channel_id_type hostId, corelink::core::network::channel_id_type streamId)>;
+    using ErrorCallback = std::function<void(corelink::core::network::channel_id_type, in<std::string>)>;
+    using ChannelCallback = std::function<void(corelink::core::network::channel_id_type)>;
+    // Called when a receiver subscribes to one of this client's streams, with that stream's server-side id
+    using SubscribeCallback = std::function<void(int statusCode, int streamId)>;
+    // Called on the sending thread when the kernel sent an audio packet of a stream on the batched data plane
+    using TransmitCallback = std::function<void(int streamId, uint64_t sequence, uint64_t kernelSendNs)>;
+    // Called with a server message that lists streams with their meta, see parseStreamAnnouncements()
+    using AnnounceCallback = std::function<void(const std::string& message)>;
+
     CorelinkClient();
     ~CorelinkClient();
 
-    void addControlChannel(SenderAudioProcessor* senderAudioProcessor);
+    void addControlChannel(ErrorCallback onError, ChannelCallback onInit, ChannelCallback onUninit);
     bool initProtocols();
     void authenticate(const juce::String& username, const juce::String& password, const std::function<void(int)>& cb);
     void disconnectChannel(std::vector<corelink::core::network::channel_id_type> streamIDs, const std::function<void(int, corelink::core::network::channel_id_type)> cb);
 
-    void addOnSubscribe(const std::function<void(int)>& cb);
-    void createSender(const juce::String& workspace, const juce::String& stream_type, const std::function<void(int)> cb);
+    void addOnSubscribe(const SubscribeCallback& cb);
+    void addOnUpdate(const AnnounceCallback& cb);
+    void createSender(const juce::String& workspace, const juce::String& stream_type, const StreamFormat& format, const StreamCallback cb);
+    void createReceiver(const juce::String& workspace, const juce::String& stream_type, ReceiveCallback onReceive, const StreamCallback cb, const AnnounceCallback onStreams = nullptr);
+    void subscribe(corelink::core::network::channel_id_type receiverStreamId, corelink::core::network::channel_id_type streamId, const std::function<void(int)>& cb);
     void sendData(corelink::core::network::channel_id_type hostId, std::vector<uint8_t> mData, corelink::utils::json meta);
+    void sendData(corelink::core::network::channel_id_type hostId, PacketHandle packet, size_t maxDatagramSize);
     void setInfo(const juce::String& hostId, const juce::String& username);
 
+    void setDataPlane(DataPlane dataPlane);
+    DataPlane getDataPlane() const { return mDataPlane.load(std::memory_order_relaxed); }
+    void flush();
+    /** Must be set before anything is sent */
+    void setTransmitCallback(TransmitCallback callback);
+    UdpBatchTransport::Counters getDataPlaneCounters() const { return mTransport.getCounters(); }
+    unsigned getDataPlaneTimestamping() const;
+
 private:
     corelink::utils::json meta;
     std::vector<uint8_t> mData;
+    uint32_t mNextMessageId = 0;
+
+    // Senders created while the batched data plane is selected, by data channel, with their stream id
+    std::atomic<DataPlane> mDataPlane { DataPlane::Corelink };
+    mutable std::mutex mDirectLock;
+    UdpBatchTransport mTransport;
+    std::unordered_map<corelink::core::network::channel_id_type, int> mDirectStreams;
+    std::vector<uint8_t> mFragment;
+    TransmitCallback mTransmitCallback;
+    // Transmit stamps read under mDirectLock, passed on after it is released; sending thread only
+    std::vector<std::pair<uint64_t, uint64_t>> mTransmitStamps;
+
+    void openDirectStream(corelink::core::network::channel_id_type hostId, int streamId, int port);
+    void queueDirect(int streamId, const uint8_t* data, size_t size, uint64_t tag = UDP_UNTRACKED);
 
     void setControlChannelId(corelink::core::network::channel_id_type controlChannelId);
 };
@@ -0,0 +1,96 @@
+#include "DriftEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+void DriftEstimator::prepare(double sampleRate)
+{
+    mSampleRate = sampleRate;
+    mBinLength = DRIFT_BIN_MS * sampleRate / 1000.0;
+    reset();
+}
+
+void DriftEstimator::reset()
+{
+    mNumBins = 0;
+    mNextBin = 0;
+    mHasBin = false;
+    mHasOrigin = false;
+    mHasEstimate = false;
+    mRatio = 1.0;
+}
+
+void DriftEstimator::addPacket(uint64_t senderPosition, double localPosition)
+{
+    if (!mHasOrigin)
+    {
+        mOriginTime = localPosition;
+        mOriginOffset = localPosition - (double) senderPosition;
+        mHasOrigin = true;
+    }
+
+    const double time = localPosition - mOriginTime;
+    const double offset = localPosition - (double) senderPosition - mOriginOffset;
+
+    if (mHasBin && std::abs(offset - mCurrent.offset) > mSampleRate)
+    {
+        // Not drift: the sender restarted or its positions jumped
+        reset();
+        addPacket(senderPosition, localPosition);
+        return;
+    }
+
+    if (!mHasBin)
+    {
+        mBinStart = time;
+        mCurrent = { time, offset };
+        mHasBin = true;
+        return;
+    }
+
+    if (offset < mCurrent.offset)
+        mCurrent = { time, offset };
+
+    if (time - mBinStart >= mBinLength)
+    {
+        mBins[(size_t) mNextBin] = mCurrent;
+        mNextBin = (mNextBin + 1) % DRIFT_NUM_BINS;
+        mNumBins = std::min(mNumBins + 1, DRIFT_NUM_BINS);
+        mBinStart = time;
+        mCurrent = { time, offset };
+        fit();
+    }
+}
+
+/**
+ * @brief Fits a line through the bin minima; its slope is the drift in local samples per local sample
+*/
+void DriftEstimator::fit()
+{
+    if (mNumBins < DRIFT_MIN_BINS)
+        return;
+
+    double meanTime = 0.0, meanOffset = 0.0;
+    for (int i = 0; i < mNumBins; ++i)
+    {
+        meanTime += mBins[(size_t) i].time;
+        meanOffset += mBins[(size_t) i].offset;
+    }
+    meanTime /= mNumBins;
+    meanOffset /= mNumBins;
+
+    double covariance = 0.0, variance = 0.0;
+    for (int i = 0; i < mNumBins; ++i)
+    {
+        const double dt = mBins[(size_t) i].time - meanTime;
+        covariance += dt * (mBins[(size_t) i].offset - meanOffset);
+        variance += dt * dt;
+    }
+    if (variance <= 0.0)
+        return;
+
+    // The offset shrinks when the sender's clock runs fast, so it must be played faster
+    const double slope = covariance / variance;
+    mRatio = 1.0 - std::clamp(slope, -DRIFT_MAX_PPM * 1e-6, DRIFT_MAX_PPM * 1e-6);
+    mHasEstimate = true;
+}
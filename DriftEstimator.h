@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#define DRIFT_BIN_MS 1000.0
+#define DRIFT_NUM_BINS 64
+#define DRIFT_MIN_BINS 4
+#define DRIFT_MAX_PPM 1000.0
+
+/**
+ * @brief Estimates how fast the sender's sample clock runs against the local one
+ *
+ * Each packet gives its sender sample position and the local output sample count when it
+ * arrived. Their difference grows or shrinks with the clock drift, buried in network jitter.
+ * The smallest difference in each DRIFT_BIN_MS bin tracks the fastest path, which is stable;
+ * a least-squares line through the last DRIFT_NUM_BINS bin minima gives the drift.
+ *
+ * getRatio() is the number of sender samples to play per local sample. Positions jumping by more
+ * than a second (a restarted sender) start the estimate over.
+*/
+class DriftEstimator
+{
+public:
+    DriftEstimator() = default;
+
+    void prepare(double sampleRate);
+    void reset();
+
+    void addPacket(uint64_t senderPosition, double localPosition);
+
+    bool hasEstimate() const { return mHasEstimate; }
+    double getRatio() const { return mRatio; }
+    double getDriftPpm() const { return (mRatio - 1.0) * 1e6; }
+
+private:
+    void fit();
+
+    struct Bin
+    {
+        double time = 0.0;
+        double offset = 0.0;
+    };
+
+    double mSampleRate = 48000.0;
+    double mBinLength = 0.0;
+
+    std::array<Bin, DRIFT_NUM_BINS> mBins;
+    int mNumBins = 0;
+    int mNextBin = 0;
+
+    bool mHasBin = false;
+    double mBinStart = 0.0;
+    Bin mCurrent;
+
+    // Offsets are kept relative to the first packet so the fit stays well conditioned
+    bool mHasOrigin = false;
+    double mOriginTime = 0.0;
+    double mOriginOffset = 0.0;
+
+    bool mHasEstimate = false;
+    double mRatio = 1.0;
+};
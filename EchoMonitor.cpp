@@ -0,0 +1,187 @@
+#include "EchoMonitor.h"
+
+#include <algorithm>
+
+#include "PacketHeader.h"
+
+namespace
+{
+    constexpr int kReassemblySlots = 4;
+}
+
+/**
+ * @brief Allocates the history and the echo reassembly buffers and clears everything
+*/
+void EchoMonitor::prepare(size_t maxPacketSize, int historyPackets)
+{
+    mNumSlots = (size_t) std::max(1, historyPackets);
+    mSlots = std::make_unique<Slot[]>(mNumSlots);
+    mReassembler.prepare(kReassemblySlots, maxPacketSize);
+    mStatistics.prepare();
+    mUserStatistics.prepare();
+
+    mHasSent = false;
+    mNextToJudge = 0;
+    mLoss = 0.0;
+    mHasEcho = false;
+    mHighestEchoed = 0;
+    mReorder = 0.0;
+    for (auto* counter : { &mSent, &mEchoed, &mLost, &mLate, &mReordered, &mDuplicates, &mKernelStamped })
+        counter->store(0, std::memory_order_relaxed);
+    mLossRate.store(0.0, std::memory_order_relaxed);
+    mReorderRate.store(0.0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Notes a packet just sent at sendNs on our monotonic clock. Sender thread only
+*/
+void EchoMonitor::onSent(uint64_t sequence, uint64_t sendNs)
+{
+    if (!mSlots)
+        return;
+
+    if (!mHasSent || sequence < mNextToJudge)
+    {
+        mHasSent = true;
+        mNextToJudge = sequence;
+    }
+    // Packets whose slots have been reused can no longer be judged
+    if (sequence - mNextToJudge > mNumSlots)
+        mNextToJudge = sequence - mNumSlots;
+    judge(sequence, sendNs);
+
+    // Readers compare the sequence before and after reading the slot, like a sequence lock
+    auto& slot = mSlots[sequence % mNumSlots];
+    slot.sequence.store(UINT64_MAX, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.sendNs.store(sendNs, std::memory_order_relaxed);
+    slot.kernelSendNs.store(0, std::memory_order_relaxed);
+    slot.state.store(Pending, std::memory_order_relaxed);
+    slot.sequence.store(sequence, std::memory_order_release);
+    bump(mSent);
+}
+
+/**
+ * @brief Notes when the kernel sent a packet. Only the thread reading transmit stamps
+*/
+void EchoMonitor::onTransmitted(uint64_t sequence, uint64_t kernelSendNs)
+{
+    if (!mSlots)
+        return;
+
+    auto& slot = mSlots[sequence % mNumSlots];
+    if (slot.sequence.load(std::memory_order_acquire) != sequence || slot.state.load(std::memory_order_relaxed) != Pending)
+        return;
+    slot.kernelSendNs.store(kernelSendNs, std::memory_order_release);
+    bump(mKernelStamped);
+}
+
+/**
+ * @brief Settles every packet sent before sequence whose echo has had ECHO_LOSS_TIMEOUT_MS to come back
+*/
+void EchoMonitor::judge(uint64_t sequence, uint64_t nowNs)
+{
+    const auto timeoutNs = (uint64_t) (ECHO_LOSS_TIMEOUT_MS * 1e6);
+    for (; mNextToJudge < sequence; ++mNextToJudge)
+    {
+        auto& slot = mSlots[mNextToJudge % mNumSlots];
+        if (slot.sequence.load(std::memory_order_relaxed) != mNextToJudge)
+            continue;
+        if (slot.sendNs.load(std::memory_order_relaxed) + timeoutNs > nowNs)
+            break;
+
+        // The network thread may be marking it echoed right now; whoever swaps first decides
+        uint8_t expected = Pending;
+        const bool lost = slot.state.compare_exchange_strong(expected, Lost, std::memory_order_relaxed);
+        if (lost)
+            bump(mLost);
+        mLoss += ((lost ? 1.0 : 0.0) - mLoss) / ECHO_RATE_PACKETS;
+        mLossRate.store(mLoss, std::memory_order_relaxed);
+    }
+}
+
+bool EchoMonitor::onEcho(const uint8_t* data, size_t size, uint64_t arrivalNs)
+{
+    if (!mSlots)
+        return false;
+
+    if (FragmentHeader::isFragment(data, size))
+    {
+        const uint8_t* message = nullptr;
+        size_t messageSize = 0;
+        if (!mReassembler.addFragment(data, size, message, messageSize))
+            return false;
+        data = message;
+        size = messageSize;
+    }
+
+    // FEC repair packets fail here along with anything else that is not an audio packet
+    PacketHeader header;
+    if (!PacketHeader::decode(data, size, header))
+        return false;
+
+    auto& slot = mSlots[header.sequence % mNumSlots];
+    if (slot.sequence.load(std::memory_order_acquire) != header.sequence)
+        return false;
+    const uint64_t userSendNs = slot.sendNs.load(std::memory_order_relaxed);
+    const uint64_t kernelSendNs = slot.kernelSendNs.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != header.sequence || arrivalNs < userSendNs)
+        return false;
+    // A stamp from before the packet was built or after its echo came back belongs to another packet
+    const bool kernelStamped = kernelSendNs >= userSendNs && kernelSendNs <= arrivalNs;
+    const uint64_t sendNs = kernelStamped ? kernelSendNs : userSendNs;
+
+    uint8_t expected = Pending;
+    if (!slot.state.compare_exchange_strong(expected, Echoed, std::memory_order_relaxed))
+    {
+        if (expected == Echoed)
+        {
+            bump(mDuplicates);
+            return false;
+        }
+        slot.state.store(Echoed, std::memory_order_relaxed);
+        bump(mLate);
+    }
+    bump(mEchoed);
+
+    const bool reordered = mHasEcho && header.sequence < mHighestEchoed;
+    if (reordered)
+        bump(mReordered);
+    else
+        mHighestEchoed = header.sequence;
+    mHasEcho = true;
+    mReorder += ((reordered ? 1.0 : 0.0) - mReorder) / ECHO_RATE_PACKETS;
+    mReorderRate.store(mReorder, std::memory_order_relaxed);
+
+    // Both ends of the round trip are on our clock, so the transit time is the round trip itself
+    mStatistics.addRoundTrip(arrivalNs - sendNs, arrivalNs);
+    mStatistics.addArrival(sendNs, arrivalNs);
+    if (kernelStamped)
+    {
+        mUserStatistics.addRoundTrip(arrivalNs - userSendNs, arrivalNs);
+        mUserStatistics.addArrival(userSendNs, arrivalNs);
+    }
+    return true;
+}
+
+EchoMonitor::Counters EchoMonitor::getCounters() const
+{
+    Counters counters;
+    counters.sent = mSent.load(std::memory_order_relaxed);
+    counters.echoed = mEchoed.load(std::memory_order_relaxed);
+    counters.lost = mLost.load(std::memory_order_relaxed);
+    counters.late = mLate.load(std::memory_order_relaxed);
+    counters.reordered = mReordered.load(std::memory_order_relaxed);
+    counters.duplicates = mDuplicates.load(std::memory_order_relaxed);
+    counters.kernelStamped = mKernelStamped.load(std::memory_order_relaxed);
+    return counters;
+}
+
+/**
+ * @brief Single-writer increment
+*/
+void EchoMonitor::bump(std::atomic<uint64_t>& counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "JitterStatistics.h"
+#include "PacketFragmenter.h"
+
+#define ECHO_HISTORY_PACKETS 4096
+#define ECHO_LOSS_TIMEOUT_MS 1000.0
+#define ECHO_RATE_PACKETS 256
+
+/**
+ * @brief Round-trip time, loss and reordering of the live audio stream, from its own echo
+ *
+ * The server echoes every packet the sender sends back to it. onSent() notes each packet's
+ * sequence number and send time in a ring of historyPackets slots; onEcho() matches the echo by
+ * sequence number, so the round trip costs no bandwidth beyond the echo itself. Fragmented
+ * packets count once all their fragments are back; FEC repair packets are not tracked, so the
+ * loss is that of the raw path.
+ *
+ * A packet whose echo is not back ECHO_LOSS_TIMEOUT_MS after it was sent is counted lost; an
+ * echo that turns up later still gives a round-trip time and is counted late. An echo of a
+ * lower sequence number than one already back is counted reordered. Next to the totals, the
+ * loss and reorder rates are kept as running averages over about ECHO_RATE_PACKETS packets.
+ * Round-trip times go into JitterStatistics: its RoundTrip metric holds the percentiles, its
+ * jitter the RFC 3550 jitter of the round trip and its queueing delay the time above the fastest.
+ *
+ * When the socket reports when the kernel actually sent a packet (see UdpBatchTransport),
+ * onTransmitted() replaces the user-space send time with that stamp, so time the packet spent
+ * queued in the plugin no longer counts as network delay. The round trips from the user-space
+ * send times go into a second set of statistics, kept only for such packets, for comparison.
+ * A stamp must arrive before its slot is reused; one that does not fit between the send and the
+ * echo is ignored.
+ *
+ * onSent() runs on the sender thread, onTransmitted() on the thread that reads the transmit
+ * stamps and onEcho() on the network thread; they share only atomics. The getters may be called from any thread. prepare() allocates and must not run
+ * concurrently with either; nothing else does. historyPackets must cover ECHO_LOSS_TIMEOUT_MS
+ * of packets, or packets are overwritten before they can be judged and go uncounted.
+*/
+class EchoMonitor
+{
+public:
+    EchoMonitor() = default;
+
+    void prepare(size_t maxPacketSize, int historyPackets = ECHO_HISTORY_PACKETS);
+
+    void onSent(uint64_t sequence, uint64_t sendNs);
+    /** Takes the kernel's transmit stamp of a packet, on the clock of sendNs */
+    void onTransmitted(uint64_t sequence, uint64_t kernelSendNs);
+    /** Takes an echoed datagram; returns true if it completed the echo of a tracked packet */
+    bool onEcho(const uint8_t* data, size_t size, uint64_t arrivalNs);
+
+    struct Counters
+    {
+        uint64_t sent = 0;
+        uint64_t echoed = 0;
+        uint64_t lost = 0;
+        uint64_t late = 0;
+        uint64_t reordered = 0;
+        uint64_t duplicates = 0;
+        uint64_t kernelStamped = 0;
+    };
+
+    Counters getCounters() const;
+    double getLossRate() const { return mLossRate.load(std::memory_order_relaxed); }
+    double getReorderRate() const { return mReorderRate.load(std::memory_order_relaxed); }
+    const JitterStatistics& getStatistics() const { return mStatistics; }
+    /** Round trips from the user-space send times of the packets that also had a kernel stamp */
+    const JitterStatistics& getUserStatistics() const { return mUserStatistics; }
+
+private:
+    enum State : uint8_t
+    {
+        Pending,
+        Echoed,
+        Lost
+    };
+
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence { UINT64_MAX };
+        std::atomic<uint64_t> sendNs { 0 };
+        std::atomic<uint64_t> kernelSendNs { 0 };
+        std::atomic<uint8_t> state { Pending };
+    };
+
+    void judge(uint64_t sequence, uint64_t nowNs);
+    static void bump(std::atomic<uint64_t>& counter);
+
+    std::unique_ptr<Slot[]> mSlots;
+    size_t mNumSlots = 0;
+    JitterStatistics mStatistics;
+    JitterStatistics mUserStatistics;
+
+    // Sender thread
+    bool mHasSent = false;
+    uint64_t mNextToJudge = 0;
+    double mLoss = 0.0;
+
+    // Network thread
+    PacketReassembler mReassembler;
+    bool mHasEcho = false;
+    uint64_t mHighestEchoed = 0;
+    double mReorder = 0.0;
+
+    std::atomic<uint64_t> mSent { 0 };
+    std::atomic<uint64_t> mEchoed { 0 };
+    std::atomic<uint64_t> mLost { 0 };
+    std::atomic<uint64_t> mLate { 0 };
+    std::atomic<uint64_t> mReordered { 0 };
+    std::atomic<uint64_t> mDuplicates { 0 };
+    std::atomic<uint64_t> mKernelStamped { 0 };
+    std::atomic<double> mLossRate { 0.0 };
+    std::atomic<double> mReorderRate { 0.0 };
+};
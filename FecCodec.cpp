@@ -0,0 +1,558 @@
+#include "FecCodec.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    void writeU32(uint8_t* p, uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            p[i] = (uint8_t) (v >> (8 * i));
+    }
+
+    void writeU64(uint8_t* p, uint64_t v)
+    {
+        for (int i = 0; i < 8; ++i)
+            p[i] = (uint8_t) (v >> (8 * i));
+    }
+
+    uint16_t readU16(const uint8_t* p)
+    {
+        return (uint16_t) (p[0] | (p[1] << 8));
+    }
+
+    uint32_t readU32(const uint8_t* p)
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= (uint32_t) p[i] << (8 * i);
+        return v;
+    }
+
+    uint64_t readU64(const uint8_t* p)
+    {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i)
+            v |= (uint64_t) p[i] << (8 * i);
+        return v;
+    }
+
+    /**
+     * @brief GF(256) arithmetic with the polynomial x^8 + x^4 + x^3 + x^2 + 1
+     *
+     * The full product table is 64 KB; a multiply-add then costs one lookup per byte, using the
+     * 256-byte row of the coefficient.
+    */
+    struct GaloisField
+    {
+        uint8_t exp[512];
+        uint8_t log[256];
+        uint8_t mul[256][256];
+
+        GaloisField()
+        {
+            int x = 1;
+            for (int i = 0; i < 255; ++i)
+            {
+                exp[i] = (uint8_t) x;
+                exp[i + 255] = (uint8_t) x;
+                log[x] = (uint8_t) i;
+                x <<= 1;
+                if (x & 0x100)
+                    x ^= 0x11d;
+            }
+            exp[510] = exp[0];
+            exp[511] = exp[1];
+            log[0] = 0;
+
+            for (int a = 0; a < 256; ++a)
+                for (int b = 0; b < 256; ++b)
+                    mul[a][b] = (a == 0 || b == 0) ? 0 : exp[log[a] + log[b]];
+        }
+
+        uint8_t inverse(uint8_t a) const { return exp[255 - log[a]]; }
+        uint8_t divide(uint8_t a, uint8_t b) const { return a == 0 ? 0 : exp[log[a] + 255 - log[b]]; }
+    };
+
+    const GaloisField& gf()
+    {
+        static const GaloisField field;
+        return field;
+    }
+
+    /** dest ^= c * src over size bytes */
+    void mulAdd(uint8_t* dest, const uint8_t* src, size_t size, uint8_t c)
+    {
+        if (c == 0)
+            return;
+        if (c == 1)
+        {
+            for (size_t n = 0; n < size; ++n)
+                dest[n] ^= src[n];
+            return;
+        }
+        const uint8_t* row = gf().mul[c];
+        for (size_t n = 0; n < size; ++n)
+            dest[n] ^= row[src[n]];
+    }
+
+    /** Adds c times the symbol of a packet (length prefix, then the bytes) to dest */
+    void mulAddSymbol(uint8_t* dest, const uint8_t* packet, uint32_t size, uint8_t c)
+    {
+        uint8_t prefix[4];
+        writeU32(prefix, size);
+        mulAdd(dest, prefix, 4, c);
+        mulAdd(dest + 4, packet, size, c);
+    }
+
+    /** Inverts the n x n matrix a in place of inv with Gauss-Jordan elimination. Fails if a is singular */
+    bool invert(uint8_t* a, uint8_t* inv, int n)
+    {
+        const auto& field = gf();
+        std::fill(inv, inv + n * n, 0);
+        for (int i = 0; i < n; ++i)
+            inv[i * n + i] = 1;
+
+        for (int col = 0; col < n; ++col)
+        {
+            int pivot = col;
+            while (pivot < n && a[pivot * n + col] == 0)
+                ++pivot;
+            if (pivot == n)
+                return false;
+            if (pivot != col)
+            {
+                std::swap_ranges(a + pivot * n, a + pivot * n + n, a + col * n);
+                std::swap_ranges(inv + pivot * n, inv + pivot * n + n, inv + col * n);
+            }
+
+            const uint8_t scale = field.inverse(a[col * n + col]);
+            for (int j = 0; j < n; ++j)
+            {
+                a[col * n + j] = field.mul[scale][a[col * n + j]];
+                inv[col * n + j] = field.mul[scale][inv[col * n + j]];
+            }
+
+            for (int row = 0; row < n; ++row)
+            {
+                const uint8_t factor = a[row * n + col];
+                if (row == col || factor == 0)
+                    continue;
+                mulAdd(a + row * n, a + col * n, (size_t) n, factor);
+                mulAdd(inv + row * n, inv + col * n, (size_t) n, factor);
+            }
+        }
+        return true;
+    }
+}
+
+size_t FecHeader::encode(uint8_t* dest, size_t capacity) const
+{
+    if (capacity < kSize)
+        return 0;
+
+    dest[0] = (uint8_t) FEC_HEADER_MAGIC;
+    dest[1] = (uint8_t) (FEC_HEADER_MAGIC >> 8);
+    dest[2] = version;
+    dest[3] = flags;
+    dest[4] = k;
+    dest[5] = m;
+    dest[6] = index;
+    dest[7] = 0;
+    writeU64(dest + 8, baseSequence);
+    writeU32(dest + 16, symbolSize);
+    return kSize;
+}
+
+bool FecHeader::decode(const uint8_t* src, size_t size, FecHeader& header)
+{
+    if (!isRepair(src, size) || src[2] != FEC_HEADER_VERSION)
+        return false;
+
+    header.version = src[2];
+    header.flags = src[3];
+    header.k = src[4];
+    header.m = src[5];
+    header.index = src[6];
+    header.baseSequence = readU64(src + 8);
+    header.symbolSize = readU32(src + 16);
+    return Fec::isValidCode(header.k, header.m) && header.index < header.m && size >= kSize + header.symbolSize;
+}
+
+bool FecHeader::isRepair(const uint8_t* src, size_t size)
+{
+    return size >= kSize && readU16(src) == FEC_HEADER_MAGIC;
+}
+
+bool Fec::isValidCode(int k, int m)
+{
+    return k >= 1 && k <= FEC_MAX_SOURCE_PACKETS && m >= 1 && m <= FEC_MAX_REPAIR_PACKETS;
+}
+
+/**
+ * @brief Entry of the generator matrix: 1 / (x_j + y_i) with x_j = k + j and y_i = i, each
+ * column divided by its first-row entry. Scaling columns keeps every square submatrix invertible
+*/
+uint8_t Fec::getCoefficient(int k, int repairIndex, int sourceIndex)
+{
+    const auto& field = gf();
+    const uint8_t c = field.inverse((uint8_t) ((k + repairIndex) ^ sourceIndex));
+    const uint8_t first = field.inverse((uint8_t) (k ^ sourceIndex));
+    return field.divide(c, first);
+}
+
+size_t Fec::getSymbolSize(size_t packetSize)
+{
+    return 4 + packetSize;
+}
+
+/**
+ * @brief Allocates parity for the largest code and packets of up to maxPacketSize bytes
+*/
+void FecEncoder::prepare(size_t maxPacketSize)
+{
+    mMaxPacketSize = maxPacketSize;
+    mParity.assign(FEC_MAX_REPAIR_PACKETS, std::vector<uint8_t>(Fec::getSymbolSize(maxPacketSize), 0));
+    mSymbolSize = 0;
+    reset();
+}
+
+/**
+ * @brief Switches to k source and m repair packets per group; k = 0 turns protection off
+*/
+bool FecEncoder::setCode(int k, int m)
+{
+    if (k != 0 && !Fec::isValidCode(k, m))
+        return false;
+
+    mK = k;
+    mM = k == 0 ? 0 : m;
+    reset();
+    return true;
+}
+
+void FecEncoder::reset()
+{
+    mInGroup = false;
+    mNumInGroup = 0;
+}
+
+int FecEncoder::addPacket(const uint8_t* packet, size_t size, uint64_t sequence)
+{
+    if (mK == 0)
+        return 0;
+
+    if (mInGroup && sequence != mBaseSequence + (uint64_t) mNumInGroup)
+    {
+        // A packet went out without passing through here; the group can no longer be decoded
+        mInGroup = false;
+    }
+
+    if (!mInGroup)
+    {
+        if (sequence % (uint64_t) mK != 0)
+            return 0;
+        startGroup(sequence);
+    }
+
+    if (size > mMaxPacketSize)
+    {
+        mInGroup = false;
+        return 0;
+    }
+
+    for (int j = 0; j < mM; ++j)
+        mulAddSymbol(mParity[(size_t) j].data(), packet, (uint32_t) size, Fec::getCoefficient(mK, j, mNumInGroup));
+    mSymbolSize = std::max(mSymbolSize, Fec::getSymbolSize(size));
+
+    if (++mNumInGroup < mK)
+        return 0;
+
+    mInGroup = false;
+    return mM;
+}
+
+size_t FecEncoder::writeRepairPacket(int index, uint8_t* dest, size_t capacity) const
+{
+    if (index < 0 || index >= mM || mNumInGroup != mK || capacity < FecHeader::kSize + mSymbolSize)
+        return 0;
+
+    FecHeader header;
+    header.k = (uint8_t) mK;
+    header.m = (uint8_t) mM;
+    header.index = (uint8_t) index;
+    header.baseSequence = mBaseSequence;
+    header.symbolSize = (uint32_t) mSymbolSize;
+    header.encode(dest, capacity);
+    std::memcpy(dest + FecHeader::kSize, mParity[(size_t) index].data(), mSymbolSize);
+    return FecHeader::kSize + mSymbolSize;
+}
+
+void FecEncoder::startGroup(uint64_t baseSequence)
+{
+    // Only the bytes the previous group touched can be non-zero
+    for (auto& parity : mParity)
+        std::fill(parity.begin(), parity.begin() + (std::ptrdiff_t) mSymbolSize, 0);
+
+    mInGroup = true;
+    mNumInGroup = 0;
+    mBaseSequence = baseSequence;
+    mSymbolSize = 0;
+}
+
+/**
+ * @brief Allocates the packet history and the repair group slots
+*/
+void FecDecoder::prepare(size_t maxPacketSize, int historySize, int numGroups)
+{
+    mMaxPacketSize = maxPacketSize;
+    const size_t symbolSize = Fec::getSymbolSize(maxPacketSize);
+
+    mSources.assign((size_t) std::max(historySize, FEC_MAX_SOURCE_PACKETS), Source());
+    for (auto& source : mSources)
+        source.data.resize(maxPacketSize);
+
+    mGroups.assign((size_t) std::max(1, numGroups), Group());
+    for (auto& group : mGroups)
+        group.repair.assign(FEC_MAX_REPAIR_PACKETS, std::vector<uint8_t>(symbolSize));
+
+    mRecovered.reserve(FEC_MAX_SOURCE_PACKETS);
+    mMissing.reserve(FEC_MAX_SOURCE_PACKETS);
+    mRows.reserve(FEC_MAX_REPAIR_PACKETS);
+    mMatrix.resize(FEC_MAX_REPAIR_PACKETS * FEC_MAX_REPAIR_PACKETS);
+    mInverse.resize(FEC_MAX_REPAIR_PACKETS * FEC_MAX_REPAIR_PACKETS);
+    mSymbol.resize(symbolSize);
+
+    reset();
+}
+
+void FecDecoder::reset()
+{
+    for (auto& source : mSources)
+        source.valid = false;
+    for (auto& group : mGroups)
+        group.active = false;
+    mRecovered.clear();
+    mHasSequence = false;
+    mNewestSequence = 0;
+    mNumRecovered = 0;
+    mNumUnrecoverable = 0;
+    mNumRejected = 0;
+}
+
+int FecDecoder::addSourcePacket(const uint8_t* packet, size_t size, uint64_t sequence)
+{
+    mRecovered.clear();
+    if (mSources.empty() || size > mMaxPacketSize)
+    {
+        ++mNumRejected;
+        return 0;
+    }
+    if (findSource(sequence) != nullptr)
+        return 0;
+
+    auto& source = storeSource(sequence);
+    source.size = (uint32_t) size;
+    std::memcpy(source.data.data(), packet, size);
+
+    for (auto& group : mGroups)
+    {
+        if (group.active && sequence >= group.baseSequence && sequence < group.baseSequence + (uint64_t) group.k)
+            tryRecover(group);
+    }
+    return (int) mRecovered.size();
+}
+
+int FecDecoder::addRepairPacket(const uint8_t* data, size_t size)
+{
+    mRecovered.clear();
+    FecHeader header;
+    if (mGroups.empty() || !FecHeader::decode(data, size, header) || header.symbolSize > Fec::getSymbolSize(mMaxPacketSize))
+    {
+        ++mNumRejected;
+        return 0;
+    }
+
+    auto* group = findGroup(header);
+    if (group == nullptr)
+        return 0;
+
+    const uint32_t bit = 1u << header.index;
+    if ((group->received & bit) == 0)
+    {
+        group->received |= bit;
+        std::memcpy(group->repair[header.index].data(), data + FecHeader::kSize, header.symbolSize);
+        tryRecover(*group);
+    }
+    return (int) mRecovered.size();
+}
+
+const uint8_t* FecDecoder::getRecoveredPacket(int index, size_t& size, uint64_t& sequence) const
+{
+    if (index < 0 || index >= (int) mRecovered.size())
+        return nullptr;
+
+    const auto& source = mSources[(size_t) mRecovered[(size_t) index]];
+    size = source.size;
+    sequence = source.sequence;
+    return source.data.data();
+}
+
+FecDecoder::Source* FecDecoder::findSource(uint64_t sequence)
+{
+    auto& source = mSources[(size_t) (sequence % mSources.size())];
+    return (source.valid && source.sequence == sequence) ? &source : nullptr;
+}
+
+FecDecoder::Source& FecDecoder::storeSource(uint64_t sequence)
+{
+    if (!mHasSequence || sequence > mNewestSequence)
+        mNewestSequence = sequence;
+    mHasSequence = true;
+
+    auto& source = mSources[(size_t) (sequence % mSources.size())];
+    source.valid = true;
+    source.sequence = sequence;
+    return source;
+}
+
+/**
+ * @brief Returns the slot for the repair packet's group, taking the oldest slot if it is new.
+ * nullptr if the group is already done or disagrees with the one being collected
+*/
+FecDecoder::Group* FecDecoder::findGroup(const FecHeader& header)
+{
+    Group* target = nullptr;
+    for (auto& group : mGroups)
+    {
+        if (group.active && group.baseSequence == header.baseSequence)
+        {
+            const bool same = group.k == header.k && group.m == header.m && group.symbolSize == header.symbolSize;
+            if (!same)
+                ++mNumRejected;
+            return same ? &group : nullptr;
+        }
+
+        if (target == nullptr || (target->active && (!group.active || group.baseSequence < target->baseSequence)))
+            target = &group;
+    }
+
+    // Every packet of the group already arrived, or the group fell out of the history
+    bool complete = true;
+    for (int i = 0; i < header.k && complete; ++i)
+        complete = findSource(header.baseSequence + (uint64_t) i) != nullptr;
+    if (complete || (mHasSequence && header.baseSequence + mSources.size() <= mNewestSequence))
+        return nullptr;
+
+    if (target->active)
+        closeGroup(*target);
+
+    target->active = true;
+    target->baseSequence = header.baseSequence;
+    target->k = header.k;
+    target->m = header.m;
+    target->symbolSize = header.symbolSize;
+    target->received = 0;
+    return target;
+}
+
+/**
+ * @brief Retires a group, counting the packets it failed to rebuild
+*/
+void FecDecoder::closeGroup(Group& group)
+{
+    for (int i = 0; i < group.k; ++i)
+    {
+        if (findSource(group.baseSequence + (uint64_t) i) == nullptr)
+            ++mNumUnrecoverable;
+    }
+    group.active = false;
+}
+
+void FecDecoder::tryRecover(Group& group)
+{
+    if (mNewestSequence >= group.baseSequence + mSources.size())
+    {
+        // The packets this group protects are no longer in the history
+        closeGroup(group);
+        return;
+    }
+
+    mMissing.clear();
+    for (int i = 0; i < group.k; ++i)
+    {
+        if (findSource(group.baseSequence + (uint64_t) i) == nullptr)
+            mMissing.push_back(i);
+    }
+
+    if (mMissing.empty())
+    {
+        group.active = false;
+        return;
+    }
+
+    mRows.clear();
+    for (int j = 0; j < group.m && mRows.size() < mMissing.size(); ++j)
+    {
+        if ((group.received & (1u << j)) != 0)
+            mRows.push_back(j);
+    }
+    if (mRows.size() < mMissing.size())
+        return;
+
+    // Remove the received packets from the parity, leaving e equations in the e missing symbols
+    const int e = (int) mMissing.size();
+    for (int u = 0; u < e; ++u)
+    {
+        auto* parity = group.repair[(size_t) mRows[(size_t) u]].data();
+        for (int i = 0; i < group.k; ++i)
+        {
+            const auto* source = findSource(group.baseSequence + (uint64_t) i);
+            if (source == nullptr)
+                continue;
+            if (Fec::getSymbolSize(source->size) > group.symbolSize)
+            {
+                // Cannot have been part of this group
+                ++mNumRejected;
+                closeGroup(group);
+                return;
+            }
+            mulAddSymbol(parity, source->data.data(), source->size, Fec::getCoefficient(group.k, mRows[(size_t) u], i));
+        }
+
+        for (int t = 0; t < e; ++t)
+            mMatrix[(size_t) (u * e + t)] = Fec::getCoefficient(group.k, mRows[(size_t) u], mMissing[(size_t) t]);
+    }
+
+    if (!invert(mMatrix.data(), mInverse.data(), e))
+    {
+        closeGroup(group);
+        return;
+    }
+
+    // Each missing symbol is a combination of the reduced parity rows
+    for (int t = 0; t < e; ++t)
+    {
+        uint8_t* symbol = mSymbol.data();
+        std::fill(symbol, symbol + group.symbolSize, 0);
+        for (int u = 0; u < e; ++u)
+            mulAdd(symbol, group.repair[(size_t) mRows[(size_t) u]].data(), group.symbolSize, mInverse[(size_t) (t * e + u)]);
+
+        const uint32_t size = readU32(symbol);
+        if (Fec::getSymbolSize(size) > group.symbolSize)
+        {
+            ++mNumRejected;
+            continue;
+        }
+
+        const uint64_t sequence = group.baseSequence + (uint64_t) mMissing[(size_t) t];
+        auto& source = storeSource(sequence);
+        source.size = size;
+        std::memcpy(source.data.data(), symbol + 4, size);
+        mRecovered.push_back((int) (sequence % mSources.size()));
+        ++mNumRecovered;
+    }
+
+    group.active = false;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define FEC_HEADER_MAGIC 0x4C52
+#define FEC_HEADER_VERSION 1
+#define FEC_MAX_SOURCE_PACKETS 64
+#define FEC_MAX_REPAIR_PACKETS 16
+
+/**
+ * @brief Header of a repair packet protecting a group of k consecutive audio packets
+ *
+ * Wire layout, little-endian, 20 bytes:
+ *   0  magic (u16)          2  version (u8)          3  flags (u8)
+ *   4  k (u8)               5  m (u8)                6  index (u8)     7  reserved (u8)
+ *   8  baseSequence (u64)  16  symbolSize (u32)
+ *
+ * The group holds the packets with PacketHeader sequence baseSequence .. baseSequence + k - 1.
+ * symbolSize bytes of parity follow the header. Each source packet enters the code as a symbol
+ * made of its length (u32) followed by the packet and zero padding up to symbolSize, so a
+ * rebuilt packet comes back with its exact size.
+*/
+struct FecHeader
+{
+    static constexpr size_t kSize = 20;
+
+    uint8_t version = FEC_HEADER_VERSION;
+    uint8_t flags = 0;
+    uint8_t k = 0;
+    uint8_t m = 0;
+    uint8_t index = 0;
+    uint64_t baseSequence = 0;
+    uint32_t symbolSize = 0;
+
+    size_t encode(uint8_t* dest, size_t capacity) const;
+    static bool decode(const uint8_t* src, size_t size, FecHeader& header);
+    static bool isRepair(const uint8_t* src, size_t size);
+};
+
+/**
+ * @brief Systematic erasure code over groups of k packets with m repair packets per group
+ *
+ * Repair packet j is the sum over GF(256) of C[j][i] times source symbol i, where C is a Cauchy
+ * matrix scaled so that its first row is all ones. Any k of the k + m packets of a group then
+ * rebuild the rest, and with m = 1 the code is plain XOR parity.
+*/
+namespace Fec
+{
+    bool isValidCode(int k, int m);
+    uint8_t getCoefficient(int k, int repairIndex, int sourceIndex);
+    size_t getSymbolSize(size_t packetSize);
+}
+
+/**
+ * @brief Sender side. Parity is accumulated as packets go out, so sources are never stored
+ *
+ * prepare() allocates for the largest code; setCode() switches codes without allocating.
+ * Group boundaries follow the packet sequence: a group starts on a multiple of k, and packets
+ * sent before the first boundary are unprotected.
+*/
+class FecEncoder
+{
+public:
+    FecEncoder() = default;
+
+    void prepare(size_t maxPacketSize);
+    bool setCode(int k, int m);
+    void reset();
+
+    int getNumSourcePackets() const { return mK; }
+    int getNumRepairPackets() const { return mM; }
+    size_t getMaxRepairPacketSize() const { return FecHeader::kSize + Fec::getSymbolSize(mMaxPacketSize); }
+
+    /** Adds a packet that is about to be sent. Returns the number of repair packets now ready, 0 or m */
+    int addPacket(const uint8_t* packet, size_t size, uint64_t sequence);
+    /** Writes repair packet index of the group just completed. Returns its size, or 0 if it does not fit */
+    size_t writeRepairPacket(int index, uint8_t* dest, size_t capacity) const;
+
+private:
+    void startGroup(uint64_t baseSequence);
+
+    size_t mMaxPacketSize = 0;
+    int mK = 0;
+    int mM = 0;
+    bool mInGroup = false;
+    int mNumInGroup = 0;
+    uint64_t mBaseSequence = 0;
+    size_t mSymbolSize = 0;
+    std::vector<std::vector<uint8_t>> mParity;
+};
+
+/**
+ * @brief Receiver side. Keeps the most recent packets and rebuilds lost ones from repair packets
+ *
+ * Source packets are remembered in a ring of the last historySize sequence numbers and repair
+ * packets in a fixed number of group slots, so memory is bounded and nothing is allocated after
+ * prepare(). Recovery runs as soon as a group has enough packets, so a rebuilt packet is
+ * available one repair packet after the loss; whether it still makes its playout deadline is up
+ * to the jitter buffer.
+*/
+class FecDecoder
+{
+public:
+    FecDecoder() = default;
+
+    void prepare(size_t maxPacketSize, int historySize = 4 * FEC_MAX_SOURCE_PACKETS, int numGroups = 8);
+    void reset();
+
+    /** Returns the number of packets rebuilt thanks to this one; fetch them with getRecoveredPacket */
+    int addSourcePacket(const uint8_t* packet, size_t size, uint64_t sequence);
+    int addRepairPacket(const uint8_t* data, size_t size);
+
+    /** Packet rebuilt by the last add call, valid until the next one */
+    const uint8_t* getRecoveredPacket(int index, size_t& size, uint64_t& sequence) const;
+
+    uint64_t getNumRecovered() const { return mNumRecovered; }
+    uint64_t getNumUnrecoverable() const { return mNumUnrecoverable; }
+    uint64_t getNumRejected() const { return mNumRejected; }
+
+private:
+    struct Source
+    {
+        bool valid = false;
+        uint64_t sequence = 0;
+        uint32_t size = 0;
+        std::vector<uint8_t> data;
+    };
+
+    struct Group
+    {
+        bool active = false;
+        uint64_t baseSequence = 0;
+        int k = 0;
+        int m = 0;
+        size_t symbolSize = 0;
+        uint32_t received = 0;
+        std::vector<std::vector<uint8_t>> repair;
+    };
+
+    Source* findSource(uint64_t sequence);
+    Source& storeSource(uint64_t sequence);
+    Group* findGroup(const FecHeader& header);
+    void closeGroup(Group& group);
+    void tryRecover(Group& group);
+
+    size_t mMaxPacketSize = 0;
+    std::vector<Source> mSources;
+    std::vector<Group> mGroups;
+    uint64_t mNewestSequence = 0;
+    bool mHasSequence = false;
+
+    std::vector<int> mRecovered;
+    std::vector<uint8_t> mMatrix, mInverse, mSymbol;
+    std::vector<int> mMissing, mRows;
+
+    uint64_t mNumRecovered = 0;
+    uint64_t mNumUnrecoverable = 0;
+    uint64_t mNumRejected = 0;
+};
@@ -20,22 +20,22 @@ void JitterBuffer::setupSender() {
     request->meta          = "{ \"username\": \"" + *mUsername + "\",\n"
                            "  \"timestamp\": \"" + std::to_string(ts) + "\",\n"
                            "  \"type\": \"" + *mStreamType + "\" }";
-    request->on_init = [&](corelink::core::network::channel_id_type hostId)
+    request->on_init = [ids = mIds](corelink::core::network::channel_id_type hostId)
     {
-      mHostId = hostId;
+      ids->hostId = hostId;
     };
 
     mClient->request(
         *mControlChannelId,
         corelink::client::corelink_functions::create_sender,
         request,
-        [&](corelink::core::network::channel_id_type hostId,
+        [ids = mIds](corelink::core::network::channel_id_type hostId,
             in<std::string>,
             in<std::shared_ptr<corelink::client::request_response::responses::corelink_server_response_base>> response)
         {
             corelink::utils::json receiver_response(response->message);
-            mStreamId = receiver_response.get_int("streamID");
-            mHostId = hostId;
+            ids->streamId = receiver_response.get_int("streamID");
+            ids->hostId = hostId;
         });
 }
 
@@ -48,13 +48,13 @@ JitterBuffer::~JitterBuffer() {
 }
 
 corelink::core::network::channel_id_type JitterBuffer::getHostId() {
-    return mHostId;
+    return mIds->hostId.load();
 }
 corelink::core::network::channel_id_type JitterBuffer::getStreamId() {
-    return mStreamId;
+    return mIds->streamId.load();
 }
 
-void JitterBuffer::updateEstimatedJitter(int newTransitTime, int index)
+void JitterBuffer::updateEstimatedJitter(int newTransitTime)
 {
     if (lastTransitTime == -1) {
         lastTransitTime = newTransitTime;
@@ -65,8 +65,13 @@ void JitterBuffer::updateEstimatedJitter(int newTransitTime, int index)
         totalJitter += jitter;
     }
     nJitterPackets++;
+}
 
-    if (index == 9999) mIsJitterBufferReady = true;
+/**
+ * @brief Called once probing has converged or finished, whatever number of probes that took
+*/
+void JitterBuffer::markReady() {
+    mIsJitterBufferReady = true;
 }
 
 bool JitterBuffer::checkJitterBufferReady() {
@@ -74,5 +79,5 @@ bool JitterBuffer::checkJitterBufferReady() {
 }
 
 int JitterBuffer::getAverageJitter() {
-    return totalJitter / nJitterPackets;
+    return nJitterPackets == 0 ? 0 : totalJitter / nJitterPackets;
 }
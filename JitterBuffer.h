@@ -7,12 +7,12 @@
 
 #include "corelink_all.hpp"
 
+#include <atomic>
+#include <memory>
+
 template<typename t> using in = corelink::in<t>;
 template<typename t> using out = corelink::out<t>;
 
-#define RTT_MEASUREMENTS 10000
-#define RTT_PACKET_SIZE 1000
-
 class JitterBuffer{
 public:
     JitterBuffer(
@@ -29,14 +29,20 @@ public:
     corelink::core::network::channel_id_type getHostId();
     corelink::core::network::channel_id_type getStreamId();
     void setupSender();
-    void updateEstimatedJitter(int newTransitTime, int index);
+    void updateEstimatedJitter(int newTransitTime);
+    void markReady();
     bool checkJitterBufferReady();
     int getAverageJitter();
 private:
     corelink::client::corelink_classic_client* mClient;
     corelink::core::network::channel_id_type* mControlChannelId;
-    corelink::core::network::channel_id_type mHostId;
-    corelink::core::network::channel_id_type mStreamId;
+    // Set by the server's responses, which can arrive after this object is gone, so they share these instead of capturing it
+    struct StreamIds
+    {
+        std::atomic<corelink::core::network::channel_id_type> hostId {};
+        std::atomic<corelink::core::network::channel_id_type> streamId {};
+    };
+    std::shared_ptr<StreamIds> mIds = std::make_shared<StreamIds>();
     std::string* mWorkspace;
     std::string* mStreamType;
     std::string* mUsername;
@@ -0,0 +1,275 @@
+#include "JitterStatistics.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+    constexpr uint64_t kNsPerSecond = 1000000000;
+
+    uint32_t clampMicros(int64_t us)
+    {
+        return (uint32_t) std::clamp<int64_t>(us, 0, UINT32_MAX);
+    }
+}
+
+/**
+ * @brief Allocates the histograms for a window of windowSeconds and clears them
+*/
+void LatencyHistogram::prepare(int windowSeconds)
+{
+    mWindowSeconds = std::clamp(windowSeconds, 1, STATS_MAX_WINDOW_SECONDS);
+    const int numSlices = mWindowSeconds + 1;
+    mSlices = std::make_unique<Slice[]>((size_t) numSlices);
+    mBuckets = std::make_unique<std::atomic<uint32_t>[]>((size_t) numSlices * kNumBuckets);
+    for (int i = 0; i < numSlices; ++i)
+        mSlices[(size_t) i].buckets = mBuckets.get() + (size_t) i * kNumBuckets;
+    reset();
+}
+
+void LatencyHistogram::reset()
+{
+    if (!isPrepared())
+        return;
+
+    for (int i = 0; i <= mWindowSeconds; ++i)
+        clear(mSlices[(size_t) i]);
+    mCurrentSecond.store(-1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Bucket index: the value itself below 2 * kSubBuckets, then kSubBuckets per octave
+*/
+int LatencyHistogram::getBucket(uint32_t valueUs)
+{
+    const int msb = std::bit_width(valueUs) - 1;
+    const int shift = std::max(0, msb - STATS_SUB_BUCKET_BITS);
+    return (shift << STATS_SUB_BUCKET_BITS) + (int) (valueUs >> shift);
+}
+
+uint32_t LatencyHistogram::getBucketValue(int bucket)
+{
+    if (bucket < 2 * kSubBuckets)
+        return (uint32_t) bucket;
+
+    const int shift = (bucket >> STATS_SUB_BUCKET_BITS) - 1;
+    const uint32_t lowest = (uint32_t) (bucket - (shift << STATS_SUB_BUCKET_BITS)) << shift;
+    return lowest + ((1u << shift) - 1) / 2;
+}
+
+/**
+ * @brief Records one value at nowNs. Writer thread only
+*/
+void LatencyHistogram::add(uint32_t valueUs, uint64_t nowNs)
+{
+    if (!isPrepared())
+        return;
+
+    const int bucket = getBucket(valueUs);
+    record(mSlices[0], valueUs, bucket);
+
+    const auto second = (int64_t) (nowNs / kNsPerSecond);
+    auto& slice = mSlices[(size_t) (1 + second % mWindowSeconds)];
+    const int64_t sliceSecond = slice.second.load(std::memory_order_relaxed);
+    if (sliceSecond != second)
+    {
+        // A value stamped before the second this slot has moved on to belongs to no window
+        if (sliceSecond > second)
+            return;
+        slice.second.store(-1, std::memory_order_relaxed);
+        clear(slice);
+        slice.second.store(second, std::memory_order_release);
+    }
+    record(slice, valueUs, bucket);
+
+    if (second > mCurrentSecond.load(std::memory_order_relaxed))
+        mCurrentSecond.store(second, std::memory_order_release);
+}
+
+void LatencyHistogram::record(Slice& slice, uint32_t valueUs, int bucket)
+{
+    // Single writer: load and store instead of read-modify-write
+    auto bump = [](auto& counter, auto amount) { counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed); };
+    bump(slice.buckets[bucket], 1u);
+    bump(slice.sum, (uint64_t) valueUs);
+    if (valueUs < slice.min.load(std::memory_order_relaxed))
+        slice.min.store(valueUs, std::memory_order_relaxed);
+    if (valueUs > slice.max.load(std::memory_order_relaxed))
+        slice.max.store(valueUs, std::memory_order_relaxed);
+    bump(slice.count, (uint64_t) 1);
+}
+
+void LatencyHistogram::clear(Slice& slice)
+{
+    for (int i = 0; i < kNumBuckets; ++i)
+        slice.buckets[i].store(0, std::memory_order_relaxed);
+    slice.count.store(0, std::memory_order_relaxed);
+    slice.sum.store(0, std::memory_order_relaxed);
+    slice.min.store(UINT32_MAX, std::memory_order_relaxed);
+    slice.max.store(0, std::memory_order_relaxed);
+}
+
+StatisticsSummary LatencyHistogram::getSummary() const
+{
+    if (!isPrepared())
+        return {};
+
+    const Slice* all = &mSlices[0];
+    return summarize(&all, 1);
+}
+
+/**
+ * @brief Summary of the values recorded in the last getWindowSeconds() seconds of writer time
+*/
+StatisticsSummary LatencyHistogram::getWindowSummary() const
+{
+    const int64_t current = mCurrentSecond.load(std::memory_order_acquire);
+    if (!isPrepared() || current < 0)
+        return {};
+
+    const Slice* slices[STATS_MAX_WINDOW_SECONDS];
+    int numSlices = 0;
+    for (int i = 1; i <= mWindowSeconds; ++i)
+    {
+        const int64_t second = mSlices[(size_t) i].second.load(std::memory_order_acquire);
+        if (second >= 0 && second > current - mWindowSeconds && second <= current)
+            slices[numSlices++] = &mSlices[(size_t) i];
+    }
+    return summarize(slices, numSlices);
+}
+
+/**
+ * @brief Merges the slices' counters and reads the percentiles off their combined buckets
+*/
+StatisticsSummary LatencyHistogram::summarize(const Slice* const* slices, int numSlices)
+{
+    StatisticsSummary summary;
+    uint64_t sum = 0;
+    uint32_t min = UINT32_MAX, max = 0;
+    for (int s = 0; s < numSlices; ++s)
+    {
+        sum += slices[s]->sum.load(std::memory_order_relaxed);
+        min = std::min(min, slices[s]->min.load(std::memory_order_relaxed));
+        max = std::max(max, slices[s]->max.load(std::memory_order_relaxed));
+    }
+
+    // Ranks come from the buckets themselves so they agree with the walk below
+    auto bucketCount = [&](int bucket)
+    {
+        uint64_t count = 0;
+        for (int s = 0; s < numSlices; ++s)
+            count += slices[s]->buckets[bucket].load(std::memory_order_relaxed);
+        return count;
+    };
+    uint64_t total = 0;
+    for (int b = 0; b < kNumBuckets; ++b)
+        total += bucketCount(b);
+    if (total == 0)
+        return summary;
+
+    const double quantiles[] = { 0.5, 0.95, 0.99, 0.999 };
+    double* results[] = { &summary.p50Ms, &summary.p95Ms, &summary.p99Ms, &summary.p999Ms };
+    size_t next = 0;
+    uint64_t seen = 0;
+    for (int b = 0; b < kNumBuckets && next < std::size(quantiles); ++b)
+    {
+        seen += bucketCount(b);
+        while (next < std::size(quantiles) && (double) seen >= std::ceil(quantiles[next] * (double) total))
+        {
+            const uint32_t value = std::clamp(getBucketValue(b), std::min(min, max), max);
+            *results[next++] = value / 1000.0;
+        }
+    }
+
+    summary.count = total;
+    summary.minMs = min / 1000.0;
+    summary.maxMs = max / 1000.0;
+    summary.meanMs = (double) sum / (double) total / 1000.0;
+    return summary;
+}
+
+/**
+ * @brief Allocates every metric's histograms. Must not run concurrently with the writer or readers
+*/
+void JitterStatistics::prepare(int windowSeconds)
+{
+    for (auto& metric : mMetrics)
+        metric.prepare(windowSeconds);
+    reset();
+}
+
+void JitterStatistics::reset()
+{
+    for (auto& metric : mMetrics)
+        metric.reset();
+    mHasArrival = false;
+    mHasTransit = false;
+    mJitter = 0;
+    mPublishedJitter.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Records a packet sent at sendNs on the sender's clock and received at arrivalNs on ours,
+ * or with synchronized set, both on one shared time base
+*/
+void JitterStatistics::addArrival(uint64_t sendNs, uint64_t arrivalNs, bool synchronized)
+{
+    const int64_t transitUs = ((int64_t) arrivalNs - (int64_t) sendNs) / 1000;
+
+    if (mHasArrival && arrivalNs >= mLastArrivalNs)
+        mMetrics[(size_t) StatisticsMetric::InterArrival].add(clampMicros((int64_t) ((arrivalNs - mLastArrivalNs) / 1000)), arrivalNs);
+    mHasArrival = true;
+    mLastArrivalNs = arrivalNs;
+
+    if (synchronized)
+        mMetrics[(size_t) StatisticsMetric::OneWayDelay].add(clampMicros(transitUs), arrivalNs);
+
+    // Transit times on different time bases cannot be compared
+    if (mHasTransit && synchronized == mSynchronized)
+    {
+        // RFC 3550 A.8: J is kept scaled by 16 and moves 1/16 of the way to |D| per packet
+        const int64_t d = std::abs(transitUs - mLastTransitUs);
+        mJitter += d - ((mJitter + 8) >> 4);
+        mPublishedJitter.store(mJitter, std::memory_order_relaxed);
+        mMinTransitUs = std::min(mMinTransitUs, transitUs);
+    }
+    else
+    {
+        mMinTransitUs = transitUs;
+        mHasTransit = true;
+        mSynchronized = synchronized;
+    }
+
+    mMetrics[(size_t) StatisticsMetric::QueueingDelay].add(clampMicros(transitUs - mMinTransitUs), arrivalNs);
+    mLastTransitUs = transitUs;
+}
+
+void JitterStatistics::addRoundTrip(uint64_t rttNs, uint64_t nowNs)
+{
+    mMetrics[(size_t) StatisticsMetric::RoundTrip].add(clampMicros((int64_t) (rttNs / 1000)), nowNs);
+}
+
+void JitterStatistics::addDelay(StatisticsMetric metric, int64_t delayNs, uint64_t nowNs)
+{
+    mMetrics[(size_t) metric].add(clampMicros(delayNs / 1000), nowNs);
+}
+
+/**
+ * @brief The RFC 3550 interarrival jitter in milliseconds
+*/
+double JitterStatistics::getJitterMs() const
+{
+    return (double) mPublishedJitter.load(std::memory_order_relaxed) / 16.0 / 1000.0;
+}
+
+StatisticsSummary JitterStatistics::getSummary(StatisticsMetric metric) const
+{
+    return mMetrics[(size_t) metric].getSummary();
+}
+
+StatisticsSummary JitterStatistics::getWindowSummary(StatisticsMetric metric) const
+{
+    return mMetrics[(size_t) metric].getWindowSummary();
+}
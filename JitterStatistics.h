@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#define STATS_WINDOW_SECONDS 10
+#define STATS_MAX_WINDOW_SECONDS 300
+#define STATS_SUB_BUCKET_BITS 5
+
+enum class StatisticsMetric
+{
+    InterArrival,
+    RoundTrip,
+    // Towards us, on a clock synchronized with the sender's
+    OneWayDelay,
+    // Transit time above the fastest packet's; needs no synchronized clock
+    QueueingDelay,
+    // From us towards the peer, measured by probes
+    OutboundDelay
+};
+
+/**
+ * @brief Count, range, mean and percentiles of one metric, all in milliseconds
+*/
+struct StatisticsSummary
+{
+    uint64_t count = 0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+    double meanMs = 0.0;
+    double p50Ms = 0.0;
+    double p95Ms = 0.0;
+    double p99Ms = 0.0;
+    double p999Ms = 0.0;
+};
+
+/**
+ * @brief Streaming quantile sketch of one metric, over all time and over the last few seconds
+ *
+ * Values are kept in microseconds in a log-linear histogram: exact below 64 us, then 32
+ * buckets per octave, so any percentile is within about 3% of the true value whatever the
+ * range. Next to the all-time histogram there is a ring of one-second slices; the window
+ * summary merges the slices of the last windowSeconds, and the writer clears a slice when it
+ * moves into it.
+ *
+ * One writer thread calls add(); any number of readers call the getters. Everything is a
+ * relaxed atomic, so neither side ever blocks or allocates; a reader racing the writer sees a
+ * summary that may be one value behind, and one racing a slice rotation may miss that slice's
+ * first values. prepare() allocates and must not run concurrently with either.
+*/
+class LatencyHistogram
+{
+public:
+    static constexpr int kSubBuckets = 1 << STATS_SUB_BUCKET_BITS;
+    static constexpr int kNumBuckets = (32 - STATS_SUB_BUCKET_BITS + 1) * kSubBuckets;
+
+    LatencyHistogram() = default;
+
+    void prepare(int windowSeconds = STATS_WINDOW_SECONDS);
+    void reset();
+    bool isPrepared() const { return mBuckets != nullptr; }
+
+    void add(uint32_t valueUs, uint64_t nowNs);
+
+    StatisticsSummary getSummary() const;
+    StatisticsSummary getWindowSummary() const;
+    int getWindowSeconds() const { return mWindowSeconds; }
+
+    static int getBucket(uint32_t valueUs);
+    /** Midpoint of the values that land in bucket */
+    static uint32_t getBucketValue(int bucket);
+
+private:
+    struct Slice
+    {
+        std::atomic<int64_t> second { -1 };
+        std::atomic<uint64_t> count { 0 };
+        std::atomic<uint64_t> sum { 0 };
+        std::atomic<uint32_t> min { UINT32_MAX };
+        std::atomic<uint32_t> max { 0 };
+        std::atomic<uint32_t>* buckets = nullptr;
+    };
+
+    static void record(Slice& slice, uint32_t valueUs, int bucket);
+    static void clear(Slice& slice);
+    static StatisticsSummary summarize(const Slice* const* slices, int numSlices);
+
+    int mWindowSeconds = 0;
+    // Slice 0 is the all-time histogram, the rest the ring of seconds
+    std::unique_ptr<Slice[]> mSlices;
+    std::unique_ptr<std::atomic<uint32_t>[]> mBuckets;
+    std::atomic<int64_t> mCurrentSecond { -1 };
+};
+
+/**
+ * @brief Receive-side latency statistics: inter-arrival time, one-way and queueing delay,
+ * round-trip time and the RFC 3550 interarrival jitter
+ *
+ * addArrival() takes each packet's send timestamp and arrival time. The jitter is the RFC 3550
+ * estimator in the fixed-point form of its appendix A.8: the difference between consecutive
+ * transit times, in microseconds with four fractional bits, smoothed with gain 1/16. The
+ * sender's and receiver's clocks need not agree for it. Neither do they for the queueing delay,
+ * the transit time above the smallest one seen since reset(). The one-way delay is recorded
+ * only for packets whose send and arrival times are on one synchronized time base (see
+ * ClockSync); when a stream switches between the two, transit comparisons start afresh.
+ * addRoundTrip() and addDelay() take times measured elsewhere, such as by the probe engine.
+ *
+ * Writers and readers follow LatencyHistogram: a single network thread adds, the UI polls the
+ * summaries and getJitterMs() without locking.
+*/
+class JitterStatistics
+{
+public:
+    JitterStatistics() = default;
+
+    void prepare(int windowSeconds = STATS_WINDOW_SECONDS);
+    void reset();
+    bool isPrepared() const { return mMetrics[0].isPrepared(); }
+
+    void addArrival(uint64_t sendNs, uint64_t arrivalNs, bool synchronized = false);
+    void addRoundTrip(uint64_t rttNs, uint64_t nowNs);
+    void addDelay(StatisticsMetric metric, int64_t delayNs, uint64_t nowNs);
+
+    double getJitterMs() const;
+    StatisticsSummary getSummary(StatisticsMetric metric) const;
+    StatisticsSummary getWindowSummary(StatisticsMetric metric) const;
+
+private:
+    static constexpr size_t kNumMetrics = 5;
+
+    LatencyHistogram mMetrics[kNumMetrics];
+
+    bool mHasArrival = false;
+    bool mHasTransit = false;
+    bool mSynchronized = false;
+    uint64_t mLastArrivalNs = 0;
+    int64_t mLastTransitUs = 0;
+    int64_t mMinTransitUs = 0;
+    int64_t mJitter = 0;
+    std::atomic<int64_t> mPublishedJitter { 0 };
+};
@@ -0,0 +1,151 @@
+#include "LocalStreamReceiver.h"
+
+#include "PacketHeader.h"
+
+#include <algorithm>
+
+/**
+ * @brief Drains one ring into the callback, sleeping on the ring between packets
+*/
+class LocalStreamReceiver::Reader : public juce::Thread
+{
+public:
+    Reader(uint64_t scope, int streamId, PacketCallback& callback)
+        : juce::Thread("Corelink Local Reader"), mScope(scope), mStreamId(streamId), mCallback(callback)
+    {
+    }
+
+    ~Reader() override
+    {
+        stop();
+    }
+
+    bool attach()
+    {
+        if (!mRing.attach(mScope, mStreamId))
+            return false;
+        mPacket.resize(mRing.getMaxPacketSize());
+        startThread(juce::Thread::Priority::high);
+        return true;
+    }
+
+    void stop()
+    {
+        signalThreadShouldExit();
+        mRing.wakeReaders();
+        stopThread(2000);
+        mRing.close();
+    }
+
+    uint64_t getScope() const { return mScope; }
+    int getStreamId() const { return mStreamId; }
+    bool isFinished() const { return !isThreadRunning(); }
+
+    void run() override
+    {
+        uint64_t nextCheckNs = 0;
+        while (!threadShouldExit())
+        {
+            size_t size = 0;
+            while (mRing.pop(mPacket.data(), mPacket.size(), size))
+                mCallback(mStreamId, mPacket.data(), size, getMonotonicTimeNs());
+
+            // Liveness costs a system call, so it is checked at the discovery rate rather than per wake-up
+            const uint64_t nowNs = getMonotonicTimeNs();
+            if (nowNs >= nextCheckNs)
+            {
+                if (!mRing.isWriterAlive())
+                    break;
+                nextCheckNs = nowNs + (uint64_t) LOCAL_DISCOVERY_INTERVAL_MS * 1000000ull;
+            }
+            mRing.wait(LOCAL_WAIT_TIMEOUT_MS);
+        }
+    }
+
+private:
+    const uint64_t mScope;
+    const int mStreamId;
+    PacketCallback& mCallback;
+    LocalStreamRing mRing;
+    std::vector<uint8_t> mPacket;
+};
+
+LocalStreamReceiver::LocalStreamReceiver(const StreamIngest& ingest, PacketCallback callback)
+    : juce::Thread("Corelink Local Discovery"), mIngest(ingest), mCallback(std::move(callback))
+{
+}
+
+LocalStreamReceiver::~LocalStreamReceiver()
+{
+    stop();
+}
+
+void LocalStreamReceiver::start()
+{
+    if (!isThreadRunning())
+        startThread();
+}
+
+/**
+ * @brief Stops discovery and every reader. Readers are only touched by the discovery thread until it has exited
+*/
+void LocalStreamReceiver::stop()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread(2000);
+    mReaders.clear();
+    mNumAttached = 0;
+}
+
+void LocalStreamReceiver::setScope(uint64_t scope)
+{
+    mScope.store(scope, std::memory_order_relaxed);
+    notify();
+}
+
+void LocalStreamReceiver::run()
+{
+    while (!threadShouldExit())
+    {
+        discover();
+        wait(LOCAL_DISCOVERY_INTERVAL_MS);
+    }
+}
+
+/**
+ * @brief Retires readers whose writer went away or whose scope was left and attaches to the rings of streams not read yet
+*/
+void LocalStreamReceiver::discover()
+{
+    const uint64_t scope = mScope.load(std::memory_order_relaxed);
+    mReaders.erase(std::remove_if(mReaders.begin(), mReaders.end(), [scope](const auto& reader) {
+                       return reader->isFinished() || reader->getScope() != scope;
+                   }),
+                   mReaders.end());
+    if (scope == 0)
+    {
+        mNumAttached = 0;
+        return;
+    }
+
+    const int numStreams = mIngest.getNumStreams();
+    for (int i = 0; i < numStreams; ++i)
+    {
+        const int streamId = mIngest.getStreamId(i);
+        // A slot between two streams has none
+        if (streamId < 0)
+            continue;
+        const bool reading = std::any_of(mReaders.begin(), mReaders.end(), [streamId](const auto& reader) {
+            return reader->getStreamId() == streamId;
+        });
+        if (reading)
+            continue;
+
+        // A stream whose sender is on another host has no ring here and fails at shm_open()
+        auto reader = std::make_unique<Reader>(scope, streamId, mCallback);
+        if (reader->attach())
+            mReaders.push_back(std::move(reader));
+    }
+    mNumAttached = (int) mReaders.size();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include "LocalStreamRing.h"
+#include "StreamIngest.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#define LOCAL_DISCOVERY_INTERVAL_MS 500
+#define LOCAL_WAIT_TIMEOUT_MS 100
+
+/**
+ * @brief Picks up same-host senders' packets from their LocalStreamRing instead of waiting for the server
+ *
+ * Every LOCAL_DISCOVERY_INTERVAL_MS this thread tries to attach to the ring of each stream the
+ * ingest stage has seen, in the scope of the server and workspace set with setScope(), and gives every ring it attaches to a reader thread of its own that
+ * sleeps on the ring's futex. Packets go to the callback with their arrival time, the same way
+ * the network delivers them; the network copies that follow are dropped by StreamIngest as
+ * duplicates, so a stream that is also sent to remote subscribers needs no special casing.
+ *
+ * The callback runs on the reader threads, several at once with more than one local sender, and
+ * must serialise with any other producer of the ingest stage. A reader whose writer closed its
+ * ring or died stops, and the stream is attached again if its sender creates a new ring.
+*/
+class LocalStreamReceiver : public juce::Thread
+{
+public:
+    using PacketCallback = std::function<void(int sourceStreamId, const uint8_t* data, size_t size, uint64_t arrivalNs)>;
+
+    LocalStreamReceiver(const StreamIngest& ingest, PacketCallback callback);
+    ~LocalStreamReceiver() override;
+
+    void start();
+    void stop();
+    /** The LocalStreamRing scope of the streams received; readers of another scope are dropped */
+    void setScope(uint64_t scope);
+
+    int getNumAttached() const { return mNumAttached.load(std::memory_order_relaxed); }
+
+    void run() override;
+
+private:
+    class Reader;
+
+    void discover();
+
+    const StreamIngest& mIngest;
+    PacketCallback mCallback;
+    std::vector<std::unique_ptr<Reader>> mReaders;
+    std::atomic<int> mNumAttached { 0 };
+    // 0 until set: no ring is attached without knowing whose stream ids these are
+    std::atomic<uint64_t> mScope { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LocalStreamReceiver)
+};
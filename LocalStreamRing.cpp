@@ -0,0 +1,406 @@
+#include "LocalStreamRing.h"
+
+#include <juce_core/juce_core.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#if JUCE_LINUX || JUCE_MAC
+    #include <cerrno>
+    #include <csignal>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#if JUCE_LINUX
+    #include <ctime>
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+#else
+    #include <chrono>
+    #include <thread>
+#endif
+
+// Lives in memory shared between processes, so every field has a fixed layout and no pointers
+struct LocalStreamRing::Header
+{
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t numSlots;
+    uint32_t maxPacketSize;
+    int32_t writerPid;
+    int32_t streamId;
+    uint64_t scope;
+    std::atomic<uint32_t> closed;
+
+    alignas(64) std::atomic<uint64_t> writeIndex;
+
+    // Futex word, bumped on every publish; readers sleep on it
+    alignas(64) std::atomic<uint32_t> signal;
+    std::atomic<uint32_t> sleepers;
+    std::atomic<uint32_t> readers;
+};
+
+namespace
+{
+    struct SlotHeader
+    {
+        // Index + 1 of the packet in the slot, 0 while it is being written
+        std::atomic<uint64_t> index;
+        std::atomic<uint32_t> size;
+        uint32_t reserved;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+                  "The ring is shared between processes and needs address-free atomics");
+
+    size_t roundUp(size_t size, size_t alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+}
+
+LocalStreamRing::~LocalStreamRing()
+{
+    close();
+}
+
+/**
+ * @brief FNV-1a of "server:port/workspace"
+*/
+uint64_t LocalStreamRing::makeScope(const std::string& server, int port, const std::string& workspace)
+{
+    const std::string key = server + ":" + std::to_string(port) + "/" + workspace;
+    uint64_t hash = 14695981039346656037ull;
+    for (const char c : key)
+    {
+        hash ^= (uint8_t) c;
+        hash *= 1099511628211ull;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+std::string LocalStreamRing::getName(uint64_t scope, int streamId)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "/corelink-%08x-%d", (unsigned) (scope ^ (scope >> 32)), streamId);
+    return name;
+}
+
+uint8_t* LocalStreamRing::getSlot(uint64_t index) const
+{
+    return reinterpret_cast<uint8_t*>(mHeader) + roundUp(sizeof(Header), 64) + (size_t) (index % mHeader->numSlots) * mSlotStride;
+}
+
+size_t LocalStreamRing::getMaxPacketSize() const
+{
+    return mHeader != nullptr ? mHeader->maxPacketSize : 0;
+}
+
+bool LocalStreamRing::hasReaders() const
+{
+    return mHeader != nullptr && mHeader->readers.load(std::memory_order_relaxed) > 0;
+}
+
+#if JUCE_LINUX || JUCE_MAC
+namespace
+{
+    void futexWake(std::atomic<uint32_t>& word)
+    {
+    #if JUCE_LINUX
+        // Not FUTEX_PRIVATE: the sleepers are in other processes
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+    #else
+        juce::ignoreUnused(word);
+    #endif
+    }
+
+    void futexWait(std::atomic<uint32_t>& word, uint32_t expected, int timeoutMs)
+    {
+    #if JUCE_LINUX
+        timespec timeout { timeoutMs / 1000, (long) (timeoutMs % 1000) * 1000000 };
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+    #else
+        // No cross-process futex here: poll the word at a fraction of a block
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (word.load() == expected && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+    #endif
+    }
+}
+
+bool LocalStreamRing::isAlive(const Header& header)
+{
+    if (header.closed.load() != 0)
+        return false;
+    // EPERM still means the process exists
+    return kill((pid_t) header.writerPid, 0) == 0 || errno == EPERM;
+}
+
+/**
+ * @brief Removes the ring under name if its writer closed it or died. Returns false while its writer is alive
+*/
+bool LocalStreamRing::removeIfAbandoned(const std::string& name)
+{
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return errno == ENOENT;
+
+    bool alive = false;
+    struct stat status {};
+    // A ring smaller than its header never got past create(), so nobody writes to it
+    if (fstat(fd, &status) == 0 && (size_t) status.st_size >= sizeof(Header))
+    {
+        void* memory = mmap(nullptr, sizeof(Header), PROT_READ, MAP_SHARED, fd, 0);
+        if (memory != MAP_FAILED)
+        {
+            alive = isAlive(*static_cast<const Header*>(memory));
+            munmap(memory, sizeof(Header));
+        }
+    }
+    ::close(fd);
+
+    if (alive)
+        return false;
+    shm_unlink(name.c_str());
+    return true;
+}
+
+/**
+ * @brief Sizes, maps and initialises the ring. The magic goes in last so readers never see it half set up
+*/
+bool LocalStreamRing::create(uint64_t scope, int streamId, int numSlots, size_t maxPacketSize)
+{
+    close();
+    if (numSlots < 2 || maxPacketSize == 0)
+        return false;
+
+    const auto name = getName(scope, streamId);
+    const size_t stride = roundUp(sizeof(SlotHeader) + maxPacketSize, 64);
+    const size_t size = roundUp(sizeof(Header), 64) + (size_t) numSlots * stride;
+
+    // A ring under this name is either left over from a writer that exited without closing it or
+    // belongs to a live writer, of another scope that shares the name or of this stream elsewhere
+    if (!removeIfAbandoned(name))
+        return false;
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, (off_t) size) != 0)
+    {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    mHeader = new (memory) Header();
+    mHeader->version = LOCAL_RING_VERSION;
+    mHeader->numSlots = (uint32_t) numSlots;
+    mHeader->maxPacketSize = (uint32_t) maxPacketSize;
+    mHeader->writerPid = (int32_t) getpid();
+    mHeader->streamId = (int32_t) streamId;
+    mHeader->scope = scope;
+    mHeader->closed.store(0, std::memory_order_relaxed);
+    mHeader->writeIndex.store(0, std::memory_order_relaxed);
+    mHeader->signal.store(0, std::memory_order_relaxed);
+    mHeader->sleepers.store(0, std::memory_order_relaxed);
+    mHeader->readers.store(0, std::memory_order_relaxed);
+
+    mMappedSize = size;
+    mSlotStride = stride;
+    mWriter = true;
+    mName = name;
+    for (int i = 0; i < numSlots; ++i)
+        new (getSlot((uint64_t) i)) SlotHeader { { 0 }, { 0 }, 0 };
+
+    mHeader->magic.store(LOCAL_RING_MAGIC, std::memory_order_release);
+    return true;
+}
+
+bool LocalStreamRing::attach(uint64_t scope, int streamId)
+{
+    close();
+    const auto name = getName(scope, streamId);
+    const int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat status {};
+    void* memory = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && (size_t) status.st_size >= sizeof(Header))
+        memory = mmap(nullptr, (size_t) status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED)
+        return false;
+
+    mHeader = static_cast<Header*>(memory);
+    mMappedSize = (size_t) status.st_size;
+    mWriter = false;
+    mName = name;
+
+    const bool valid = mHeader->magic.load(std::memory_order_acquire) == LOCAL_RING_MAGIC
+                    && mHeader->version == LOCAL_RING_VERSION
+                    && mHeader->scope == scope
+                    && mHeader->streamId == (int32_t) streamId
+                    && mHeader->numSlots >= 2
+                    && roundUp(sizeof(Header), 64) + (size_t) mHeader->numSlots * roundUp(sizeof(SlotHeader) + mHeader->maxPacketSize, 64) <= mMappedSize;
+    if (!valid || !isWriterAlive())
+    {
+        munmap(memory, mMappedSize);
+        mHeader = nullptr;
+        mMappedSize = 0;
+        return false;
+    }
+
+    mSlotStride = roundUp(sizeof(SlotHeader) + mHeader->maxPacketSize, 64);
+    mHeader->readers.fetch_add(1);
+    // Starts with the next packet: what was written before belongs to no one now
+    mReadIndex = mHeader->writeIndex.load(std::memory_order_acquire);
+    mMissed = 0;
+    return true;
+}
+
+/**
+ * @brief Unmaps the ring. The writer marks it closed and wakes its readers first, then removes the name
+*/
+void LocalStreamRing::close()
+{
+    if (mHeader == nullptr)
+        return;
+
+    if (mWriter)
+    {
+        mHeader->closed.store(1);
+        wakeReaders();
+        shm_unlink(mName.c_str());
+    }
+    else
+    {
+        mHeader->readers.fetch_sub(1);
+    }
+
+    munmap(mHeader, mMappedSize);
+    mHeader = nullptr;
+    mMappedSize = 0;
+    mWriter = false;
+}
+
+bool LocalStreamRing::isWriterAlive() const
+{
+    return mHeader != nullptr && isAlive(*mHeader);
+}
+
+/**
+ * @brief Publishes one packet. Writer only; returns false, without copying, while no reader is attached
+*/
+bool LocalStreamRing::push(const uint8_t* data, size_t size)
+{
+    if (mHeader == nullptr || !mWriter || size == 0 || size > mHeader->maxPacketSize || !hasReaders())
+        return false;
+
+    const auto w = mHeader->writeIndex.load(std::memory_order_relaxed);
+    auto* slot = getSlot(w);
+    auto* slotHeader = reinterpret_cast<SlotHeader*>(slot);
+
+    // Readers seeing index 0 (or a newer one) after their copy discard it
+    slotHeader->index.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(slot + sizeof(SlotHeader), data, size);
+    slotHeader->size.store((uint32_t) size, std::memory_order_relaxed);
+    slotHeader->index.store(w + 1, std::memory_order_release);
+    mHeader->writeIndex.store(w + 1, std::memory_order_seq_cst);
+
+    mHeader->signal.fetch_add(1);
+    if (mHeader->sleepers.load() > 0)
+        futexWake(mHeader->signal);
+    return true;
+}
+
+/**
+ * @brief Copies the next packet into dest. Reader only; packets overwritten before they were read are skipped
+*/
+bool LocalStreamRing::pop(uint8_t* dest, size_t capacity, size_t& size)
+{
+    if (mHeader == nullptr || mWriter)
+        return false;
+
+    const uint64_t numSlots = mHeader->numSlots;
+    for (;;)
+    {
+        const auto w = mHeader->writeIndex.load(std::memory_order_acquire);
+        if (mReadIndex == w)
+            return false;
+
+        // The oldest slot may already be under the writer; leave it one slot of room
+        if (w - mReadIndex >= numSlots)
+        {
+            mMissed += w - numSlots + 1 - mReadIndex;
+            mReadIndex = w - numSlots + 1;
+        }
+
+        auto* slot = getSlot(mReadIndex);
+        auto* slotHeader = reinterpret_cast<SlotHeader*>(slot);
+        const auto expected = mReadIndex + 1;
+        if (slotHeader->index.load(std::memory_order_acquire) == expected)
+        {
+            const size_t packetSize = slotHeader->size.load(std::memory_order_relaxed);
+            std::memcpy(dest, slot + sizeof(SlotHeader), std::min(packetSize, capacity));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slotHeader->index.load(std::memory_order_relaxed) == expected && packetSize <= capacity)
+            {
+                ++mReadIndex;
+                size = packetSize;
+                return true;
+            }
+        }
+        ++mMissed;
+        ++mReadIndex;
+    }
+}
+
+/**
+ * @brief Sleeps until the writer publishes, closes the ring or timeoutMs passes
+*/
+void LocalStreamRing::wait(int timeoutMs)
+{
+    if (mHeader == nullptr || mWriter)
+        return;
+
+    const auto signal = mHeader->signal.load();
+    mHeader->sleepers.fetch_add(1);
+    // Checked after registering as a sleeper, so a packet published in between is either seen here
+    // or its writer sees the sleeper and changes the word before this waits on it
+    if (mHeader->writeIndex.load() == mReadIndex && mHeader->closed.load() == 0)
+        futexWait(mHeader->signal, signal, timeoutMs);
+    mHeader->sleepers.fetch_sub(1);
+}
+
+void LocalStreamRing::wakeReaders()
+{
+    if (mHeader == nullptr)
+        return;
+    mHeader->signal.fetch_add(1);
+    futexWake(mHeader->signal);
+}
+#else
+bool LocalStreamRing::create(uint64_t, int, int, size_t) { return false; }
+bool LocalStreamRing::attach(uint64_t, int) { return false; }
+void LocalStreamRing::close() { mHeader = nullptr; mWriter = false; }
+bool LocalStreamRing::isWriterAlive() const { return false; }
+bool LocalStreamRing::push(const uint8_t*, size_t) { return false; }
+bool LocalStreamRing::pop(uint8_t*, size_t, size_t&) { return false; }
+void LocalStreamRing::wait(int) {}
+void LocalStreamRing::wakeReaders() {}
+#endif
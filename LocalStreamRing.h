@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define LOCAL_RING_MAGIC 0x4C535452
+#define LOCAL_RING_VERSION 2
+#define LOCAL_RING_SLOTS 64
+
+/**
+ * @brief Broadcast ring of audio packets in POSIX shared memory, for receivers on the sender's host
+ *
+ * The sender creates one ring per stream, named after its Corelink stream id and a scope made of
+ * the server address and workspace (see makeScope), so a receiver on the same machine finds it by
+ * the id of a stream it already gets over the network: shared memory names are local to the host,
+ * so a ring that can be attached is a same-host sender. Stream ids are only unique per server,
+ * and the name keeps 32 bits of the scope to stay within macOS's 31 characters, so the header
+ * holds the full scope and stream id and attach() refuses a ring that is not the one it asked
+ * for. create() only replaces a ring whose writer is gone; one whose writer is alive is left
+ * alone and create() fails.
+ * Packets are copied in unchanged, PacketHeader and all, and come out exactly as the network
+ * would deliver them.
+ *
+ * There is one writer and any number of readers, each with its own read position in its own
+ * process. The writer never waits: it overwrites the oldest slot, and a reader that falls a
+ * whole ring behind skips ahead and counts the packets it missed. Each slot carries the index
+ * it was written for, checked before and after copying, so a reader never returns a slot that
+ * was overwritten under it.
+ *
+ * Readers sleep on a futex in the shared header (polling on platforms without one). The writer
+ * only makes the wake-up call when a reader is asleep, and only copies packets at all while
+ * some reader is attached, so a sender nobody listens to locally pays one atomic load per packet.
+*/
+class LocalStreamRing
+{
+public:
+    LocalStreamRing() = default;
+    ~LocalStreamRing();
+
+    LocalStreamRing(const LocalStreamRing&) = delete;
+    LocalStreamRing& operator=(const LocalStreamRing&) = delete;
+
+    /** Creates the ring of streamId as its writer, replacing any left behind by a writer that is gone */
+    bool create(uint64_t scope, int streamId, int numSlots, size_t maxPacketSize);
+    /** Joins the ring of streamId as a reader; fails if there is none, it belongs to another scope or its writer is gone */
+    bool attach(uint64_t scope, int streamId);
+    void close();
+
+    bool isOpen() const { return mHeader != nullptr; }
+    bool isWriter() const { return mWriter; }
+    bool hasReaders() const;
+    bool isWriterAlive() const;
+    size_t getMaxPacketSize() const;
+
+    bool push(const uint8_t* data, size_t size);
+    bool pop(uint8_t* dest, size_t capacity, size_t& size);
+    /** Blocks until a packet may be ready or timeoutMs passes. Reader only */
+    void wait(int timeoutMs);
+    void wakeReaders();
+
+    uint64_t getNumMissed() const { return mMissed; }
+
+    /** Identifies the server and workspace a stream id belongs to; never 0 */
+    static uint64_t makeScope(const std::string& server, int port, const std::string& workspace);
+    static std::string getName(uint64_t scope, int streamId);
+
+private:
+    struct Header;
+
+    static bool isAlive(const Header& header);
+    static bool removeIfAbandoned(const std::string& name);
+    uint8_t* getSlot(uint64_t index) const;
+
+    Header* mHeader = nullptr;
+    size_t mMappedSize = 0;
+    size_t mSlotStride = 0;
+    bool mWriter = false;
+    std::string mName;
+
+    // Reader
+    uint64_t mReadIndex = 0;
+    uint64_t mMissed = 0;
+};
@@ -0,0 +1,248 @@
+#include "LossConcealer.h"
+
+#include <algorithm>
+#include <cmath>
+
+void LossConcealer::prepare(int numChannels, double sampleRate, int maxBlockSize)
+{
+    mNumChannels = numChannels;
+    mMinPeriod = (int) std::lround(PLC_MIN_PITCH_MS * sampleRate / 1000.0);
+    mMaxPeriod = (int) std::lround(PLC_MAX_PITCH_MS * sampleRate / 1000.0);
+    // Whole multiples of the decimation factor keep the coarse search aligned with the history
+    mMaxPeriod = (mMaxPeriod + PLC_DECIMATION - 1) / PLC_DECIMATION * PLC_DECIMATION;
+    mFullGainSamples = (int) std::lround(PLC_FULL_GAIN_MS * sampleRate / 1000.0);
+    mFadeSamples = std::max(1, (int) std::lround(PLC_FADE_MS * sampleRate / 1000.0));
+    mCrossfadeSamples = std::max(1, (int) std::lround(PLC_CROSSFADE_MS * sampleRate / 1000.0));
+
+    // The pitch search compares the last period-length window with one up to a period earlier
+    size_t capacity = 1;
+    while (capacity < (size_t) (2 * mMaxPeriod))
+        capacity <<= 1;
+    mHistoryMask = capacity - 1;
+    mHistory.assign((size_t) numChannels, std::vector<float>(capacity, 0.0f));
+
+    mPeriodBuffer.assign((size_t) numChannels, std::vector<float>((size_t) mMaxPeriod, 0.0f));
+    mStartOffsets.assign((size_t) numChannels, 0.0f);
+    mDecimated.assign((size_t) (2 * mMaxPeriod / PLC_DECIMATION), 0.0f);
+    mScores.assign((size_t) (mMaxPeriod / PLC_DECIMATION + 1), 0.0);
+    mCrossfade.assign((size_t) numChannels, std::vector<float>((size_t) std::min(mCrossfadeSamples, std::max(1, maxBlockSize)), 0.0f));
+    mCrossfadePtrs.resize((size_t) numChannels);
+    for (int ch = 0; ch < numChannels; ++ch)
+        mCrossfadePtrs[(size_t) ch] = mCrossfade[(size_t) ch].data();
+
+    reset();
+}
+
+void LossConcealer::reset()
+{
+    for (auto& history : mHistory)
+        std::fill(history.begin(), history.end(), 0.0f);
+    mHistoryWrite = 0;
+    mConcealing = false;
+    mPeriod = 0;
+    mPeriodPosition = 0;
+    mConcealedSamples = 0;
+}
+
+void LossConcealer::process(float* const* channels, int numSamples)
+{
+    if (mConcealing)
+    {
+        // Fade from where the concealment would have gone into the real signal
+        const int length = std::min({ numSamples, mCrossfadeSamples, (int) mCrossfade[0].size() });
+        generate(mCrossfadePtrs.data(), length);
+        for (int ch = 0; ch < mNumChannels; ++ch)
+        {
+            for (int i = 0; i < length; ++i)
+            {
+                const float w = ((float) i + 0.5f) / (float) length;
+                channels[ch][i] = w * channels[ch][i] + (1.0f - w) * mCrossfade[(size_t) ch][(size_t) i];
+            }
+        }
+        mConcealing = false;
+    }
+
+    appendHistory(channels, numSamples);
+}
+
+void LossConcealer::conceal(float* const* dest, int numSamples)
+{
+    if (!mConcealing)
+        startConcealment();
+
+    generate(dest, numSamples);
+    appendHistory(dest, numSamples);
+}
+
+/**
+ * @brief Lengthens the output by one period. The next good block is cross-faded in like after a loss
+*/
+int LossConcealer::extend(float* const* dest, int maxSamples)
+{
+    if (!mConcealing)
+        startConcealment();
+
+    const int numSamples = std::min(mPeriod, maxSamples);
+    generate(dest, numSamples);
+    appendHistory(dest, numSamples);
+    return numSamples;
+}
+
+float LossConcealer::getHistory(int channel, int offset) const
+{
+    // offset counts back from the newest sample: -1 is the last one written
+    return mHistory[(size_t) channel][(mHistoryWrite + (uint64_t) (int64_t) offset) & mHistoryMask];
+}
+
+void LossConcealer::appendHistory(const float* const* channels, int numSamples)
+{
+    // Only the most recent capacity samples can ever be read back
+    const int skip = std::max(0, numSamples - (int) (mHistoryMask + 1));
+    for (int ch = 0; ch < mNumChannels; ++ch)
+    {
+        auto* history = mHistory[(size_t) ch].data();
+        for (int i = skip; i < numSamples; ++i)
+            history[(mHistoryWrite + (uint64_t) i) & mHistoryMask] = channels[ch][i];
+    }
+    mHistoryWrite += (uint64_t) numSamples;
+}
+
+/**
+ * @brief Captures the last pitch period, overlap-adding its end with the samples before it
+*/
+void LossConcealer::startConcealment()
+{
+    mPeriod = findPitch();
+    mPeriodPosition = 0;
+    mConcealedSamples = 0;
+    mConcealing = true;
+
+    const int overlap = mPeriod / 4;
+    for (int ch = 0; ch < mNumChannels; ++ch)
+    {
+        auto* period = mPeriodBuffer[(size_t) ch].data();
+        for (int k = 0; k < mPeriod - overlap; ++k)
+            period[k] = getHistory(ch, k - mPeriod);
+
+        // Ends on the sample just before the period's first one, so the wrap is continuous
+        for (int j = 0; j < overlap; ++j)
+        {
+            const float w = ((float) j + 0.5f) / (float) overlap;
+            period[mPeriod - overlap + j] = (1.0f - w) * getHistory(ch, j - overlap) + w * getHistory(ch, j - overlap - mPeriod);
+        }
+
+        // The first repetition follows the last sample played, not the one a period before it
+        mStartOffsets[(size_t) ch] = getHistory(ch, -1) - getHistory(ch, -1 - mPeriod);
+    }
+}
+
+/**
+ * @brief Finds the pitch period of the recent output by normalized autocorrelation
+*/
+int LossConcealer::findPitch()
+{
+    // Coarse search on a decimated mono mix of the last two maximum periods
+    const int numDecimated = (int) mDecimated.size();
+    const float scale = 1.0f / (float) (PLC_DECIMATION * mNumChannels);
+    for (int j = 0; j < numDecimated; ++j)
+    {
+        float sum = 0.0f;
+        for (int ch = 0; ch < mNumChannels; ++ch)
+            for (int d = 0; d < PLC_DECIMATION; ++d)
+                sum += getHistory(ch, j * PLC_DECIMATION + d - 2 * mMaxPeriod);
+        mDecimated[(size_t) j] = sum * scale;
+    }
+
+    const int window = mMaxPeriod / PLC_DECIMATION;
+    const float* recent = mDecimated.data() + (numDecimated - window);
+    float recentEnergy = 0.0f;
+    for (int n = 0; n < window; ++n)
+        recentEnergy += recent[n] * recent[n];
+    if (recentEnergy <= 1e-9f)
+        return mMaxPeriod;
+
+    auto score = [](double cross, double energy) { return cross <= 0.0 ? 0.0 : cross * cross / (energy + 1e-12); };
+
+    const int minLag = std::max(1, mMinPeriod / PLC_DECIMATION);
+    const int maxLag = mMaxPeriod / PLC_DECIMATION;
+    double best = 0.0;
+    for (int lag = minLag; lag <= maxLag; ++lag)
+    {
+        double cross = 0.0, energy = 0.0;
+        for (int n = 0; n < window; ++n)
+        {
+            cross += (double) recent[n] * recent[n - lag];
+            energy += (double) recent[n - lag] * recent[n - lag];
+        }
+        mScores[(size_t) lag] = score(cross, energy);
+        best = std::max(best, mScores[(size_t) lag]);
+    }
+
+    // Multiples of the period score as well as the period itself: take the first peak close to the best
+    int coarse = maxLag;
+    for (int lag = minLag; lag <= maxLag; ++lag)
+    {
+        const double s = mScores[(size_t) lag];
+        if (s >= 0.9 * best && (lag == maxLag || s >= mScores[(size_t) lag + 1]))
+        {
+            coarse = lag;
+            break;
+        }
+    }
+
+    // Refine around the coarse lag at full rate, on a window half a maximum period long
+    const int fullWindow = mMaxPeriod / 2;
+    int period = coarse * PLC_DECIMATION;
+    best = -1.0;
+    const int first = std::max(mMinPeriod, coarse * PLC_DECIMATION - PLC_DECIMATION);
+    const int last = std::min(mMaxPeriod, coarse * PLC_DECIMATION + PLC_DECIMATION);
+    for (int lag = first; lag <= last; ++lag)
+    {
+        double cross = 0.0, energy = 0.0;
+        for (int n = -fullWindow; n < 0; ++n)
+        {
+            for (int ch = 0; ch < mNumChannels; ++ch)
+            {
+                const double a = getHistory(ch, n);
+                const double b = getHistory(ch, n - lag);
+                cross += a * b;
+                energy += b * b;
+            }
+        }
+        const double s = score(cross, energy);
+        if (s > best)
+        {
+            best = s;
+            period = lag;
+        }
+    }
+    return period;
+}
+
+/**
+ * @brief Continues the repeated period with the fade applied, without touching the history
+*/
+void LossConcealer::generate(float* const* dest, int numSamples)
+{
+    const int offsetSamples = std::max(1, mPeriod / 4);
+    for (int ch = 0; ch < mNumChannels; ++ch)
+    {
+        const auto* period = mPeriodBuffer[(size_t) ch].data();
+        const float offset = mStartOffsets[(size_t) ch];
+        int position = mPeriodPosition;
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const int elapsed = mConcealedSamples + i - mFullGainSamples;
+            const float gain = elapsed <= 0 ? 1.0f : std::max(0.0f, 1.0f - (float) elapsed / (float) mFadeSamples);
+            const int started = mConcealedSamples + i;
+            const float ramp = started < offsetSamples ? offset * (1.0f - ((float) started + 0.5f) / (float) offsetSamples) : 0.0f;
+            dest[ch][i] = (period[position] + ramp) * gain;
+            if (++position == mPeriod)
+                position = 0;
+        }
+    }
+
+    mPeriodPosition = (int) (((int64_t) mPeriodPosition + numSamples) % mPeriod);
+    // Saturates once the fade is done so long gaps cannot overflow it
+    mConcealedSamples = std::min(mConcealedSamples + numSamples, mFullGainSamples + mFadeSamples);
+}
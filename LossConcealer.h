@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define PLC_MIN_PITCH_MS 2.5
+#define PLC_MAX_PITCH_MS 15.0
+#define PLC_FULL_GAIN_MS 10.0
+#define PLC_FADE_MS 50.0
+#define PLC_CROSSFADE_MS 2.5
+#define PLC_DECIMATION 4
+
+/**
+ * @brief Packet loss concealment by pitch-period repetition
+ *
+ * Every frame that reaches the output passes through here: good frames through process(),
+ * missing ones are generated by conceal(). On the first missing frame the pitch period of the
+ * recent output is found by normalized autocorrelation, first on a 4x decimated mono mix and then
+ * refined at full rate; the first autocorrelation peak within 90% of the best wins, so multiples
+ * of the period are not mistaken for it. The last period is then repeated; its final quarter is overlap-added
+ * with the samples one period earlier so every repetition joins smoothly onto the next. Where the
+ * recent output is not exactly periodic the first repetition would still start with a step; the
+ * difference is added back and ramped out over the same quarter period.
+ *
+ * Concealment plays at full level for PLC_FULL_GAIN_MS and then fades to silence over
+ * PLC_FADE_MS, so a long gap does not turn into a buzz. The first good frame after a gap is
+ * cross-faded from the continuing concealment over PLC_CROSSFADE_MS.
+ *
+ * prepare() allocates. process() and conceal() run on the audio thread, do not allocate and do a
+ * bounded amount of work: the pitch search costs the same whatever the signal.
+*/
+class LossConcealer
+{
+public:
+    LossConcealer() = default;
+
+    void prepare(int numChannels, double sampleRate, int maxBlockSize);
+    void reset();
+
+    /** Passes a good block through, cross-fading it in if the previous block was concealed */
+    void process(float* const* channels, int numSamples);
+    /** Writes numSamples of concealment for a missing block */
+    void conceal(float* const* dest, int numSamples);
+    /** Repeats one pitch period (at most maxSamples) to lengthen the output; returns the count written */
+    int extend(float* const* dest, int maxSamples);
+
+    bool isConcealing() const { return mConcealing; }
+    int getPitchPeriod() const { return mPeriod; }
+
+private:
+    float getHistory(int channel, int offset) const;
+    void appendHistory(const float* const* channels, int numSamples);
+    void startConcealment();
+    int findPitch();
+    void generate(float* const* dest, int numSamples);
+
+    int mNumChannels = 0;
+    int mMinPeriod = 0;
+    int mMaxPeriod = 0;
+    int mFullGainSamples = 0;
+    int mFadeSamples = 0;
+    int mCrossfadeSamples = 0;
+
+    // Recent output per channel, indexed by a running sample count
+    std::vector<std::vector<float>> mHistory;
+    size_t mHistoryMask = 0;
+    uint64_t mHistoryWrite = 0;
+
+    std::vector<std::vector<float>> mPeriodBuffer;
+    std::vector<float> mStartOffsets;
+    std::vector<float> mDecimated;
+    std::vector<double> mScores;
+    std::vector<std::vector<float>> mCrossfade;
+    std::vector<float*> mCrossfadePtrs;
+
+    bool mConcealing = false;
+    int mPeriod = 0;
+    int mPeriodPosition = 0;
+    int mConcealedSamples = 0;
+};
@@ -0,0 +1,748 @@
+#include "LosslessCodec.h"
+#include "BitStream.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace
+{
+    enum SubframeType
+    {
+        Constant = 0,
+        Verbatim = 1,
+        Fixed = 2,
+        Lpc = 3
+    };
+
+    enum StereoMode
+    {
+        Independent = 0,
+        LeftSide = 1,
+        RightSide = 2,
+        MidSide = 3
+    };
+
+    constexpr int kRiceEscape = 31;
+    constexpr int kMaxRiceParam = 30;
+    constexpr int kMaxFixedOrder = 4;
+    constexpr int64_t kResidualLimit = int64_t(1) << 30;
+    constexpr int kLpcOrders[] = { 1, 2, 3, 4, 6, 8 };
+
+    bool fitsSigned(int64_t v, int bits)
+    {
+        return v >= -(int64_t(1) << (bits - 1)) && v < (int64_t(1) << (bits - 1));
+    }
+
+    bool computeFixedResidual(const int32_t* x, int n, int order, int32_t* residual)
+    {
+        for (int i = order; i < n; ++i)
+        {
+            int64_t r = 0;
+            switch (order)
+            {
+                case 0: r = x[i]; break;
+                case 1: r = (int64_t) x[i] - x[i - 1]; break;
+                case 2: r = (int64_t) x[i] - 2 * (int64_t) x[i - 1] + x[i - 2]; break;
+                case 3: r = (int64_t) x[i] - 3 * (int64_t) x[i - 1] + 3 * (int64_t) x[i - 2] - x[i - 3]; break;
+                case 4: r = (int64_t) x[i] - 4 * (int64_t) x[i - 1] + 6 * (int64_t) x[i - 2] - 4 * (int64_t) x[i - 3] + x[i - 4]; break;
+                default: return false;
+            }
+            if (r >= kResidualLimit || r <= -kResidualLimit)
+                return false;
+            residual[i] = (int32_t) r;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Picks the fixed predictor order with the smallest absolute residual in one pass and
+     * returns a rough Rice-coded size for it, used to rank stereo modes without coding them
+    */
+    int64_t estimateFixed(const int32_t* x, int n, int& order)
+    {
+        order = 0;
+        if (n <= kMaxFixedOrder)
+            return (int64_t) n * 32;
+
+        uint64_t sums[kMaxFixedOrder + 1] = {};
+        int64_t d1 = (int64_t) x[3] - x[2];
+        int64_t d2 = d1 - ((int64_t) x[2] - x[1]);
+        int64_t d3 = d2 - ((int64_t) x[2] - x[1] - ((int64_t) x[1] - x[0]));
+        for (int i = kMaxFixedOrder; i < n; ++i)
+        {
+            const int64_t e0 = x[i];
+            const int64_t e1 = e0 - x[i - 1];
+            const int64_t e2 = e1 - d1;
+            const int64_t e3 = e2 - d2;
+            const int64_t e4 = e3 - d3;
+            sums[0] += (uint64_t) std::abs(e0);
+            sums[1] += (uint64_t) std::abs(e1);
+            sums[2] += (uint64_t) std::abs(e2);
+            sums[3] += (uint64_t) std::abs(e3);
+            sums[4] += (uint64_t) std::abs(e4);
+            d1 = e1;
+            d2 = e2;
+            d3 = e3;
+        }
+
+        for (int o = 1; o <= kMaxFixedOrder; ++o)
+            if (sums[o] < sums[order])
+                order = o;
+
+        const auto count = (uint64_t) (n - kMaxFixedOrder);
+        const auto mean = 2 * sums[order] / count;
+        const int k = mean == 0 ? 0 : 63 - std::countl_zero(mean);
+        return (int64_t) (count * (uint64_t) (k + 1) + ((2 * sums[order]) >> k));
+    }
+
+    // Fixed-order kernel so the predictor loop unrolls; the range check is folded into one
+    // min/max pass instead of a branch per sample
+    template <int Order>
+    bool computeLpcResidual(const int32_t* x, int n, const int32_t* coeffs, int shift, int32_t* residual)
+    {
+        int64_t lo = 0, hi = 0;
+        for (int i = Order; i < n; ++i)
+        {
+            int64_t sum = 0;
+            for (int j = 0; j < Order; ++j)
+                sum += (int64_t) coeffs[j] * x[i - 1 - j];
+            const int64_t r = (int64_t) x[i] - (sum >> shift);
+            lo = std::min(lo, r);
+            hi = std::max(hi, r);
+            residual[i] = (int32_t) r;
+        }
+        return hi < kResidualLimit && lo > -kResidualLimit;
+    }
+
+    bool computeLpcResidual(const int32_t* x, int n, const int32_t* coeffs, int order, int shift, int32_t* residual)
+    {
+        switch (order)
+        {
+            case 1: return computeLpcResidual<1>(x, n, coeffs, shift, residual);
+            case 2: return computeLpcResidual<2>(x, n, coeffs, shift, residual);
+            case 3: return computeLpcResidual<3>(x, n, coeffs, shift, residual);
+            case 4: return computeLpcResidual<4>(x, n, coeffs, shift, residual);
+            case 5: return computeLpcResidual<5>(x, n, coeffs, shift, residual);
+            case 6: return computeLpcResidual<6>(x, n, coeffs, shift, residual);
+            case 7: return computeLpcResidual<7>(x, n, coeffs, shift, residual);
+            case 8: return computeLpcResidual<8>(x, n, coeffs, shift, residual);
+            default: return false;
+        }
+    }
+
+    bool quantizeLpc(const double* lpc, int order, int precision, int32_t* coeffs, int& shift)
+    {
+        double cmax = 0.0;
+        for (int j = 0; j < order; ++j)
+            cmax = std::max(cmax, std::abs(lpc[j]));
+        if (cmax <= 0.0 || !std::isfinite(cmax))
+            return false;
+
+        int exponent = 0;
+        std::frexp(cmax, &exponent);
+        shift = std::min(precision - exponent - 1, 31);
+        if (shift < 0)
+            return false;
+
+        const int32_t qmax = (1 << (precision - 1)) - 1;
+        double error = 0.0;
+        for (int j = 0; j < order; ++j)
+        {
+            error += lpc[j] * (double) (int64_t(1) << shift);
+            const auto q = (int32_t) std::clamp<long>(std::lround(error), -qmax - 1, qmax);
+            coeffs[j] = q;
+            error -= q;
+        }
+        return true;
+    }
+
+    void writeResidual(BitWriter& writer, const int32_t* residual, int n, int order, int partitionOrder, const uint8_t* riceParams)
+    {
+        writer.write((uint32_t) partitionOrder, 3);
+        const int partitionSize = n >> partitionOrder;
+
+        for (int p = 0; p < (1 << partitionOrder); ++p)
+        {
+            const int start = p == 0 ? order : p * partitionSize;
+            const int end = (p + 1) * partitionSize;
+            const int k = riceParams[p];
+            writer.write((uint32_t) k, 5);
+
+            if (k == kRiceEscape)
+            {
+                uint32_t maxU = 0;
+                for (int i = start; i < end; ++i)
+                    maxU = std::max(maxU, zigzagEncode(residual[i]));
+                const int width = maxU == 0 ? 0 : 32 - std::countl_zero(maxU);
+                writer.write((uint32_t) width, 5);
+                for (int i = start; i < end; ++i)
+                    writer.write((uint32_t) residual[i], width);
+            }
+            else
+            {
+                for (int i = start; i < end; ++i)
+                    writer.writeRice(residual[i], k);
+            }
+        }
+    }
+
+    bool readResidual(BitReader& reader, int32_t* residual, int n, int order)
+    {
+        const int partitionOrder = (int) reader.read(3);
+        const int partitionSize = n >> partitionOrder;
+        if ((partitionSize << partitionOrder) != n || partitionSize < order)
+            return false;
+
+        for (int p = 0; p < (1 << partitionOrder); ++p)
+        {
+            const int start = p == 0 ? order : p * partitionSize;
+            const int end = (p + 1) * partitionSize;
+            const int k = (int) reader.read(5);
+
+            if (k == kRiceEscape)
+            {
+                const int width = (int) reader.read(5);
+                for (int i = start; i < end; ++i)
+                    residual[i] = width == 0 ? 0 : reader.readSigned(width);
+            }
+            else
+            {
+                for (int i = start; i < end; ++i)
+                    residual[i] = reader.readRice(k);
+            }
+
+            if (reader.hasError())
+                return false;
+        }
+        return true;
+    }
+
+    bool readSubframe(BitReader& reader, int32_t* x, int n, int sampleBits)
+    {
+        const int type = (int) reader.read(2);
+
+        if (type == Constant)
+        {
+            const auto value = reader.readSigned(sampleBits);
+            std::fill(x, x + n, value);
+            return !reader.hasError();
+        }
+
+        if (type == Verbatim)
+        {
+            for (int i = 0; i < n; ++i)
+                x[i] = reader.readSigned(sampleBits);
+            return !reader.hasError();
+        }
+
+        int order = 0, shift = 0;
+        int32_t coeffs[LOSSLESS_MAX_LPC_ORDER] = {};
+
+        if (type == Fixed)
+        {
+            order = (int) reader.read(3);
+            if (order > kMaxFixedOrder)
+                return false;
+        }
+        else
+        {
+            order = (int) reader.read(4) + 1;
+            const int precision = (int) reader.read(4) + 1;
+            shift = (int) reader.read(5);
+            if (order > LOSSLESS_MAX_LPC_ORDER)
+                return false;
+            for (int j = 0; j < order; ++j)
+                coeffs[j] = reader.readSigned(precision);
+        }
+
+        if (order > n)
+            return false;
+
+        for (int i = 0; i < order; ++i)
+            x[i] = reader.readSigned(sampleBits);
+
+        if (reader.hasError() || !readResidual(reader, x, n, order))
+            return false;
+
+        // x[order..] holds the residual at this point and is reconstructed in place
+        for (int i = order; i < n; ++i)
+        {
+            int64_t prediction = 0;
+            if (type == Fixed)
+            {
+                switch (order)
+                {
+                    case 0: prediction = 0; break;
+                    case 1: prediction = x[i - 1]; break;
+                    case 2: prediction = 2 * (int64_t) x[i - 1] - x[i - 2]; break;
+                    case 3: prediction = 3 * (int64_t) x[i - 1] - 3 * (int64_t) x[i - 2] + x[i - 3]; break;
+                    default: prediction = 4 * (int64_t) x[i - 1] - 6 * (int64_t) x[i - 2] + 4 * (int64_t) x[i - 3] - x[i - 4]; break;
+                }
+            }
+            else
+            {
+                for (int j = 0; j < order; ++j)
+                    prediction += (int64_t) coeffs[j] * x[i - 1 - j];
+                prediction >>= shift;
+            }
+
+            const int64_t value = x[i] + prediction;
+            if (!fitsSigned(value, sampleBits))
+                return false;
+            x[i] = (int32_t) value;
+        }
+        return true;
+    }
+}
+
+/**
+ * @brief Allocates scratch memory for packets of up to maxChannels x maxFrames
+*/
+void LosslessCodec::prepare(int maxChannels, int maxFrames)
+{
+    mMaxChannels = maxChannels;
+    mMaxFrames = std::min(maxFrames, 65535);
+    mChannels.assign((size_t) maxChannels, std::vector<int32_t>((size_t) mMaxFrames));
+    mChannelPtrs.assign((size_t) maxChannels, nullptr);
+    mChannelWritePtrs.assign((size_t) maxChannels, nullptr);
+    mMid.assign((size_t) mMaxFrames, 0);
+    mSide.assign((size_t) mMaxFrames, 0);
+    mResidual.assign((size_t) mMaxFrames, 0);
+    mWindowed.assign((size_t) mMaxFrames, 0.0);
+}
+
+/**
+ * @brief Upper bound for an encoded packet: the verbatim size plus headers
+*/
+size_t LosslessCodec::getMaxEncodedSize(int numChannels, int numFrames, int bitsPerSample)
+{
+    const auto bits = 37 + (size_t) numChannels * (2 + 2 + (size_t) numFrames * (size_t) (bitsPerSample + 1));
+    return bits / 8 + 2;
+}
+
+int32_t LosslessCodec::quantize(float sample, int bitsPerSample)
+{
+    const float scale = (float) (1 << (bitsPerSample - 1));
+    return (int32_t) std::lrintf(std::clamp(sample * scale, -scale, scale - 1.0f));
+}
+
+/**
+ * @brief Quantizes a planar float block to bitsPerSample and encodes it. Returns 0 on failure
+*/
+size_t LosslessCodec::encode(const float* const* src, int numChannels, int numFrames, int bitsPerSample, uint8_t* dest, size_t capacity)
+{
+    if (numChannels < 1 || numChannels > mMaxChannels || numFrames < 1 || numFrames > mMaxFrames)
+        return 0;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto* q = mChannels[(size_t) ch].data();
+        for (int i = 0; i < numFrames; ++i)
+            q[i] = quantize(src[ch][i], bitsPerSample);
+        mChannelPtrs[(size_t) ch] = q;
+    }
+
+    return encode(mChannelPtrs.data(), numChannels, numFrames, bitsPerSample, dest, capacity);
+}
+
+/**
+ * @brief Encodes a planar block of PCM integers. Returns the packet size, or 0 on failure
+*/
+size_t LosslessCodec::encode(const int32_t* const* src, int numChannels, int numFrames, int bitsPerSample, uint8_t* dest, size_t capacity)
+{
+    if (numChannels < 1 || numChannels > mMaxChannels || numChannels > 255 || numFrames < 1 || numFrames > mMaxFrames
+        || bitsPerSample < 4 || bitsPerSample > 24)
+        return 0;
+
+    BitWriter writer(dest, capacity);
+    writer.write(LOSSLESS_CODEC_VERSION, 8);
+    writer.write((uint32_t) numChannels, 8);
+    writer.write((uint32_t) numFrames, 16);
+    writer.write((uint32_t) bitsPerSample, 5);
+
+    auto writeSubframe = [&](const int32_t* x, int sampleBits, const SubframePlan& plan) {
+        writer.write((uint32_t) plan.type, 2);
+
+        if (plan.type == Constant)
+        {
+            writer.write((uint32_t) x[0], sampleBits);
+            return;
+        }
+
+        if (plan.type == Verbatim)
+        {
+            for (int i = 0; i < numFrames; ++i)
+                writer.write((uint32_t) x[i], sampleBits);
+            return;
+        }
+
+        if (plan.type == Fixed)
+        {
+            writer.write((uint32_t) plan.order, 3);
+            computeFixedResidual(x, numFrames, plan.order, mResidual.data());
+        }
+        else
+        {
+            writer.write((uint32_t) plan.order - 1, 4);
+            writer.write((uint32_t) plan.precision - 1, 4);
+            writer.write((uint32_t) plan.shift, 5);
+            for (int j = 0; j < plan.order; ++j)
+                writer.write((uint32_t) plan.coeffs[j], plan.precision);
+            computeLpcResidual(x, numFrames, plan.coeffs, plan.order, plan.shift, mResidual.data());
+        }
+
+        for (int i = 0; i < plan.order; ++i)
+            writer.write((uint32_t) x[i], sampleBits);
+        writeResidual(writer, mResidual.data(), numFrames, plan.order, plan.partitionOrder, plan.riceParams);
+    };
+
+    int ch = 0;
+    for (; ch + 1 < numChannels; ch += 2)
+    {
+        const int32_t* left = src[ch];
+        const int32_t* right = src[ch + 1];
+        for (int i = 0; i < numFrames; ++i)
+        {
+            mSide[(size_t) i] = left[i] - right[i];
+            mMid[(size_t) i] = (left[i] + right[i]) >> 1;
+        }
+
+        // Rank the stereo modes on the fixed-predictor estimate and only fully plan the chosen pair
+        int unusedOrder = 0;
+        const auto bitsLeft = estimateFixed(left, numFrames, unusedOrder);
+        const auto bitsRight = estimateFixed(right, numFrames, unusedOrder);
+        const auto bitsMid = estimateFixed(mMid.data(), numFrames, unusedOrder);
+        const auto bitsSide = estimateFixed(mSide.data(), numFrames, unusedOrder);
+
+        const int64_t costs[] = { bitsLeft + bitsRight, bitsLeft + bitsSide, bitsSide + bitsRight, bitsMid + bitsSide };
+        const auto mode = (int) (std::min_element(std::begin(costs), std::end(costs)) - std::begin(costs));
+        writer.write((uint32_t) mode, 2);
+
+        SubframePlan planLeft, planRight, planMid, planSide;
+        if (mode == Independent || mode == LeftSide)
+            planSubframe(left, numFrames, bitsPerSample, planLeft);
+        if (mode == Independent || mode == RightSide)
+            planSubframe(right, numFrames, bitsPerSample, planRight);
+        if (mode == MidSide)
+            planSubframe(mMid.data(), numFrames, bitsPerSample, planMid);
+        if (mode != Independent)
+            planSubframe(mSide.data(), numFrames, bitsPerSample + 1, planSide);
+
+        switch (mode)
+        {
+            case LeftSide:
+                writeSubframe(left, bitsPerSample, planLeft);
+                writeSubframe(mSide.data(), bitsPerSample + 1, planSide);
+                break;
+            case RightSide:
+                writeSubframe(mSide.data(), bitsPerSample + 1, planSide);
+                writeSubframe(right, bitsPerSample, planRight);
+                break;
+            case MidSide:
+                writeSubframe(mMid.data(), bitsPerSample, planMid);
+                writeSubframe(mSide.data(), bitsPerSample + 1, planSide);
+                break;
+            case Independent:
+            default:
+                writeSubframe(left, bitsPerSample, planLeft);
+                writeSubframe(right, bitsPerSample, planRight);
+                break;
+        }
+    }
+
+    if (ch < numChannels)
+    {
+        SubframePlan plan;
+        planSubframe(src[ch], numFrames, bitsPerSample, plan);
+        writeSubframe(src[ch], bitsPerSample, plan);
+    }
+
+    return writer.finish();
+}
+
+/**
+ * @brief Decodes a packet into planar float. Returns false on a malformed packet
+*/
+bool LosslessCodec::decode(const uint8_t* src, size_t size, float* const* dest, int maxChannels, int maxFrames, int& numChannels, int& numFrames)
+{
+    const int channelLimit = std::min(maxChannels, mMaxChannels);
+    for (int ch = 0; ch < channelLimit; ++ch)
+        mChannelWritePtrs[(size_t) ch] = mChannels[(size_t) ch].data();
+
+    int bitsPerSample = 0;
+    if (!decode(src, size, mChannelWritePtrs.data(), channelLimit, std::min(maxFrames, mMaxFrames), numChannels, numFrames, bitsPerSample))
+        return false;
+
+    const float scale = 1.0f / (float) (1 << (bitsPerSample - 1));
+    for (int ch = 0; ch < numChannels; ++ch)
+        for (int i = 0; i < numFrames; ++i)
+            dest[ch][i] = (float) mChannels[(size_t) ch][(size_t) i] * scale;
+    return true;
+}
+
+/**
+ * @brief Decodes a packet into planar PCM integers. Returns false on a malformed packet
+*/
+bool LosslessCodec::decode(const uint8_t* src, size_t size, int32_t* const* dest, int maxChannels, int maxFrames, int& numChannels, int& numFrames, int& bitsPerSample)
+{
+    BitReader reader(src, size);
+    if (reader.read(8) != LOSSLESS_CODEC_VERSION)
+        return false;
+
+    numChannels = (int) reader.read(8);
+    numFrames = (int) reader.read(16);
+    bitsPerSample = (int) reader.read(5);
+
+    if (reader.hasError() || numChannels < 1 || numChannels > maxChannels || numFrames < 1 || numFrames > maxFrames
+        || bitsPerSample < 4 || bitsPerSample > 24)
+        return false;
+
+    int ch = 0;
+    for (; ch + 1 < numChannels; ch += 2)
+    {
+        const int mode = (int) reader.read(2);
+        const int firstBits = mode == RightSide ? bitsPerSample + 1 : bitsPerSample;
+        const int secondBits = mode == Independent || mode == RightSide ? bitsPerSample : bitsPerSample + 1;
+
+        int32_t* a = dest[ch];
+        int32_t* b = dest[ch + 1];
+        if (!readSubframe(reader, a, numFrames, firstBits) || !readSubframe(reader, b, numFrames, secondBits))
+            return false;
+
+        for (int i = 0; i < numFrames; ++i)
+        {
+            switch (mode)
+            {
+                case LeftSide:
+                    b[i] = a[i] - b[i];
+                    break;
+                case RightSide:
+                    a[i] = a[i] + b[i];
+                    break;
+                case MidSide:
+                {
+                    const int32_t side = b[i];
+                    const int32_t sum = (int32_t) ((uint32_t) a[i] << 1) | (side & 1);
+                    a[i] = (sum + side) >> 1;
+                    b[i] = (sum - side) >> 1;
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+    if (ch < numChannels && !readSubframe(reader, dest[ch], numFrames, bitsPerSample))
+        return false;
+
+    return !reader.hasError();
+}
+
+/**
+ * @brief Picks the cheapest subframe coding for one channel and returns its size in bits
+*/
+int64_t LosslessCodec::planSubframe(const int32_t* x, int n, int sampleBits, SubframePlan& plan)
+{
+    if (std::all_of(x + 1, x + n, [x](int32_t v) { return v == x[0]; }))
+    {
+        plan.type = Constant;
+        plan.bits = 2 + sampleBits;
+        return plan.bits;
+    }
+
+    plan.type = Verbatim;
+    plan.bits = 2 + (int64_t) n * sampleBits;
+
+    SubframePlan candidate;
+    int fixedOrder = 0;
+    estimateFixed(x, n, fixedOrder);
+    if (computeFixedResidual(x, n, fixedOrder, mResidual.data()))
+    {
+        candidate.type = Fixed;
+        candidate.order = fixedOrder;
+        candidate.bits = 2 + 3 + (int64_t) fixedOrder * sampleBits + planResidual(mResidual.data(), n, fixedOrder, candidate);
+        if (candidate.bits < plan.bits)
+            plan = candidate;
+    }
+
+    const int maxLpcOrder = std::min(LOSSLESS_MAX_LPC_ORDER, n - 1);
+    if (maxLpcOrder < 1)
+        return plan.bits;
+
+    computeLpc(x, n, maxLpcOrder);
+    const int precision = sampleBits <= 17 ? 12 : 15;
+
+    // Rank the orders on the Levinson prediction error and only code the two most promising ones
+    int bestOrders[2] = { 0, 0 };
+    double bestEstimates[2] = { 0.0, 0.0 };
+    for (int order : kLpcOrders)
+    {
+        if (order > maxLpcOrder || mLpcError[order] <= 0.0)
+            break;
+
+        const double estimate = 0.5 * (n - order) * std::log2(std::max(mLpcError[order] / n, 1.0)) + order * (precision + sampleBits);
+        if (bestOrders[0] == 0 || estimate < bestEstimates[0])
+        {
+            bestOrders[1] = bestOrders[0];
+            bestEstimates[1] = bestEstimates[0];
+            bestOrders[0] = order;
+            bestEstimates[0] = estimate;
+        }
+        else if (bestOrders[1] == 0 || estimate < bestEstimates[1])
+        {
+            bestOrders[1] = order;
+            bestEstimates[1] = estimate;
+        }
+    }
+
+    for (int order : bestOrders)
+    {
+        if (order == 0)
+            continue;
+
+        candidate.type = Lpc;
+        candidate.order = order;
+        candidate.precision = precision;
+        if (!quantizeLpc(mLpc[order], order, precision, candidate.coeffs, candidate.shift)
+            || !computeLpcResidual(x, n, candidate.coeffs, order, candidate.shift, mResidual.data()))
+            continue;
+
+        candidate.bits = 2 + 4 + 4 + 5 + (int64_t) order * (precision + sampleBits) + planResidual(mResidual.data(), n, order, candidate);
+        if (candidate.bits < plan.bits)
+            plan = candidate;
+    }
+
+    return plan.bits;
+}
+
+/**
+ * @brief Chooses the partition order and Rice parameters for a residual, returning the estimated size in bits
+*/
+int64_t LosslessCodec::planResidual(const int32_t* residual, int n, int order, SubframePlan& plan)
+{
+    int maxPartitionOrder = 0;
+    while (maxPartitionOrder < LOSSLESS_MAX_PARTITION_ORDER
+           && ((n >> (maxPartitionOrder + 1)) << (maxPartitionOrder + 1)) == n
+           && (n >> (maxPartitionOrder + 1)) >= std::max(order, 1))
+        ++maxPartitionOrder;
+
+    constexpr int kMaxPartitions = 1 << LOSSLESS_MAX_PARTITION_ORDER;
+    uint64_t sums[kMaxPartitions] = {};
+    uint32_t maxima[kMaxPartitions] = {};
+    int counts[kMaxPartitions] = {};
+
+    const int finestSize = n >> maxPartitionOrder;
+    for (int p = 0; p < (1 << maxPartitionOrder); ++p)
+    {
+        const int start = p == 0 ? order : p * finestSize;
+        const int end = (p + 1) * finestSize;
+        for (int i = start; i < end; ++i)
+        {
+            const auto u = zigzagEncode(residual[i]);
+            sums[p] += u;
+            maxima[p] = std::max(maxima[p], u);
+        }
+        counts[p] = end - start;
+    }
+
+    int64_t bestBits = -1;
+    for (int partitionOrder = maxPartitionOrder; partitionOrder >= 0; --partitionOrder)
+    {
+        const int numPartitions = 1 << partitionOrder;
+        if (partitionOrder < maxPartitionOrder)
+        {
+            // Merge the finer level pairwise to get this level's statistics
+            for (int p = 0; p < numPartitions; ++p)
+            {
+                sums[p] = sums[2 * p] + sums[2 * p + 1];
+                maxima[p] = std::max(maxima[2 * p], maxima[2 * p + 1]);
+                counts[p] = counts[2 * p] + counts[2 * p + 1];
+            }
+        }
+
+        int64_t bits = 3;
+        uint8_t params[kMaxPartitions];
+        for (int p = 0; p < numPartitions; ++p)
+        {
+            const int width = maxima[p] == 0 ? 0 : 32 - std::countl_zero(maxima[p]);
+            int64_t best = 5 + 5 + (int64_t) counts[p] * width;
+            params[p] = kRiceEscape;
+
+            if (counts[p] > 0)
+            {
+                const auto mean = sums[p] / (uint64_t) counts[p];
+                const int estimate = mean == 0 ? 0 : 63 - std::countl_zero(mean);
+                for (int k = std::max(estimate - 1, 0); k <= std::min(estimate + 1, kMaxRiceParam); ++k)
+                {
+                    const int64_t cost = 5 + (int64_t) counts[p] * (k + 1) + (int64_t) (sums[p] >> k);
+                    if (cost < best)
+                    {
+                        best = cost;
+                        params[p] = (uint8_t) k;
+                    }
+                }
+            }
+            bits += best;
+        }
+
+        if (bestBits < 0 || bits < bestBits)
+        {
+            bestBits = bits;
+            plan.partitionOrder = partitionOrder;
+            std::copy(params, params + numPartitions, plan.riceParams);
+        }
+    }
+
+    return bestBits;
+}
+
+/**
+ * @brief Levinson-Durbin on the Welch-windowed autocorrelation; fills mLpc[order] and mLpcError[order] for every order
+*/
+void LosslessCodec::computeLpc(const int32_t* x, int n, int maxOrder)
+{
+    const double half = 0.5 * (n - 1);
+    const double scale = 0.5 * (n + 1);
+    for (int i = 0; i < n; ++i)
+    {
+        const double t = (i - half) / scale;
+        mWindowed[(size_t) i] = x[i] * (1.0 - t * t);
+    }
+
+    double autocorr[LOSSLESS_MAX_LPC_ORDER + 1] = {};
+    for (int lag = 0; lag <= maxOrder; ++lag)
+        for (int i = lag; i < n; ++i)
+            autocorr[lag] += mWindowed[(size_t) i] * mWindowed[(size_t) (i - lag)];
+
+    double a[LOSSLESS_MAX_LPC_ORDER + 1] = { 1.0 };
+    double error = autocorr[0];
+
+    for (int m = 1; m <= LOSSLESS_MAX_LPC_ORDER; ++m)
+    {
+        std::fill(mLpc[m], mLpc[m] + LOSSLESS_MAX_LPC_ORDER + 1, 0.0);
+        mLpcError[m] = 0.0;
+    }
+
+    for (int m = 1; m <= maxOrder && error > 0.0; ++m)
+    {
+        double acc = autocorr[m];
+        for (int j = 1; j < m; ++j)
+            acc += a[j] * autocorr[m - j];
+        const double k = -acc / error;
+
+        double next[LOSSLESS_MAX_LPC_ORDER + 1];
+        for (int j = 1; j < m; ++j)
+            next[j] = a[j] + k * a[m - j];
+        next[m] = k;
+        for (int j = 1; j <= m; ++j)
+            a[j] = next[j];
+        error *= 1.0 - k * k;
+        mLpcError[m] = error;
+
+        // Predictor form: x[i] ~ sum_j mLpc[m][j] * x[i - 1 - j]
+        for (int j = 0; j < m; ++j)
+            mLpc[m][j] = -a[j + 1];
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define LOSSLESS_CODEC_VERSION 1
+#define LOSSLESS_MAX_LPC_ORDER 8
+#define LOSSLESS_MAX_PARTITION_ORDER 6
+
+/**
+ * @brief FLAC-style lossless codec for one packet of quantized PCM
+ *
+ * Each packet is self-contained: channel pairs are decorrelated (left/side, right/side or
+ * mid/side), every channel is coded with the best of constant, verbatim, fixed polynomial or
+ * quantized LPC prediction, and residuals are Rice coded in partitions. Nothing is carried
+ * between packets, so a lost packet never affects the next one.
+ *
+ * prepare() allocates all scratch memory, so encode and decode do not touch the heap.
+*/
+class LosslessCodec
+{
+public:
+    LosslessCodec() = default;
+
+    void prepare(int maxChannels, int maxFrames);
+
+    static size_t getMaxEncodedSize(int numChannels, int numFrames, int bitsPerSample);
+
+    size_t encode(const float* const* src, int numChannels, int numFrames, int bitsPerSample, uint8_t* dest, size_t capacity);
+    size_t encode(const int32_t* const* src, int numChannels, int numFrames, int bitsPerSample, uint8_t* dest, size_t capacity);
+
+    bool decode(const uint8_t* src, size_t size, float* const* dest, int maxChannels, int maxFrames, int& numChannels, int& numFrames);
+    bool decode(const uint8_t* src, size_t size, int32_t* const* dest, int maxChannels, int maxFrames, int& numChannels, int& numFrames, int& bitsPerSample);
+
+    static int32_t quantize(float sample, int bitsPerSample);
+
+private:
+    struct SubframePlan
+    {
+        int type = 0;
+        int order = 0;
+        int precision = 0;
+        int shift = 0;
+        int32_t coeffs[LOSSLESS_MAX_LPC_ORDER] = {};
+        int partitionOrder = 0;
+        uint8_t riceParams[1 << LOSSLESS_MAX_PARTITION_ORDER] = {};
+        int64_t bits = 0;
+    };
+
+    int64_t planSubframe(const int32_t* x, int n, int sampleBits, SubframePlan& plan);
+    int64_t planResidual(const int32_t* residual, int n, int order, SubframePlan& plan);
+    void computeLpc(const int32_t* x, int n, int maxOrder);
+
+    std::vector<std::vector<int32_t>> mChannels;
+    std::vector<const int32_t*> mChannelPtrs;
+    std::vector<int32_t*> mChannelWritePtrs;
+    std::vector<int32_t> mMid, mSide;
+    std::vector<int32_t> mResidual;
+    std::vector<double> mWindowed;
+    double mLpc[LOSSLESS_MAX_LPC_ORDER + 1][LOSSLESS_MAX_LPC_ORDER + 1] = {};
+    double mLpcError[LOSSLESS_MAX_LPC_ORDER + 1] = {};
+    int mMaxChannels = 0;
+    int mMaxFrames = 0;
+};
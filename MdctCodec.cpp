@@ -0,0 +1,358 @@
+#include "MdctCodec.h"
+#include "BitStream.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace
+{
+    // Band edges in bins for a 120-bin frame (200 Hz per bin at 48 kHz), scaled for other hops
+    constexpr int kBandEdges120[] = { 0, 2, 4, 6, 8, 10, 12, 16, 20, 24, 32, 40, 56, 72, 96, 120 };
+
+    // Quantizer range in band RMS units for 0..MDCT_MAX_BAND_BITS bits, close to the optimal
+    // uniform quantizer for a unit-variance Gaussian
+    constexpr float kLoading[MDCT_MAX_BAND_BITS + 1] = { 0.0f, 1.596f, 1.99f, 2.34f, 2.68f, 3.0f, 3.3f, 3.6f, 3.9f };
+
+    constexpr int kMinEnergy = -64;
+    constexpr int kMaxEnergy = 63;
+    constexpr int kEnergyRice = 1;
+
+    float bandGain(int energy)
+    {
+        return std::exp2(0.5f * (float) energy);
+    }
+
+    int bandBits(int energy, int threshold)
+    {
+        return std::clamp((energy - threshold) / 2, 0, MDCT_MAX_BAND_BITS);
+    }
+}
+
+MdctCodec::MdctCodec(int bitrate) : mBitrate(bitrate > 0 ? bitrate : MDCT_DEFAULT_BITRATE)
+{
+}
+
+/**
+ * @brief Builds the window, transform matrix and band layout for the sample rate
+*/
+void MdctCodec::prepare(double sampleRate, int numChannels, int)
+{
+    mHop = std::max(8, (int) (sampleRate * MDCT_FRAME_MS / 1000.0) & ~3);
+    mNumChannels = numChannels;
+
+    const int channelBitrate = std::clamp(mBitrate / std::max(numChannels, 1), MDCT_MIN_CHANNEL_BITRATE, MDCT_MAX_CHANNEL_BITRATE);
+    mFrameBits = (int) ((int64_t) channelBitrate * mHop / (int64_t) sampleRate);
+
+    mBandEdges.clear();
+    for (int edge : kBandEdges120)
+    {
+        const int scaled = edge * mHop / 120;
+        if (mBandEdges.empty() || scaled > mBandEdges.back())
+            mBandEdges.push_back(scaled);
+    }
+    mBandEdges.back() = mHop;
+
+    const double pi = 3.14159265358979323846;
+    mWindow.resize((size_t) (2 * mHop));
+    for (int n = 0; n < 2 * mHop; ++n)
+        mWindow[(size_t) n] = (float) std::sin(pi * (n + 0.5) / (2.0 * mHop));
+
+    // Orthonormal DCT-IV: symmetric and its own inverse
+    mDct.resize((size_t) (mHop * mHop));
+    const double scale = std::sqrt(2.0 / mHop);
+    for (int k = 0; k < mHop; ++k)
+        for (int n = 0; n < mHop; ++n)
+            mDct[(size_t) (k * mHop + n)] = (float) (scale * std::cos(pi / mHop * (n + 0.5) * (k + 0.5)));
+
+    mInput.assign((size_t) numChannels, std::vector<float>((size_t) mHop));
+    mHistory.assign((size_t) numChannels, std::vector<float>((size_t) mHop));
+    mOverlap.assign((size_t) numChannels, std::vector<float>((size_t) mHop));
+    mWindowed.assign((size_t) (2 * mHop), 0.0f);
+    mFolded.assign((size_t) mHop, 0.0f);
+    mCoeffs.assign((size_t) mHop, 0.0f);
+    mSpectrum.assign((size_t) mHop, 0.0f);
+    reset();
+}
+
+/**
+ * @brief Clears the transform overlap, e.g. when a stream restarts
+*/
+void MdctCodec::reset()
+{
+    for (auto& channel : mInput)
+        std::fill(channel.begin(), channel.end(), 0.0f);
+    for (auto& channel : mHistory)
+        std::fill(channel.begin(), channel.end(), 0.0f);
+    for (auto& channel : mOverlap)
+        std::fill(channel.begin(), channel.end(), 0.0f);
+    mNumBuffered = 0;
+    mNoiseSeed = 1;
+}
+
+size_t MdctCodec::getMaxEncodedSize(int numChannels, int numFrames) const
+{
+    const int numBands = (int) mBandEdges.size() - 1;
+    const size_t energyBits = 7 + (size_t) std::max(numBands - 1, 0) * ((kMaxEnergy - kMinEnergy) + 2);
+    const size_t numHops = (size_t) (numFrames + mHop - 1) / (size_t) std::max(mHop, 1) + 1;
+    return (16 + numHops * (size_t) numChannels * (energyBits + (size_t) mFrameBits) + 7) / 8;
+}
+
+/**
+ * @brief Buffers input and codes every completed hop. Returns the payload size, or 0 when no
+ * hop completed or the payload did not fit
+*/
+size_t MdctCodec::encode(const float* const* src, int numChannels, int numFrames, uint8_t* dest, size_t capacity, int& numEncodedFrames)
+{
+    numEncodedFrames = 0;
+    if (numChannels != mNumChannels || mHop == 0)
+        return 0;
+
+    const int numHops = (mNumBuffered + numFrames) / mHop;
+    const int numBands = (int) mBandEdges.size() - 1;
+
+    BitWriter writer(dest, capacity);
+    writer.write((uint32_t) numHops, 16);
+
+    int consumed = 0;
+    while (consumed < numFrames)
+    {
+        const int count = std::min(numFrames - consumed, mHop - mNumBuffered);
+        for (int ch = 0; ch < numChannels; ++ch)
+            std::copy(src[ch] + consumed, src[ch] + consumed + count, mInput[(size_t) ch].begin() + mNumBuffered);
+        mNumBuffered += count;
+        consumed += count;
+
+        if (mNumBuffered < mHop)
+            break;
+        mNumBuffered = 0;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto& history = mHistory[(size_t) ch];
+            auto& input = mInput[(size_t) ch];
+            std::copy(history.begin(), history.end(), mWindowed.begin());
+            std::copy(input.begin(), input.end(), mWindowed.begin() + mHop);
+            std::swap(history, input);
+            forward(mWindowed.data(), mCoeffs.data());
+
+            int energies[std::size(kBandEdges120)];
+            const auto start = writer.getNumBitsWritten();
+            for (int b = 0; b < numBands; ++b)
+            {
+                const int lo = mBandEdges[(size_t) b], hi = mBandEdges[(size_t) b + 1];
+                float sum = 0.0f;
+                for (int k = lo; k < hi; ++k)
+                    sum += mCoeffs[(size_t) k] * mCoeffs[(size_t) k];
+                const float meanSquare = sum / (float) (hi - lo);
+                energies[b] = meanSquare > 0.0f ? std::clamp((int) std::lround(std::log2(meanSquare)), kMinEnergy, kMaxEnergy) : kMinEnergy;
+
+                if (b == 0)
+                    writer.write((uint32_t) (energies[b] - kMinEnergy), 7);
+                else
+                    writer.writeRice(energies[b] - energies[b - 1], kEnergyRice);
+            }
+
+            int bits[std::size(kBandEdges120)];
+            allocate(energies, mFrameBits - (int) (writer.getNumBitsWritten() - start), bits);
+
+            for (int b = 0; b < numBands; ++b)
+            {
+                if (bits[b] == 0)
+                    continue;
+
+                const int levels = 1 << bits[b];
+                const float step = 2.0f * kLoading[bits[b]] / (float) levels;
+                const float inverseStep = 1.0f / (step * bandGain(energies[b]));
+                for (int k = mBandEdges[(size_t) b]; k < mBandEdges[(size_t) b + 1]; ++k)
+                {
+                    const int index = (int) std::floor(mCoeffs[(size_t) k] * inverseStep) + levels / 2;
+                    writer.write((uint32_t) std::clamp(index, 0, levels - 1), bits[b]);
+                }
+            }
+        }
+    }
+
+    if (numHops == 0)
+        return 0;
+
+    const auto size = writer.finish();
+    if (size > 0)
+        numEncodedFrames = numHops * mHop;
+    return size;
+}
+
+/**
+ * @brief Decodes a payload into numFrames samples per channel. Returns false if it is malformed
+*/
+bool MdctCodec::decode(const uint8_t* src, size_t size, int numChannels, int numFrames, float* const* dest)
+{
+    if (numChannels != mNumChannels || mHop == 0)
+        return false;
+
+    BitReader reader(src, size);
+    const int numHops = (int) reader.read(16);
+    if (reader.hasError() || numHops * mHop != numFrames)
+        return false;
+
+    const int numBands = (int) mBandEdges.size() - 1;
+
+    for (int hop = 0; hop < numHops; ++hop)
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            int energies[std::size(kBandEdges120)];
+            const auto start = reader.getNumBitsRead();
+            for (int b = 0; b < numBands; ++b)
+            {
+                energies[b] = b == 0 ? (int) reader.read(7) + kMinEnergy : energies[b - 1] + reader.readRice(kEnergyRice);
+                if (energies[b] < kMinEnergy || energies[b] > kMaxEnergy)
+                    return false;
+            }
+
+            int bits[std::size(kBandEdges120)];
+            allocate(energies, mFrameBits - (int) (reader.getNumBitsRead() - start), bits);
+
+            for (int b = 0; b < numBands; ++b)
+            {
+                const float gain = bandGain(energies[b]);
+                const int lo = mBandEdges[(size_t) b], hi = mBandEdges[(size_t) b + 1];
+
+                if (bits[b] == 0)
+                {
+                    // Noise fill at the band energy; the silence floor stays silent
+                    const float amplitude = energies[b] == kMinEnergy ? 0.0f : gain * 1.7320508f / 2147483648.0f;
+                    for (int k = lo; k < hi; ++k)
+                    {
+                        mNoiseSeed = mNoiseSeed * 1664525u + 1013904223u;
+                        mSpectrum[(size_t) k] = amplitude * (float) (int32_t) mNoiseSeed;
+                    }
+                    continue;
+                }
+
+                const int levels = 1 << bits[b];
+                const float step = 2.0f * kLoading[bits[b]] / (float) levels * gain;
+                for (int k = lo; k < hi; ++k)
+                    mSpectrum[(size_t) k] = ((float) ((int) reader.read(bits[b]) - levels / 2) + 0.5f) * step;
+            }
+
+            if (reader.hasError())
+                return false;
+
+            inverse(mSpectrum.data(), mWindowed.data());
+
+            auto& overlap = mOverlap[(size_t) ch];
+            float* out = dest[ch] + hop * mHop;
+            for (int n = 0; n < mHop; ++n)
+            {
+                out[n] = overlap[(size_t) n] + mWindowed[(size_t) n];
+                overlap[(size_t) n] = mWindowed[(size_t) (mHop + n)];
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Windowed MDCT of 2 * hop samples: fold into hop samples, then DCT-IV
+*/
+void MdctCodec::forward(const float* input, float* coeffs)
+{
+    const int half = mHop / 2;
+    const float* w = mWindow.data();
+    float* u = mFolded.data();
+
+    for (int n = 0; n < half; ++n)
+    {
+        // (a, b, c, d) quarters -> (-c_r - d, a - b_r)
+        const int c = mHop + half - 1 - n;
+        const int d = mHop + half + n;
+        u[n] = -w[c] * input[c] - w[d] * input[d];
+
+        const int a = n;
+        const int b = mHop - 1 - n;
+        u[half + n] = w[a] * input[a] - w[b] * input[b];
+    }
+
+    dctIV(u, coeffs);
+}
+
+/**
+ * @brief Inverse of forward(): DCT-IV, unfold to 2 * hop samples and window, ready for overlap-add
+*/
+void MdctCodec::inverse(const float* coeffs, float* output)
+{
+    const int half = mHop / 2;
+    const float* w = mWindow.data();
+    float* v = mFolded.data();
+    dctIV(coeffs, v);
+
+    // (v1, v2) -> (v2, -v2_r, -v1_r, -v1)
+    for (int n = 0; n < half; ++n)
+    {
+        output[n] = w[n] * v[half + n];
+        output[half + n] = -w[half + n] * v[mHop - 1 - n];
+        output[mHop + n] = -w[mHop + n] * v[half - 1 - n];
+        output[mHop + half + n] = -w[mHop + half + n] * v[n];
+    }
+}
+
+void MdctCodec::dctIV(const float* input, float* output) const
+{
+    // Row-wise multiply-add over the symmetric matrix; the inner loop is contiguous and vectorises
+    std::fill(output, output + mHop, 0.0f);
+    for (int n = 0; n < mHop; ++n)
+    {
+        const float x = input[n];
+        const float* row = mDct.data() + (size_t) n * (size_t) mHop;
+        for (int k = 0; k < mHop; ++k)
+            output[k] += x * row[k];
+    }
+}
+
+/**
+ * @brief Reverse water-filling: finds the lowest threshold whose allocation fits the budget.
+ * Integer-only so encoder and decoder always agree. Returns the coefficient bits used
+*/
+int MdctCodec::allocate(const int* energies, int budget, int* bits) const
+{
+    const int numBands = (int) mBandEdges.size() - 1;
+    auto total = [&](int threshold) {
+        int sum = 0;
+        for (int b = 0; b < numBands; ++b)
+            sum += bandBits(energies[b], threshold) * (mBandEdges[(size_t) b + 1] - mBandEdges[(size_t) b]);
+        return sum;
+    };
+
+    int lo = kMinEnergy - 2 * MDCT_MAX_BAND_BITS - 2;
+    int hi = kMaxEnergy;
+    if (total(lo) <= budget)
+        hi = lo;
+
+    // total() is non-increasing in the threshold; find the smallest threshold that fits
+    while (lo < hi)
+    {
+        const int mid = lo + (hi - lo) / 2;
+        if (total(mid) <= budget)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    int used = total(hi);
+    for (int b = 0; b < numBands; ++b)
+        bits[b] = bandBits(energies[b], hi);
+
+    // Spend what the threshold search left over, one extra bit per band, low bands first
+    for (int b = 0; b < numBands; ++b)
+    {
+        const int width = mBandEdges[(size_t) b + 1] - mBandEdges[(size_t) b];
+        if (bits[b] < MDCT_MAX_BAND_BITS && energies[b] > kMinEnergy && used + width <= budget)
+        {
+            ++bits[b];
+            used += width;
+        }
+    }
+    return used;
+}
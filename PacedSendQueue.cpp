@@ -0,0 +1,154 @@
+#include "PacedSendQueue.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Allocates every class. Must not be called while a producer or consumer is active
+*/
+void PacedSendQueue::prepare(int numPackets)
+{
+    for (auto& queue : mQueues)
+        queue.prepare(numPackets);
+    mTokens = 0.0;
+    mLastRefillNs = 0;
+    mStale.store(0, std::memory_order_relaxed);
+    mPaced.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Queues a request in its class. Any thread; returns false and releases the packet when that class is full
+*/
+bool PacedSendQueue::push(SendPriority priority, SendRequest request)
+{
+    if (!mQueues[(int) priority].push(std::move(request)))
+        return false;
+
+    mSignal.fetch_add(1);
+    mSignal.notify_one();
+    return true;
+}
+
+/**
+ * @brief Takes the next request that may go out at nowNs. Consumer thread only
+ *
+ * Returns Paced with readyNs set when something is queued but the bucket is in debt; the
+ * consumer should send what it has batched and come back then.
+*/
+PacedSendQueue::PopResult PacedSendQueue::pop(SendRequest& dest, uint64_t nowNs, uint64_t& readyNs)
+{
+    const double rate = mRate.load(std::memory_order_relaxed);
+    if (rate > 0.0)
+    {
+        const double depth = rate * PACING_BURST_MS / 1000.0;
+        if (mLastRefillNs == 0)
+            mTokens = depth;
+        else if (nowNs > mLastRefillNs)
+            mTokens = std::min(depth, mTokens + rate * (double) (nowNs - mLastRefillNs) / 1e9);
+        mLastRefillNs = nowNs;
+    }
+
+    for (int priority = 0; priority < (int) SendPriority::NumClasses; ++priority)
+    {
+        auto& queue = mQueues[priority];
+        const bool paced = priority != (int) SendPriority::Probe;
+        while (queue.getNumReady() > 0)
+        {
+            if (paced && rate > 0.0 && mTokens < 0.0)
+            {
+                readyNs = nowNs + (uint64_t) std::ceil(-mTokens / rate * 1e9);
+                bump(mPaced);
+                return PopResult::Paced;
+            }
+            // A slot claimed but not yet published: it holds up its class, as in PacketSendQueue
+            if (!queue.pop(dest))
+                break;
+
+            if (dest.deadlineNs != 0 && nowNs > dest.deadlineNs)
+            {
+                dest.packet.reset();
+                bump(mStale);
+                continue;
+            }
+
+            // Probes use up what the bucket holds but never put it in debt, so a train cannot stall the audio behind it
+            if (rate > 0.0)
+                mTokens = paced ? mTokens - (double) getCost(dest) : std::max(mTokens - (double) getCost(dest), std::min(mTokens, 0.0));
+            return PopResult::Ready;
+        }
+    }
+    return PopResult::Empty;
+}
+
+/**
+ * @brief Sets the pacing rate in bytes per second. Any thread; 0 sends as fast as requests come
+*/
+void PacedSendQueue::setRate(double bytesPerSecond)
+{
+    mRate.store(std::max(bytesPerSecond, 0.0), std::memory_order_relaxed);
+}
+
+uint32_t PacedSendQueue::getSignal() const
+{
+    return mSignal.load();
+}
+
+/**
+ * @brief Blocks the consumer until a request is queued in any class or wakeConsumer() is called
+ *
+ * As with PacketSendQueue, lastSignal must be read before the consumer last checked its exit condition.
+*/
+void PacedSendQueue::waitForData(uint32_t lastSignal)
+{
+    if (getNumReady() > 0)
+        return;
+    mSignal.wait(lastSignal);
+}
+
+void PacedSendQueue::wakeConsumer()
+{
+    mSignal.fetch_add(1);
+    mSignal.notify_all();
+}
+
+size_t PacedSendQueue::getNumReady() const
+{
+    size_t ready = 0;
+    for (const auto& queue : mQueues)
+        ready += queue.getNumReady();
+    return ready;
+}
+
+uint64_t PacedSendQueue::getNumAccepted() const
+{
+    uint64_t accepted = 0;
+    for (const auto& queue : mQueues)
+        accepted += queue.getNumAccepted();
+    return accepted;
+}
+
+uint64_t PacedSendQueue::getNumDropped() const
+{
+    uint64_t dropped = 0;
+    for (const auto& queue : mQueues)
+        dropped += queue.getNumDropped();
+    return dropped;
+}
+
+/**
+ * @brief Bytes a request puts on the wire, as far as the bucket is concerned
+*/
+size_t PacedSendQueue::getCost(const SendRequest& request)
+{
+    if (request.mtuProbeSize > 0)
+        return (size_t) request.mtuProbeSize;
+    return request.packet ? request.packet.size() : 0;
+}
+
+/**
+ * @brief Single-writer increment
+*/
+void PacedSendQueue::bump(std::atomic<uint64_t>& counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
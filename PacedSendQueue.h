@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "PacketSendQueue.h"
+
+#define PACING_HEADROOM 1.5
+#define PACING_BURST_MS 5.0
+
+// Strict priority: a class is only served while every class before it is empty
+enum class SendPriority
+{
+    Audio,
+    Probe,
+    NumClasses
+};
+
+/**
+ * @brief Priority classes and a token bucket in front of the shared sender
+ *
+ * Each class is a PacketSendQueue, so producers stay lock-free; the consumer always takes from
+ * the highest class that has anything queued, so audio never waits behind probes. Requests
+ * whose deadline has passed by the time they come up are dropped here rather than sent: audio
+ * that can no longer make its playout time only adds to the burst.
+ *
+ * The bucket refills at the rate set with setRate() and holds PACING_BURST_MS of it. A request
+ * may go out while the bucket is not in debt, and takes its size from it, so packets larger than
+ * the bucket are still sent, only spaced out. After a stall the queued backlog leaves at the
+ * paced rate instead of back to back. A rate of 0 turns pacing off. Probes take what tokens the
+ * bucket holds but are never held by it: a probe train has to leave back to back for its
+ * dispersion to say anything about the path.
+ *
+ * push() is safe from any thread; pop() and the pacing state belong to the one consumer.
+*/
+class PacedSendQueue
+{
+public:
+    enum class PopResult
+    {
+        Ready,
+        Empty,
+        // The next request must wait for the bucket; pop() says until when
+        Paced
+    };
+
+    PacedSendQueue() = default;
+
+    void prepare(int numPackets = SEND_QUEUE_PACKETS);
+
+    bool push(SendPriority priority, SendRequest request);
+    PopResult pop(SendRequest& dest, uint64_t nowNs, uint64_t& readyNs);
+
+    void setRate(double bytesPerSecond);
+    double getRate() const { return mRate.load(std::memory_order_relaxed); }
+
+    uint32_t getSignal() const;
+    void waitForData(uint32_t lastSignal);
+    void wakeConsumer();
+
+    size_t getNumReady() const;
+    uint64_t getNumAccepted() const;
+    uint64_t getNumDropped() const;
+    /** Requests dropped because their deadline passed while queued */
+    uint64_t getNumStale() const { return mStale.load(std::memory_order_relaxed); }
+    /** Times the consumer had to wait for the bucket */
+    uint64_t getNumPaced() const { return mPaced.load(std::memory_order_relaxed); }
+
+private:
+    static size_t getCost(const SendRequest& request);
+    static void bump(std::atomic<uint64_t>& counter);
+
+    PacketSendQueue mQueues[(int) SendPriority::NumClasses];
+    alignas(64) std::atomic<uint32_t> mSignal { 0 };
+    std::atomic<double> mRate { 0.0 };
+
+    // Consumer
+    double mTokens = 0.0;
+    uint64_t mLastRefillNs = 0;
+
+    std::atomic<uint64_t> mStale { 0 };
+    std::atomic<uint64_t> mPaced { 0 };
+};
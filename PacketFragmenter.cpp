@@ -0,0 +1,238 @@
+#include "PacketFragmenter.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    void writeU16(uint8_t* p, uint16_t v)
+    {
+        p[0] = (uint8_t) v;
+        p[1] = (uint8_t) (v >> 8);
+    }
+
+    void writeU32(uint8_t* p, uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            p[i] = (uint8_t) (v >> (8 * i));
+    }
+
+    uint16_t readU16(const uint8_t* p)
+    {
+        return (uint16_t) (p[0] | (p[1] << 8));
+    }
+
+    uint32_t readU32(const uint8_t* p)
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= (uint32_t) p[i] << (8 * i);
+        return v;
+    }
+
+    constexpr uint64_t kNoMessage = ~uint64_t(0);
+}
+
+/**
+ * @brief Writes the header into dest. Returns the number of bytes written, or 0 if it does not fit
+*/
+size_t FragmentHeader::encode(uint8_t* dest, size_t capacity) const
+{
+    if (capacity < kSize)
+        return 0;
+
+    writeU16(dest + 0, FRAGMENT_HEADER_MAGIC);
+    dest[2] = version;
+    dest[3] = flags;
+    writeU32(dest + 4, messageId);
+    writeU16(dest + 8, index);
+    writeU16(dest + 10, count);
+    writeU32(dest + 12, totalSize);
+    writeU32(dest + 16, offset);
+    return kSize;
+}
+
+/**
+ * @brief Parses a header. Range checks against the reassembly limits are left to the caller
+*/
+bool FragmentHeader::decode(const uint8_t* src, size_t size, FragmentHeader& header)
+{
+    if (!isFragment(src, size) || src[2] != FRAGMENT_HEADER_VERSION)
+        return false;
+
+    header.version = src[2];
+    header.flags = src[3];
+    header.messageId = readU32(src + 4);
+    header.index = readU16(src + 8);
+    header.count = readU16(src + 10);
+    header.totalSize = readU32(src + 12);
+    header.offset = readU32(src + 16);
+    return true;
+}
+
+bool FragmentHeader::isFragment(const uint8_t* src, size_t size)
+{
+    return size >= kSize && readU16(src) == FRAGMENT_HEADER_MAGIC;
+}
+
+int PacketFragmenter::getNumFragments(size_t packetSize, size_t maxDatagramSize)
+{
+    if (packetSize <= maxDatagramSize)
+        return 1;
+    if (maxDatagramSize < FragmentHeader::kSize + FRAGMENT_MIN_PAYLOAD || packetSize > 0xffffffffu)
+        return 0;
+
+    const size_t chunk = maxDatagramSize - FragmentHeader::kSize;
+    const size_t count = (packetSize + chunk - 1) / chunk;
+    return count > 0xffff ? 0 : (int) count;
+}
+
+size_t PacketFragmenter::writeFragment(const uint8_t* packet, size_t packetSize, uint32_t messageId, int index,
+                                       size_t maxDatagramSize, uint8_t* dest, size_t capacity)
+{
+    const int count = getNumFragments(packetSize, maxDatagramSize);
+    if (count < 2 || index < 0 || index >= count)
+        return 0;
+
+    const size_t chunk = maxDatagramSize - FragmentHeader::kSize;
+    const size_t offset = (size_t) index * chunk;
+    const size_t length = std::min(chunk, packetSize - offset);
+    if (capacity < FragmentHeader::kSize + length)
+        return 0;
+
+    FragmentHeader header;
+    header.messageId = messageId;
+    header.index = (uint16_t) index;
+    header.count = (uint16_t) count;
+    header.totalSize = (uint32_t) packetSize;
+    header.offset = (uint32_t) offset;
+    header.encode(dest, capacity);
+    std::memcpy(dest + FragmentHeader::kSize, packet + offset, length);
+    return FragmentHeader::kSize + length;
+}
+
+/**
+ * @brief Allocates numSlots packets of maxMessageSize bytes and clears all state and counters
+*/
+void PacketReassembler::prepare(int numSlots, size_t maxMessageSize)
+{
+    mMaxMessageSize = maxMessageSize;
+    mMaxFragments = (int) std::min<size_t>(0xffff, (maxMessageSize + FRAGMENT_MIN_PAYLOAD - 1) / FRAGMENT_MIN_PAYLOAD);
+
+    mSlots.assign((size_t) std::max(1, numSlots), Slot());
+    for (auto& slot : mSlots)
+    {
+        slot.data.resize(maxMessageSize);
+        slot.received.resize(((size_t) mMaxFragments + 63) / 64);
+    }
+    // Long enough to absorb duplicates that arrive while later packets are reassembled
+    mCompleted.assign(mSlots.size() * 4, kNoMessage);
+
+    reset();
+}
+
+void PacketReassembler::reset()
+{
+    for (auto& slot : mSlots)
+        slot.active = false;
+    std::fill(mCompleted.begin(), mCompleted.end(), kNoMessage);
+    mCompletedPos = 0;
+    mClock = 0;
+    mNumCompleted = 0;
+    mNumEvicted = 0;
+    mNumRejected = 0;
+    mNumDuplicates = 0;
+}
+
+int PacketReassembler::getNumPending() const
+{
+    return (int) std::count_if(mSlots.begin(), mSlots.end(), [](const Slot& slot) { return slot.active; });
+}
+
+bool PacketReassembler::addFragment(const uint8_t* data, size_t size, const uint8_t*& message, size_t& messageSize)
+{
+    FragmentHeader header;
+    if (mSlots.empty() || !FragmentHeader::decode(data, size, header))
+    {
+        ++mNumRejected;
+        return false;
+    }
+
+    const size_t length = size - FragmentHeader::kSize;
+    if (length == 0 || header.count == 0 || header.count > mMaxFragments || header.index >= header.count
+        || header.totalSize > mMaxMessageSize || (size_t) header.offset + length > header.totalSize)
+    {
+        ++mNumRejected;
+        return false;
+    }
+
+    if (wasRecentlyCompleted(header.messageId))
+    {
+        // A late copy of a fragment of a packet that was already delivered
+        ++mNumDuplicates;
+        return false;
+    }
+
+    auto* slot = findSlot(header);
+    if (slot == nullptr)
+    {
+        ++mNumRejected;
+        return false;
+    }
+
+    auto& word = slot->received[header.index / 64];
+    const uint64_t bit = uint64_t(1) << (header.index % 64);
+    if ((word & bit) != 0)
+    {
+        ++mNumDuplicates;
+        return false;
+    }
+
+    word |= bit;
+    std::memcpy(slot->data.data() + header.offset, data + FragmentHeader::kSize, length);
+    slot->lastTouched = ++mClock;
+    if (++slot->numReceived < slot->count)
+        return false;
+
+    slot->active = false;
+    mCompleted[mCompletedPos] = slot->messageId;
+    mCompletedPos = (mCompletedPos + 1) % mCompleted.size();
+    ++mNumCompleted;
+
+    message = slot->data.data();
+    messageSize = slot->totalSize;
+    return true;
+}
+
+/**
+ * @brief Returns the slot collecting this packet, starting one if needed. nullptr if the fragment
+ * contradicts the packet already being collected under its id
+*/
+PacketReassembler::Slot* PacketReassembler::findSlot(const FragmentHeader& header)
+{
+    Slot* target = nullptr;
+    for (auto& slot : mSlots)
+    {
+        if (slot.active && slot.messageId == header.messageId)
+            return (slot.count == header.count && slot.totalSize == header.totalSize) ? &slot : nullptr;
+
+        if (target == nullptr || (target->active && (!slot.active || slot.lastTouched < target->lastTouched)))
+            target = &slot;
+    }
+
+    if (target->active)
+        ++mNumEvicted;
+
+    target->active = true;
+    target->messageId = header.messageId;
+    target->count = header.count;
+    target->numReceived = 0;
+    target->totalSize = header.totalSize;
+    std::fill(target->received.begin(), target->received.end(), 0);
+    return target;
+}
+
+bool PacketReassembler::wasRecentlyCompleted(uint32_t messageId) const
+{
+    return std::find(mCompleted.begin(), mCompleted.end(), (uint64_t) messageId) != mCompleted.end();
+}
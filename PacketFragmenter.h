@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define FRAGMENT_HEADER_MAGIC 0x4C46
+#define FRAGMENT_HEADER_VERSION 1
+#define FRAGMENT_MIN_PAYLOAD 256
+
+/**
+ * @brief Header prepended to each piece of a packet that does not fit one datagram
+ *
+ * Wire layout, little-endian, 20 bytes:
+ *   0  magic (u16)          2  version (u8)          3  flags (u8)
+ *   4  messageId (u32)      8  index (u16)          10  count (u16)
+ *  12  totalSize (u32)     16  offset (u32)
+ *
+ * The magic differs from PACKET_HEADER_MAGIC, so a receiver can tell a fragment from a packet
+ * that was sent whole by its first two bytes. messageId is the same for all fragments of one
+ * packet; offset is where this fragment's bytes go in the reassembled packet of totalSize.
+*/
+struct FragmentHeader
+{
+    static constexpr size_t kSize = 20;
+
+    uint8_t version = FRAGMENT_HEADER_VERSION;
+    uint8_t flags = 0;
+    uint32_t messageId = 0;
+    uint16_t index = 0;
+    uint16_t count = 0;
+    uint32_t totalSize = 0;
+    uint32_t offset = 0;
+
+    size_t encode(uint8_t* dest, size_t capacity) const;
+    static bool decode(const uint8_t* src, size_t size, FragmentHeader& header);
+    static bool isFragment(const uint8_t* src, size_t size);
+};
+
+/**
+ * @brief Splits packets larger than one datagram into fragments of at most maxDatagramSize bytes
+ *
+ * Stateless: the caller picks the message id and writes the fragments wherever it wants them.
+ * All fragments but the last carry the same number of payload bytes, at least FRAGMENT_MIN_PAYLOAD,
+ * which bounds the fragment count the receiver has to track per packet.
+*/
+namespace PacketFragmenter
+{
+    /** Number of datagrams needed for a packet, 1 if it is sent whole, 0 if it cannot be split */
+    int getNumFragments(size_t packetSize, size_t maxDatagramSize);
+
+    /** Writes fragment index of the packet into dest and returns its size, or 0 on bad arguments */
+    size_t writeFragment(const uint8_t* packet, size_t packetSize, uint32_t messageId, int index,
+                         size_t maxDatagramSize, uint8_t* dest, size_t capacity);
+}
+
+/**
+ * @brief Bounded reassembly buffer for fragmented packets
+ *
+ * Holds a fixed number of partially received packets, each up to maxMessageSize bytes, so memory
+ * stays constant whatever arrives. Fragments may arrive in any order. When all slots are busy
+ * the least recently touched one is dropped: under loss an incomplete packet is evicted by the
+ * packets that follow it rather than waiting for fragments that will never come.
+ *
+ * Everything is allocated in prepare(); addFragment() does not allocate and is meant to run on
+ * the network receive thread.
+*/
+class PacketReassembler
+{
+public:
+    PacketReassembler() = default;
+
+    void prepare(int numSlots, size_t maxMessageSize);
+    void reset();
+
+    /**
+     * @brief Adds one fragment. Returns true when it completed a packet; message and messageSize
+     * then refer to an internal buffer that stays valid until the next call
+    */
+    bool addFragment(const uint8_t* data, size_t size, const uint8_t*& message, size_t& messageSize);
+
+    int getNumPending() const;
+    uint64_t getNumCompleted() const { return mNumCompleted; }
+    uint64_t getNumEvicted() const { return mNumEvicted; }
+    uint64_t getNumRejected() const { return mNumRejected; }
+    uint64_t getNumDuplicates() const { return mNumDuplicates; }
+
+private:
+    struct Slot
+    {
+        bool active = false;
+        uint32_t messageId = 0;
+        uint16_t count = 0;
+        uint16_t numReceived = 0;
+        uint32_t totalSize = 0;
+        uint64_t lastTouched = 0;
+        std::vector<uint8_t> data;
+        std::vector<uint64_t> received;
+    };
+
+    Slot* findSlot(const FragmentHeader& header);
+    bool wasRecentlyCompleted(uint32_t messageId) const;
+
+    std::vector<Slot> mSlots;
+    std::vector<uint64_t> mCompleted;
+    size_t mCompletedPos = 0;
+    size_t mMaxMessageSize = 0;
+    int mMaxFragments = 0;
+    uint64_t mClock = 0;
+
+    uint64_t mNumCompleted = 0;
+    uint64_t mNumEvicted = 0;
+    uint64_t mNumRejected = 0;
+    uint64_t mNumDuplicates = 0;
+};
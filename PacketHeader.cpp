@@ -0,0 +1,97 @@
+#include "PacketHeader.h"
+
+#include <chrono>
+
+namespace
+{
+    void writeU16(uint8_t* p, uint16_t v)
+    {
+        p[0] = (uint8_t) v;
+        p[1] = (uint8_t) (v >> 8);
+    }
+
+    void writeU32(uint8_t* p, uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            p[i] = (uint8_t) (v >> (8 * i));
+    }
+
+    void writeU64(uint8_t* p, uint64_t v)
+    {
+        for (int i = 0; i < 8; ++i)
+            p[i] = (uint8_t) (v >> (8 * i));
+    }
+
+    uint16_t readU16(const uint8_t* p)
+    {
+        return (uint16_t) (p[0] | (p[1] << 8));
+    }
+
+    uint32_t readU32(const uint8_t* p)
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= (uint32_t) p[i] << (8 * i);
+        return v;
+    }
+
+    uint64_t readU64(const uint8_t* p)
+    {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i)
+            v |= (uint64_t) p[i] << (8 * i);
+        return v;
+    }
+}
+
+/**
+ * @brief Writes the header into dest. Returns the number of bytes written, or 0 if it does not fit
+*/
+size_t PacketHeader::encode(uint8_t* dest, size_t capacity) const
+{
+    if (capacity < kSize)
+        return 0;
+
+    writeU16(dest + 0, PACKET_HEADER_MAGIC);
+    dest[2] = version;
+    dest[3] = flags;
+    writeU16(dest + 4, numChannels);
+    dest[6] = (uint8_t) sampleFormat;
+    dest[7] = (uint8_t) codec;
+    writeU64(dest + 8, sequence);
+    writeU64(dest + 16, samplePosition);
+    writeU64(dest + 24, sendTimeNs);
+    writeU32(dest + 32, numFrames);
+    writeU32(dest + 36, payloadSize);
+    return kSize;
+}
+
+/**
+ * @brief Parses and validates a header. Fails on a bad magic, an unknown version or a truncated payload
+*/
+bool PacketHeader::decode(const uint8_t* src, size_t size, PacketHeader& header)
+{
+    if (size < kSize || readU16(src) != PACKET_HEADER_MAGIC || src[2] != PACKET_HEADER_VERSION)
+        return false;
+
+    header.version = src[2];
+    header.flags = src[3];
+    header.numChannels = readU16(src + 4);
+    header.sampleFormat = (SampleFormat) src[6];
+    header.codec = (CodecId) src[7];
+    header.sequence = readU64(src + 8);
+    header.samplePosition = readU64(src + 16);
+    header.sendTimeNs = readU64(src + 24);
+    header.numFrames = readU32(src + 32);
+    header.payloadSize = readU32(src + 36);
+
+    return header.payloadSize <= size - kSize;
+}
+
+/**
+ * @brief Monotonic clock used for packet send timestamps
+*/
+uint64_t getMonotonicTimeNs()
+{
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
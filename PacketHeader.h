@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define PACKET_HEADER_MAGIC 0x4C43
+#define PACKET_HEADER_VERSION 1
+#define PACKET_FLAG_SYNCED_TIME 0x01
+
+enum class SampleFormat : uint8_t
+{
+    Float32 = 0,
+    Int16 = 1,
+    Int24 = 2
+};
+
+enum class CodecId : uint8_t
+{
+    Pcm = 0,
+    Lossless = 1,
+    Mdct = 2
+};
+
+/**
+ * @brief Static description of an audio stream, sent once in the createSender metadata
+*/
+struct StreamFormat
+{
+    double sampleRate = 48000.0;
+    int numChannels = 0;
+    SampleFormat sampleFormat = SampleFormat::Float32;
+    CodecId codec = CodecId::Pcm;
+    int bitrate = 0;
+    int codecDelay = 0;
+};
+
+/**
+ * @brief Fixed-size binary header prepended to every audio packet
+ *
+ * Wire layout, little-endian, 40 bytes:
+ *   0  magic (u16)          2  version (u8)          3  flags (u8)
+ *   4  numChannels (u16)    6  sampleFormat (u8)     7  codec (u8)
+ *   8  sequence (u64)      16  samplePosition (u64) 24  sendTimeNs (u64, monotonic)
+ *  32  numFrames (u32)     36  payloadSize (u32)
+ *
+ * With PACKET_FLAG_SYNCED_TIME set, sendTimeNs is on the time base the sender shares with its
+ * peers through ClockSync rather than on its own monotonic clock.
+ *
+ * PCM payloads follow the header as interleaved little-endian samples in sampleFormat.
+ * Lossless payloads are one LosslessCodec packet; sampleFormat then gives the quantized
+ * resolution (Int16 or Int24). Mdct payloads hold whole codec frames; numFrames is the decoded
+ * length and samplePosition refers to the encoder input, so decoded audio lags it by the
+ * codec_delay announced in the stream metadata.
+*/
+struct PacketHeader
+{
+    static constexpr size_t kSize = 40;
+
+    uint8_t version = PACKET_HEADER_VERSION;
+    uint8_t flags = 0;
+    uint16_t numChannels = 0;
+    SampleFormat sampleFormat = SampleFormat::Float32;
+    CodecId codec = CodecId::Pcm;
+    uint64_t sequence = 0;
+    uint64_t samplePosition = 0;
+    uint64_t sendTimeNs = 0;
+    uint32_t numFrames = 0;
+    uint32_t payloadSize = 0;
+
+    size_t encode(uint8_t* dest, size_t capacity) const;
+    static bool decode(const uint8_t* src, size_t size, PacketHeader& header);
+};
+
+uint64_t getMonotonicTimeNs();
@@ -0,0 +1,158 @@
+#include "PacketPool.h"
+
+#include <cassert>
+
+PacketHandle::PacketHandle(Packet* packet) : mPacket(packet)
+{
+    if (mPacket != nullptr)
+        mPacket->refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+PacketHandle::PacketHandle(const PacketHandle& other) : PacketHandle(other.mPacket) {}
+
+PacketHandle::PacketHandle(PacketHandle&& other) noexcept : mPacket(other.mPacket)
+{
+    other.mPacket = nullptr;
+}
+
+PacketHandle& PacketHandle::operator=(const PacketHandle& other)
+{
+    if (this != &other)
+    {
+        reset();
+        mPacket = other.mPacket;
+        if (mPacket != nullptr)
+            mPacket->refCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    return *this;
+}
+
+PacketHandle& PacketHandle::operator=(PacketHandle&& other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+        mPacket = other.mPacket;
+        other.mPacket = nullptr;
+    }
+    return *this;
+}
+
+PacketHandle::~PacketHandle()
+{
+    reset();
+}
+
+void PacketHandle::setSize(size_t newSize)
+{
+    assert(newSize <= mPacket->capacity);
+    mPacket->size = newSize;
+}
+
+void PacketHandle::reset()
+{
+    if (mPacket != nullptr && mPacket->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        mPacket->pool->release(mPacket);
+    mPacket = nullptr;
+}
+
+PacketPool::~PacketPool()
+{
+    assert(getNumInUse() == 0);
+}
+
+/**
+ * @brief Allocates every packet up front. Must not be called while handles are outstanding
+*/
+void PacketPool::prepare(int numPackets, size_t packetCapacity)
+{
+    assert(getNumInUse() == 0);
+
+    mPackets.clear();
+    mPacketCapacity = packetCapacity;
+    mNext = std::make_unique<std::atomic<uint32_t>[]>((size_t) numPackets);
+
+    for (int i = 0; i < numPackets; ++i)
+    {
+        auto packet = std::make_unique<Packet>();
+        packet->storage = std::make_unique<uint8_t[]>(packetCapacity);
+        packet->capacity = packetCapacity;
+        packet->pool = this;
+        packet->index = (uint32_t) i;
+        mPackets.push_back(std::move(packet));
+
+        mNext[(size_t) i].store(i + 1 < numPackets ? (uint32_t) (i + 1) : kEmpty, std::memory_order_relaxed);
+    }
+
+    mFreeHead.store(numPackets > 0 ? 0 : kEmpty, std::memory_order_release);
+    mInUse.store(0, std::memory_order_relaxed);
+    mHighWaterMark.store(0, std::memory_order_relaxed);
+    mExhausted.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Takes a packet off the free list, or returns an empty handle if none are left
+*/
+PacketHandle PacketPool::acquire()
+{
+    auto head = mFreeHead.load(std::memory_order_acquire);
+
+    for (;;)
+    {
+        const auto index = (uint32_t) (head & 0xffffffffu);
+        if (index == kEmpty)
+        {
+            mExhausted.fetch_add(1, std::memory_order_relaxed);
+            return {};
+        }
+
+        const auto next = mNext[index].load(std::memory_order_relaxed);
+        const auto tag = (head >> 32) + 1;
+        if (mFreeHead.compare_exchange_weak(head, (tag << 32) | next, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            const auto inUse = mInUse.fetch_add(1, std::memory_order_relaxed) + 1;
+            auto highWater = mHighWaterMark.load(std::memory_order_relaxed);
+            while (inUse > highWater && !mHighWaterMark.compare_exchange_weak(highWater, inUse, std::memory_order_relaxed))
+            {
+            }
+
+            auto* packet = mPackets[index].get();
+            packet->size = 0;
+            // Empty for a pool that is not shared; copying it only touches the control block's count
+            packet->keepAlive = weak_from_this().lock();
+            return PacketHandle(packet);
+        }
+    }
+}
+
+void PacketPool::release(Packet* packet)
+{
+    // Taken before the packet goes back: if it holds the last reference, the pool is freed as this returns
+    const auto keepAlive = std::move(packet->keepAlive);
+    auto head = mFreeHead.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        mNext[packet->index].store((uint32_t) (head & 0xffffffffu), std::memory_order_relaxed);
+        const auto tag = (head >> 32) + 1;
+        if (mFreeHead.compare_exchange_weak(head, (tag << 32) | packet->index, std::memory_order_acq_rel, std::memory_order_relaxed))
+            break;
+    }
+
+    mInUse.fetch_sub(1, std::memory_order_relaxed);
+}
+
+size_t PacketPool::getNumInUse() const
+{
+    return mInUse.load(std::memory_order_relaxed);
+}
+
+size_t PacketPool::getHighWaterMark() const
+{
+    return mHighWaterMark.load(std::memory_order_relaxed);
+}
+
+uint64_t PacketPool::getNumExhausted() const
+{
+    return mExhausted.load(std::memory_order_relaxed);
+}
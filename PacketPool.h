@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class PacketPool;
+
+/**
+ * @brief Preallocated packet storage owned by a PacketPool
+*/
+struct Packet
+{
+    std::unique_ptr<uint8_t[]> storage;
+    size_t capacity = 0;
+    size_t size = 0;
+    std::atomic<int> refCount { 0 };
+    PacketPool* pool = nullptr;
+    // Set while the packet is out of a pool owned by a std::shared_ptr, so the pool outlives it
+    std::shared_ptr<PacketPool> keepAlive;
+    uint32_t index = 0;
+};
+
+/**
+ * @brief Refcounted reference to a pooled packet. The packet returns to its pool when the
+ * last handle goes away, from whichever thread that happens on
+*/
+class PacketHandle
+{
+public:
+    PacketHandle() = default;
+    explicit PacketHandle(Packet* packet);
+    PacketHandle(const PacketHandle& other);
+    PacketHandle(PacketHandle&& other) noexcept;
+    PacketHandle& operator=(const PacketHandle& other);
+    PacketHandle& operator=(PacketHandle&& other) noexcept;
+    ~PacketHandle();
+
+    uint8_t* data() { return mPacket->storage.get(); }
+    const uint8_t* data() const { return mPacket->storage.get(); }
+    size_t size() const { return mPacket->size; }
+    size_t capacity() const { return mPacket->capacity; }
+    void setSize(size_t newSize);
+
+    void reset();
+    explicit operator bool() const { return mPacket != nullptr; }
+
+private:
+    Packet* mPacket = nullptr;
+};
+
+/**
+ * @brief Fixed set of packets handed out without touching the heap
+ *
+ * The free list is a tagged Treiber stack, so packets can be acquired on the sender thread
+ * and released on a transport thread without locks.
+ *
+ * A pool owned by a std::shared_ptr is kept alive by every packet it has handed out, so its
+ * owner may drop it while a transport still holds some: the last packet to come back frees it.
+*/
+class PacketPool : public std::enable_shared_from_this<PacketPool>
+{
+public:
+    PacketPool() = default;
+    ~PacketPool();
+
+    void prepare(int numPackets, size_t packetCapacity);
+
+    PacketHandle acquire();
+
+    size_t getNumPackets() const { return mPackets.size(); }
+    size_t getPacketCapacity() const { return mPacketCapacity; }
+    size_t getNumInUse() const;
+    size_t getHighWaterMark() const;
+    uint64_t getNumExhausted() const;
+
+private:
+    friend class PacketHandle;
+    void release(Packet* packet);
+
+    static constexpr uint32_t kEmpty = 0xffffffffu;
+
+    std::vector<std::unique_ptr<Packet>> mPackets;
+    std::unique_ptr<std::atomic<uint32_t>[]> mNext;
+    size_t mPacketCapacity = 0;
+
+    // low 32 bits: index of the top free packet, high 32 bits: ABA tag
+    std::atomic<uint64_t> mFreeHead { kEmpty };
+    std::atomic<size_t> mInUse { 0 };
+    std::atomic<size_t> mHighWaterMark { 0 };
+    std::atomic<uint64_t> mExhausted { 0 };
+};
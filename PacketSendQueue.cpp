@@ -0,0 +1,127 @@
+#include "PacketSendQueue.h"
+
+#include <algorithm>
+
+/**
+ * @brief Allocates the slots. Must not be called while a producer or consumer is active
+*/
+void PacketSendQueue::prepare(int numPackets)
+{
+    size_t capacity = 1;
+    while (capacity < (size_t) std::max(numPackets, 2))
+        capacity <<= 1;
+
+    mSlots = std::make_unique<Slot[]>(capacity);
+    for (size_t i = 0; i < capacity; ++i)
+        mSlots[i].sequence.store(i, std::memory_order_relaxed);
+
+    mMask = capacity - 1;
+    mWriteIndex.store(0, std::memory_order_relaxed);
+    mReadIndex.store(0, std::memory_order_relaxed);
+    mDropped.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Queues a packet for channel. Any thread; returns false and releases the packet when full
+*/
+bool PacketSendQueue::push(uint64_t channel, PacketHandle packet, size_t maxDatagramSize)
+{
+    SendRequest request;
+    request.channel = channel;
+    request.packet = std::move(packet);
+    request.maxDatagramSize = maxDatagramSize;
+    return push(std::move(request));
+}
+
+/**
+ * @brief Queues a request. Any thread; returns false and releases its packet when full
+*/
+bool PacketSendQueue::push(SendRequest request)
+{
+    if (!mSlots)
+        return false;
+
+    auto w = mWriteIndex.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    for (;;)
+    {
+        slot = &mSlots[w & mMask];
+        const auto sequence = slot->sequence.load(std::memory_order_acquire);
+        const auto lag = (int64_t) (sequence - w);
+        if (lag == 0)
+        {
+            // On failure w is reloaded with the index another producer just left behind
+            if (mWriteIndex.compare_exchange_weak(w, w + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (lag < 0)
+        {
+            // The slot still holds the packet from one lap ago: the consumer is a full queue behind
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            w = mWriteIndex.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->request = std::move(request);
+    slot->sequence.store(w + 1, std::memory_order_release);
+
+    mSignal.fetch_add(1);
+    mSignal.notify_one();
+    return true;
+}
+
+/**
+ * @brief Moves the oldest published packet into dest. Consumer thread only
+*/
+bool PacketSendQueue::pop(SendRequest& dest)
+{
+    if (!mSlots)
+        return false;
+
+    const auto r = mReadIndex.load(std::memory_order_relaxed);
+    auto& slot = mSlots[r & mMask];
+    // A claimed slot that is still being filled holds back everything behind it, keeping order
+    if (slot.sequence.load(std::memory_order_acquire) != r + 1)
+        return false;
+
+    dest = std::move(slot.request);
+
+    slot.sequence.store(r + mMask + 1, std::memory_order_release);
+    mReadIndex.store(r + 1, std::memory_order_relaxed);
+    return true;
+}
+
+uint32_t PacketSendQueue::getSignal() const
+{
+    return mSignal.load();
+}
+
+/**
+ * @brief Blocks the consumer until a packet is queued or wakeConsumer() is called
+ *
+ * lastSignal must be read with getSignal() before the consumer last checked its exit
+ * condition, otherwise a wake-up issued in between would be lost.
+*/
+void PacketSendQueue::waitForData(uint32_t lastSignal)
+{
+    if (getNumReady() > 0)
+        return;
+    mSignal.wait(lastSignal);
+}
+
+void PacketSendQueue::wakeConsumer()
+{
+    mSignal.fetch_add(1);
+    mSignal.notify_all();
+}
+
+size_t PacketSendQueue::getNumReady() const
+{
+    const auto r = mReadIndex.load(std::memory_order_acquire);
+    const auto w = mWriteIndex.load(std::memory_order_acquire);
+    return (size_t) (w - r);
+}
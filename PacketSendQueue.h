@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "PacketPool.h"
+
+#define SEND_QUEUE_PACKETS 1024
+
+/**
+ * @brief One packet waiting for the shared sender, with the data channel it goes out on
+*/
+struct SendRequest
+{
+    uint64_t channel = 0;
+    PacketHandle packet;
+    size_t maxDatagramSize = 0;
+    // Monotonic time after which the packet is no longer worth sending, 0 for never
+    uint64_t deadlineNs = 0;
+    // Set for a path-MTU probe, which carries no packet and goes out with its size in the metadata
+    int mtuProbeSize = 0;
+};
+
+/**
+ * @brief Lock-free multi-producer/single-consumer queue of packets to send
+ *
+ * Every plugin instance's sender thread pushes here and the one network thread of the shared
+ * connection pops. It is a bounded ring in which each slot carries a sequence number, as in
+ * Vyukov's bounded queue: a producer claims a slot by advancing the write index with a CAS and
+ * publishes it by storing the slot's sequence, so producers never wait for each other or for
+ * the consumer. A full queue rejects the incoming packet: with many writers the oldest packet
+ * cannot be reclaimed safely, and a full queue means the network is already behind.
+ *
+ * Handles are moved in and out, so queued packets stay in their instance's PacketPool and go
+ * back to it when the sender is done with them.
+*/
+class PacketSendQueue
+{
+public:
+    PacketSendQueue() = default;
+
+    void prepare(int numPackets = SEND_QUEUE_PACKETS);
+
+    bool push(uint64_t channel, PacketHandle packet, size_t maxDatagramSize);
+    bool push(SendRequest request);
+    bool pop(SendRequest& dest);
+
+    uint32_t getSignal() const;
+    void waitForData(uint32_t lastSignal);
+    void wakeConsumer();
+
+    size_t getNumReady() const;
+    /** Packets ever accepted, counting those still being written */
+    uint64_t getNumAccepted() const { return mWriteIndex.load(std::memory_order_acquire); }
+    uint64_t getNumDropped() const { return mDropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence { 0 };
+        SendRequest request;
+    };
+
+    std::unique_ptr<Slot[]> mSlots;
+    size_t mMask = 0;
+
+    alignas(64) std::atomic<uint64_t> mWriteIndex { 0 };
+    alignas(64) std::atomic<uint64_t> mReadIndex { 0 };
+    alignas(64) std::atomic<uint32_t> mSignal { 0 };
+    std::atomic<uint64_t> mDropped { 0 };
+};
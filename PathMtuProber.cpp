@@ -0,0 +1,128 @@
+#include "PathMtuProber.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    void writeU32(uint8_t* p, uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            p[i] = (uint8_t) (v >> (8 * i));
+    }
+
+    uint32_t readU32(const uint8_t* p)
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= (uint32_t) p[i] << (8 * i);
+        return v;
+    }
+}
+
+/**
+ * @brief Starts a new search between PATH_MTU_MIN and PATH_MTU_MAX. The current MTU stays in use until a probe answers
+*/
+void PathMtuProber::start(int64_t nowMs)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    mProbing = true;
+    mAwaitingEcho = false;
+    mLow = PATH_MTU_MIN;
+    mHigh = PATH_MTU_MAX;
+    mCandidate = PATH_MTU_DEFAULT;
+    mAttempts = 0;
+    mSentAtMs = nowMs;
+}
+
+void PathMtuProber::stop()
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    mProbing = false;
+    mAwaitingEcho = false;
+}
+
+bool PathMtuProber::isProbing() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mProbing;
+}
+
+int PathMtuProber::poll(int64_t nowMs)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mProbing)
+        return 0;
+
+    if (mAwaitingEcho)
+    {
+        if (nowMs - mSentAtMs < PATH_MTU_PROBE_TIMEOUT_MS)
+            return 0;
+
+        mAwaitingEcho = false;
+        if (++mAttempts >= PATH_MTU_PROBE_ATTEMPTS)
+        {
+            mHigh = mCandidate - 1;
+            // The size in use has just been shown not to fit: fall back to the largest one that did
+            if (mPathMtu.load(std::memory_order_relaxed) > mHigh)
+                mPathMtu.store(mLow, std::memory_order_relaxed);
+            nextCandidate();
+            if (!mProbing)
+                return 0;
+        }
+    }
+
+    mAwaitingEcho = true;
+    mSentAtMs = nowMs;
+    return mCandidate;
+}
+
+/**
+ * @brief Called when a probe of probeSize bytes came back. Echoes of earlier probes are ignored
+*/
+void PathMtuProber::onProbeEcho(int probeSize)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mProbing || probeSize != mCandidate)
+        return;
+
+    mAwaitingEcho = false;
+    mLow = mCandidate;
+    mPathMtu.store(mLow, std::memory_order_relaxed);
+    nextCandidate();
+}
+
+void PathMtuProber::writeProbe(uint8_t* data, size_t size, int probeSize)
+{
+    std::memset(data, 0, size);
+    writeU32(data, PATH_MTU_PROBE_MAGIC);
+    writeU32(data + 4, (uint32_t) probeSize);
+}
+
+int PathMtuProber::readProbe(const uint8_t* data, size_t size)
+{
+    if (size < PATH_MTU_PROBE_HEADER_SIZE || readU32(data) != PATH_MTU_PROBE_MAGIC)
+        return 0;
+
+    // A payload cut short on the way is not an echo of the size it claims
+    const auto probeSize = (int) readU32(data + 4);
+    if (probeSize < PATH_MTU_MIN || probeSize > PATH_MTU_MAX || size != getProbePayloadSize(probeSize))
+        return 0;
+    return probeSize;
+}
+
+void PathMtuProber::setPathMtu(int pathMtu)
+{
+    mPathMtu.store(std::clamp(pathMtu, PATH_MTU_MIN, PATH_MTU_MAX), std::memory_order_relaxed);
+}
+
+void PathMtuProber::nextCandidate()
+{
+    mAttempts = 0;
+    if (mHigh - mLow < PATH_MTU_RESOLUTION)
+    {
+        mProbing = false;
+        return;
+    }
+    mCandidate = mLow + (mHigh - mLow + 1) / 2;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#define PATH_MTU_DEFAULT 1500
+#define PATH_MTU_MIN 1280
+#define PATH_MTU_MAX 9000
+#define PATH_MTU_RESOLUTION 16
+#define PATH_MTU_PROBE_ATTEMPTS 3
+#define PATH_MTU_PROBE_TIMEOUT_MS 250
+// IPv6 + UDP + the Corelink datagram header, whose size depends on the stream id and metadata
+#define PATH_MTU_HEADER_OVERHEAD 128
+#define PATH_MTU_PROBE_MAGIC 0x4D545550
+#define PATH_MTU_PROBE_HEADER_SIZE 8
+
+/**
+ * @brief Path-MTU search over the jitter probe stream
+ *
+ * Binary searches the largest datagram that makes it to the server and back. The first probe is
+ * the Ethernet MTU, as that is where most paths end up. A probe size counts as working when its
+ * echo returns and as too large after PATH_MTU_PROBE_ATTEMPTS unanswered probes, so a single
+ * lost probe does not shrink the result. The search stops once the bracket is narrower than
+ * PATH_MTU_RESOLUTION bytes.
+ *
+ * A probe's payload starts with PATH_MTU_PROBE_MAGIC and the probe size, both little-endian
+ * u32, and is zero after that, so its echo is recognised on the jitter stream next to the
+ * round-trip probes without the datagram's metadata.
+ *
+ * poll() and onProbeEcho() may be called from different threads. getMaxDatagramSize() is a
+ * single atomic load and safe on the sender thread.
+*/
+class PathMtuProber
+{
+public:
+    PathMtuProber() = default;
+
+    void start(int64_t nowMs);
+    void stop();
+    bool isProbing() const;
+
+    /** Returns the IP datagram size to probe with now, or 0 if no probe is due */
+    int poll(int64_t nowMs);
+    void onProbeEcho(int probeSize);
+
+    /** Largest known-good IP datagram size; PATH_MTU_DEFAULT until probing says otherwise */
+    int getPathMtu() const { return mPathMtu.load(std::memory_order_relaxed); }
+    void setPathMtu(int pathMtu);
+    /** Largest application payload that fits one datagram on this path */
+    size_t getMaxDatagramSize() const { return (size_t) (getPathMtu() - PATH_MTU_HEADER_OVERHEAD); }
+
+    static size_t getProbePayloadSize(int probeSize) { return (size_t) (probeSize - PATH_MTU_HEADER_OVERHEAD); }
+    /** Writes the payload of a probe of probeSize bytes; size must be getProbePayloadSize(probeSize) */
+    static void writeProbe(uint8_t* data, size_t size, int probeSize);
+    /** Returns the size of the probe whose payload this is, or 0 if it is not a path-MTU probe */
+    static int readProbe(const uint8_t* data, size_t size);
+
+private:
+    void nextCandidate();
+
+    mutable std::mutex mLock;
+    bool mProbing = false;
+    bool mAwaitingEcho = false;
+    int mLow = PATH_MTU_MIN;
+    int mHigh = PATH_MTU_MAX;
+    int mCandidate = 0;
+    int mAttempts = 0;
+    int64_t mSentAtMs = 0;
+    std::atomic<int> mPathMtu { PATH_MTU_DEFAULT };
+};
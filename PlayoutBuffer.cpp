@@ -0,0 +1,536 @@
+#include "PlayoutBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // Delay error at which the playout rate reaches its limit
+    constexpr double kFullAdjustMs = 20.0;
+    // Errors below this are left alone so the rate does not wander constantly
+    constexpr double kDeadbandMs = 0.5;
+    // Concealed frames in a row with nothing buffered before playback stops and re-primes
+    constexpr int kMaxUnderrunFrames = 4;
+}
+
+PlayoutBuffer::PlayoutBuffer() = default;
+
+PlayoutBuffer::~PlayoutBuffer() = default;
+
+/**
+ * @brief Creates the stream's decoder and allocates slots for PLAYOUT_SLOTS packets. Not on the audio thread
+*/
+void PlayoutBuffer::prepare(const StreamFormat& format, int maxPacketSize, int maxFrameSamples, int maxBlockSize)
+{
+    mFormat = format;
+    mMaxPacketSize = maxPacketSize;
+    mMaxFrameSamples = maxFrameSamples;
+    mNumChannels = format.numChannels;
+    mSamplesPerNs = format.sampleRate / 1e9;
+
+    mCodec = AudioCodec::create(format);
+    if (mCodec)
+        mCodec->prepare(format.sampleRate, mNumChannels, maxFrameSamples);
+
+    mSlots.resize(PLAYOUT_SLOTS);
+    for (auto& slot : mSlots)
+        slot.data.assign((size_t) maxPacketSize, 0);
+
+    mTimeScaler.prepare(mNumChannels, format.sampleRate);
+    mMinTimeScale = (int) std::lround(TSM_MIN_PERIOD_MS * format.sampleRate / 1000.0);
+    mMaxTimeScaleCredit = (int) std::lround(TSM_MAX_PERIOD_MS * format.sampleRate / 1000.0);
+
+    // Decoding runs at most one frame ahead of what a block needs, or of what the time-scale stage
+    // needs to find a period. Every sample is stored twice, capacity apart, so the resampler
+    // always reads a contiguous window
+    size_t capacity = 1;
+    while (capacity < (size_t) (4 * maxFrameSamples + 2 * maxBlockSize + 2 * Resampler::getNumTaps() + mTimeScaler.getMaxCompressLength()))
+        capacity <<= 1;
+    mFifoMask = capacity - 1;
+    mFifo.assign((size_t) mNumChannels, std::vector<float>(2 * capacity, 0.0f));
+    mScaled.assign((size_t) mNumChannels, std::vector<float>(capacity, 0.0f));
+    mScaledPtrs.resize((size_t) mNumChannels);
+    for (int ch = 0; ch < mNumChannels; ++ch)
+        mScaledPtrs[(size_t) ch] = mScaled[(size_t) ch].data();
+    mResampler.prepare();
+    mDrift.prepare(format.sampleRate);
+
+    mDecoded.assign((size_t) mNumChannels, std::vector<float>((size_t) maxFrameSamples, 0.0f));
+    mDecodedPtrs.resize((size_t) mNumChannels);
+    for (int ch = 0; ch < mNumChannels; ++ch)
+        mDecodedPtrs[(size_t) ch] = mDecoded[(size_t) ch].data();
+    mConcealer.prepare(mNumChannels, format.sampleRate, maxFrameSamples);
+
+    mMinDelay = PLAYOUT_MIN_DELAY_MS * format.sampleRate / 1000.0;
+    mMaxDelay = PLAYOUT_MAX_DELAY_MS * format.sampleRate / 1000.0;
+    mBlockSize = maxBlockSize;
+
+    reset();
+}
+
+void PlayoutBuffer::reset()
+{
+    for (auto& slot : mSlots)
+        slot.valid = false;
+
+    if (mCodec)
+        mCodec->reset();
+
+    mPlaying = false;
+    mHasPackets = false;
+    mNextSequence = 0;
+    mNextPosition = 0;
+    mFrameLength = 0;
+    mFifoWrite = 0;
+    mReadPosition = 0.0;
+    mUnderrunFrames = 0;
+    mConcealer.reset();
+    mDrift.reset();
+    mHasRead = false;
+    mLocalPosition = 0.0;
+    mLastReadNs = 0;
+    mLastReadSamples = 0;
+    mTimeScaleError = 0.0;
+    mTimeScaleCredit = 0.0;
+    mStretching = false;
+    mReadEnd = 0;
+
+    mHasTransit = false;
+    mNumTransits = 0;
+    mLastTransit = 0.0;
+    mJitter = 0.0;
+    mMinTransit = 0.0;
+    mWindowMinTransit = 0.0;
+    mWindowStart = 0.0;
+
+    mFactor = 3.0;
+    mLastDelay = 0.0;
+    mCurrentDelayMs.store(0.0, std::memory_order_relaxed);
+    mDriftPpm.store(0.0, std::memory_order_relaxed);
+    updateTarget();
+
+    mNumUnderruns.store(0, std::memory_order_relaxed);
+    mNumLate.store(0, std::memory_order_relaxed);
+    mNumConcealed.store(0, std::memory_order_relaxed);
+    mNumPlayed.store(0, std::memory_order_relaxed);
+    mNumRejected.store(0, std::memory_order_relaxed);
+    mNumCompressions.store(0, std::memory_order_relaxed);
+    mNumExpansions.store(0, std::memory_order_relaxed);
+    mNumSilentDropped.store(0, std::memory_order_relaxed);
+}
+
+bool PlayoutBuffer::insert(const ReceivedPacket& packet)
+{
+    const auto& header = packet.header;
+    // PCM and lossless decoders are built for one sample format; MDCT payloads do not depend on it
+    const bool formatMismatch = header.codec != CodecId::Mdct && header.sampleFormat != mFormat.sampleFormat;
+    if (!mCodec || header.codec != mFormat.codec || formatMismatch || (int) header.numChannels != mNumChannels
+        || header.numFrames == 0 || (int) header.numFrames > mMaxFrameSamples
+        || packet.size > (size_t) mMaxPacketSize || PacketHeader::kSize + header.payloadSize > packet.size)
+    {
+        mNumRejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Rebuilt packets arrive when they were rebuilt, which says nothing about the network
+    if (!packet.recovered)
+    {
+        const double arrival = (double) packet.arrivalNs * mSamplesPerNs;
+        const double transit = arrival - (double) header.samplePosition;
+        if (!mHasTransit)
+        {
+            mMinTransit = mWindowMinTransit = transit;
+            mWindowStart = arrival;
+            mHasTransit = true;
+        }
+        else
+        {
+            // RFC 3550 interarrival jitter, as in JitterBuffer::updateEstimatedJitter
+            mJitter += (std::abs(transit - mLastTransit) - mJitter) / 16.0;
+            mMinTransit = std::min(mMinTransit, transit);
+            mWindowMinTransit = std::min(mWindowMinTransit, transit);
+
+            // The fastest path is re-measured every window so the reference can also move later
+            if (arrival - mWindowStart > PLAYOUT_MIN_TRANSIT_WINDOW_MS * mFormat.sampleRate / 1000.0)
+            {
+                mMinTransit = mWindowMinTransit;
+                mWindowMinTransit = transit;
+                mWindowStart = arrival;
+            }
+        }
+        mLastTransit = transit;
+        ++mNumTransits;
+        updateTarget();
+
+        // The local clock is the count of samples played, extrapolated from the last block
+        if (mHasRead)
+            mDrift.addPacket(header.samplePosition, mLocalPosition + ((double) packet.arrivalNs - (double) mLastReadNs) * mSamplesPerNs);
+    }
+
+    if (mPlaying && header.sequence < mNextSequence)
+    {
+        // Its slot has been concealed already; a little more delay would have saved it
+        mNumLate.fetch_add(1, std::memory_order_relaxed);
+        mFactor = std::min(mFactor + PLAYOUT_JITTER_FACTOR_STEP, PLAYOUT_JITTER_FACTOR_MAX);
+        updateTarget();
+        return false;
+    }
+
+    if (mPlaying && header.sequence >= mNextSequence + PLAYOUT_SLOTS)
+    {
+        // The sender is further ahead than the buffer can hold: start over from this packet
+        for (auto& slot : mSlots)
+            slot.valid = false;
+        mPlaying = false;
+        mHasPackets = false;
+        mDrift.reset();
+    }
+
+    auto& slot = mSlots[(size_t) (header.sequence % PLAYOUT_SLOTS)];
+    if (slot.valid && slot.header.sequence == header.sequence)
+    {
+        mNumRejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    slot.valid = true;
+    slot.header = header;
+    slot.size = packet.size;
+    std::memcpy(slot.data.data(), packet.data.data(), packet.size);
+
+    mHasPackets = true;
+    return true;
+}
+
+void PlayoutBuffer::read(float* const* dest, int numChannels, int numSamples, uint64_t nowNs)
+{
+    if (numSamples != mBlockSize)
+    {
+        mBlockSize = numSamples;
+        updateTarget();
+    }
+
+    if (mHasRead)
+        mLocalPosition += (double) mLastReadSamples;
+    mLastReadSamples = numSamples;
+    mLastReadNs = nowNs;
+    mHasRead = true;
+
+    if (!mPlaying && mHasPackets && mNumTransits >= PLAYOUT_PRIME_PACKETS)
+        start(nowNs);
+
+    if (!mPlaying)
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+            std::fill(dest[ch], dest[ch] + numSamples, 0.0f);
+        return;
+    }
+
+    const double fs = mFormat.sampleRate;
+    mLastDelay = getDelaySamples(nowNs);
+    mCurrentDelayMs.store(mLastDelay * 1000.0 / fs, std::memory_order_relaxed);
+    mDriftPpm.store(mDrift.getDriftPpm(), std::memory_order_relaxed);
+    double error = mLastDelay - mTargetDelay;
+
+    // More delay than the buffer may ever have: drop whole packets, time-scaling would take too long
+    while (error > mMaxDelay && error > (double) mFrameLength)
+    {
+        auto& slot = mSlots[(size_t) (mNextSequence % PLAYOUT_SLOTS)];
+        if (!slot.valid || slot.header.sequence != mNextSequence)
+            break;
+        slot.valid = false;
+        ++mNextSequence;
+        mNextPosition = slot.header.samplePosition + slot.header.numFrames;
+        error -= (double) slot.header.numFrames;
+        if (mCodec)
+            mCodec->reset();
+    }
+
+    // The drift estimate keeps the delay from wandering; the delay error only trims what is left
+    double ratio = mDrift.getRatio();
+    if (std::abs(error) > kDeadbandMs * fs / 1000.0)
+        ratio += std::clamp(error / (kFullAdjustMs * fs / 1000.0) * PLAYOUT_MAX_RATE_ADJUST, -PLAYOUT_MAX_RATE_ADJUST, PLAYOUT_MAX_RATE_ADJUST);
+
+    // Errors too large for the resampler are made up by time-scaling, at a bounded rate
+    const double threshold = PLAYOUT_TIME_SCALE_THRESHOLD_MS * fs / 1000.0;
+    mTimeScaleError = std::abs(error) > threshold ? error : 0.0;
+    mTimeScaleCredit = std::min(mTimeScaleCredit + numSamples * PLAYOUT_MAX_TIME_SCALE, (double) mMaxTimeScaleCredit);
+
+    // The resampler's kernel reaches half its length past the last position
+    const auto lastNeeded = (uint64_t) std::floor(mReadPosition + (numSamples - 1) * ratio) + (uint64_t) (Resampler::getNumTaps() / 2);
+    mReadEnd = lastNeeded + 1;
+    while (mFifoWrite < mReadEnd && mPlaying)
+        decodeNext();
+
+    if (mPlaying && mTimeScaleError > 0.0)
+        speedUp();
+    else if (mPlaying && mTimeScaleError < 0.0)
+        slowDown();
+
+    if (!mPlaying)
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+            std::fill(dest[ch], dest[ch] + numSamples, 0.0f);
+        return;
+    }
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        if (ch >= mNumChannels)
+        {
+            std::fill(dest[ch], dest[ch] + numSamples, 0.0f);
+            continue;
+        }
+
+        // Start the window a half kernel before the read position; the mirror keeps it contiguous
+        const double whole = std::floor(mReadPosition);
+        const int margin = Resampler::getNumTaps() / 2 - 1;
+        const float* window = mFifo[(size_t) ch].data() + (((uint64_t) whole - (uint64_t) margin) & mFifoMask);
+        mResampler.process(window, mReadPosition - whole + margin, ratio, dest[ch], numSamples);
+    }
+    mReadPosition += numSamples * ratio;
+}
+
+/**
+ * @brief Starts playback at the newest buffered packet that is already due, so the delay starts at the target
+*/
+void PlayoutBuffer::start(uint64_t nowNs)
+{
+    const double now = (double) nowNs * mSamplesPerNs;
+    const Slot* first = nullptr;
+    for (const auto& slot : mSlots)
+        if (slot.valid && now - (double) slot.header.samplePosition - mMinTransit >= mTargetDelay
+            && (first == nullptr || slot.header.sequence > first->header.sequence))
+            first = &slot;
+
+    if (first == nullptr)
+        return;
+
+    mPlaying = true;
+    mNextSequence = first->header.sequence;
+    mNextPosition = first->header.samplePosition;
+    mFrameLength = (int) first->header.numFrames;
+    mFifoWrite = 0;
+    mReadPosition = 0.0;
+    mUnderrunFrames = 0;
+    mStretching = false;
+    mReadEnd = 0;
+    mConcealer.reset();
+    if (mCodec)
+        mCodec->reset();
+    // The resampler looks back before the first sample
+    for (auto& fifo : mFifo)
+        std::fill(fifo.begin(), fifo.end(), 0.0f);
+
+    for (auto& slot : mSlots)
+        if (slot.valid && slot.header.sequence < mNextSequence)
+            slot.valid = false;
+}
+
+void PlayoutBuffer::setMinDelay(double delayMs)
+{
+    mMinDelay = std::clamp(delayMs * mFormat.sampleRate / 1000.0, 0.0, mMaxDelay);
+    updateTarget();
+}
+
+/**
+ * @brief Sets the fraction of packets allowed to miss their deadline; lower values buy safety with delay
+*/
+void PlayoutBuffer::setMaxLateRate(double rate)
+{
+    mMaxLateRate = std::clamp(rate, 1e-4, 0.5);
+}
+
+/**
+ * @brief Snapshot of the counters. Any thread
+*/
+PlayoutBuffer::Counters PlayoutBuffer::getCounters() const
+{
+    Counters counters;
+    counters.underruns = mNumUnderruns.load(std::memory_order_relaxed);
+    counters.late = mNumLate.load(std::memory_order_relaxed);
+    counters.concealed = mNumConcealed.load(std::memory_order_relaxed);
+    counters.played = mNumPlayed.load(std::memory_order_relaxed);
+    counters.rejected = mNumRejected.load(std::memory_order_relaxed);
+    counters.compressions = mNumCompressions.load(std::memory_order_relaxed);
+    counters.expansions = mNumExpansions.load(std::memory_order_relaxed);
+    counters.silentDropped = mNumSilentDropped.load(std::memory_order_relaxed);
+    return counters;
+}
+
+bool PlayoutBuffer::hasPacketsAfter(uint64_t sequence) const
+{
+    return std::any_of(mSlots.begin(), mSlots.end(), [sequence](const Slot& slot) { return slot.valid && slot.header.sequence > sequence; });
+}
+
+/**
+ * @brief Appends the next packet in sequence to the FIFO, or conceals its frame if it is missing
+*/
+void PlayoutBuffer::decodeNext()
+{
+    auto& slot = mSlots[(size_t) (mNextSequence % PLAYOUT_SLOTS)];
+    if (slot.valid && slot.header.sequence == mNextSequence)
+    {
+        const auto& header = slot.header;
+        const int numFrames = (int) header.numFrames;
+        slot.valid = false;
+        mStretching = false;
+
+        if (mCodec->decode(slot.data.data() + PacketHeader::kSize, header.payloadSize, mNumChannels, numFrames, mDecodedPtrs.data()))
+        {
+            mConcealer.process(mDecodedPtrs.data(), numFrames);
+            // Silence can go entirely while there is delay to make up
+            if (mTimeScaleError >= (double) numFrames && mTimeScaler.isSilent(mDecodedPtrs.data(), numFrames))
+            {
+                mTimeScaleError -= (double) numFrames;
+                mNumSilentDropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                appendToFifo(mDecodedPtrs.data(), numFrames);
+            }
+            mUnderrunFrames = 0;
+            mNumPlayed.fetch_add(1, std::memory_order_relaxed);
+            mFactor = std::max(mFactor - PLAYOUT_JITTER_FACTOR_STEP * mMaxLateRate, PLAYOUT_JITTER_FACTOR_MIN);
+            updateTarget();
+        }
+        else
+        {
+            conceal(numFrames);
+        }
+
+        mFrameLength = numFrames;
+        mNextPosition = header.samplePosition + (uint64_t) numFrames;
+        ++mNextSequence;
+        return;
+    }
+
+    // Before concealing, stretch what has been played just enough to cover this block, so a packet
+    // that is only a little late still makes it
+    if ((mStretching || !mConcealer.isConcealing()) && mTimeScaleCredit >= 1.0 && mFifoWrite < mReadEnd)
+    {
+        const int needed = (int) std::min(mReadEnd - mFifoWrite, (uint64_t) mMaxFrameSamples);
+        const int numSamples = mConcealer.extend(mDecodedPtrs.data(), std::min((int) mTimeScaleCredit, needed));
+        appendToFifo(mDecodedPtrs.data(), numSamples);
+        mTimeScaleCredit -= numSamples;
+        mStretching = true;
+        mNumExpansions.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    mStretching = false;
+
+    if (!hasPacketsAfter(mNextSequence))
+    {
+        mNumUnderruns.fetch_add(1, std::memory_order_relaxed);
+        // Nothing left to play: after a few frames stop and wait for the buffer to fill again
+        if (++mUnderrunFrames > kMaxUnderrunFrames)
+        {
+            mPlaying = false;
+            mHasPackets = false;
+            mUnderrunFrames = 0;
+            return;
+        }
+    }
+
+    conceal(mFrameLength);
+    mNextPosition += (uint64_t) mFrameLength;
+    ++mNextSequence;
+}
+
+bool PlayoutBuffer::isNextPacketReady() const
+{
+    const auto& slot = mSlots[(size_t) (mNextSequence % PLAYOUT_SLOTS)];
+    return slot.valid && slot.header.sequence == mNextSequence;
+}
+
+/**
+ * @brief Removes one period from the audio not yet reached by the resampler, decoding ahead
+ * only packets that have arrived
+*/
+void PlayoutBuffer::speedUp()
+{
+    const uint64_t readEnd = mReadEnd;
+    const int maxRemove = (int) std::min(mTimeScaleCredit, mTimeScaleError);
+    if (maxRemove < mMinTimeScale)
+        return;
+
+    while (mFifoWrite < readEnd + (uint64_t) mTimeScaler.getMaxCompressLength() && isNextPacketReady())
+        decodeNext();
+    if (mFifoWrite < readEnd + (uint64_t) mTimeScaler.getMinCompressLength())
+        return;
+
+    const int length = (int) (mFifoWrite - readEnd);
+    for (int ch = 0; ch < mNumChannels; ++ch)
+    {
+        const float* fifo = mFifo[(size_t) ch].data() + (readEnd & mFifoMask);
+        std::copy(fifo, fifo + length, mScaled[(size_t) ch].begin());
+    }
+
+    const int scaledLength = mTimeScaler.compress(mScaledPtrs.data(), length, maxRemove);
+    if (scaledLength == length)
+        return;
+
+    mFifoWrite = readEnd;
+    appendToFifo(mScaledPtrs.data(), scaledLength);
+    mTimeScaleCredit -= length - scaledLength;
+    mTimeScaleError -= length - scaledLength;
+    mNumCompressions.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Appends one more period of the decoded audio to refill towards the target
+*/
+void PlayoutBuffer::slowDown()
+{
+    if (mTimeScaleCredit < (double) mMinTimeScale)
+        return;
+
+    const int numSamples = mConcealer.extend(mDecodedPtrs.data(), std::min({ (int) mTimeScaleCredit, (int) -mTimeScaleError, mMaxFrameSamples }));
+    appendToFifo(mDecodedPtrs.data(), numSamples);
+    mTimeScaleCredit -= numSamples;
+    mNumExpansions.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Fills a missing frame from the concealer
+*/
+void PlayoutBuffer::conceal(int numSamples)
+{
+    mConcealer.conceal(mDecodedPtrs.data(), numSamples);
+    appendToFifo(mDecodedPtrs.data(), numSamples);
+    mNumConcealed.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PlayoutBuffer::appendToFifo(const float* const* channels, int numSamples)
+{
+    for (int ch = 0; ch < mNumChannels; ++ch)
+    {
+        auto* fifo = mFifo[(size_t) ch].data();
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto index = (mFifoWrite + (uint64_t) i) & mFifoMask;
+            fifo[index] = channels[ch][i];
+            fifo[index + mFifoMask + 1] = channels[ch][i];
+        }
+    }
+    mFifoWrite += (uint64_t) numSamples;
+}
+
+void PlayoutBuffer::updateTarget()
+{
+    // The headroom keeps the rate controller's deadband and the interpolator's extra sample clear of the deadline
+    const double headroom = 2.0 * kDeadbandMs * mFormat.sampleRate / 1000.0;
+    mTargetDelay = std::clamp(mFactor * mJitter + (double) mBlockSize + headroom, mMinDelay, mMaxDelay);
+    mTargetDelayMs.store(mTargetDelay * 1000.0 / mFormat.sampleRate, std::memory_order_relaxed);
+    mJitterMs.store(mJitter * 1000.0 / mFormat.sampleRate, std::memory_order_relaxed);
+}
+
+/**
+ * @brief How much later than the fastest observed path the sample at the read head is played
+*/
+double PlayoutBuffer::getDelaySamples(uint64_t nowNs) const
+{
+    const double headPosition = (double) mNextPosition - ((double) mFifoWrite - mReadPosition);
+    return (double) nowNs * mSamplesPerNs - headPosition - mMinTransit;
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "AudioCodec.h"
+#include "DriftEstimator.h"
+#include "LossConcealer.h"
+#include "Resampler.h"
+#include "StreamIngest.h"
+#include "TimeScaler.h"
+
+#define PLAYOUT_SLOTS 64
+#define PLAYOUT_MIN_DELAY_MS 0.0
+#define PLAYOUT_MAX_DELAY_MS 250.0
+#define PLAYOUT_DEFAULT_MAX_LATE_RATE 0.01
+#define PLAYOUT_MAX_RATE_ADJUST 0.005
+#define PLAYOUT_JITTER_FACTOR_MIN 1.0
+#define PLAYOUT_JITTER_FACTOR_MAX 16.0
+#define PLAYOUT_JITTER_FACTOR_STEP 0.25
+#define PLAYOUT_MIN_TRANSIT_WINDOW_MS 2000.0
+#define PLAYOUT_PRIME_PACKETS 8
+#define PLAYOUT_MAX_TIME_SCALE 0.05
+#define PLAYOUT_TIME_SCALE_THRESHOLD_MS 5.0
+
+/**
+ * @brief Adaptive playout buffer for one received stream
+ *
+ * Packets are inserted in arrival order and decoded in sequence order when the audio thread
+ * needs them, so reordered packets are put back in place and a packet that never came is
+ * concealed by LossConcealer at its deadline. A packet that arrives after its slot was played counts as late.
+ *
+ * Timing uses the sender's sample positions. The transit time of each packet (arrival minus
+ * sample position) feeds an RFC 3550 jitter estimate, the same running value JitterBuffer
+ * keeps for the probe stream, and a windowed minimum that stands for the fastest path. The
+ * playout delay is measured against that minimum and steered towards
+ *
+ *     target = factor * jitter + block size + 1 ms
+ *
+ * by playing up to PLAYOUT_MAX_RATE_ADJUST faster or slower, so the delay follows the network
+ * smoothly instead of in jumps. On top of that the output plays at the rate DriftEstimator finds
+ * between the sender's sample clock and the local one, so over hours the buffer neither drains
+ * nor grows. Both rates are applied by the polyphase Resampler. factor rises with every late packet and decays by maxLateRate of
+ * a step with every packet played on time, so it settles where the late rate equals the
+ * configured maximum: the lowest delay that meets it. Playback starts once PLAYOUT_PRIME_PACKETS
+ * have been timed, with the newest packet that is already due.
+ *
+ * Errors beyond PLAYOUT_TIME_SCALE_THRESHOLD_MS would take the resampler seconds to make up.
+ * Above the target TimeScaler then removes whole pitch periods from the buffered audio and
+ * silent frames are dropped outright; below it, and just before a missing packet would have to be
+ * concealed, LossConcealer repeats periods instead. Either way at most PLAYOUT_MAX_TIME_SCALE of
+ * the audio played is added or removed. Packets are only discarded beyond PLAYOUT_MAX_DELAY_MS.
+ *
+ * prepare() allocates; insert() and read() run on the audio thread and do not allocate. The
+ * counters and the delay, jitter and drift getters may be read from any thread.
+*/
+class PlayoutBuffer
+{
+public:
+    PlayoutBuffer();
+    ~PlayoutBuffer();
+
+    void prepare(const StreamFormat& format, int maxPacketSize, int maxFrameSamples, int maxBlockSize);
+    void reset();
+
+    /** Takes one packet from the ingest queue. Returns false if it was late, a duplicate or unusable */
+    bool insert(const ReceivedPacket& packet);
+    /** Produces numSamples of audio for the block that starts playing at nowNs */
+    void read(float* const* dest, int numChannels, int numSamples, uint64_t nowNs);
+
+    void setMinDelay(double delayMs);
+    void setMaxLateRate(double rate);
+
+    bool isPlaying() const { return mPlaying; }
+    const StreamFormat& getFormat() const { return mFormat; }
+    double getTargetDelayMs() const { return mTargetDelayMs.load(std::memory_order_relaxed); }
+    double getCurrentDelayMs() const { return mCurrentDelayMs.load(std::memory_order_relaxed); }
+    double getJitterMs() const { return mJitterMs.load(std::memory_order_relaxed); }
+    double getDriftPpm() const { return mDriftPpm.load(std::memory_order_relaxed); }
+
+    struct Counters
+    {
+        uint64_t underruns = 0;
+        uint64_t late = 0;
+        uint64_t concealed = 0;
+        uint64_t played = 0;
+        uint64_t rejected = 0;
+        uint64_t compressions = 0;
+        uint64_t expansions = 0;
+        uint64_t silentDropped = 0;
+    };
+
+    Counters getCounters() const;
+    uint64_t getNumUnderruns() const { return mNumUnderruns.load(std::memory_order_relaxed); }
+    uint64_t getNumLatePackets() const { return mNumLate.load(std::memory_order_relaxed); }
+    uint64_t getNumConcealedFrames() const { return mNumConcealed.load(std::memory_order_relaxed); }
+    uint64_t getNumPlayedPackets() const { return mNumPlayed.load(std::memory_order_relaxed); }
+    uint64_t getNumRejected() const { return mNumRejected.load(std::memory_order_relaxed); }
+    uint64_t getNumCompressions() const { return mNumCompressions.load(std::memory_order_relaxed); }
+    uint64_t getNumExpansions() const { return mNumExpansions.load(std::memory_order_relaxed); }
+    uint64_t getNumSilentFramesDropped() const { return mNumSilentDropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot
+    {
+        bool valid = false;
+        PacketHeader header;
+        size_t size = 0;
+        std::vector<uint8_t> data;
+    };
+
+    void start(uint64_t nowNs);
+    bool hasPacketsAfter(uint64_t sequence) const;
+    void decodeNext();
+    void conceal(int numSamples);
+    bool isNextPacketReady() const;
+    void speedUp();
+    void slowDown();
+    void appendToFifo(const float* const* channels, int numSamples);
+    void updateTarget();
+    double getDelaySamples(uint64_t nowNs) const;
+
+    StreamFormat mFormat;
+    std::unique_ptr<AudioCodec> mCodec;
+    int mMaxPacketSize = 0;
+    int mMaxFrameSamples = 0;
+    int mNumChannels = 0;
+    double mSamplesPerNs = 0.0;
+
+    std::vector<Slot> mSlots;
+    bool mPlaying = false;
+    bool mHasPackets = false;
+    uint64_t mNextSequence = 0;
+    uint64_t mNextPosition = 0;
+    int mFrameLength = 0;
+    int mUnderrunFrames = 0;
+
+    // Decoded audio waiting to be played, planar, indexed by a running sample count and mirrored
+    std::vector<std::vector<float>> mFifo;
+    size_t mFifoMask = 0;
+    uint64_t mFifoWrite = 0;
+    double mReadPosition = 0.0;
+    std::vector<std::vector<float>> mDecoded;
+    std::vector<float*> mDecodedPtrs;
+    LossConcealer mConcealer;
+    Resampler mResampler;
+
+    TimeScaler mTimeScaler;
+    std::vector<std::vector<float>> mScaled;
+    std::vector<float*> mScaledPtrs;
+    // Delay error still to be made up, and samples the time-scale stage may add or remove now
+    double mTimeScaleError = 0.0;
+    double mTimeScaleCredit = 0.0;
+    int mMinTimeScale = 0;
+    int mMaxTimeScaleCredit = 0;
+    bool mStretching = false;
+    uint64_t mReadEnd = 0;
+
+    DriftEstimator mDrift;
+    bool mHasRead = false;
+    double mLocalPosition = 0.0;
+    uint64_t mLastReadNs = 0;
+    int mLastReadSamples = 0;
+
+    bool mHasTransit = false;
+    int mNumTransits = 0;
+    double mLastTransit = 0.0;
+    double mJitter = 0.0;
+    double mMinTransit = 0.0;
+    double mWindowMinTransit = 0.0;
+    double mWindowStart = 0.0;
+
+    double mFactor = 3.0;
+    double mTargetDelay = 0.0;
+    double mMinDelay = 0.0;
+    double mMaxDelay = 0.0;
+    double mMaxLateRate = PLAYOUT_DEFAULT_MAX_LATE_RATE;
+    double mLastDelay = 0.0;
+    int mBlockSize = 0;
+
+    // Written on the audio thread, read from any
+    std::atomic<double> mTargetDelayMs { 0.0 };
+    std::atomic<double> mCurrentDelayMs { 0.0 };
+    std::atomic<double> mJitterMs { 0.0 };
+    std::atomic<double> mDriftPpm { 0.0 };
+    std::atomic<uint64_t> mNumUnderruns { 0 };
+    std::atomic<uint64_t> mNumLate { 0 };
+    std::atomic<uint64_t> mNumConcealed { 0 };
+    std::atomic<uint64_t> mNumPlayed { 0 };
+    std::atomic<uint64_t> mNumRejected { 0 };
+    std::atomic<uint64_t> mNumCompressions { 0 };
+    std::atomic<uint64_t> mNumExpansions { 0 };
+    std::atomic<uint64_t> mNumSilentDropped { 0 };
+};
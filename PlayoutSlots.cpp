@@ -0,0 +1,200 @@
+#include "PlayoutSlots.h"
+
+#include <algorithm>
+#include <cmath>
+
+PlayoutSlots::PlayoutSlots() = default;
+
+PlayoutSlots::~PlayoutSlots()
+{
+    clear();
+}
+
+/**
+ * @brief Forgets every buffer; the streams get new ones prepared for this rate and these sizes
+*/
+void PlayoutSlots::prepare(int numSlots, double sampleRate, int maxPacketSize, int maxFrameSamples, int maxBlockSize)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    clear();
+    mSlots.clear();
+    for (int i = 0; i < numSlots; ++i)
+        mSlots.push_back(std::make_unique<Slot>());
+
+    mSampleRate = sampleRate;
+    mMaxPacketSize = maxPacketSize;
+    mMaxFrameSamples = maxFrameSamples;
+    mMaxBlockSize = maxBlockSize;
+    mNumRateMismatches.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Records the format a stream announced, and prepares its buffer again if it is already playing
+*/
+void PlayoutSlots::announce(const StreamAnnouncement& stream)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    const auto known = std::find_if(mAnnounced.begin(), mAnnounced.end(), [&](const auto& s) { return s.streamId == stream.streamId; });
+    if (known != mAnnounced.end())
+        *known = stream;
+    else
+        mAnnounced.push_back(stream);
+
+    for (auto& slot : mSlots)
+    {
+        if (slot->prepared != 0 && (int) (uint32_t) (slot->prepared >> 32) == stream.streamId)
+        {
+            slot->prepared = 0;
+            mPending.store(true, std::memory_order_relaxed);
+        }
+    }
+    updateLocked();
+}
+
+void PlayoutSlots::update()
+{
+    if (!mPending.load(std::memory_order_acquire))
+        return;
+
+    std::lock_guard<std::mutex> lock(mLock);
+    updateLocked();
+}
+
+void PlayoutSlots::updateLocked()
+{
+    mPending.store(false, std::memory_order_relaxed);
+    for (auto& slot : mSlots)
+    {
+        delete slot->retired.exchange(nullptr, std::memory_order_acquire);
+
+        const uint64_t key = slot->request.load(std::memory_order_acquire);
+        if (key == 0 || key == slot->prepared)
+            continue;
+        if (slot->ready.load(std::memory_order_acquire) != nullptr)
+        {
+            // The audio thread has not taken the last one yet
+            mPending.store(true, std::memory_order_relaxed);
+            continue;
+        }
+
+        auto entry = std::make_unique<Entry>();
+        entry->key = key;
+        const StreamFormat format = getFormat(key);
+        if (std::abs(format.sampleRate - mSampleRate) < 0.5)
+        {
+            entry->buffer = std::make_unique<PlayoutBuffer>();
+            entry->buffer->prepare(format, mMaxPacketSize, mMaxFrameSamples, mMaxBlockSize);
+        }
+        else
+        {
+            mNumRateMismatches.fetch_add(1, std::memory_order_relaxed);
+        }
+        slot->prepared = key;
+        slot->ready.store(entry.release(), std::memory_order_release);
+    }
+}
+
+PlayoutBuffer* PlayoutSlots::find(int index, int streamId, const PacketHeader& header)
+{
+    if (index < 0 || index >= (int) mSlots.size())
+        return nullptr;
+
+    auto& slot = *mSlots[(size_t) index];
+    PlayoutBuffer* buffer = get(index);
+    const Entry* current = slot.current.load(std::memory_order_relaxed);
+    const uint64_t key = makeKey(streamId, header);
+    if (current != nullptr && current->key == key && buffer != nullptr)
+        return buffer;
+
+    if (current == nullptr || current->key != key)
+    {
+        slot.request.store(key, std::memory_order_release);
+        mPending.store(true, std::memory_order_release);
+    }
+    slot.dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+PlayoutBuffer* PlayoutSlots::get(int index)
+{
+    if (index < 0 || index >= (int) mSlots.size())
+        return nullptr;
+
+    auto& slot = *mSlots[(size_t) index];
+    // The replaced entry must have been freed before the slot can take another
+    if (slot.retired.load(std::memory_order_acquire) == nullptr)
+    {
+        if (Entry* ready = slot.ready.exchange(nullptr, std::memory_order_acq_rel))
+        {
+            if (Entry* replaced = slot.current.exchange(ready, std::memory_order_acq_rel))
+            {
+                slot.retired.store(replaced, std::memory_order_release);
+                mPending.store(true, std::memory_order_release);
+            }
+        }
+    }
+
+    const Entry* current = slot.current.load(std::memory_order_relaxed);
+    return current != nullptr ? current->buffer.get() : nullptr;
+}
+
+bool PlayoutSlots::getStatus(int index, StreamStatus& status) const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    if (index < 0 || index >= (int) mSlots.size())
+        return false;
+
+    const auto& slot = *mSlots[(size_t) index];
+    status = StreamStatus();
+    status.dropped = slot.dropped.load(std::memory_order_relaxed);
+    const Entry* current = slot.current.load(std::memory_order_acquire);
+    if (current == nullptr || current->buffer == nullptr)
+        return true;
+
+    const auto& buffer = *current->buffer;
+    status.streamId = (int) (uint32_t) (current->key >> 32);
+    status.format = buffer.getFormat();
+    status.counters = buffer.getCounters();
+    status.targetDelayMs = buffer.getTargetDelayMs();
+    status.currentDelayMs = buffer.getCurrentDelayMs();
+    status.jitterMs = buffer.getJitterMs();
+    status.driftPpm = buffer.getDriftPpm();
+    return true;
+}
+
+/**
+ * @brief The stream id and the header fields a decoder depends on; never 0 for a valid packet
+*/
+uint64_t PlayoutSlots::makeKey(int streamId, const PacketHeader& header)
+{
+    return (uint64_t) (uint32_t) streamId << 32 | (uint64_t) header.numChannels << 16
+         | (uint64_t) header.sampleFormat << 8 | (uint64_t) header.codec;
+}
+
+/**
+ * @brief The announced format for the key's stream, with the packets' own fields taking precedence
+*/
+StreamFormat PlayoutSlots::getFormat(uint64_t key) const
+{
+    const int streamId = (int) (uint32_t) (key >> 32);
+    StreamFormat format;
+    format.sampleRate = mSampleRate;
+    const auto announced = std::find_if(mAnnounced.begin(), mAnnounced.end(), [&](const auto& s) { return s.streamId == streamId; });
+    if (announced != mAnnounced.end())
+        format = announced->format;
+
+    format.numChannels = (int) (uint16_t) (key >> 16);
+    format.sampleFormat = (SampleFormat) (uint8_t) (key >> 8);
+    format.codec = (CodecId) (uint8_t) key;
+    return format;
+}
+
+void PlayoutSlots::clear()
+{
+    for (auto& slot : mSlots)
+    {
+        delete slot->current.exchange(nullptr);
+        delete slot->ready.exchange(nullptr);
+        delete slot->retired.exchange(nullptr);
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "PlayoutBuffer.h"
+#include "StreamAnnouncement.h"
+
+/**
+ * @brief The playout buffers of the received streams, one per ingest slot, each prepared for the format of its stream
+ *
+ * A stream is played in the format its meta announces (see parseStreamAnnouncements). Until
+ * an announcement arrives, its packet headers give the codec, sample format and channels, and
+ * the local sample rate and the codec's default bitrate stand in for the rest.
+ *
+ * The audio thread asks find() for the buffer of every packet it pops. When the slot has no
+ * buffer yet, or it was prepared for another stream or format, find() requests one and returns
+ * nullptr. update() prepares it on another thread and hands it over through an atomic pointer;
+ * the audio thread swaps it in and hands the buffer it replaces back for update() to free.
+ * Packets are dropped until then, and for good for a stream sent at another sample rate, since
+ * the playout resampler only bridges clock drift. An announcement for a stream that is already
+ * playing has its buffer prepared again.
+ *
+ * find() and get() run on the audio thread and neither lock nor allocate. prepare(), announce(),
+ * update() and getStatus() run on any other threads; prepare() not while the audio thread uses
+ * the slots. A buffer is only freed under the lock getStatus() holds while it reads one.
+*/
+class PlayoutSlots
+{
+public:
+    PlayoutSlots();
+    ~PlayoutSlots();
+
+    void prepare(int numSlots, double sampleRate, int maxPacketSize, int maxFrameSamples, int maxBlockSize);
+    void announce(const StreamAnnouncement& stream);
+    /** Prepares the requested buffers and frees the replaced ones. Returns at once if there are none */
+    void update();
+
+    int getNumSlots() const { return (int) mSlots.size(); }
+    /** Audio thread: the buffer for a packet of streamId, or nullptr while there is none for its format */
+    PlayoutBuffer* find(int index, int streamId, const PacketHeader& header);
+    /** Audio thread: the slot's current buffer, or nullptr */
+    PlayoutBuffer* get(int index);
+
+    struct StreamStatus
+    {
+        // -1 while the slot has no buffer
+        int streamId = -1;
+        StreamFormat format;
+        PlayoutBuffer::Counters counters;
+        double targetDelayMs = 0.0;
+        double currentDelayMs = 0.0;
+        double jitterMs = 0.0;
+        double driftPpm = 0.0;
+        // Packets dropped because no buffer for their format was ready or their rate does not match
+        uint64_t dropped = 0;
+    };
+
+    /** Any thread but the audio thread. Returns false for an index out of range */
+    bool getStatus(int index, StreamStatus& status) const;
+    uint64_t getNumRateMismatches() const { return mNumRateMismatches.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry
+    {
+        uint64_t key = 0;
+        // nullptr for a stream that cannot be played here
+        std::unique_ptr<PlayoutBuffer> buffer;
+    };
+
+    struct Slot
+    {
+        std::atomic<Entry*> current { nullptr };
+        std::atomic<Entry*> ready { nullptr };
+        std::atomic<Entry*> retired { nullptr };
+        std::atomic<uint64_t> request { 0 };
+        std::atomic<uint64_t> dropped { 0 };
+        // Key of the last entry made ready; only used under mLock
+        uint64_t prepared = 0;
+    };
+
+    static uint64_t makeKey(int streamId, const PacketHeader& header);
+    StreamFormat getFormat(uint64_t key) const;
+    void updateLocked();
+    void clear();
+
+    std::vector<std::unique_ptr<Slot>> mSlots;
+    std::atomic<bool> mPending { false };
+    std::atomic<uint64_t> mNumRateMismatches { 0 };
+
+    mutable std::mutex mLock;
+    std::vector<StreamAnnouncement> mAnnounced;
+    double mSampleRate = 0.0;
+    int mMaxPacketSize = 0;
+    int mMaxFrameSamples = 0;
+    int mMaxBlockSize = 0;
+};
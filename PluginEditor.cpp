@@ -248,7 +248,14 @@ int32_t SenderAudioProcessorEditor::handleDataChannel(juce::String workspace, ju
     });
 
     startTimer(5);
-    audioProcessor.waitForMLoading(false);
+    if (!audioProcessor.waitForMLoading(false)) {
+        juce::MessageManager::callAsync([]() {
+            juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon,
+                                                   "Connect Sender",
+                                                   "Timed out waiting for the sender stream to be created.");
+        });
+        return -1;
+    }
 
     return 0;
 }
@@ -276,8 +283,23 @@ void SenderAudioProcessorEditor::timerCallback() {
 }
 
 int32_t SenderAudioProcessorEditor::handleAuth(juce::String username, juce::String password, SenderAudioProcessor& audioProcessor) {
-    audioProcessor.setupControlChannel(host_id_edit.getText(), username_editor.getText(), password_editor.getText());
-    audioProcessor.waitForHandledAuth(true);
+    // A late answer to an earlier attempt that timed out must not count for this one
+    audioProcessor.resetHandledAuth();
+    const auto error = audioProcessor.setupControlChannel(host_id_edit.getText(), username_editor.getText(), password_editor.getText());
+    if (error.isNotEmpty()) {
+        juce::MessageManager::callAsync([error]() {
+            juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon, "Connection Failed", error);
+        });
+        return -1;
+    }
+    if (!audioProcessor.waitForHandledAuth(true)) {
+        juce::MessageManager::callAsync([]() {
+            juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon,
+                                                   "Authentication Failed",
+                                                   "Timed out waiting for the server to answer the sign-in.");
+        });
+        return -1;
+    }
     int32_t res_code = audioProcessor.getAuthStatusCode();
     if (res_code != 0) {
       // Authentication Failed
@@ -301,7 +323,7 @@ void SenderAudioProcessorEditor::paint (juce::Graphics& g)
 
     juce::Rectangle<int> bounds = getLocalBounds();
 
-    if (audioProcessor.getNMeasurement() == 10000 && !tabAddConnection.isEnabled()) {
+    if (audioProcessor.isProbingDone() && !tabAddConnection.isEnabled()) {
         addAndMakeVisible(submitBtn);
     }
 
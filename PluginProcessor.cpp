@@ -6,7 +6,7 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
-#include "CorelinkClient.h"
+#include "SharedCorelinkConnection.h"
 
 /**
  * @brief Constructor for the SenderAudioProcessor class
@@ -23,62 +23,87 @@ SenderAudioProcessor::SenderAudioProcessor()
                          )
 #endif
 {
-    mDone.set(false);
     mLoading.set(true);
     mStreamInit.set(false);
-    mCorelinkClient = std::make_unique<CorelinkClient>();
-
+    mProbeStatistics.prepare();
+    mProbePool->prepare(PROBE_POOL_SIZE, PROBE_MAX_SIZE);
+    mStreamIngest.setClock(&mClockSync);
+    // Prepared once: the audio thread pops and the receive paths ingest for the rest of the instance's life.
+    // One slot per playout buffer; idle slots are recycled for new streams
+    mStreamIngest.prepare(RECEIVE_MAX_PACKET_SIZE, INGEST_QUEUE_PACKETS, PLAYOUT_MAX_STREAMS);
+    mEchoMonitor.prepare(RECEIVE_MAX_PACKET_SIZE);
+    // Answers to other instances' probes go back on our jitter stream, behind any queued audio
+    mProbeStreamHandler.setReplyCallback([this](const uint8_t* data, size_t size) {
+        auto packet = mProbePool->acquire();
+        if (!packet || !mJitterBuffer)
+            return;
+        std::memcpy(packet.data(), data, size);
+        packet.setSize(size);
+        mConnection->sendProbe(mJitterBuffer->getHostId(), std::move(packet), PROBE_MAX_SIZE);
+    });
+    mConnection->attach(this);
+    // On the batched data plane the kernel says when each packet really left; the echo monitor uses that as its send time
+    mConnection->addTransmitListener(this, [this](int streamId, uint64_t sequence, uint64_t kernelSendNs) {
+        if (streamId == mSenderStreamID.load(std::memory_order_relaxed))
+            mEchoMonitor.onTransmitted(sequence, kernelSendNs);
+    });
 }
 
 /**
- * @brief
+ * @brief Connects this instance to the shared control channel, which the first instance opens and authenticates
+ *
+ * Returns an empty string once authentication is under way, or why the connection could not be used.
 */
-void SenderAudioProcessor::setupControlChannel(const juce::String& hostId, const juce::String& username, const juce::String& password)
+juce::String SenderAudioProcessor::setupControlChannel(const juce::String& hostId, const juce::String& username, const juce::String& password)
 {
-
-    mCorelinkClient->setInfo(hostId, username);
-
-
-    if (!mCorelinkClient->initProtocols())
-    {
-        throw std::runtime_error("Failed to initialize protocol information. Please contact corelink development");
-        DBG("Failed to initiate protocol");
-    }
-
-    mCorelinkClient->addControlChannel(this);
-
-    // Wait for connection to establish
-    mDone.waitForValue(true);
-    mDone.set(false);
-
-    mCorelinkClient->authenticate(username, password, [&, username](int statusCode) {
+    std::string error;
+    const bool connecting = mConnection->connect(this, hostId, username, password, [&, username](int statusCode) {
         if (statusCode == 0) {
             authStatusCode = statusCode;
             std::string workspace = "Holodeck";
             std::string streamType = JITTER_ESTIMATION_STREAM_TYPE;
             std::string name = username.toStdString();
 
-            addOnSubscribeHandler(mCorelinkClient->mControlChannelId, mCorelinkClient->mClient);
-            mJitterBuffer    = std::make_unique<JitterBuffer>(mCorelinkClient->mClient, mCorelinkClient->mControlChannelId, workspace, streamType, name);
+            auto& client = mConnection->getClient();
+            addOnSubscribeHandler(client.mControlChannelId, client.mClient);
+            mConnection->addUpdateListener(this, [this](const std::string& message) { onStreamsAnnounced(message); });
+            mJitterBuffer    = std::make_unique<JitterBuffer>(client.mClient, client.mControlChannelId, workspace, streamType, name);
             mJitterBuffer->setupSender();
+            createProbeReceiver(workspace);
         } else {
             DBG("Failed to authenticate sender");
         }
         handledAuth.set(true);
-    });
+    }, error);
+    return connecting ? juce::String() : juce::String(error);
 }
 
+/**
+ * @brief Closes this instance's streams. The shared control channel stays open for the other instances
+*/
 void SenderAudioProcessor::disconnectControlChannel() {
-    std::vector<corelink::core::network::channel_id_type> hostIds = {mCorelinkClient->mStreamId, mJitterBuffer->getStreamId()};
-    mCorelinkClient->disconnectChannel(hostIds, [this](int statusCode, corelink::core::network::channel_id_type channelId) {
+    std::vector<corelink::core::network::channel_id_type> hostIds = {(corelink::core::network::channel_id_type) mSenderStreamID.load()};
+    if (mJitterBuffer) {
+        hostIds.push_back(mJitterBuffer->getStreamId());
+    }
+    // The receiver would otherwise keep delivering to this instance after it is gone
+    if (mReceiverStreamID.load() != 0) {
+        hostIds.push_back((corelink::core::network::channel_id_type) mReceiverStreamID.load());
+    }
+    if (mProbeReceiverStreamID.load() != 0) {
+        hostIds.push_back((corelink::core::network::channel_id_type) mProbeReceiverStreamID.load());
+    }
+    mConnection->getClient().disconnectChannel(hostIds, mConnection->bind(this, [this](int statusCode, corelink::core::network::channel_id_type channelId) {
             if (statusCode == 0) {
                 std::cout << "Sender channel session with ID " << channelId << " was purged\n";
                 mSenderStreamID = -1;
+                mReceiverStreamID = 0;
+                mProbeReceiverStreamID = 0;
                 mLoading.set(true);
             } else {
                 std::cerr << "Failed to disconnect stream. Status: " <<statusCode << "\n";
             }
-        }
+        })
     );
 }
 
@@ -94,17 +119,23 @@ int32_t SenderAudioProcessor::getCreateSenderStatusCode() {
     return createSenderStatusCode;
 }
 
-void SenderAudioProcessor::waitForHandledAuth(bool new_value) {
-    handledAuth.waitForValue(new_value);
+/**
+ * @brief Waits for the authentication callback. Returns false if it did not arrive within AUTH_TIMEOUT_MS
+*/
+bool SenderAudioProcessor::waitForHandledAuth(bool new_value) {
+    return handledAuth.waitForValueFor(new_value, std::chrono::milliseconds(AUTH_TIMEOUT_MS));
 }
 
 bool SenderAudioProcessor::getHandledAuth() {
     return handledAuth.get();
 }
 
-void SenderAudioProcessor::waitForMLoading(bool new_value)
+/**
+ * @brief Waits for the sender stream to be created. Returns false if it did not happen within CREATE_SENDER_TIMEOUT_MS
+*/
+bool SenderAudioProcessor::waitForMLoading(bool new_value)
 {
-    mLoading.waitForValue(new_value);
+    return mLoading.waitForValueFor(new_value, std::chrono::milliseconds(CREATE_SENDER_TIMEOUT_MS));
 }
 
 bool SenderAudioProcessor::getMLoading() const
@@ -118,39 +149,79 @@ void SenderAudioProcessor::resetHandledAuth()
 }
 
 /**
- * @brief
+ * @brief Starts round-trip probing of the jitter stream once the server reports a subscription to
+ * one of this instance's streams. Other instances' subscriptions on the shared channel are ignored
 */
 void SenderAudioProcessor::addOnSubscribeHandler(corelink::core::network::channel_id_type mControlChannelId,
                            out<corelink::client::corelink_classic_client> mClient)
 {
-    mCorelinkClient->addOnSubscribe([&](int statusCode) {
-        if (statusCode == 0) {
-            mThreadPool.addJob([&]() mutable {
-                while (nMeasurement < 10000) {
-                    mData.clear();
-                    std::vector<uint8_t> rtt_data(1024);
-                    corelink::utils::json meta;
-                    meta.append("packetIndex", nMeasurement.load());
-                    meta.append("timestamp", std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
-
-                    mCorelinkClient->sendData(mJitterBuffer->getHostId(), std::move(rtt_data), meta);
-
-                    nMeasurement++;
-                    std::this_thread::sleep_for(std::chrono::microseconds(1000));
-                }
-            });
+    mConnection->addSubscribeListener(this, [&](int statusCode, int streamId) {
+        const bool ownStream = streamId == mSenderStreamID.load()
+                            || (mJitterBuffer && streamId == (int) mJitterBuffer->getStreamId());
+        if (statusCode == 0 && ownStream) {
+            mProbeStatistics.reset();
+            mProbeEngine.start(getMonotonicTimeNs());
+            mProbeThread.start();
+            mProbeThread.wake();
         }
     });
 }
 
+/**
+ * @brief Sends the probes that are due on the probe thread. Returns when it next needs to run
+*/
+uint64_t SenderAudioProcessor::sendProbes(uint64_t nowNs)
+{
+    if (!mJitterBuffer)
+        return UINT64_MAX;
+
+    // Probes wait behind any queued audio on the shared sender, so they never delay the stream.
+    // A whole train is due at once and is queued back to back
+    const uint8_t* probe = nullptr;
+    while (const size_t size = mProbeEngine.poll(nowNs, probe))
+    {
+        auto packet = mProbePool->acquire();
+        if (packet)
+        {
+            std::memcpy(packet.data(), probe, size);
+            packet.setSize(size);
+            mConnection->sendProbe(mJitterBuffer->getHostId(), std::move(packet), PROBE_MAX_SIZE);
+        }
+        nMeasurement = mProbeEngine.getNumSent();
+    }
+
+    // Path-MTU probes share the jitter stream; mProbeStreamHandler passes their echoes to mMtuProber
+    if (const int probeSize = mMtuProber.poll((int64_t) (nowNs / 1000000)))
+    {
+        mConnection->sendMtuProbe(mJitterBuffer->getHostId(), probeSize);
+    }
+
+    if (mProbeEngine.isDone())
+        mJitterBuffer->markReady();
+
+    uint64_t nextNs = mProbeEngine.getNextDueNs();
+    if (mMtuProber.isProbing())
+        nextNs = std::min(nextNs, nowNs + (uint64_t) PATH_MTU_PROBE_TIMEOUT_MS * 1000000 / 4);
+    return nextNs;
+}
+
 /**
  * @brief Destructor for the SenderAudioProcessor class
 */
 SenderAudioProcessor::~SenderAudioProcessor()
 {
+    mSenderThread.stop();
+    mProbeThread.stop();
+    mLocalReceiver.stop();
+    mLocalRing.close();
+    // Lets the last packets go out. Any the shared sender still holds after the timeout keep their
+    // pool alive themselves and free it when they are sent or dropped
+    mConnection->waitUntilSent();
     if (!mLoading.get()) {
         disconnectControlChannel();
     }
+    // Callbacks still registered on the shared client are dropped from here on
+    mConnection->detach(this);
     if (mJitterBuffer) {
         mJitterBuffer.reset();
     }
@@ -162,14 +233,83 @@ int SenderAudioProcessor::getNMeasurement()
     return nMeasurement.load();
 }
 
-bool SenderAudioProcessor::getMDone() const 
+/**
+ * @brief True once the round-trip probes have converged or run their course
+*/
+bool SenderAudioProcessor::isProbingDone() const
+{
+    return mProbeEngine.isDone();
+}
+
+/**
+ * @brief Returns the round-trip jitter measured by the probes in milliseconds
+*/
+double SenderAudioProcessor::getProbeJitterMs() const
+{
+    return mProbeEngine.getJitterMs();
+}
+
+/**
+ * @brief Available bandwidth and queuing delay towards the server, as last estimated from the probe echoes
+*/
+BandwidthEstimate SenderAudioProcessor::getBandwidthEstimate() const
+{
+    return mProbeEngine.getBandwidthEstimate();
+}
+
+/**
+ * @brief Round-trip time percentiles of the probe echoes, over all of probing and the last seconds
+*/
+const JitterStatistics& SenderAudioProcessor::getProbeStatistics() const
+{
+    return mProbeStatistics;
+}
+
+/**
+ * @brief Round-trip time, loss and reordering of the live stream, measured on its echo. With kernel
+ * transmit stamps its user statistics hold the same round trips from the user-space send times
+*/
+const EchoMonitor& SenderAudioProcessor::getEchoMonitor() const
+{
+    return mEchoMonitor;
+}
+
+/**
+ * @brief Returns the SocketTimestamping::Capability bits of the batched data plane, 0 while it is not in use
+*/
+unsigned SenderAudioProcessor::getDataPlaneTimestamping() const
+{
+    return mConnection->getDataPlaneTimestamping();
+}
+
+/**
+ * @brief Arrival statistics of one received stream, from kernel receive stamps where the socket had them
+*/
+const JitterStatistics* SenderAudioProcessor::getReceiveStatistics(int index) const
+{
+    return mStreamIngest.getStatistics(index);
+}
+
+/**
+ * @brief Arrival statistics of the same stream from user-space times, over the packets that also had a kernel stamp
+*/
+const JitterStatistics* SenderAudioProcessor::getReceiveUserStatistics(int index) const
+{
+    return mStreamIngest.getUserStatistics(index);
+}
+
+/**
+ * @brief The offset and skew of the reference instance's clock, which outgoing packets are stamped on.
+ * The reference is the instance in the workspace with the lowest jitter stream id
+*/
+const ClockSync& SenderAudioProcessor::getClockSync() const
 {
-    return mDone.get();
+    return mClockSync;
 }
 
 bool SenderAudioProcessor::doesCorelinkClientExist() const
 {
-    return (mCorelinkClient != nullptr);
+    return mConnection.getReferenceCount() > 0;
 }
 double SenderAudioProcessor::getAudioSampleRate() const
 {
@@ -243,7 +383,7 @@ juce::String SenderAudioProcessor::getAudioStreamType()
 }
 
 /**
- * @brief Sets the jitter buffer size
+ * @brief Sets the jitter buffer size, the minimum playout delay in ms for received streams
 */
 void SenderAudioProcessor::setBufferSize(const juce::String &val)
 {
@@ -259,37 +399,47 @@ int SenderAudioProcessor::getBufferSize()
     return mJitterBufferSize;
 }
 
-/**
- * @brief Prints error log
-*/
-void SenderAudioProcessor::onError(corelink::core::network::channel_id_type hostId, in<std::string> err)
-{
-    DBG("Error in host id: " << hostId);
-    mDone.set(true);
-}
-/**
- * @brief Prints log when the channel is connected
-*/
-void SenderAudioProcessor::onChannelInit(corelink::core::network::channel_id_type hostId)
-{
-    mDone.set(true);
-}
-/**
- * @brief Prints log when the channel is disconnected
-*/
-void SenderAudioProcessor::onChannelUninit(corelink::core::network::channel_id_type hostId)
-{
-    mDone.set(true);
-}
-
 /**
  * @brief Creates the sender processor
 */
 void SenderAudioProcessor::createSender(const juce::String& workspace, const juce::String& stream_type)
 {
-    mCorelinkClient->createSender(workspace, stream_type, [&](int statusCode) {
+    StreamFormat format;
+    format.sampleRate = mAudioSampleRate;
+    format.numChannels = NUMBER_CHANNEL;
+    format.sampleFormat = mSampleFormat.load();
+    format.codec = mCodec.load();
+    format.bitrate = format.codec == CodecId::Mdct ? mCodecBitrate.load() : 0;
+    if (format.codec == CodecId::Lossless && format.sampleFormat == SampleFormat::Float32)
+    {
+        // The lossless stage codes integers, so float input is carried at 24-bit resolution
+        format.sampleFormat = SampleFormat::Int24;
+    }
+
+    // Swap the codec while the sender thread is parked; it is restarted if audio is already prepared
+    mSenderThread.stop();
+    mStreamSampleFormat = format.sampleFormat;
+    mAudioCodec = AudioCodec::create(format);
+    prepareCodec();
+    if (mAudioBufferSize > 0)
+    {
+        mSenderThread.start();
+    }
+    format.codecDelay = mAudioCodec->getDecoderDelay();
+
+    const uint64_t scope = LocalStreamRing::makeScope(mCorelinkHostId.toStdString(), CORELINK_SERVER_PORT, workspace.toStdString());
+    mConnection->getClient().createSender(workspace, stream_type, format, mConnection->bind(this, [this, scope](int statusCode, corelink::core::network::channel_id_type hostId, corelink::core::network::channel_id_type streamId) {
+        if (statusCode == 0)
+        {
+            mSenderHostId = hostId;
+            mSenderScope.store(scope, std::memory_order_relaxed);
+            mSenderStreamID = (int) streamId;
+            // The server echoes the stream back through the receiver, which the echo monitor needs
+            if (mReceiverStreamID.load() == 0)
+                createReceiver();
+        }
         mLoading.set(false);
-    });
+    }));
 }
 
 /**
@@ -384,6 +534,143 @@ void SenderAudioProcessor::prepareToPlay(double mSampleRate, int samplesPerBlock
 {
     mAudioBufferSize = samplesPerBlock;
     mAudioSampleRate = mSampleRate;
+
+    // Network frames are sized for the longest supported duration so the duration can change
+    // while playing, and the ring holds two host blocks' worth of the shortest frames
+    mMaxNetworkFrameSamples = ReBlocker::getFrameLength(mSampleRate, NETWORK_FRAME_MS_MAX);
+    const int minFrameSamples = ReBlocker::getFrameLength(mSampleRate, NETWORK_FRAME_MS_MIN);
+    const int ringFrames = juce::jmax(SENDER_RING_FRAMES, 2 * (samplesPerBlock / minFrameSamples + 1));
+
+    // The ring and scratch frame can only be resized while nothing is draining them
+    mSenderThread.stop();
+    mFrameRing.prepare(ringFrames, NUMBER_CHANNEL, mMaxNetworkFrameSamples);
+    mReBlocker.prepare(NUMBER_CHANNEL, mMaxNetworkFrameSamples);
+    mReBlocker.setFrameLength(ReBlocker::getFrameLength(mSampleRate, mNetworkFrameMs.load()), mFrameRing);
+    prepareCodec();
+    mSenderThread.prepare(NUMBER_CHANNEL, mMaxNetworkFrameSamples);
+    mSenderThread.start();
+
+    // Each received stream gets a playout buffer for its own format once its packets arrive
+    mPlayoutSlots.prepare(PLAYOUT_MAX_STREAMS, mSampleRate, RECEIVE_MAX_PACKET_SIZE, mMaxNetworkFrameSamples, samplesPerBlock);
+    mReceivedPacket.allocate(RECEIVE_MAX_PACKET_SIZE);
+    mPlayoutScratch.setSize(NUMBER_CHANNEL, samplesPerBlock);
+}
+
+/**
+ * @brief Creates a receiver for the audio stream type and routes incoming packets into the per-stream ingest queues
+*/
+void SenderAudioProcessor::createReceiver()
+{
+    // Per-stream buffers are allocated when a stream first sends; the packet path itself never allocates.
+    // The ingest stage is not reset here, as the audio thread and earlier receive callbacks may be using it
+    mLocalReceiver.setScope(LocalStreamRing::makeScope(mCorelinkHostId.toStdString(), CORELINK_SERVER_PORT, mAudioWorkspace));
+    mLocalReceiver.start();
+
+    // The receiver may keep delivering after this instance is gone, so both callbacks go through bind()
+    mConnection->getClient().createReceiver(juce::String(mAudioWorkspace), juce::String(mAudioStreamType),
+        mConnection->bind(this, [this](int sourceStreamId, const uint8_t* data, size_t size, uint64_t arrivalNs) {
+            if (sourceStreamId == mSenderStreamID.load(std::memory_order_relaxed))
+                mEchoMonitor.onEcho(data, size, arrivalNs);
+            else
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mIngestLock);
+                    mStreamIngest.ingest(sourceStreamId, data, size, arrivalNs);
+                }
+                // Prepares the playout buffers the audio thread asked for
+                mPlayoutSlots.update();
+            }
+        }),
+        mConnection->bind(this, [this](int statusCode, corelink::core::network::channel_id_type, corelink::core::network::channel_id_type streamId) {
+            if (statusCode == 0) {
+                mReceiverStreamID = (int) streamId;
+            } else {
+                DBG("Failed to create receiver");
+            }
+        }),
+        mConnection->bind(this, [this](const std::string& message) { onStreamsAnnounced(message); }));
+}
+
+/**
+ * @brief Takes the formats announced in the meta of the streams already in the workspace or of a
+ * stream created later, so their playout buffers are prepared for them
+*/
+void SenderAudioProcessor::onStreamsAnnounced(const std::string& message)
+{
+    for (const auto& stream : parseStreamAnnouncements(message))
+    {
+        if (stream.streamId != mSenderStreamID.load(std::memory_order_relaxed))
+            mPlayoutSlots.announce(stream);
+    }
+}
+
+/**
+ * @brief Creates the receiver that gets the jitter stream back from the server, with the round-trip
+ * and path-MTU probe echoes on it
+*/
+void SenderAudioProcessor::createProbeReceiver(const std::string& workspace)
+{
+    mConnection->getClient().createReceiver(juce::String(workspace), juce::String(JITTER_ESTIMATION_STREAM_TYPE),
+        mConnection->bind(this, [this](int sourceStreamId, const uint8_t* data, size_t size, uint64_t arrivalNs) {
+            const int ownStreamId = mJitterBuffer ? (int) mJitterBuffer->getStreamId() : 0;
+            if (mProbeStreamHandler.onReceive(ownStreamId, sourceStreamId, data, size, arrivalNs) == ProbeRoute::Echo)
+                onProbeEcho();
+        }),
+        mConnection->bind(this, [this](int statusCode, corelink::core::network::channel_id_type, corelink::core::network::channel_id_type streamId) {
+            if (statusCode == 0) {
+                mProbeReceiverStreamID = (int) streamId;
+            } else {
+                DBG("Failed to create the jitter stream receiver");
+            }
+        }));
+}
+
+/**
+ * @brief Subscribes the receiver to a stream that appeared after it was created
+*/
+void SenderAudioProcessor::subscribeToStream(int streamId)
+{
+    mConnection->getClient().subscribe((corelink::core::network::channel_id_type) mReceiverStreamID.load(), streamId, [streamId](int statusCode) {
+        if (statusCode != 0) {
+            DBG("Failed to subscribe to stream " << streamId);
+        }
+    });
+}
+
+/**
+ * @brief Returns the receive-side ingest stage; its queues are drained by the playout buffers
+*/
+StreamIngest& SenderAudioProcessor::getStreamIngest()
+{
+    return mStreamIngest;
+}
+
+/**
+ * @brief Prepares the stream codec and sizes the packet pool for its largest payload. The
+ * sender thread must be stopped
+*/
+void SenderAudioProcessor::prepareCodec()
+{
+    if (!mAudioCodec)
+    {
+        // No stream created yet: default to float PCM
+        mAudioCodec = AudioCodec::create(StreamFormat());
+    }
+
+    mAudioCodec->prepare(mAudioSampleRate, NUMBER_CHANNEL, mMaxNetworkFrameSamples);
+    const size_t payloadSize = mAudioCodec->getMaxEncodedSize(NUMBER_CHANNEL, mMaxNetworkFrameSamples);
+    mFecEncoder.prepare(PacketHeader::kSize + payloadSize);
+    mAppliedFecCode = -1;
+
+    // The sender thread is stopped, but packets it queued may still be on the shared sender. A pool
+    // not drained within the timeout is replaced rather than reallocated under them; they keep the
+    // old one alive until the last of them is sent or dropped
+    mConnection->waitUntilSent();
+    if (mPacketPool->getNumInUse() > 0)
+        mPacketPool = std::make_shared<PacketPool>();
+
+    // Repair packets come from the same pool and are slightly larger than the packets they protect
+    mPacketPool->prepare(PACKET_POOL_SIZE, mFecEncoder.getMaxRepairPacketSize());
 }
 
 /**
@@ -404,6 +691,7 @@ void SenderAudioProcessor::getStateInformation(juce::MemoryBlock &destData)
 */
 void SenderAudioProcessor::releaseResources()
 {
+    mSenderThread.stop();
 }
 
 /**
@@ -437,44 +725,182 @@ void SenderAudioProcessor::processBlock(juce::AudioBuffer<float> &buffer, juce::
 
     if (!mLoading.get() && totalNumInputChannels >= 2)
     {
-        std::async(std::launch::async, &SenderAudioProcessor::sendData, this, std::move(buffer), audioBufferSize, std::ref(mData), totalNumInputChannels);
+        // Only a bounded copy into the ring happens here; the sender thread does the networking.
+        // The re-blocker turns host blocks of any size into fixed network frames
+        const int numChannels = juce::jmin(totalNumInputChannels, NUMBER_CHANNEL);
+        const float* channels[NUMBER_CHANNEL];
+        for (int ch = 0; ch < numChannels; ++ch)
+            channels[ch] = buffer.getReadPointer(ch);
+
+        mReBlocker.setFrameLength(ReBlocker::getFrameLength(mAudioSampleRate, mNetworkFrameMs.load(std::memory_order_relaxed)), mFrameRing);
+        mReBlocker.process(channels, numChannels, audioBufferSize, mCapturedSamples, mFrameRing);
     }
+    mCapturedSamples += (uint64_t) audioBufferSize;
+
+    releaseRetiredStreams();
+    if (mReceiveMonitoring.load(std::memory_order_relaxed))
+        mixReceivedStreams(buffer);
 
     // Apply gain to all channels
     buffer.applyGain(0, audioBufferSize, mVolume.get());
 }
 
+/**
+ * @brief Hands ingest slots whose stream went idle back for reuse, after resetting their playout buffers
+*/
+void SenderAudioProcessor::releaseRetiredStreams()
+{
+    const int numStreams = mStreamIngest.getNumStreams();
+    for (int index = 0; index < numStreams; ++index)
+    {
+        if (!mStreamIngest.releaseRetired(index))
+            continue;
+        if (auto* playout = mPlayoutSlots.get(index))
+            playout->reset();
+    }
+}
 
 /**
- * @brief Sends data to Corelink host
+ * @brief Moves queued packets into each stream's playout buffer and mixes the streams into the block
 */
-void SenderAudioProcessor::sendData(juce::AudioBuffer<float> buffer, int mAudioBufferSize, std::vector<uint8_t> &mData, int numChannels)
+void SenderAudioProcessor::mixReceivedStreams(juce::AudioBuffer<float>& buffer)
+{
+    const int numSamples = buffer.getNumSamples();
+    if (numSamples > mPlayoutScratch.getNumSamples())
+    {
+        return;
+    }
+
+    const int numChannels = juce::jmin(buffer.getNumChannels(), NUMBER_CHANNEL);
+    const uint64_t nowNs = getMonotonicTimeNs();
+    const double minDelayMs = (double) mJitterBufferSize.load(std::memory_order_relaxed);
+    const double maxLateRate = mMaxLateRate.load(std::memory_order_relaxed);
+    const int numStreams = juce::jmin(mStreamIngest.getNumStreams(), mPlayoutSlots.getNumSlots());
+    for (int index = 0; index < numStreams; ++index)
+    {
+        const int streamId = mStreamIngest.getStreamId(index);
+        while (mStreamIngest.pop(index, mReceivedPacket))
+        {
+            // Dropped while a buffer for the stream's format is being prepared
+            if (auto* playout = mPlayoutSlots.find(index, streamId, mReceivedPacket.header))
+                playout->insert(mReceivedPacket);
+        }
+
+        auto* playout = mPlayoutSlots.get(index);
+        if (playout == nullptr)
+            continue;
+        playout->setMinDelay(minDelayMs);
+        playout->setMaxLateRate(maxLateRate);
+        playout->read(mPlayoutScratch.getArrayOfWritePointers(), numChannels, numSamples, nowNs);
+        for (int ch = 0; ch < numChannels; ++ch)
+            buffer.addFrom(ch, 0, mPlayoutScratch, ch, 0, numSamples);
+    }
+}
+
+
+/**
+ * @brief Sends one captured frame to the Corelink host. Runs on the sender thread
+*/
+void SenderAudioProcessor::sendData(const AudioFrame& frame)
 {
     if (!mLoading.get())
     {
-        corelink::utils::json meta;
-        meta.append("counter_value", mPacketCounter);
-        meta.append("num_channel", numChannels);
+        auto packet = mPacketPool->acquire();
+        if (!packet)
+        {
+            // Pool exhausted (counted by the pool)
+            return;
+        }
+
+        auto des = packet.data() + PacketHeader::kSize;
+        const float* channels[NUMBER_CHANNEL];
+        for (int i = 0; i < frame.numChannels; i++) {
+            channels[i] = frame.getReadPointer(i);
+        }
 
-        meta.append("timestamp", std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+        mAudioCodec->setDitherEnabled(mDitherEnabled.load(std::memory_order_relaxed));
+        int numEncodedFrames = 0;
+        const size_t payloadSize = mAudioCodec->encode(channels, frame.numChannels, frame.numSamples, des, packet.capacity() - PacketHeader::kSize, numEncodedFrames);
+        if (payloadSize == 0)
+        {
+            // Nothing to send yet (the codec is still filling a frame) or the frame did not fit;
+            // either way no sequence number is used up
+            return;
+        }
 
-        mData.clear();
-        mData.resize(sizeof(float) * buffer.getNumSamples() * numChannels);
+        // Position of the first encoded sample; codecs that buffer may emit audio from earlier frames
+        const auto samplePosition = frame.samplePosition + (uint64_t) frame.numSamples
+                                  - (uint64_t) mAudioCodec->getNumBufferedFrames() - (uint64_t) numEncodedFrames;
 
-        auto des = mData.data();
-        for (int i = 0; i < numChannels; i++) {
-            std::memcpy(des, buffer.getReadPointer(i), sizeof(float) * mAudioBufferSize);
-            des += sizeof(float) * mAudioBufferSize;
+        PacketHeader header;
+        header.numChannels = (uint16_t) frame.numChannels;
+        header.sampleFormat = mStreamSampleFormat;
+        header.codec = mAudioCodec->getId();
+        header.sequence = mSequence++;
+        header.samplePosition = samplePosition;
+        header.numFrames = (uint32_t) numEncodedFrames;
+        header.payloadSize = (uint32_t) payloadSize;
+        // Once synchronized, receivers can take the one-way delay straight from the stamp
+        const uint64_t sendNs = getMonotonicTimeNs();
+        header.sendTimeNs = sendNs;
+        if (mClockSync.isSynchronized())
+        {
+            header.flags |= PACKET_FLAG_SYNCED_TIME;
+            header.sendTimeNs = mClockSync.toReferenceNs(sendNs);
         }
-        // Send data
-        if (mData.size() > 0)
+        header.encode(packet.data(), packet.capacity());
+        mEchoMonitor.onSent(header.sequence, sendNs);
+        packet.setSize(PacketHeader::kSize + payloadSize);
+
+        const int fecCode = mFecCode.load(std::memory_order_relaxed);
+        if (fecCode != mAppliedFecCode)
+        {
+            mFecEncoder.setCode(fecCode >> 8, fecCode & 0xff);
+            mAppliedFecCode = fecCode;
+        }
+
+        // The shared sender paces to the stream's nominal rate: the largest packet per frame, plus repair packets
+        double pacingRate = (double) (PacketHeader::kSize + mAudioCodec->getMaxEncodedSize(frame.numChannels, frame.numSamples))
+                          * mAudioSampleRate / (double) frame.numSamples;
+        if (mAppliedFecCode > 0)
+            pacingRate *= (double) ((mAppliedFecCode >> 8) + (mAppliedFecCode & 0xff)) / (double) (mAppliedFecCode >> 8);
+        if (pacingRate != mPacingRate)
+        {
+            mConnection->setPacingRate(this, pacingRate);
+            mPacingRate = pacingRate;
+        }
+        const int numRepairPackets = mFecEncoder.addPacket(packet.data(), packet.size(), header.sequence);
+
+        // Receivers on this host take the packet from shared memory, where it cannot be lost in transit; no repair packets
+        const int streamId = mSenderStreamID.load(std::memory_order_acquire);
+        const uint64_t scope = mSenderScope.load(std::memory_order_relaxed);
+        if (streamId != mLocalRingStreamId || scope != mLocalRingScope)
         {
-            mCorelinkClient->sendData(mCorelinkClient->mHostId, mData, meta);
+            mLocalRing.close();
+            if (streamId >= 0)
+                mLocalRing.create(scope, streamId, LOCAL_RING_SLOTS, packet.capacity());
+            mLocalRingStreamId = streamId;
+            mLocalRingScope = scope;
         }
+        mLocalRing.push(packet.data(), packet.size());
 
-        // Increment packet counter with current buffer size
-        mPacketCounter += mAudioBufferSize;
-        mPacketCounter = mPacketCounter % (150 * mAudioBufferSize);
+        // Send data
+        const size_t maxDatagramSize = mMtuProber.getMaxDatagramSize();
+        const auto hostId = mSenderHostId.load(std::memory_order_relaxed);
+        // Audio still queued once the receivers' playout delay has passed would only arrive too late
+        const uint64_t deadlineNs = sendNs + (uint64_t) mJitterBufferSize.load(std::memory_order_relaxed) * 1000000ull;
+        mConnection->send(hostId, std::move(packet), maxDatagramSize, deadlineNs);
+
+        for (int i = 0; i < numRepairPackets; i++)
+        {
+            auto repair = mPacketPool->acquire();
+            if (!repair)
+            {
+                break;
+            }
+            repair.setSize(mFecEncoder.writeRepairPacket(i, repair.data(), repair.capacity()));
+            mConnection->send(hostId, std::move(repair), maxDatagramSize, deadlineNs);
+        }
     }
 }
 
@@ -527,3 +953,235 @@ float SenderAudioProcessor::getVolume()
 {
     return mVolume.get();
 }
+
+/**
+ * @brief Chooses which frame is discarded when the sender thread falls behind
+*/
+void SenderAudioProcessor::setOverflowPolicy(OverflowPolicy policy)
+{
+    mFrameRing.setOverflowPolicy(policy);
+}
+/**
+ * @brief Returns the current sender ring overflow policy
+*/
+OverflowPolicy SenderAudioProcessor::getOverflowPolicy() const
+{
+    return mFrameRing.getOverflowPolicy();
+}
+/**
+ * @brief Returns how many frames were discarded because the sender ring was full
+*/
+uint64_t SenderAudioProcessor::getNumDroppedFrames() const
+{
+    return mFrameRing.getNumDropped();
+}
+/**
+ * @brief Returns how many times a send found the packet pool empty
+*/
+uint64_t SenderAudioProcessor::getNumPacketPoolExhausted() const
+{
+    return mPacketPool->getNumExhausted();
+}
+/**
+ * @brief Returns the largest number of packets that were in flight at once
+*/
+size_t SenderAudioProcessor::getPacketPoolHighWaterMark() const
+{
+    return mPacketPool->getHighWaterMark();
+}
+/**
+ * @brief Chooses the payload sample format for the next stream created with createSender()
+*/
+void SenderAudioProcessor::setSampleFormat(SampleFormat format)
+{
+    mSampleFormat.store(format);
+}
+/**
+ * @brief Returns the payload sample format used for new streams
+*/
+SampleFormat SenderAudioProcessor::getSampleFormat() const
+{
+    return mSampleFormat.load();
+}
+/**
+ * @brief Turns TPDF dither on or off for the 16- and 24-bit formats
+*/
+void SenderAudioProcessor::setDitherEnabled(bool enabled)
+{
+    mDitherEnabled.store(enabled);
+}
+/**
+ * @brief Chooses the payload codec for the next stream created with createSender()
+*/
+void SenderAudioProcessor::setCodec(CodecId codec)
+{
+    mCodec.store(codec);
+}
+/**
+ * @brief Returns the payload codec used for new streams
+*/
+CodecId SenderAudioProcessor::getCodec() const
+{
+    return mCodec.load();
+}
+/**
+ * @brief Sets the stream bitrate in bits per second for lossy codecs created by createSender()
+*/
+void SenderAudioProcessor::setCodecBitrate(int bitrate)
+{
+    mCodecBitrate.store(bitrate);
+}
+/**
+ * @brief Returns the bitrate used for new lossy streams
+*/
+int SenderAudioProcessor::getCodecBitrate() const
+{
+    return mCodecBitrate.load();
+}
+/**
+ * @brief Chooses how the audio datagrams of streams created from now on reach the server, for every instance in the host
+*/
+void SenderAudioProcessor::setDataPlane(DataPlane dataPlane)
+{
+    mConnection->getClient().setDataPlane(dataPlane);
+}
+/**
+ * @brief Returns the data plane new streams are created on
+*/
+DataPlane SenderAudioProcessor::getDataPlane() const
+{
+    return mConnection->getClient().getDataPlane();
+}
+/**
+ * @brief Sets the network frame duration (2.5, 5, 10 or 20 ms). Takes effect at the next audio block
+*/
+bool SenderAudioProcessor::setNetworkFrameDuration(double frameMs)
+{
+    for (double supported : { 2.5, 5.0, 10.0, 20.0 })
+    {
+        if (frameMs == supported)
+        {
+            mNetworkFrameMs.store(frameMs);
+            return true;
+        }
+    }
+    return false;
+}
+/**
+ * @brief Returns the network frame duration in milliseconds
+*/
+double SenderAudioProcessor::getNetworkFrameDuration() const
+{
+    return mNetworkFrameMs.load();
+}
+/**
+ * @brief Starts or stops path-MTU probing on the jitter stream. Without it packets are fragmented for PATH_MTU_DEFAULT
+*/
+void SenderAudioProcessor::setPathMtuProbingEnabled(bool enabled)
+{
+    if (enabled)
+    {
+        mMtuProber.start((int64_t) (getMonotonicTimeNs() / 1000000));
+        mProbeThread.start();
+        mProbeThread.wake();
+    }
+    else
+    {
+        mMtuProber.stop();
+    }
+}
+/**
+ * @brief Sets the probe count, rate, size and stop condition for the next round of probing
+*/
+bool SenderAudioProcessor::setProbeConfig(const ProbeConfig& config)
+{
+    return mProbeEngine.setConfig(config);
+}
+/**
+ * @brief Called on the jitter stream receiver once the probe engine has taken an echo
+*/
+void SenderAudioProcessor::onProbeEcho()
+{
+    if (!mJitterBuffer)
+        return;
+    mJitterBuffer->updateEstimatedJitter((int) std::lround(mProbeEngine.getLastRttMs() * 1000.0));
+    if (mProbeEngine.isDone())
+    {
+        mJitterBuffer->markReady();
+        mProbeThread.wake();
+    }
+}
+/**
+ * @brief Returns the largest IP datagram size currently assumed to reach the server unfragmented
+*/
+int SenderAudioProcessor::getPathMtu() const
+{
+    return mMtuProber.getPathMtu();
+}
+/**
+ * @brief Protects every numSourcePackets audio packets with numRepairPackets repair packets.
+ * 0 turns forward error correction off; with one repair packet the parity is a plain XOR
+*/
+bool SenderAudioProcessor::setFecCode(int numSourcePackets, int numRepairPackets)
+{
+    if (numSourcePackets == 0 || numRepairPackets == 0)
+    {
+        mFecCode.store(0);
+        return true;
+    }
+    if (!Fec::isValidCode(numSourcePackets, numRepairPackets))
+    {
+        return false;
+    }
+    mFecCode.store(numSourcePackets << 8 | numRepairPackets);
+    return true;
+}
+/**
+ * @brief Mixes the received streams into the plugin output through their playout buffers. Off by default
+*/
+void SenderAudioProcessor::setReceiveMonitoringEnabled(bool enabled)
+{
+    mReceiveMonitoring.store(enabled);
+}
+/**
+ * @brief Sets the fraction of received packets allowed to miss their playout deadline; lower values buy safety with delay
+*/
+void SenderAudioProcessor::setMaxLateRate(double rate)
+{
+    mMaxLateRate.store(rate);
+}
+/**
+ * @brief Returns the late-packet rate the playout buffers aim for
+*/
+double SenderAudioProcessor::getMaxLateRate() const
+{
+    return mMaxLateRate.load();
+}
+/**
+ * @brief Returns the number of playout slots, one per received stream at most
+*/
+int SenderAudioProcessor::getNumPlayoutStreams() const
+{
+    return mPlayoutSlots.getNumSlots();
+}
+/**
+ * @brief Reads the counters and the target and current delay of one received stream's playout buffer. Not on the audio thread
+*/
+bool SenderAudioProcessor::getPlayoutStatus(int index, PlayoutSlots::StreamStatus& status) const
+{
+    return mPlayoutSlots.getStatus(index, status);
+}
+/**
+ * @brief Returns the number of audio packets per FEC group, 0 when FEC is off
+*/
+int SenderAudioProcessor::getFecSourcePackets() const
+{
+    return mFecCode.load() >> 8;
+}
+/**
+ * @brief Returns the number of repair packets per FEC group
+*/
+int SenderAudioProcessor::getFecRepairPackets() const
+{
+    return mFecCode.load() & 0xff;
+}
@@ -12,6 +12,16 @@
 #define CORELINK_ENABLE_STRING_UTIL_FUNCTIONS
 #define NUMBER_CHANNEL 4
 #define JITTER_ESTIMATION_STREAM_TYPE "JitterEst"
+#define SENDER_RING_FRAMES 32
+#define NETWORK_FRAME_MS 10.0
+#define NETWORK_FRAME_MS_MIN 2.5
+#define NETWORK_FRAME_MS_MAX 20.0
+#define PACKET_POOL_SIZE 64
+#define PROBE_POOL_SIZE 8
+#define AUTH_TIMEOUT_MS 10000
+#define CREATE_SENDER_TIMEOUT_MS 30000
+#define RECEIVE_MAX_PACKET_SIZE 32768
+#define PLAYOUT_MAX_STREAMS 8
 
 #include <juce_analytics/juce_analytics.h>
 #include <juce_animation/juce_animation.h>
@@ -32,16 +42,37 @@
 #include "corelink_all.hpp"
 #include <iostream>
 #include <future>
+#include <mutex>
 #include "JitterBuffer.h"
 #include <cmath>
 
+#include "AudioCodec.h"
+#include "AudioFrameRing.h"
+#include "AudioSenderThread.h"
+#include "ClockSync.h"
+#include "EchoMonitor.h"
+#include "FecCodec.h"
+#include "JitterStatistics.h"
+#include "LocalStreamReceiver.h"
+#include "LocalStreamRing.h"
+#include "PacketHeader.h"
+#include "PacketPool.h"
+#include "PathMtuProber.h"
+#include "PlayoutSlots.h"
+#include "ProbeEngine.h"
+#include "ProbeStreamHandler.h"
+#include "ProbeThread.h"
+#include "ReBlocker.h"
+#include "StreamIngest.h"
+#include "MdctCodec.h"
 #include "CorelinkAudio.h"
 #include "ThreadSafeVar.h"
+#include "UdpBatchTransport.h"
 
 template<typename t> using in = corelink::in<t>;
 template<typename t> using out = corelink::out<t>;
 
-class CorelinkClient;
+class SharedCorelinkConnection;
 
 class SenderAudioProcessor  : public juce::AudioProcessor
                             #if JucePlugin_Enable_ARA
@@ -80,16 +111,13 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* mData, int sizeInBytes) override;
 
-    void onChannelInit(corelink::core::network::channel_id_type host_id);
-    void onChannelUninit(corelink::core::network::channel_id_type host_id);
-    void onError(corelink::core::network::channel_id_type host_id, in<std::string> err);
     void addOnSubscribeHandler(corelink::core::network::channel_id_type mControlChannelId,
                                                     out<corelink::client::corelink_classic_client> mClient);
 
     template<class T>
     void swapMove(T& a, T& b);
 
-    void sendData(juce::AudioBuffer<float> buffer, int mAudioBufferSize, std::vector<uint8_t> &mData, int numChannels);
+    void sendData(const AudioFrame& frame);
 
     void setAudioWorkspace(const juce::String& val);
     void setAudioStreamType(const juce::String& val);
@@ -97,6 +125,18 @@ public:
     void setHostId(const juce::String& val);
     void setBufferSize(const juce::String& val);
     void setVolume(float newVolume);
+    void setOverflowPolicy(OverflowPolicy policy);
+    void setSampleFormat(SampleFormat format);
+    void setDitherEnabled(bool enabled);
+    void setCodec(CodecId codec);
+    void setCodecBitrate(int bitrate);
+    bool setNetworkFrameDuration(double frameMs);
+    void setPathMtuProbingEnabled(bool enabled);
+    bool setFecCode(int numSourcePackets, int numRepairPackets);
+    void setReceiveMonitoringEnabled(bool enabled);
+    void setMaxLateRate(double rate);
+    void setDataPlane(DataPlane dataPlane);
+    bool setProbeConfig(const ProbeConfig& config);
 
     bool getStreamInit();
     juce::String getAudioWorkspace();
@@ -104,23 +144,48 @@ public:
     juce::String getHostId();
     int getBufferSize();
     float getVolume();
+    OverflowPolicy getOverflowPolicy() const;
+    SampleFormat getSampleFormat() const;
+    CodecId getCodec() const;
+    int getCodecBitrate() const;
+    DataPlane getDataPlane() const;
+    double getNetworkFrameDuration() const;
+    int getPathMtu() const;
+    int getFecSourcePackets() const;
+    int getFecRepairPackets() const;
+    uint64_t getNumDroppedFrames() const;
+    uint64_t getNumPacketPoolExhausted() const;
+    size_t getPacketPoolHighWaterMark() const;
 
     void createSender(const juce::String& workspace, const juce::String& stream_type);
     void createReceiver();
-    void setupControlChannel(const juce::String& hostId, const juce::String& username, const juce::String& password);
+    void subscribeToStream(int streamId);
+    StreamIngest& getStreamIngest();
+    int getNumPlayoutStreams() const;
+    bool getPlayoutStatus(int index, PlayoutSlots::StreamStatus& status) const;
+    double getMaxLateRate() const;
+    juce::String setupControlChannel(const juce::String& hostId, const juce::String& username, const juce::String& password);
 
     int32_t getAuthStatusCode();
     int32_t getCreateSenderStatusCode();
     bool getHandledAuth();
-    void waitForHandledAuth(bool);
-    void waitForMLoading(bool);
+    bool waitForHandledAuth(bool);
+    bool waitForMLoading(bool);
     bool getMLoading() const;
     void resetHandledAuth();
     void disconnectControlChannel();
     int getNMeasurement();
+    bool isProbingDone() const;
+    double getProbeJitterMs() const;
+    BandwidthEstimate getBandwidthEstimate() const;
+    const JitterStatistics& getProbeStatistics() const;
+    const ClockSync& getClockSync() const;
+    const EchoMonitor& getEchoMonitor() const;
+    unsigned getDataPlaneTimestamping() const;
+    const JitterStatistics* getReceiveStatistics(int index) const;
+    const JitterStatistics* getReceiveUserStatistics(int index) const;
     
     //Testing Methods
-    bool getMDone() const;
     bool doesCorelinkClientExist() const;
     double getAudioSampleRate() const;
     int getAudioBufferSize() const;
@@ -135,37 +200,104 @@ private:
     int32_t authStatusCode = 999;
     int32_t createSenderStatusCode = 999;
 
-    int mAudioBufferSize;
-    double mAudioSampleRate;
+    int mAudioBufferSize = 0;
+    double mAudioSampleRate = 48000.0;
+    int mMaxNetworkFrameSamples = 0;
+
+    void prepareCodec();
+    void mixReceivedStreams(juce::AudioBuffer<float>& buffer);
+    void releaseRetiredStreams();
+    uint64_t sendProbes(uint64_t nowNs);
+    void createProbeReceiver(const std::string& workspace);
+    void onStreamsAnnounced(const std::string& message);
+    void onProbeEcho();
 
-    ThreadSafeVar<bool> mDone;
     ThreadSafeVar<bool> mError; 
     ThreadSafeVar<bool> mLoading;
     ThreadSafeVar<bool> mStreamInit;
     ThreadSafeVar<bool> handledAuth;
     ThreadSafeVar<float> mVolume;
-    std::atomic<int> nMeasurement = 1;
-    std::atomic<int> mSenderStreamID; 
+    std::atomic<int> nMeasurement = 0;
+    std::atomic<int> mSenderStreamID { -1 };
     std::atomic<int> mReceiverStreamID = 0;
+    // Receives the echo of the jitter stream
+    std::atomic<int> mProbeReceiverStreamID { 0 };
+    // Data channel of this instance's sender on the shared connection
+    std::atomic<corelink::core::network::channel_id_type> mSenderHostId {};
 
 
     std::string mAudioWorkspace   = "ZackAudio";
     std::string mAudioStreamType  = "audiotesting";
     juce::String mCorelinkHostId   = "127.0.0.1";
-    int          mJitterBufferSize = 25;
+    // Minimum playout delay in ms for received streams
+    std::atomic<int> mJitterBufferSize { 25 };
 
-    int         mPacketCounter = 0;
+    uint64_t    mSequence = 0;
+    uint64_t    mCapturedSamples = 0;
 
     std::vector<uint8_t> mData;
 
+    AudioFrameRing mFrameRing;
+    ReBlocker mReBlocker;
+    std::atomic<double> mNetworkFrameMs { NETWORK_FRAME_MS };
+    // Shared, so packets still queued on the shared sender keep their pool alive after it is replaced
+    std::shared_ptr<PacketPool> mPacketPool = std::make_shared<PacketPool>();
+    // Nominal rate of the stream as last registered for pacing; sender thread
+    double mPacingRate = 0.0;
+    std::atomic<SampleFormat> mSampleFormat { SampleFormat::Float32 };
+    SampleFormat mStreamSampleFormat = SampleFormat::Float32;
+    std::atomic<bool> mDitherEnabled { true };
+    std::atomic<CodecId> mCodec { CodecId::Pcm };
+    std::atomic<int> mCodecBitrate { MDCT_DEFAULT_BITRATE };
+    std::unique_ptr<AudioCodec> mAudioCodec;
+    PathMtuProber mMtuProber;
+    // k << 8 | m, 0 when off; applied by the sender thread
+    std::atomic<int> mFecCode { 0 };
+    int mAppliedFecCode = 0;
+    FecEncoder mFecEncoder;
+    AudioSenderThread mSenderThread { mFrameRing, [this](const AudioFrame& frame) { sendData(frame); } };
+    // Same-host copy of the stream for local subscribers; opened and written by the sender thread
+    LocalStreamRing mLocalRing;
+    int mLocalRingStreamId = -1;
+    uint64_t mLocalRingScope = 0;
+    // Server and workspace of the sender's stream, set before mSenderStreamID
+    std::atomic<uint64_t> mSenderScope { 0 };
+
+    StreamIngest mStreamIngest;
+    // The network callback and the local ring readers both feed mStreamIngest
+    std::mutex mIngestLock;
+    // One playout buffer per ingest slot, in the format its stream announced; drained on the audio
+    // thread and prepared on the network threads
+    PlayoutSlots mPlayoutSlots;
+    LocalStreamReceiver mLocalReceiver { mStreamIngest, [this](int sourceStreamId, const uint8_t* data, size_t size, uint64_t arrivalNs) {
+        {
+            std::lock_guard<std::mutex> lock(mIngestLock);
+            mStreamIngest.ingest(sourceStreamId, data, size, arrivalNs);
+        }
+        mPlayoutSlots.update();
+    } };
+    ReceivedPacket mReceivedPacket;
+    juce::AudioBuffer<float> mPlayoutScratch;
+    std::atomic<bool> mReceiveMonitoring { false };
+    std::atomic<double> mMaxLateRate { PLAYOUT_DEFAULT_MAX_LATE_RATE };
+
     std::unique_ptr<JitterBuffer> mJitterBuffer;
+    // Round-trip probes and path-MTU probes both go out on the jitter stream from mProbeThread
+    ProbeEngine mProbeEngine;
+    std::shared_ptr<PacketPool> mProbePool = std::make_shared<PacketPool>();
+    JitterStatistics mProbeStatistics;
+    ClockSync mClockSync;
+    ProbeStreamHandler mProbeStreamHandler { mProbeEngine, mMtuProber, mClockSync, mProbeStatistics };
+    // Fed by the sender thread and the echoed copy of the stream
+    EchoMonitor mEchoMonitor;
+    ProbeThread mProbeThread { [this](uint64_t nowNs) { return sendProbes(nowNs); } };
     std::string mUsername;
-    juce::ThreadPool mThreadPool{4};
 
     std::atomic<float*> mjitterBuffer;
     juce::MemoryBlock mBlock;
 
     ProgressCallback progressCallback;
-    std::unique_ptr<CorelinkClient> mCorelinkClient;
+    // One control channel and network sender for every instance in the host
+    juce::SharedResourcePointer<SharedCorelinkConnection> mConnection;
 
 };
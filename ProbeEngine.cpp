@@ -0,0 +1,310 @@
+#include "ProbeEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace
+{
+    void writeU32(uint8_t* p, uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            p[i] = (uint8_t) (v >> (8 * i));
+    }
+
+    void writeU64(uint8_t* p, uint64_t v)
+    {
+        for (int i = 0; i < 8; ++i)
+            p[i] = (uint8_t) (v >> (8 * i));
+    }
+
+    uint32_t readU32(const uint8_t* p)
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= (uint32_t) p[i] << (8 * i);
+        return v;
+    }
+
+    uint64_t readU64(const uint8_t* p)
+    {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i)
+            v |= (uint64_t) p[i] << (8 * i);
+        return v;
+    }
+
+    constexpr uint64_t kNever = std::numeric_limits<uint64_t>::max();
+}
+
+bool ProbeConfig::isValid() const
+{
+    return numProbes > 0 && intervalMs > 0.0 && probeSize >= PROBE_HEADER_SIZE && probeSize <= PROBE_MAX_SIZE
+        && minEchoes >= 0 && toleranceMs >= 0.0 && window > 1
+        && trainLength >= 1 && trainLength <= PROBE_MAX_TRAIN_LENGTH
+        && (maxProbeSize == 0 || (maxProbeSize >= probeSize && maxProbeSize <= PROBE_MAX_SIZE));
+}
+
+/**
+ * @brief Size of every probe in the given train
+*/
+int ProbeConfig::getProbeSize(int train) const
+{
+    if (maxProbeSize <= probeSize)
+        return probeSize;
+    return probeSize + (maxProbeSize - probeSize) * (train % PROBE_SIZE_STEPS) / (PROBE_SIZE_STEPS - 1);
+}
+
+bool ProbeEngine::setConfig(const ProbeConfig& config)
+{
+    if (!config.isValid())
+        return false;
+
+    std::lock_guard<std::mutex> lock(mLock);
+    mConfig = config;
+    return true;
+}
+
+ProbeConfig ProbeEngine::getConfig() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mConfig;
+}
+
+/**
+ * @brief Starts a new run with the current config. The first probe is due immediately. Allocates
+*/
+void ProbeEngine::start(uint64_t nowNs)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    mBuffer.assign((size_t) std::max(mConfig.probeSize, mConfig.maxProbeSize), 0);
+    mEchoed.assign((size_t) mConfig.numProbes, false);
+    mHistory.assign((size_t) mConfig.window, 0.0);
+
+    mState = ProbeState::Probing;
+    // Every instance in the workspace sees the others' probes, so sessions start at a random point
+    if (mSession == 0)
+        mSession = std::random_device()();
+    ++mSession;
+    mFirstTrain += (mNumSent + mTrainLength - 1) / mTrainLength + 1;
+    mTrainLength = mConfig.trainLength;
+    mIntervalNs = (uint64_t) std::llround(mConfig.intervalMs * 1e6);
+    mNextDueNs = nowNs;
+    mLastSentNs = nowNs;
+    mNumSent = 0;
+    mNumEchoes = 0;
+
+    mHasRtt = false;
+    mLastRttNs = 0.0;
+    mMinRttNs = 0.0;
+    mTotalRttNs = 0.0;
+    mJitterNs = 0.0;
+    mTotalJitterNs = 0.0;
+}
+
+void ProbeEngine::stop()
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mState == ProbeState::Probing)
+        mState = ProbeState::Stopped;
+}
+
+ProbeState ProbeEngine::getState() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mState;
+}
+
+bool ProbeEngine::isDone() const
+{
+    const auto state = getState();
+    return state == ProbeState::Converged || state == ProbeState::Finished;
+}
+
+size_t ProbeEngine::poll(uint64_t nowNs, const uint8_t*& data)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mState != ProbeState::Probing)
+        return 0;
+
+    if (mNumSent == mConfig.numProbes)
+    {
+        // Everything is out: whatever has not come back by now is lost
+        if (nowNs >= mLastSentNs + (uint64_t) (PROBE_ECHO_TIMEOUT_MS * 1e6))
+            mState = ProbeState::Finished;
+        return 0;
+    }
+
+    if (nowNs < mNextDueNs)
+        return 0;
+
+    const int train = mNumSent / mTrainLength;
+    const bool endsTrain = mNumSent % mTrainLength == mTrainLength - 1;
+    writeU32(mBuffer.data() + 0, PROBE_MAGIC);
+    writeU32(mBuffer.data() + 4, mSession);
+    writeU32(mBuffer.data() + 8, (uint32_t) mNumSent);
+    writeU32(mBuffer.data() + 12, 0);
+    writeU64(mBuffer.data() + 16, nowNs);
+    ++mNumSent;
+    mLastSentNs = nowNs;
+
+    // The rest of a train is due at once. A late wakeup delays the following trains rather than
+    // sending a burst to catch up
+    if (endsTrain)
+        mNextDueNs = std::max(mNextDueNs, nowNs) + mIntervalNs;
+
+    data = mBuffer.data();
+    return (size_t) mConfig.getProbeSize(train);
+}
+
+uint64_t ProbeEngine::getNextDueNs() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mState != ProbeState::Probing)
+        return kNever;
+    if (mNumSent == mConfig.numProbes)
+        return mLastSentNs + (uint64_t) (PROBE_ECHO_TIMEOUT_MS * 1e6);
+    return mNextDueNs;
+}
+
+bool ProbeEngine::isProbe(const uint8_t* data, size_t size)
+{
+    return size >= PROBE_HEADER_SIZE && readU32(data) == PROBE_MAGIC;
+}
+
+bool ProbeEngine::isReply(const uint8_t* data, size_t size) const
+{
+    if (!isProbe(data, size) || (readU32(data + 12) & PROBE_FLAG_STAMPED) == 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mLock);
+    return readU32(data + 4) == mSession && readU32(data + 8) < (uint32_t) mNumSent;
+}
+
+bool ProbeEngine::stampReply(uint8_t* data, size_t size, uint64_t receiveNs, uint64_t transmitNs)
+{
+    if (!isProbe(data, size))
+        return false;
+
+    writeU32(data + 12, readU32(data + 12) | PROBE_FLAG_STAMPED);
+    writeU64(data + 24, receiveNs);
+    writeU64(data + 32, transmitNs);
+    return true;
+}
+
+bool ProbeEngine::getClockSample(const uint8_t* data, size_t size, uint64_t arrivalNs, ClockSample& sample)
+{
+    if (!isProbe(data, size) || (readU32(data + 12) & PROBE_FLAG_STAMPED) == 0)
+        return false;
+
+    sample.originNs = readU64(data + 16);
+    sample.receiveNs = readU64(data + 24);
+    sample.transmitNs = readU64(data + 32);
+    sample.destinationNs = arrivalNs;
+    return true;
+}
+
+bool ProbeEngine::onEcho(const uint8_t* data, size_t size, uint64_t arrivalNs)
+{
+    if (!isProbe(data, size))
+        return false;
+
+    std::lock_guard<std::mutex> lock(mLock);
+    const uint32_t index = readU32(data + 8);
+    const uint64_t sentNs = readU64(data + 16);
+    if (mState != ProbeState::Probing || readU32(data + 4) != mSession || index >= (uint32_t) mNumSent
+        || mEchoed[index] || arrivalNs < sentNs)
+        return false;
+    mEchoed[index] = true;
+
+    const double rtt = (double) (arrivalNs - sentNs);
+    if (mHasRtt)
+        mJitterNs += (std::abs(rtt - mLastRttNs) - mJitterNs) / 16.0;
+    mMinRttNs = mHasRtt ? std::min(mMinRttNs, rtt) : rtt;
+    mLastRttNs = rtt;
+    mTotalRttNs += rtt;
+    mHasRtt = true;
+    mTotalJitterNs += mJitterNs;
+    ++mNumEchoes;
+
+    // A stamped probe says when it reached the peer, which takes the return path out of the gradient
+    const bool stamped = (readU32(data + 12) & PROBE_FLAG_STAMPED) != 0;
+    mBandwidth.onProbe(mFirstTrain + (int) index / mTrainLength, size, sentNs, stamped ? readU64(data + 24) : arrivalNs, rtt, arrivalNs);
+    mHistory[(size_t) mNumEchoes % mHistory.size()] = mTotalJitterNs / mNumEchoes;
+
+    if (hasConverged())
+        mState = ProbeState::Converged;
+    else if (mNumEchoes == mConfig.numProbes)
+        mState = ProbeState::Finished;
+    return true;
+}
+
+/**
+ * @brief Whether the average jitter has stayed within the tolerance over the last window echoes
+*/
+bool ProbeEngine::hasConverged() const
+{
+    if (mConfig.toleranceMs <= 0.0 || mNumEchoes < std::max(mConfig.minEchoes, mConfig.window))
+        return false;
+
+    const auto [low, high] = std::minmax_element(mHistory.begin(), mHistory.end());
+    return *high - *low <= mConfig.toleranceMs * 1e6;
+}
+
+int ProbeEngine::getNumSent() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mNumSent;
+}
+
+int ProbeEngine::getNumEchoes() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mNumEchoes;
+}
+
+double ProbeEngine::getJitterMs() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mJitterNs / 1e6;
+}
+
+double ProbeEngine::getAverageJitterMs() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mNumEchoes == 0 ? 0.0 : mTotalJitterNs / mNumEchoes / 1e6;
+}
+
+double ProbeEngine::getMinRttMs() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mMinRttNs / 1e6;
+}
+
+double ProbeEngine::getMeanRttMs() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mNumEchoes == 0 ? 0.0 : mTotalRttNs / mNumEchoes / 1e6;
+}
+
+double ProbeEngine::getLastRttMs() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mLastRttNs / 1e6;
+}
+
+BandwidthEstimate ProbeEngine::getBandwidthEstimate() const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mBandwidth.getEstimate();
+}
+
+/**
+ * @brief Forgets what the estimator learned, e.g. after the route to the server changed
+*/
+void ProbeEngine::resetBandwidthEstimate()
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    mBandwidth.reset();
+}
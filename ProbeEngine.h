@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "BandwidthEstimator.h"
+#include "ClockSync.h"
+
+#define PROBE_MAGIC 0x50524F42
+#define PROBE_HEADER_SIZE 40
+#define PROBE_FLAG_STAMPED 0x1
+#define PROBE_MAX_SIZE 9000
+#define PROBE_DEFAULT_COUNT 1000
+#define PROBE_DEFAULT_INTERVAL_MS 5.0
+#define PROBE_DEFAULT_SIZE 1000
+#define PROBE_DEFAULT_MIN_ECHOES 100
+#define PROBE_DEFAULT_TOLERANCE_MS 0.05
+#define PROBE_DEFAULT_WINDOW 50
+#define PROBE_ECHO_TIMEOUT_MS 1000.0
+#define PROBE_MAX_TRAIN_LENGTH 64
+#define PROBE_SIZE_STEPS 4
+
+/**
+ * @brief How many probes to send, how fast and how large, and when to stop early
+ *
+ * Probing stops once minEchoes echoes are in and the average jitter has stayed within
+ * toleranceMs over the last window echoes. A tolerance of 0 always sends all numProbes.
+ *
+ * Every intervalMs a train of trainLength probes goes out back to back: 1 sends single probes,
+ * 2 packet pairs. With maxProbeSize above probeSize, successive trains step through
+ * PROBE_SIZE_STEPS sizes from probeSize to maxProbeSize. numProbes counts single probes.
+*/
+struct ProbeConfig
+{
+    int numProbes = PROBE_DEFAULT_COUNT;
+    double intervalMs = PROBE_DEFAULT_INTERVAL_MS;
+    int probeSize = PROBE_DEFAULT_SIZE;
+    int minEchoes = PROBE_DEFAULT_MIN_ECHOES;
+    double toleranceMs = PROBE_DEFAULT_TOLERANCE_MS;
+    int window = PROBE_DEFAULT_WINDOW;
+    int trainLength = 1;
+    // 0 sends every probe at probeSize
+    int maxProbeSize = 0;
+
+    bool isValid() const;
+    int getProbeSize(int train) const;
+};
+
+enum class ProbeState
+{
+    Idle,
+    Probing,
+    Converged,
+    Finished,
+    Stopped
+};
+
+/**
+ * @brief Round-trip probing of the echoed jitter stream
+ *
+ * Probes go out every intervalMs, in trains of trainLength, from a single preallocated buffer: a
+ * 40-byte header, padded with zeros to the train's size.
+ *
+ * Wire layout, little-endian:
+ *   0  magic (u32)   4  session (u32)   8  index (u32)   12  flags (u32)   16  sendTimeNs (u64)
+ *  24  receiveTimeNs (u64)   32  transmitTimeNs (u64)
+ *
+ * A plain reflector sends the probe back untouched. A peer that answers it with stampReply()
+ * fills in when it received and sent it back on its own clock and sets PROBE_FLAG_STAMPED, and
+ * getClockSample() then yields the four timestamps ClockSync needs.
+ *
+ * Echoes carry their own send time, so onEcho() needs no per-probe state beyond a bit that
+ * rejects duplicates. The session changes with every start(), so late echoes of an earlier run
+ * are ignored; the first one is random, so neither are the probes of other engines. The jitter is the RFC 3550 running estimate over successive round-trip times;
+ * its average over the run is what converges. Probing ends then, or once every probe has been
+ * answered or timed out after PROBE_ECHO_TIMEOUT_MS.
+ *
+ * Every echo also feeds a BandwidthEstimator, with the peer's receive stamp as the arrival time
+ * when the probe was stamped. Its estimate of available bandwidth and queuing delay carries on
+ * from run to run, so it can be read while no run is active.
+ *
+ * The engine does no timing of its own: the caller's thread calls poll() at getNextDueNs().
+ * poll() and onEcho() may be called from different threads. start() allocates; poll() and
+ * onEcho() do not.
+*/
+class ProbeEngine
+{
+public:
+    ProbeEngine() = default;
+
+    /** Used by the next start(); returns false and keeps the old one if config is invalid */
+    bool setConfig(const ProbeConfig& config);
+    ProbeConfig getConfig() const;
+
+    void start(uint64_t nowNs);
+    void stop();
+
+    ProbeState getState() const;
+    bool isProbing() const { return getState() == ProbeState::Probing; }
+    /** True once probing has converged or run its course */
+    bool isDone() const;
+
+    /** Returns the size of the probe due now, with data pointing at it, or 0 if none is due. The data stays valid until the next poll() */
+    size_t poll(uint64_t nowNs, const uint8_t*& data);
+    /** When poll() next has something to do, or UINT64_MAX if nothing is scheduled */
+    uint64_t getNextDueNs() const;
+
+    /** Takes an echoed datagram; returns false if it is not an echo of the current run */
+    bool onEcho(const uint8_t* data, size_t size, uint64_t arrivalNs);
+    static bool isProbe(const uint8_t* data, size_t size);
+    /** True for a peer's stamped answer to a probe of the current run */
+    bool isReply(const uint8_t* data, size_t size) const;
+    /** Responder side: stamps a received probe with its arrival and departure times before echoing it */
+    static bool stampReply(uint8_t* data, size_t size, uint64_t receiveNs, uint64_t transmitNs);
+    /** Reads the four timestamps of a stamped echo that arrived at arrivalNs */
+    static bool getClockSample(const uint8_t* data, size_t size, uint64_t arrivalNs, ClockSample& sample);
+
+    int getNumSent() const;
+    int getNumEchoes() const;
+    double getJitterMs() const;
+    double getAverageJitterMs() const;
+    double getMinRttMs() const;
+    double getMeanRttMs() const;
+    double getLastRttMs() const;
+
+    BandwidthEstimate getBandwidthEstimate() const;
+    void resetBandwidthEstimate();
+
+private:
+    bool hasConverged() const;
+
+    mutable std::mutex mLock;
+    ProbeConfig mConfig;
+    ProbeState mState = ProbeState::Idle;
+    uint32_t mSession = 0;
+
+    std::vector<uint8_t> mBuffer;
+    std::vector<bool> mEchoed;
+    // Average jitter after each of the last window echoes, oldest overwritten first
+    std::vector<double> mHistory;
+
+    int mTrainLength = 1;
+    uint64_t mIntervalNs = 0;
+    uint64_t mNextDueNs = 0;
+    uint64_t mLastSentNs = 0;
+    int mNumSent = 0;
+    int mNumEchoes = 0;
+
+    bool mHasRtt = false;
+    double mLastRttNs = 0.0;
+    double mMinRttNs = 0.0;
+    double mTotalRttNs = 0.0;
+    double mJitterNs = 0.0;
+    double mTotalJitterNs = 0.0;
+
+    BandwidthEstimator mBandwidth;
+    // Trains are numbered across runs, so the estimator sees one ordered sequence of groups
+    int mFirstTrain = 0;
+};
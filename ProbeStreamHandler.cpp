@@ -0,0 +1,92 @@
+#include "ProbeStreamHandler.h"
+
+#include "PacketHeader.h"
+
+#include <cmath>
+#include <cstring>
+
+ProbeStreamHandler::ProbeStreamHandler(ProbeEngine& engine, PathMtuProber& mtuProber, ClockSync& clock, JitterStatistics& statistics)
+    : mEngine(engine), mMtuProber(mtuProber), mClock(clock), mStatistics(statistics)
+{
+    mReply.resize(PROBE_MAX_SIZE);
+}
+
+void ProbeStreamHandler::setReplyCallback(ReplyCallback callback)
+{
+    mReplyCallback = std::move(callback);
+}
+
+ProbeRoute ProbeStreamHandler::onReceive(int ownStreamId, int sourceStreamId, const uint8_t* data, size_t size, uint64_t arrivalNs)
+{
+    if (ownStreamId <= 0)
+        return ProbeRoute::Ignored;
+
+    if (sourceStreamId != ownStreamId)
+    {
+        if (!ProbeEngine::isProbe(data, size))
+            return ProbeRoute::Ignored;
+
+        ClockSample sample;
+        if (ProbeEngine::getClockSample(data, size, arrivalNs, sample))
+            return onReply(ownStreamId, sourceStreamId, data, size, sample);
+        return answer(ownStreamId, sourceStreamId, data, size, arrivalNs);
+    }
+
+    if (const int probeSize = PathMtuProber::readProbe(data, size))
+    {
+        mMtuProber.onProbeEcho(probeSize);
+        return ProbeRoute::MtuEcho;
+    }
+
+    if (!mEngine.onEcho(data, size, arrivalNs))
+        return ProbeRoute::Ignored;
+
+    mStatistics.addRoundTrip((uint64_t) std::llround(mEngine.getLastRttMs() * 1.0e6), arrivalNs);
+    return ProbeRoute::Echo;
+}
+
+/**
+ * @brief Takes a peer's answer to one of our probes into the clock, if that peer is our reference
+*/
+ProbeRoute ProbeStreamHandler::onReply(int ownStreamId, int sourceStreamId, const uint8_t* data, size_t size, const ClockSample& sample)
+{
+    // Answers to other instances' probes reach us too
+    if (sourceStreamId > ownStreamId || !mEngine.isReply(data, size))
+        return ProbeRoute::Ignored;
+
+    if (mClockPeer < 0 || sourceStreamId < mClockPeer)
+    {
+        // A lower peer has turned up: what was learned about any other clock no longer applies
+        mClock.setReference(false);
+        mClock.reset();
+        mClockPeer = sourceStreamId;
+    }
+    else if (sourceStreamId != mClockPeer)
+    {
+        return ProbeRoute::Ignored;
+    }
+
+    if (!mClock.addSample(sample))
+        return ProbeRoute::Ignored;
+
+    const uint64_t arrivalNs = sample.destinationNs;
+    mStatistics.addDelay(StatisticsMetric::OutboundDelay, (int64_t) sample.receiveNs - (int64_t) mClock.toReferenceNs(sample.originNs), arrivalNs);
+    mStatistics.addDelay(StatisticsMetric::OneWayDelay, (int64_t) mClock.toReferenceNs(sample.destinationNs) - (int64_t) sample.transmitNs, arrivalNs);
+    return ProbeRoute::Reply;
+}
+
+/**
+ * @brief Stamps a copy of a peer's probe and sends it back, if that peer synchronizes to us
+*/
+ProbeRoute ProbeStreamHandler::answer(int ownStreamId, int sourceStreamId, const uint8_t* data, size_t size, uint64_t arrivalNs)
+{
+    if (sourceStreamId < ownStreamId || size > mReply.size() || !mReplyCallback)
+        return ProbeRoute::Ignored;
+
+    std::memcpy(mReply.data(), data, size);
+    ProbeEngine::stampReply(mReply.data(), size, arrivalNs, getMonotonicTimeNs());
+    if (mClockPeer < 0)
+        mClock.setReference(true);
+    mReplyCallback(mReply.data(), size);
+    return ProbeRoute::Answered;
+}
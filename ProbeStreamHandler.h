@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "ClockSync.h"
+#include "JitterStatistics.h"
+#include "PathMtuProber.h"
+#include "ProbeEngine.h"
+
+enum class ProbeRoute
+{
+    Ignored,
+    // An echo of one of our round-trip probes, taken by the probe engine
+    Echo,
+    // An echo of one of our path-MTU probes
+    MtuEcho,
+    // A peer's stamped answer to one of our round-trip probes, taken by the clock
+    Reply,
+    // A peer's round-trip probe, stamped and handed to the reply callback
+    Answered
+};
+
+/**
+ * @brief Routes what arrives on the jitter stream receiver
+ *
+ * The server echoes this instance's jitter stream back to it, next to the jitter streams of the
+ * other instances in the workspace. Echoes of our own round-trip probes go to the ProbeEngine,
+ * which also feeds its bandwidth estimate, and their round-trip times to the statistics. Echoes
+ * of our path-MTU probes go to the PathMtuProber.
+ *
+ * Each instance also answers the round-trip probes of the others: it stamps a copy with
+ * ProbeEngine::stampReply() and hands it to the reply callback, which sends it on its own jitter
+ * stream. A peer's answer to one of our probes is an NTP-style exchange for the ClockSync, and
+ * splits the round trip into its outbound and return delays for the statistics.
+ *
+ * All instances synchronize to one reference, the one with the lowest jitter stream id. Probes
+ * are only answered for higher ids, answers only taken from lower ones, and of those only from
+ * the lowest that has answered. An instance that answers probes without having such a peer
+ * itself is the reference.
+ *
+ * onReceive() is called from the receiver's network thread only and does not allocate.
+*/
+class ProbeStreamHandler
+{
+public:
+    // Sends a stamped answer on this instance's jitter stream
+    using ReplyCallback = std::function<void(const uint8_t* data, size_t size)>;
+
+    ProbeStreamHandler(ProbeEngine& engine, PathMtuProber& mtuProber, ClockSync& clock, JitterStatistics& statistics);
+
+    /** Must be set before the first onReceive() */
+    void setReplyCallback(ReplyCallback callback);
+
+    /** ownStreamId is this instance's jitter stream, 0 while it does not exist yet */
+    ProbeRoute onReceive(int ownStreamId, int sourceStreamId, const uint8_t* data, size_t size, uint64_t arrivalNs);
+
+private:
+    ProbeRoute onReply(int ownStreamId, int sourceStreamId, const uint8_t* data, size_t size, const ClockSample& sample);
+    ProbeRoute answer(int ownStreamId, int sourceStreamId, const uint8_t* data, size_t size, uint64_t arrivalNs);
+
+    ProbeEngine& mEngine;
+    PathMtuProber& mMtuProber;
+    ClockSync& mClock;
+    JitterStatistics& mStatistics;
+
+    ReplyCallback mReplyCallback;
+    std::vector<uint8_t> mReply;
+    // Jitter stream of the peer the clock is synchronized to, -1 while there is none
+    int mClockPeer = -1;
+};
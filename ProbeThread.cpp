@@ -0,0 +1,45 @@
+#include "ProbeThread.h"
+#include "PacketHeader.h"
+
+#include <cmath>
+
+ProbeThread::ProbeThread(TickCallback tick)
+    : juce::Thread("Corelink Probes"), mTick(std::move(tick))
+{
+}
+
+ProbeThread::~ProbeThread()
+{
+    stop();
+}
+
+void ProbeThread::start()
+{
+    if (!isThreadRunning())
+        startThread();
+}
+
+void ProbeThread::stop()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread(2000);
+}
+
+void ProbeThread::wake()
+{
+    notify();
+}
+
+void ProbeThread::run()
+{
+    while (!threadShouldExit())
+    {
+        const uint64_t nowNs = getMonotonicTimeNs();
+        const uint64_t nextNs = mTick(nowNs);
+        if (nextNs == UINT64_MAX)
+            wait(-1);
+        else if (nextNs > nowNs)
+            wait((int) std::ceil((double) (nextNs - nowNs) / 1e6));
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <cstdint>
+#include <functional>
+
+/**
+ * @brief Timer thread shared by everything that probes the network
+ *
+ * Each wakeup calls the tick callback with the current monotonic time; it sends whatever is due
+ * and returns when it next needs to run, UINT64_MAX to sleep until wake(). Probes are sent from
+ * here rather than from a pool job that sleeps between them.
+*/
+class ProbeThread : public juce::Thread
+{
+public:
+    using TickCallback = std::function<uint64_t(uint64_t nowNs)>;
+
+    explicit ProbeThread(TickCallback tick);
+    ~ProbeThread() override;
+
+    void start();
+    void stop();
+    /** Runs the tick now, e.g. after probing was started */
+    void wake();
+
+    void run() override;
+
+private:
+    TickCallback mTick;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ProbeThread)
+};
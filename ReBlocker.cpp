@@ -0,0 +1,110 @@
+#include "ReBlocker.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Length in samples of a network frame of frameMs milliseconds
+*/
+int ReBlocker::getFrameLength(double sampleRate, double frameMs)
+{
+    return std::max(1, (int) std::lround(sampleRate * frameMs / 1000.0));
+}
+
+/**
+ * @brief Allocates the partial-frame buffer. Must not be called while the audio thread is running
+*/
+void ReBlocker::prepare(int maxChannels, int maxFrameLength)
+{
+    mMaxChannels = maxChannels;
+    mMaxFrameLength = maxFrameLength;
+    mBuffer.assign((size_t) maxChannels * (size_t) maxFrameLength, 0.0f);
+    mFrameLength = std::min(mFrameLength > 0 ? mFrameLength : maxFrameLength, maxFrameLength);
+    reset();
+}
+
+void ReBlocker::reset()
+{
+    mNumChannels = 0;
+    mNumBuffered = 0;
+    mFramePosition = 0;
+}
+
+/**
+ * @brief Changes the frame length, pushing any partial frame first. Audio thread only
+*/
+void ReBlocker::setFrameLength(int numSamples, AudioFrameRing& ring)
+{
+    numSamples = std::clamp(numSamples, 1, std::max(mMaxFrameLength, 1));
+    if (numSamples == mFrameLength)
+        return;
+
+    flush(ring);
+    mFrameLength = numSamples;
+}
+
+/**
+ * @brief Pushes the partial frame, if any, as a short frame. Audio thread only
+*/
+void ReBlocker::flush(AudioFrameRing& ring)
+{
+    if (mNumBuffered == 0)
+        return;
+
+    const float* channels[kMaxChannels];
+    const int numChannels = std::min(mNumChannels, kMaxChannels);
+    for (int ch = 0; ch < numChannels; ++ch)
+        channels[ch] = mBuffer.data() + (size_t) ch * (size_t) mMaxFrameLength;
+
+    ring.push(channels, numChannels, mNumBuffered, mFramePosition);
+    mFramePosition += (uint64_t) mNumBuffered;
+    mNumBuffered = 0;
+}
+
+/**
+ * @brief Adds one host block and pushes every frame it completes. Audio thread only
+*/
+void ReBlocker::process(const float* const* channels, int numChannels, int numSamples, uint64_t samplePosition, AudioFrameRing& ring)
+{
+    numChannels = std::min({ numChannels, mMaxChannels, kMaxChannels });
+    if (mFrameLength == 0 || numChannels <= 0)
+        return;
+
+    if (numChannels != mNumChannels || samplePosition != mFramePosition + (uint64_t) mNumBuffered)
+    {
+        flush(ring);
+        mNumChannels = numChannels;
+        mFramePosition = samplePosition;
+    }
+
+    const float* frame[kMaxChannels];
+    int offset = 0;
+    while (offset < numSamples)
+    {
+        if (mNumBuffered == 0 && numSamples - offset >= mFrameLength)
+        {
+            // A whole frame is available in the host buffer; no need to stage it
+            for (int ch = 0; ch < numChannels; ++ch)
+                frame[ch] = channels[ch] + offset;
+            ring.push(frame, numChannels, mFrameLength, mFramePosition);
+            mFramePosition += (uint64_t) mFrameLength;
+            offset += mFrameLength;
+            continue;
+        }
+
+        const int count = std::min(numSamples - offset, mFrameLength - mNumBuffered);
+        for (int ch = 0; ch < numChannels; ++ch)
+            std::copy(channels[ch] + offset, channels[ch] + offset + count, mBuffer.begin() + (ptrdiff_t) ch * mMaxFrameLength + mNumBuffered);
+        mNumBuffered += count;
+        offset += count;
+
+        if (mNumBuffered == mFrameLength)
+        {
+            mNumBuffered = 0;
+            for (int ch = 0; ch < numChannels; ++ch)
+                frame[ch] = mBuffer.data() + (size_t) ch * (size_t) mMaxFrameLength;
+            ring.push(frame, numChannels, mFrameLength, mFramePosition);
+            mFramePosition += (uint64_t) mFrameLength;
+        }
+    }
+}
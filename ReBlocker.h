@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "AudioFrameRing.h"
+
+/**
+ * @brief Cuts host blocks of any size into fixed-length network frames
+ *
+ * Runs on the audio thread between processBlock and the frame ring. Samples are collected until
+ * a full frame is available and the frame is pushed with the position of its first sample, so
+ * frame k of a stream always starts at base + k * frameLength regardless of the host block size.
+ * When a whole frame is available in the host buffer it is pushed straight from there.
+ *
+ * A partial frame is only pushed when the stream is interrupted: on a position jump, a channel
+ * count change or a frame length change.
+*/
+class ReBlocker
+{
+public:
+    static constexpr int kMaxChannels = 64;
+
+    ReBlocker() = default;
+
+    static int getFrameLength(double sampleRate, double frameMs);
+
+    void prepare(int maxChannels, int maxFrameLength);
+    void reset();
+
+    void setFrameLength(int numSamples, AudioFrameRing& ring);
+    int getFrameLength() const { return mFrameLength; }
+    int getNumBuffered() const { return mNumBuffered; }
+
+    void process(const float* const* channels, int numChannels, int numSamples, uint64_t samplePosition, AudioFrameRing& ring);
+    void flush(AudioFrameRing& ring);
+
+private:
+    std::vector<float> mBuffer;
+    int mMaxChannels = 0;
+    int mMaxFrameLength = 0;
+    int mFrameLength = 0;
+    int mNumChannels = 0;
+    int mNumBuffered = 0;
+    uint64_t mFramePosition = 0;
+};
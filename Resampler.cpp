@@ -0,0 +1,164 @@
+#include "Resampler.h"
+
+#include "SampleConversion.h"
+
+#include <juce_core/juce_core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if JUCE_INTEL
+    #include <immintrin.h>
+    #if JUCE_MSVC
+        #define AVX2_TARGET
+    #else
+        #define AVX2_TARGET __attribute__((target("avx2")))
+    #endif
+#endif
+
+namespace
+{
+    constexpr int kHalfTaps = RESAMPLER_TAPS / 2;
+
+    double besselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // Splits position into the first input sample of the kernel, the phase and the fraction between phases
+    struct Tap
+    {
+        const float* src;
+        int phase;
+        float frac;
+    };
+
+    // Inlined into each kernel; positions are never negative, so truncation is floor and no libm call is needed
+    inline Tap locate(const float* src, double position)
+    {
+        const auto whole = (ptrdiff_t) position;
+        const double phase = (position - (double) whole) * RESAMPLER_PHASES;
+        const int p = std::min((int) phase, RESAMPLER_PHASES - 1);
+        return { src + whole - (kHalfTaps - 1), p, (float) (phase - p) };
+    }
+
+    void processScalar(const float* table, const float* src, double position, double ratio, float* dest, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto tap = locate(src, position + i * ratio);
+            const float* h0 = table + tap.phase * RESAMPLER_TAPS;
+            const float* h1 = h0 + RESAMPLER_TAPS;
+            float a = 0.0f, b = 0.0f;
+            for (int k = 0; k < RESAMPLER_TAPS; ++k)
+            {
+                a += h0[k] * tap.src[k];
+                b += h1[k] * tap.src[k];
+            }
+            dest[i] = a + tap.frac * (b - a);
+        }
+    }
+
+#if JUCE_INTEL
+    float horizontalSum(__m128 v)
+    {
+        v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 0x55));
+        return _mm_cvtss_f32(v);
+    }
+
+    void processSse2(const float* table, const float* src, double position, double ratio, float* dest, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto tap = locate(src, position + i * ratio);
+            const float* h0 = table + tap.phase * RESAMPLER_TAPS;
+            const float* h1 = h0 + RESAMPLER_TAPS;
+            auto a = _mm_setzero_ps();
+            auto b = _mm_setzero_ps();
+            for (int k = 0; k < RESAMPLER_TAPS; k += 4)
+            {
+                const auto x = _mm_loadu_ps(tap.src + k);
+                a = _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(h0 + k), x));
+                b = _mm_add_ps(b, _mm_mul_ps(_mm_loadu_ps(h1 + k), x));
+            }
+            const float sa = horizontalSum(a);
+            dest[i] = sa + tap.frac * (horizontalSum(b) - sa);
+        }
+    }
+
+    AVX2_TARGET void processAvx2(const float* table, const float* src, double position, double ratio, float* dest, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto tap = locate(src, position + i * ratio);
+            const float* h0 = table + tap.phase * RESAMPLER_TAPS;
+            const float* h1 = h0 + RESAMPLER_TAPS;
+            auto a = _mm256_setzero_ps();
+            auto b = _mm256_setzero_ps();
+            for (int k = 0; k < RESAMPLER_TAPS; k += 8)
+            {
+                const auto x = _mm256_loadu_ps(tap.src + k);
+                a = _mm256_add_ps(a, _mm256_mul_ps(_mm256_loadu_ps(h0 + k), x));
+                b = _mm256_add_ps(b, _mm256_mul_ps(_mm256_loadu_ps(h1 + k), x));
+            }
+            // Both sums at once, without leaving AVX code
+            auto sums = _mm_hadd_ps(_mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1)),
+                                    _mm_add_ps(_mm256_castps256_ps128(b), _mm256_extractf128_ps(b, 1)));
+            sums = _mm_hadd_ps(sums, sums);
+            const float sa = _mm_cvtss_f32(sums);
+            const float sb = _mm_cvtss_f32(_mm_shuffle_ps(sums, sums, 0x55));
+            dest[i] = sa + tap.frac * (sb - sa);
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Builds the kernel table; each phase is normalized to unity gain at DC
+*/
+void Resampler::prepare()
+{
+    mTable.assign((size_t) (RESAMPLER_PHASES + 1) * RESAMPLER_TAPS, 0.0f);
+    const double pi = 3.14159265358979323846;
+    const double norm = besselI0(RESAMPLER_KAISER_BETA);
+
+    for (int p = 0; p <= RESAMPLER_PHASES; ++p)
+    {
+        const double frac = (double) p / RESAMPLER_PHASES;
+        double sum = 0.0;
+        std::vector<double> kernel(RESAMPLER_TAPS);
+        for (int k = 0; k < RESAMPLER_TAPS; ++k)
+        {
+            // Distance of tap k from the interpolated position
+            const double x = (double) (k - (kHalfTaps - 1)) - frac;
+            const double arg = pi * RESAMPLER_CUTOFF * x;
+            const double sinc = std::abs(arg) < 1e-12 ? 1.0 : std::sin(arg) / arg;
+            const double r = x / kHalfTaps;
+            const double window = std::abs(r) >= 1.0 ? 0.0 : besselI0(RESAMPLER_KAISER_BETA * std::sqrt(1.0 - r * r)) / norm;
+            kernel[(size_t) k] = sinc * window;
+            sum += kernel[(size_t) k];
+        }
+        for (int k = 0; k < RESAMPLER_TAPS; ++k)
+            mTable[(size_t) (p * RESAMPLER_TAPS + k)] = (float) (kernel[(size_t) k] / sum);
+    }
+}
+
+void Resampler::process(const float* src, double position, double ratio, float* dest, int numSamples) const
+{
+#if JUCE_INTEL
+    const auto isa = SampleConversion::getIsa();
+    if (isa == SampleConversion::Isa::Avx2)
+        return processAvx2(mTable.data(), src, position, ratio, dest, numSamples);
+    if (isa == SampleConversion::Isa::Sse2)
+        return processSse2(mTable.data(), src, position, ratio, dest, numSamples);
+#endif
+    processScalar(mTable.data(), src, position, ratio, dest, numSamples);
+}
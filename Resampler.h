@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+#define RESAMPLER_TAPS 32
+#define RESAMPLER_PHASES 128
+#define RESAMPLER_CUTOFF 0.92
+#define RESAMPLER_KAISER_BETA 8.0
+
+/**
+ * @brief Polyphase windowed-sinc interpolator for ratios close to 1
+ *
+ * A table of RESAMPLER_PHASES + 1 Kaiser-windowed sinc kernels of RESAMPLER_TAPS taps covers
+ * one sample period; each output sample is the two neighbouring phases applied to the input
+ * and linearly interpolated by the remaining fraction. The ratio may change from call to call,
+ * which is what drift compensation needs. The dot products have SSE2 and AVX2 paths chosen
+ * with SampleConversion::getIsa().
+ *
+ * process() reads src from floor(position) - RESAMPLER_TAPS / 2 + 1 to
+ * floor(position + (numSamples - 1) * ratio) + RESAMPLER_TAPS / 2; position must not be
+ * negative. prepare() allocates the table; process() does not allocate.
+*/
+class Resampler
+{
+public:
+    Resampler() = default;
+
+    void prepare();
+
+    /** Writes numSamples interpolated at position, position + ratio, ... of src */
+    void process(const float* src, double position, double ratio, float* dest, int numSamples) const;
+
+    static constexpr int getNumTaps() { return RESAMPLER_TAPS; }
+
+private:
+    std::vector<float> mTable;
+};
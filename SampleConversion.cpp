@@ -0,0 +1,673 @@
+#include "SampleConversion.h"
+
+#include <juce_core/juce_core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if JUCE_INTEL
+    #include <immintrin.h>
+    #if JUCE_MSVC
+        #define AVX2_TARGET
+    #else
+        #define AVX2_TARGET __attribute__((target("avx2")))
+    #endif
+#endif
+
+namespace
+{
+    constexpr float kInt16Scale = 32768.0f;
+    constexpr float kInt24Scale = 8388608.0f;
+    constexpr float kUniformScale = 1.0f / 16777216.0f;
+
+    std::atomic<SampleConversion::Isa> activeIsa { SampleConversion::getBestIsa() };
+
+    //==============================================================================
+    // Scalar reference kernels
+
+    uint32_t xorshift(uint32_t& x)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return x;
+    }
+
+    float tpdf(uint32_t& state)
+    {
+        const float a = (float) (xorshift(state) >> 8) * kUniformScale;
+        const float b = (float) (xorshift(state) >> 8) * kUniformScale;
+        return a - b;
+    }
+
+    int32_t quantize(float x, float scale, float dither)
+    {
+        const float v = std::clamp(x * scale + dither, -scale, scale - 1.0f);
+        return (int32_t) std::lrintf(v);
+    }
+
+    void interleaveScalar(const float* const* src, int numChannels, int startFrame, int numFrames, float* dest)
+    {
+        for (int f = startFrame; f < numFrames; ++f)
+            for (int ch = 0; ch < numChannels; ++ch)
+                dest[(size_t) f * (size_t) numChannels + (size_t) ch] = src[ch][f];
+    }
+
+    void deinterleaveScalar(const float* src, int numChannels, int startFrame, int numFrames, float* const* dest)
+    {
+        for (int f = startFrame; f < numFrames; ++f)
+            for (int ch = 0; ch < numChannels; ++ch)
+                dest[ch][f] = src[(size_t) f * (size_t) numChannels + (size_t) ch];
+    }
+
+    void floatToInt16Scalar(const float* src, uint8_t* dest, size_t start, size_t numSamples, Dither* dither)
+    {
+        for (size_t i = start; i < numSamples; ++i)
+        {
+            const float d = dither != nullptr ? tpdf(dither->state[i & 7]) : 0.0f;
+            const auto v = (uint32_t) quantize(src[i], kInt16Scale, d);
+            dest[2 * i] = (uint8_t) v;
+            dest[2 * i + 1] = (uint8_t) (v >> 8);
+        }
+    }
+
+    void floatToInt24Scalar(const float* src, uint8_t* dest, size_t start, size_t numSamples, Dither* dither)
+    {
+        for (size_t i = start; i < numSamples; ++i)
+        {
+            const float d = dither != nullptr ? tpdf(dither->state[i & 7]) : 0.0f;
+            const auto v = (uint32_t) quantize(src[i], kInt24Scale, d);
+            dest[3 * i] = (uint8_t) v;
+            dest[3 * i + 1] = (uint8_t) (v >> 8);
+            dest[3 * i + 2] = (uint8_t) (v >> 16);
+        }
+    }
+
+    void int16ToFloatScalar(const uint8_t* src, float* dest, size_t start, size_t numSamples)
+    {
+        for (size_t i = start; i < numSamples; ++i)
+            dest[i] = (float) (int16_t) (src[2 * i] | (src[2 * i + 1] << 8)) * (1.0f / kInt16Scale);
+    }
+
+    void int24ToFloatScalar(const uint8_t* src, float* dest, size_t start, size_t numSamples)
+    {
+        for (size_t i = start; i < numSamples; ++i)
+        {
+            const auto v = (int32_t) ((uint32_t) src[3 * i] << 8 | (uint32_t) src[3 * i + 1] << 16 | (uint32_t) src[3 * i + 2] << 24) >> 8;
+            dest[i] = (float) v * (1.0f / kInt24Scale);
+        }
+    }
+
+#if JUCE_INTEL
+    //==============================================================================
+    // SSE2
+
+    __m128 uniformSse2(__m128i& state)
+    {
+        state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+        state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+        state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+        return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(state, 8)), _mm_set1_ps(kUniformScale));
+    }
+
+    __m128 tpdfSse2(__m128i& state)
+    {
+        const auto a = uniformSse2(state);
+        return _mm_sub_ps(a, uniformSse2(state));
+    }
+
+    __m128i quantizeSse2(const float* src, float scale, __m128i* ditherState)
+    {
+        auto v = _mm_mul_ps(_mm_loadu_ps(src), _mm_set1_ps(scale));
+        if (ditherState != nullptr)
+            v = _mm_add_ps(v, tpdfSse2(*ditherState));
+        v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-scale)), _mm_set1_ps(scale - 1.0f));
+        return _mm_cvtps_epi32(v);
+    }
+
+    int interleaveSse2(const float* const* src, int numChannels, int numFrames, float* dest)
+    {
+        const int vectorFrames = numFrames & ~3;
+
+        if (numChannels == 2)
+        {
+            for (int f = 0; f < vectorFrames; f += 4)
+            {
+                const auto l = _mm_loadu_ps(src[0] + f);
+                const auto r = _mm_loadu_ps(src[1] + f);
+                _mm_storeu_ps(dest + 2 * f, _mm_unpacklo_ps(l, r));
+                _mm_storeu_ps(dest + 2 * f + 4, _mm_unpackhi_ps(l, r));
+            }
+            return vectorFrames;
+        }
+
+        if (numChannels % 4 != 0)
+            return 0;
+
+        for (int cg = 0; cg < numChannels; cg += 4)
+        {
+            for (int f = 0; f < vectorFrames; f += 4)
+            {
+                auto r0 = _mm_loadu_ps(src[cg] + f);
+                auto r1 = _mm_loadu_ps(src[cg + 1] + f);
+                auto r2 = _mm_loadu_ps(src[cg + 2] + f);
+                auto r3 = _mm_loadu_ps(src[cg + 3] + f);
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                float* d = dest + (size_t) f * (size_t) numChannels + (size_t) cg;
+                _mm_storeu_ps(d, r0);
+                _mm_storeu_ps(d + numChannels, r1);
+                _mm_storeu_ps(d + 2 * numChannels, r2);
+                _mm_storeu_ps(d + 3 * numChannels, r3);
+            }
+        }
+        return vectorFrames;
+    }
+
+    int deinterleaveSse2(const float* src, int numChannels, int numFrames, float* const* dest)
+    {
+        const int vectorFrames = numFrames & ~3;
+
+        if (numChannels == 2)
+        {
+            for (int f = 0; f < vectorFrames; f += 4)
+            {
+                const auto a = _mm_loadu_ps(src + 2 * f);
+                const auto b = _mm_loadu_ps(src + 2 * f + 4);
+                _mm_storeu_ps(dest[0] + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+                _mm_storeu_ps(dest[1] + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+            }
+            return vectorFrames;
+        }
+
+        if (numChannels % 4 != 0)
+            return 0;
+
+        for (int cg = 0; cg < numChannels; cg += 4)
+        {
+            for (int f = 0; f < vectorFrames; f += 4)
+            {
+                const float* s = src + (size_t) f * (size_t) numChannels + (size_t) cg;
+                auto r0 = _mm_loadu_ps(s);
+                auto r1 = _mm_loadu_ps(s + numChannels);
+                auto r2 = _mm_loadu_ps(s + 2 * numChannels);
+                auto r3 = _mm_loadu_ps(s + 3 * numChannels);
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                _mm_storeu_ps(dest[cg] + f, r0);
+                _mm_storeu_ps(dest[cg + 1] + f, r1);
+                _mm_storeu_ps(dest[cg + 2] + f, r2);
+                _mm_storeu_ps(dest[cg + 3] + f, r3);
+            }
+        }
+        return vectorFrames;
+    }
+
+    size_t floatToInt16Sse2(const float* src, uint8_t* dest, size_t numSamples, Dither* dither)
+    {
+        __m128i state = _mm_loadu_si128((const __m128i*) dither->state);
+        __m128i* statePtr = dither->enabled ? &state : nullptr;
+
+        size_t i = 0;
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const auto a = quantizeSse2(src + i, kInt16Scale, statePtr);
+            const auto b = quantizeSse2(src + i + 4, kInt16Scale, statePtr);
+            _mm_storeu_si128((__m128i*) (dest + 2 * i), _mm_packs_epi32(a, b));
+        }
+
+        _mm_storeu_si128((__m128i*) dither->state, state);
+        return i;
+    }
+
+    size_t floatToInt24Sse2(const float* src, uint8_t* dest, size_t numSamples, Dither* dither)
+    {
+        __m128i state = _mm_loadu_si128((const __m128i*) dither->state);
+        __m128i* statePtr = dither->enabled ? &state : nullptr;
+
+        size_t i = 0;
+        alignas(16) int32_t tmp[4];
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            _mm_store_si128((__m128i*) tmp, quantizeSse2(src + i, kInt24Scale, statePtr));
+            for (int k = 0; k < 4; ++k)
+            {
+                uint8_t* d = dest + 3 * (i + (size_t) k);
+                d[0] = (uint8_t) tmp[k];
+                d[1] = (uint8_t) (tmp[k] >> 8);
+                d[2] = (uint8_t) (tmp[k] >> 16);
+            }
+        }
+
+        _mm_storeu_si128((__m128i*) dither->state, state);
+        return i;
+    }
+
+    size_t int16ToFloatSse2(const uint8_t* src, float* dest, size_t numSamples)
+    {
+        const auto scale = _mm_set1_ps(1.0f / kInt16Scale);
+        size_t i = 0;
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const auto v = _mm_loadu_si128((const __m128i*) (src + 2 * i));
+            const auto lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            const auto hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+            _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+            _mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+        }
+        return i;
+    }
+
+    //==============================================================================
+    // AVX2
+
+    AVX2_TARGET __m256 uniformAvx2(__m256i& state)
+    {
+        state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 13));
+        state = _mm256_xor_si256(state, _mm256_srli_epi32(state, 17));
+        state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 5));
+        return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(state, 8)), _mm256_set1_ps(kUniformScale));
+    }
+
+    AVX2_TARGET __m256 tpdfAvx2(__m256i& state)
+    {
+        const auto a = uniformAvx2(state);
+        return _mm256_sub_ps(a, uniformAvx2(state));
+    }
+
+    AVX2_TARGET __m256i quantizeAvx2(const float* src, float scale, __m256i* ditherState)
+    {
+        auto v = _mm256_mul_ps(_mm256_loadu_ps(src), _mm256_set1_ps(scale));
+        if (ditherState != nullptr)
+            v = _mm256_add_ps(v, tpdfAvx2(*ditherState));
+        v = _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(-scale)), _mm256_set1_ps(scale - 1.0f));
+        return _mm256_cvtps_epi32(v);
+    }
+
+    AVX2_TARGET void transpose8x8(__m256& r0, __m256& r1, __m256& r2, __m256& r3, __m256& r4, __m256& r5, __m256& r6, __m256& r7)
+    {
+        const auto t0 = _mm256_unpacklo_ps(r0, r1);
+        const auto t1 = _mm256_unpackhi_ps(r0, r1);
+        const auto t2 = _mm256_unpacklo_ps(r2, r3);
+        const auto t3 = _mm256_unpackhi_ps(r2, r3);
+        const auto t4 = _mm256_unpacklo_ps(r4, r5);
+        const auto t5 = _mm256_unpackhi_ps(r4, r5);
+        const auto t6 = _mm256_unpacklo_ps(r6, r7);
+        const auto t7 = _mm256_unpackhi_ps(r6, r7);
+        const auto s0 = _mm256_shuffle_ps(t0, t2, 0x44);
+        const auto s1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+        const auto s2 = _mm256_shuffle_ps(t1, t3, 0x44);
+        const auto s3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+        const auto s4 = _mm256_shuffle_ps(t4, t6, 0x44);
+        const auto s5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+        const auto s6 = _mm256_shuffle_ps(t5, t7, 0x44);
+        const auto s7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+        r0 = _mm256_permute2f128_ps(s0, s4, 0x20);
+        r1 = _mm256_permute2f128_ps(s1, s5, 0x20);
+        r2 = _mm256_permute2f128_ps(s2, s6, 0x20);
+        r3 = _mm256_permute2f128_ps(s3, s7, 0x20);
+        r4 = _mm256_permute2f128_ps(s0, s4, 0x31);
+        r5 = _mm256_permute2f128_ps(s1, s5, 0x31);
+        r6 = _mm256_permute2f128_ps(s2, s6, 0x31);
+        r7 = _mm256_permute2f128_ps(s3, s7, 0x31);
+    }
+
+    AVX2_TARGET int interleaveAvx2(const float* const* src, int numChannels, int numFrames, float* dest)
+    {
+        const int vectorFrames = numFrames & ~7;
+
+        if (numChannels == 2)
+        {
+            for (int f = 0; f < vectorFrames; f += 8)
+            {
+                const auto l = _mm256_loadu_ps(src[0] + f);
+                const auto r = _mm256_loadu_ps(src[1] + f);
+                const auto lo = _mm256_unpacklo_ps(l, r);
+                const auto hi = _mm256_unpackhi_ps(l, r);
+                _mm256_storeu_ps(dest + 2 * f, _mm256_permute2f128_ps(lo, hi, 0x20));
+                _mm256_storeu_ps(dest + 2 * f + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+            }
+            return vectorFrames;
+        }
+
+        if (numChannels % 8 != 0)
+            return interleaveSse2(src, numChannels, numFrames, dest);
+
+        for (int cg = 0; cg < numChannels; cg += 8)
+        {
+            for (int f = 0; f < vectorFrames; f += 8)
+            {
+                auto r0 = _mm256_loadu_ps(src[cg] + f);
+                auto r1 = _mm256_loadu_ps(src[cg + 1] + f);
+                auto r2 = _mm256_loadu_ps(src[cg + 2] + f);
+                auto r3 = _mm256_loadu_ps(src[cg + 3] + f);
+                auto r4 = _mm256_loadu_ps(src[cg + 4] + f);
+                auto r5 = _mm256_loadu_ps(src[cg + 5] + f);
+                auto r6 = _mm256_loadu_ps(src[cg + 6] + f);
+                auto r7 = _mm256_loadu_ps(src[cg + 7] + f);
+                transpose8x8(r0, r1, r2, r3, r4, r5, r6, r7);
+                float* d = dest + (size_t) f * (size_t) numChannels + (size_t) cg;
+                _mm256_storeu_ps(d, r0);
+                _mm256_storeu_ps(d + numChannels, r1);
+                _mm256_storeu_ps(d + 2 * numChannels, r2);
+                _mm256_storeu_ps(d + 3 * numChannels, r3);
+                _mm256_storeu_ps(d + 4 * numChannels, r4);
+                _mm256_storeu_ps(d + 5 * numChannels, r5);
+                _mm256_storeu_ps(d + 6 * numChannels, r6);
+                _mm256_storeu_ps(d + 7 * numChannels, r7);
+            }
+        }
+        return vectorFrames;
+    }
+
+    AVX2_TARGET int deinterleaveAvx2(const float* src, int numChannels, int numFrames, float* const* dest)
+    {
+        const int vectorFrames = numFrames & ~7;
+
+        if (numChannels == 2)
+        {
+            for (int f = 0; f < vectorFrames; f += 8)
+            {
+                const auto a = _mm256_loadu_ps(src + 2 * f);
+                const auto b = _mm256_loadu_ps(src + 2 * f + 8);
+                const auto lo = _mm256_permute2f128_ps(a, b, 0x20);
+                const auto hi = _mm256_permute2f128_ps(a, b, 0x31);
+                _mm256_storeu_ps(dest[0] + f, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+                _mm256_storeu_ps(dest[1] + f, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+            }
+            return vectorFrames;
+        }
+
+        if (numChannels % 8 != 0)
+            return deinterleaveSse2(src, numChannels, numFrames, dest);
+
+        for (int cg = 0; cg < numChannels; cg += 8)
+        {
+            for (int f = 0; f < vectorFrames; f += 8)
+            {
+                const float* s = src + (size_t) f * (size_t) numChannels + (size_t) cg;
+                auto r0 = _mm256_loadu_ps(s);
+                auto r1 = _mm256_loadu_ps(s + numChannels);
+                auto r2 = _mm256_loadu_ps(s + 2 * numChannels);
+                auto r3 = _mm256_loadu_ps(s + 3 * numChannels);
+                auto r4 = _mm256_loadu_ps(s + 4 * numChannels);
+                auto r5 = _mm256_loadu_ps(s + 5 * numChannels);
+                auto r6 = _mm256_loadu_ps(s + 6 * numChannels);
+                auto r7 = _mm256_loadu_ps(s + 7 * numChannels);
+                transpose8x8(r0, r1, r2, r3, r4, r5, r6, r7);
+                _mm256_storeu_ps(dest[cg] + f, r0);
+                _mm256_storeu_ps(dest[cg + 1] + f, r1);
+                _mm256_storeu_ps(dest[cg + 2] + f, r2);
+                _mm256_storeu_ps(dest[cg + 3] + f, r3);
+                _mm256_storeu_ps(dest[cg + 4] + f, r4);
+                _mm256_storeu_ps(dest[cg + 5] + f, r5);
+                _mm256_storeu_ps(dest[cg + 6] + f, r6);
+                _mm256_storeu_ps(dest[cg + 7] + f, r7);
+            }
+        }
+        return vectorFrames;
+    }
+
+    AVX2_TARGET size_t floatToInt16Avx2(const float* src, uint8_t* dest, size_t numSamples, Dither* dither)
+    {
+        __m256i state = _mm256_loadu_si256((const __m256i*) dither->state);
+        __m256i* statePtr = dither->enabled ? &state : nullptr;
+
+        size_t i = 0;
+        for (; i + 16 <= numSamples; i += 16)
+        {
+            const auto a = quantizeAvx2(src + i, kInt16Scale, statePtr);
+            const auto b = quantizeAvx2(src + i + 8, kInt16Scale, statePtr);
+            // packs works per 128-bit lane, so restore sample order afterwards
+            const auto packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+            _mm256_storeu_si256((__m256i*) (dest + 2 * i), packed);
+        }
+
+        _mm256_storeu_si256((__m256i*) dither->state, state);
+        return i;
+    }
+
+    AVX2_TARGET size_t floatToInt24Avx2(const float* src, uint8_t* dest, size_t numSamples, Dither* dither)
+    {
+        __m256i state = _mm256_loadu_si256((const __m256i*) dither->state);
+        __m256i* statePtr = dither->enabled ? &state : nullptr;
+
+        const auto mask = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                           0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+        // Each step writes 28 bytes for 24 bytes of samples, so stop while the overspill still
+        // lands inside samples that are written afterwards
+        size_t i = 0;
+        for (; i + 10 <= numSamples; i += 8)
+        {
+            const auto packed = _mm256_shuffle_epi8(quantizeAvx2(src + i, kInt24Scale, statePtr), mask);
+            _mm_storeu_si128((__m128i*) (dest + 3 * i), _mm256_castsi256_si128(packed));
+            _mm_storeu_si128((__m128i*) (dest + 3 * i + 12), _mm256_extracti128_si256(packed, 1));
+        }
+
+        _mm256_storeu_si256((__m256i*) dither->state, state);
+        return i;
+    }
+
+    AVX2_TARGET size_t int16ToFloatAvx2(const uint8_t* src, float* dest, size_t numSamples)
+    {
+        const auto scale = _mm256_set1_ps(1.0f / kInt16Scale);
+        size_t i = 0;
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const auto v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (src + 2 * i)));
+            _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+        }
+        return i;
+    }
+
+    AVX2_TARGET size_t int24ToFloatAvx2(const uint8_t* src, float* dest, size_t numSamples)
+    {
+        const auto scale = _mm256_set1_ps(1.0f / kInt24Scale);
+        const auto mask = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                           -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+
+        // Reads 28 bytes per 24 bytes of samples, so leave room at the end of the buffer
+        size_t i = 0;
+        for (; i + 10 <= numSamples; i += 8)
+        {
+            const auto lo = _mm_loadu_si128((const __m128i*) (src + 3 * i));
+            const auto hi = _mm_loadu_si128((const __m128i*) (src + 3 * i + 12));
+            const auto bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            const auto v = _mm256_srai_epi32(_mm256_shuffle_epi8(bytes, mask), 8);
+            _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+        }
+        return i;
+    }
+#endif
+}
+
+//==============================================================================
+Dither::Dither(uint32_t seed)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        state[i] = seed != 0 ? seed : 1u;
+    }
+}
+
+/**
+ * @brief Returns the widest instruction set this CPU supports
+*/
+SampleConversion::Isa SampleConversion::getBestIsa()
+{
+#if JUCE_INTEL
+    if (juce::SystemStats::hasAVX2())
+        return Isa::Avx2;
+    if (juce::SystemStats::hasSSE2())
+        return Isa::Sse2;
+#endif
+    return Isa::Scalar;
+}
+
+SampleConversion::Isa SampleConversion::getIsa()
+{
+    return activeIsa.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Forces a kernel set, e.g. for benchmarking. Requests beyond what the CPU supports are clamped
+*/
+void SampleConversion::setIsa(Isa isa)
+{
+    activeIsa.store(std::min(isa, getBestIsa()), std::memory_order_relaxed);
+}
+
+size_t SampleConversion::getBytesPerSample(SampleFormat format)
+{
+    switch (format)
+    {
+        case SampleFormat::Int16:
+            return 2;
+        case SampleFormat::Int24:
+            return 3;
+        case SampleFormat::Float32:
+        default:
+            return 4;
+    }
+}
+
+void SampleConversion::interleave(const float* const* src, int numChannels, int numFrames, float* dest)
+{
+    int done = 0;
+#if JUCE_INTEL
+    const auto isa = getIsa();
+    if (isa == Isa::Avx2)
+        done = interleaveAvx2(src, numChannels, numFrames, dest);
+    else if (isa == Isa::Sse2)
+        done = interleaveSse2(src, numChannels, numFrames, dest);
+#endif
+    interleaveScalar(src, numChannels, done, numFrames, dest);
+}
+
+void SampleConversion::deinterleave(const float* src, int numChannels, int numFrames, float* const* dest)
+{
+    int done = 0;
+#if JUCE_INTEL
+    const auto isa = getIsa();
+    if (isa == Isa::Avx2)
+        done = deinterleaveAvx2(src, numChannels, numFrames, dest);
+    else if (isa == Isa::Sse2)
+        done = deinterleaveSse2(src, numChannels, numFrames, dest);
+#endif
+    deinterleaveScalar(src, numChannels, done, numFrames, dest);
+}
+
+/**
+ * @brief Quantizes to 16-bit little-endian PCM, adding TPDF dither when dither is enabled
+*/
+void SampleConversion::floatToInt16(const float* src, uint8_t* dest, size_t numSamples, Dither* dither)
+{
+    size_t done = 0;
+    Dither none;
+    none.enabled = false;
+    auto* d = dither != nullptr ? dither : &none;
+#if JUCE_INTEL
+    const auto isa = getIsa();
+    if (isa == Isa::Avx2)
+        done = floatToInt16Avx2(src, dest, numSamples, d);
+    else if (isa == Isa::Sse2)
+        done = floatToInt16Sse2(src, dest, numSamples, d);
+#endif
+    floatToInt16Scalar(src, dest, done, numSamples, d->enabled ? d : nullptr);
+}
+
+/**
+ * @brief Quantizes to packed 24-bit little-endian PCM, adding TPDF dither when dither is enabled
+*/
+void SampleConversion::floatToInt24(const float* src, uint8_t* dest, size_t numSamples, Dither* dither)
+{
+    size_t done = 0;
+    Dither none;
+    none.enabled = false;
+    auto* d = dither != nullptr ? dither : &none;
+#if JUCE_INTEL
+    const auto isa = getIsa();
+    if (isa == Isa::Avx2)
+        done = floatToInt24Avx2(src, dest, numSamples, d);
+    else if (isa == Isa::Sse2)
+        done = floatToInt24Sse2(src, dest, numSamples, d);
+#endif
+    floatToInt24Scalar(src, dest, done, numSamples, d->enabled ? d : nullptr);
+}
+
+void SampleConversion::int16ToFloat(const uint8_t* src, float* dest, size_t numSamples)
+{
+    size_t done = 0;
+#if JUCE_INTEL
+    const auto isa = getIsa();
+    if (isa == Isa::Avx2)
+        done = int16ToFloatAvx2(src, dest, numSamples);
+    else if (isa == Isa::Sse2)
+        done = int16ToFloatSse2(src, dest, numSamples);
+#endif
+    int16ToFloatScalar(src, dest, done, numSamples);
+}
+
+void SampleConversion::int24ToFloat(const uint8_t* src, float* dest, size_t numSamples)
+{
+    size_t done = 0;
+#if JUCE_INTEL
+    if (getIsa() == Isa::Avx2)
+        done = int24ToFloatAvx2(src, dest, numSamples);
+#endif
+    int24ToFloatScalar(src, dest, done, numSamples);
+}
+
+/**
+ * @brief Interleaves and quantizes a planar block into dest. Returns the payload size in bytes
+ *
+ * scratch must hold numChannels * numFrames floats; it is not needed for Float32.
+*/
+size_t SampleConversion::pack(const float* const* src, int numChannels, int numFrames, SampleFormat format, Dither* dither, float* scratch, uint8_t* dest)
+{
+    const auto numSamples = (size_t) numChannels * (size_t) numFrames;
+
+    switch (format)
+    {
+        case SampleFormat::Int16:
+            interleave(src, numChannels, numFrames, scratch);
+            floatToInt16(scratch, dest, numSamples, dither);
+            break;
+        case SampleFormat::Int24:
+            interleave(src, numChannels, numFrames, scratch);
+            floatToInt24(scratch, dest, numSamples, dither);
+            break;
+        case SampleFormat::Float32:
+        default:
+            // Payload is little-endian, which every supported host already is
+            interleave(src, numChannels, numFrames, reinterpret_cast<float*>(dest));
+            break;
+    }
+
+    return numSamples * getBytesPerSample(format);
+}
+
+/**
+ * @brief Inverse of pack(): dequantizes and deinterleaves a payload into planar buffers
+*/
+void SampleConversion::unpack(const uint8_t* src, int numChannels, int numFrames, SampleFormat format, float* scratch, float* const* dest)
+{
+    const auto numSamples = (size_t) numChannels * (size_t) numFrames;
+
+    switch (format)
+    {
+        case SampleFormat::Int16:
+            int16ToFloat(src, scratch, numSamples);
+            deinterleave(scratch, numChannels, numFrames, dest);
+            break;
+        case SampleFormat::Int24:
+            int24ToFloat(src, scratch, numSamples);
+            deinterleave(scratch, numChannels, numFrames, dest);
+            break;
+        case SampleFormat::Float32:
+        default:
+            deinterleave(reinterpret_cast<const float*>(src), numChannels, numFrames, dest);
+            break;
+    }
+}
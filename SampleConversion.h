@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "PacketHeader.h"
+
+/**
+ * @brief Per-stream state for the TPDF dither generator (one xorshift lane per SIMD lane)
+*/
+struct Dither
+{
+    explicit Dither(uint32_t seed = 0x9e3779b9u);
+
+    bool enabled = true;
+    uint32_t state[8];
+};
+
+/**
+ * @brief Vectorised kernels that turn planar float blocks into packet payloads and back
+ *
+ * Payload samples are interleaved and little-endian. Every kernel has SSE2 and AVX2 paths
+ * chosen at runtime, with a scalar fallback for other CPUs and channel counts.
+*/
+struct SampleConversion
+{
+    enum class Isa
+    {
+        Scalar,
+        Sse2,
+        Avx2
+    };
+
+    static Isa getBestIsa();
+    static Isa getIsa();
+    static void setIsa(Isa isa);
+
+    static size_t getBytesPerSample(SampleFormat format);
+
+    static void interleave(const float* const* src, int numChannels, int numFrames, float* dest);
+    static void deinterleave(const float* src, int numChannels, int numFrames, float* const* dest);
+
+    static void floatToInt16(const float* src, uint8_t* dest, size_t numSamples, Dither* dither);
+    static void floatToInt24(const float* src, uint8_t* dest, size_t numSamples, Dither* dither);
+    static void int16ToFloat(const uint8_t* src, float* dest, size_t numSamples);
+    static void int24ToFloat(const uint8_t* src, float* dest, size_t numSamples);
+
+    static size_t pack(const float* const* src, int numChannels, int numFrames, SampleFormat format, Dither* dither, float* scratch, uint8_t* dest);
+    static void unpack(const uint8_t* src, int numChannels, int numFrames, SampleFormat format, float* scratch, float* const* dest);
+};
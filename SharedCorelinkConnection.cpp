@@ -0,0 +1,361 @@
+#include "SharedCorelinkConnection.h"
+
+#include "PacketHeader.h"
+#include "PathMtuProber.h"
+
+#include <algorithm>
+#include <thread>
+
+SharedCorelinkConnection::SendThread::SendThread(SharedCorelinkConnection& owner)
+    : juce::Thread("Corelink Shared Sender"), mOwner(owner)
+{
+}
+
+void SharedCorelinkConnection::SendThread::run()
+{
+    for (;;)
+    {
+        const auto signal = mOwner.mQueue.getSignal();
+        if (threadShouldExit())
+            break;
+
+        const uint64_t nowNs = getMonotonicTimeNs();
+        uint64_t readyNs = 0;
+        const auto result = mOwner.mQueue.pop(mRequest, nowNs, readyNs);
+        if (result == PacedSendQueue::PopResult::Ready)
+        {
+            const auto channel = (corelink::core::network::channel_id_type) mRequest.channel;
+            if (mRequest.mtuProbeSize > 0)
+            {
+                // Path-MTU probes are echoed on the jitter stream, where their payload identifies them
+                std::vector<uint8_t> probe(PathMtuProber::getProbePayloadSize(mRequest.mtuProbeSize));
+                PathMtuProber::writeProbe(probe.data(), probe.size(), mRequest.mtuProbeSize);
+                mOwner.mClient.sendData(channel, std::move(probe), corelink::utils::json());
+            }
+            else
+            {
+                // The handle goes back to its instance's pool as sendData() returns
+                mOwner.mClient.sendData(channel, std::move(mRequest.packet), mRequest.maxDatagramSize);
+            }
+            mOwner.mNumHandled.fetch_add(1, std::memory_order_release);
+        }
+        else
+        {
+            // Everything that came in together goes out in one batch on the batched data plane
+            mOwner.mClient.flush();
+            if (result == PacedSendQueue::PopResult::Paced)
+                std::this_thread::sleep_for(std::chrono::nanoseconds(readyNs - nowNs));
+            else
+                mOwner.mQueue.waitForData(signal);
+        }
+    }
+}
+
+SharedCorelinkConnection::SharedCorelinkConnection()
+{
+    mQueue.prepare(SEND_QUEUE_PACKETS);
+    mClient.setTransmitCallback([this](int streamId, uint64_t sequence, uint64_t kernelSendNs) { notifyTransmitted(streamId, sequence, kernelSendNs); });
+    mSendThread.startThread(juce::Thread::Priority::high);
+}
+
+SharedCorelinkConnection::~SharedCorelinkConnection()
+{
+    mSendThread.signalThreadShouldExit();
+    mQueue.wakeConsumer();
+    mSendThread.stopThread(2000);
+}
+
+/**
+ * @brief Registers a plugin instance; callbacks it wraps with bind() run from now until detach()
+*/
+void SharedCorelinkConnection::attach(void* owner)
+{
+    std::lock_guard<std::recursive_mutex> callbacks(mCallbackLock);
+    if (!isAttached(owner))
+        mOwners.push_back(owner);
+}
+
+bool SharedCorelinkConnection::isAttached(void* owner) const
+{
+    std::lock_guard<std::recursive_mutex> callbacks(mCallbackLock);
+    return std::find(mOwners.begin(), mOwners.end(), owner) != mOwners.end();
+}
+
+/**
+ * @brief Connects and authenticates the shared control channel, or joins the authentication already made
+ *
+ * Blocks while the channel connects, as the per-instance connection did. onAuthenticated is
+ * called with the server's status code, on the network thread or, if authentication already
+ * finished, before connect() returns. Returns false with the reason in error, and without calling
+ * onAuthenticated, if the channel cannot be opened or is already open to another server or as
+ * another user. It is called from the editor, where an exception would take down the host.
+*/
+bool SharedCorelinkConnection::connect(void* owner, const juce::String& hostId, const juce::String& username, const juce::String& password,
+                                       StatusCallback onAuthenticated, std::string& error)
+{
+    std::unique_lock<std::mutex> lock(mLock);
+
+    // A channel the server dropped is opened again
+    if (mState != State::Disconnected && !mChannelOpen.load())
+    {
+        mState = State::Disconnected;
+        mAuthenticated.store(false, std::memory_order_release);
+    }
+
+    if (mState != State::Disconnected && hostId.toStdString() != mHostId)
+    {
+        error = "All plugin instances share one connection, which is open to " + mHostId;
+        return false;
+    }
+
+    const bool sameUser = username.toStdString() == mUsername && password.toStdString() == mPassword;
+    if (mState == State::Authenticated || mState == State::Authenticating)
+    {
+        if (!sameUser)
+        {
+            error = "All plugin instances share one connection, which is signed in as " + mUsername;
+            return false;
+        }
+
+        if (mState == State::Authenticated)
+        {
+            const int statusCode = mAuthStatus;
+            lock.unlock();
+            onAuthenticated(statusCode);
+            return true;
+        }
+
+        std::lock_guard<std::recursive_mutex> callbacks(mCallbackLock);
+        mPendingAuth.emplace_back(owner, std::move(onAuthenticated));
+        return true;
+    }
+
+    if (mState == State::Disconnected)
+    {
+        mClient.setInfo(hostId, username);
+        if (!mClient.initProtocols())
+        {
+            error = "Failed to initialize protocol information. Please contact corelink development";
+            return false;
+        }
+
+        // Any of the three callbacks ends the wait; only a successful init leaves the channel open
+        mChannelEvent.set(false);
+        mClient.addControlChannel(
+            [this](corelink::core::network::channel_id_type, in<std::string>) {
+                DBG("Error on the shared control channel");
+                mChannelEvent.set(true);
+            },
+            [this](corelink::core::network::channel_id_type) {
+                mChannelOpen.store(true);
+                mChannelEvent.set(true);
+            },
+            [this](corelink::core::network::channel_id_type) {
+                mChannelOpen.store(false);
+                mAuthenticated.store(false, std::memory_order_release);
+                mChannelEvent.set(true);
+            });
+
+        if (!mChannelEvent.waitForValueFor(true, std::chrono::milliseconds(CONNECT_TIMEOUT_MS)))
+        {
+            error = "Timed out connecting the control channel to " + hostId.toStdString();
+            return false;
+        }
+        // The error callback also ends the wait; the state stays Disconnected so the next instance tries again
+        if (!mChannelOpen.load())
+        {
+            error = "Failed to open the control channel to " + hostId.toStdString();
+            return false;
+        }
+        mHostId = hostId.toStdString();
+        mState = State::Connected;
+    }
+
+    mUsername = username.toStdString();
+    mPassword = password.toStdString();
+    mState = State::Authenticating;
+    {
+        std::lock_guard<std::recursive_mutex> callbacks(mCallbackLock);
+        mPendingAuth.emplace_back(owner, std::move(onAuthenticated));
+    }
+    lock.unlock();
+
+    mClient.authenticate(username, password, [this](int statusCode) { finishAuthentication(statusCode); });
+    return true;
+}
+
+/**
+ * @brief Settles the authentication and calls everyone who waited for it. Network thread
+*/
+void SharedCorelinkConnection::finishAuthentication(int statusCode)
+{
+    bool registerSubscribe = false;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mAuthStatus = statusCode;
+        // A failed attempt leaves the channel open for another try with other credentials
+        mState = statusCode == 0 ? State::Authenticated : State::Connected;
+        if (statusCode != 0)
+        {
+            mUsername.clear();
+            mPassword.clear();
+        }
+        registerSubscribe = statusCode == 0 && !mSubscribeRegistered;
+        mSubscribeRegistered |= registerSubscribe;
+    }
+    mAuthenticated.store(statusCode == 0, std::memory_order_release);
+
+    if (registerSubscribe)
+    {
+        mClient.addOnSubscribe([this](int subscribeStatus, int streamId) { notifySubscribed(subscribeStatus, streamId); });
+        mClient.addOnUpdate([this](const std::string& message) { notifyUpdated(message); });
+    }
+
+    std::lock_guard<std::recursive_mutex> callbacks(mCallbackLock);
+    auto pending = std::move(mPendingAuth);
+    mPendingAuth.clear();
+    for (auto& [owner, callback] : pending)
+        callback(statusCode);
+}
+
+/**
+ * @brief Passes a subscription on the shared channel to every listener; each filters by its own streams
+*/
+void SharedCorelinkConnection::notifySubscribed(int statusCode, int streamId)
+{
+    std::lock_guard<std::recursive_mutex> callbacks(mCallbackLock);
+    for (auto& [owner, listener] : mSubscribeListeners)
+        listener(statusCode, streamId);
+}
+
+void SharedCorelinkConnection::addSubscribeListener(void* owner, SubscribeCallback listener)
+{
+    std::lock_guard<std::recursive_mutex> callbacks(mCallbackLock);
+    mSubscribeListeners.emplace_back(owner, std::move(listener));
+}
+
+/**
+ * @brief Passes a stream alert on the shared channel to every listener
+*/
+void SharedCorelinkConnection::notifyUpdated(const std::string& message)
+{
+    std::lock_guard<std::recursive_mutex> callbacks(mCallbackLock);
+    for (auto& [owner, listener] : mUpdateListeners)
+        listener(message);
+}
+
+void SharedCorelinkConnection::addUpdateListener(void* owner, AnnounceCallback listener)
+{
+    std::lock_guard<std::recursive_mutex> callbacks(mCallbackLock);
+    mUpdateListeners.emplace_back(owner, std::move(listener));
+}
+
+/**
+ * @brief Passes a kernel transmit stamp to every listener; each filters by its own stream
+*/
+void SharedCorelinkConnection::notifyTransmitted(int streamId, uint64_t sequence, uint64_t kernelSendNs)
+{
+    std::lock_guard<std::recursive_mutex> callbacks(mCallbackLock);
+    for (auto& [owner, listener] : mTransmitListeners)
+        listener(streamId, sequence, kernelSendNs);
+}
+
+void SharedCorelinkConnection::addTransmitListener(void* owner, TransmitCallback listener)
+{
+    std::lock_guard<std::recursive_mutex> callbacks(mCallbackLock);
+    mTransmitListeners.emplace_back(owner, std::move(listener));
+}
+
+/**
+ * @brief Forgets every callback of owner, including those wrapped with bind(). Once it returns
+ * none of them is running or will run
+*/
+void SharedCorelinkConnection::detach(void* owner)
+{
+    std::lock_guard<std::recursive_mutex> callbacks(mCallbackLock);
+    mOwners.erase(std::remove(mOwners.begin(), mOwners.end(), owner), mOwners.end());
+    auto isOwner = [owner](const auto& entry) { return entry.first == owner; };
+    mPendingAuth.erase(std::remove_if(mPendingAuth.begin(), mPendingAuth.end(), isOwner), mPendingAuth.end());
+    mSubscribeListeners.erase(std::remove_if(mSubscribeListeners.begin(), mSubscribeListeners.end(), isOwner), mSubscribeListeners.end());
+    mUpdateListeners.erase(std::remove_if(mUpdateListeners.begin(), mUpdateListeners.end(), isOwner), mUpdateListeners.end());
+    mTransmitListeners.erase(std::remove_if(mTransmitListeners.begin(), mTransmitListeners.end(), isOwner), mTransmitListeners.end());
+    setPacingRate(owner, 0.0);
+}
+
+/**
+ * @brief Queues an audio packet for the shared network thread. Any thread, never blocks
+ *
+ * A packet still queued at deadlineNs (monotonic, 0 for never) is dropped instead of sent.
+*/
+bool SharedCorelinkConnection::send(corelink::core::network::channel_id_type hostId, PacketHandle packet, size_t maxDatagramSize, uint64_t deadlineNs)
+{
+    SendRequest request;
+    request.channel = (uint64_t) hostId;
+    request.packet = std::move(packet);
+    request.maxDatagramSize = maxDatagramSize;
+    request.deadlineNs = deadlineNs;
+    return mQueue.push(SendPriority::Audio, std::move(request));
+}
+
+/**
+ * @brief Queues a probe or diagnostic packet; it only goes out while no audio is waiting
+*/
+bool SharedCorelinkConnection::sendProbe(corelink::core::network::channel_id_type hostId, PacketHandle packet, size_t maxDatagramSize)
+{
+    SendRequest request;
+    request.channel = (uint64_t) hostId;
+    request.packet = std::move(packet);
+    request.maxDatagramSize = maxDatagramSize;
+    return mQueue.push(SendPriority::Probe, std::move(request));
+}
+
+/**
+ * @brief Queues a path-MTU probe of probeSize bytes at probe priority
+*/
+bool SharedCorelinkConnection::sendMtuProbe(corelink::core::network::channel_id_type hostId, int probeSize)
+{
+    SendRequest request;
+    request.channel = (uint64_t) hostId;
+    request.mtuProbeSize = probeSize;
+    return mQueue.push(SendPriority::Probe, std::move(request));
+}
+
+/**
+ * @brief Registers owner's nominal stream rate in bytes per second; 0 removes it
+ *
+ * The network thread is paced to PACING_HEADROOM times the sum, so a backlog drains faster than
+ * it builds up without leaving as one burst.
+*/
+void SharedCorelinkConnection::setPacingRate(void* owner, double bytesPerSecond)
+{
+    std::lock_guard<std::mutex> lock(mRateLock);
+    auto entry = std::find_if(mPacingRates.begin(), mPacingRates.end(), [owner](const auto& rate) { return rate.first == owner; });
+    if (entry != mPacingRates.end())
+        mPacingRates.erase(entry);
+    if (bytesPerSecond > 0.0)
+        mPacingRates.emplace_back(owner, bytesPerSecond);
+
+    double total = 0.0;
+    for (const auto& rate : mPacingRates)
+        total += rate.second;
+    mQueue.setRate(total * PACING_HEADROOM);
+}
+
+/**
+ * @brief Waits until everything queued so far has been handed to the transport
+ *
+ * Call after the caller's own producers have stopped. Dropped stale packets count as handled.
+ * Returns false after SEND_FLUSH_TIMEOUT_MS.
+*/
+bool SharedCorelinkConnection::waitUntilSent()
+{
+    const uint64_t target = mQueue.getNumAccepted();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SEND_FLUSH_TIMEOUT_MS);
+    while (mNumHandled.load(std::memory_order_acquire) + mQueue.getNumStale() < target)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CorelinkClient.h"
+#include "PacedSendQueue.h"
+#include "ThreadSafeVar.h"
+
+#define CONNECT_TIMEOUT_MS 10000
+#define SEND_FLUSH_TIMEOUT_MS 2000
+
+/**
+ * @brief One Corelink control channel and one network sender shared by every plugin instance in the host
+ *
+ * Held through juce::SharedResourcePointer, so the first instance creates it and the last one to
+ * go destroys it. The control channel is connected and authenticated once: later instances
+ * asking for the same server and credentials get the result of that authentication, and
+ * instances asking for different ones are refused, since the server sees a single client.
+ * Each instance still creates its own sender, receiver and jitter streams on the shared channel.
+ *
+ * Audio packets and probes from all instances go through one PacedSendQueue to a single
+ * network thread, so the sender threads never block on each other or on the network; send()
+ * is lock-free. Audio goes ahead of probes and is dropped once past its deadline, and the
+ * network thread paces everything to PACING_HEADROOM times the sum of the rates the instances
+ * register with setPacingRate(). Queued packets belong to their instance's PacketPool: an
+ * instance must call waitUntilSent() after stopping its producers and before its pool goes away.
+ *
+ * The server's on-subscribed notification can only be registered once per channel, so it is
+ * fanned out to the listeners instances add, with the id of the stream that was subscribed to;
+ * each instance only acts on its own streams. Kernel transmit stamps of the batched data plane
+ * are fanned out the same way, from the network thread, with the stream id and sequence number. Callbacks are keyed by the owning instance and
+ * detach() removes them; it returns only once none of them is running.
+ *
+ * The client outlives any one instance, so an instance never hands it a callback that captures
+ * the instance directly: it wraps it with bind(), which drops calls made after detach().
+*/
+class SharedCorelinkConnection
+{
+public:
+    using StatusCallback = std::function<void(int)>;
+    using SubscribeCallback = CorelinkClient::SubscribeCallback;
+    using AnnounceCallback = CorelinkClient::AnnounceCallback;
+    using TransmitCallback = CorelinkClient::TransmitCallback;
+
+    SharedCorelinkConnection();
+    ~SharedCorelinkConnection();
+
+    void attach(void* owner);
+    bool connect(void* owner, const juce::String& hostId, const juce::String& username, const juce::String& password, StatusCallback onAuthenticated, std::string& error);
+    void addSubscribeListener(void* owner, SubscribeCallback listener);
+    void addUpdateListener(void* owner, AnnounceCallback listener);
+    void addTransmitListener(void* owner, TransmitCallback listener);
+    void detach(void* owner);
+
+    /** Wraps a callback for the shared client so that it only runs while owner is attached */
+    template <typename Callback>
+    auto bind(void* owner, Callback callback)
+    {
+        return [this, owner, callback = std::move(callback)](auto&&... args) {
+            // Held while the callback runs, so detach() waits for it
+            std::lock_guard<std::recursive_mutex> callbacks(mCallbackLock);
+            if (isAttached(owner))
+                callback(std::forward<decltype(args)>(args)...);
+        };
+    }
+
+    bool isAuthenticated() const { return mAuthenticated.load(std::memory_order_acquire); }
+    CorelinkClient& getClient() { return mClient; }
+
+    bool send(corelink::core::network::channel_id_type hostId, PacketHandle packet, size_t maxDatagramSize, uint64_t deadlineNs = 0);
+    bool sendProbe(corelink::core::network::channel_id_type hostId, PacketHandle packet, size_t maxDatagramSize);
+    bool sendMtuProbe(corelink::core::network::channel_id_type hostId, int probeSize);
+    bool waitUntilSent();
+    void setPacingRate(void* owner, double bytesPerSecond);
+
+    uint64_t getNumDropped() const { return mQueue.getNumDropped(); }
+    uint64_t getNumStale() const { return mQueue.getNumStale(); }
+    uint64_t getNumPaced() const { return mQueue.getNumPaced(); }
+    unsigned getDataPlaneTimestamping() const { return mClient.getDataPlaneTimestamping(); }
+
+private:
+    class SendThread : public juce::Thread
+    {
+    public:
+        explicit SendThread(SharedCorelinkConnection& owner);
+        void run() override;
+
+    private:
+        SharedCorelinkConnection& mOwner;
+        SendRequest mRequest;
+    };
+
+    enum class State
+    {
+        Disconnected,
+        Connected,
+        Authenticating,
+        Authenticated
+    };
+
+    bool isAttached(void* owner) const;
+    void finishAuthentication(int statusCode);
+    void notifySubscribed(int statusCode, int streamId);
+    void notifyUpdated(const std::string& message);
+    void notifyTransmitted(int streamId, uint64_t sequence, uint64_t kernelSendNs);
+
+    PacedSendQueue mQueue;
+    std::atomic<uint64_t> mNumHandled { 0 };
+    SendThread mSendThread { *this };
+
+    // Control-channel callbacks only touch these, so they never wait on mLock
+    ThreadSafeVar<bool> mChannelEvent;
+    std::atomic<bool> mChannelOpen { false };
+    std::atomic<bool> mAuthenticated { false };
+
+    std::mutex mLock;
+    State mState = State::Disconnected;
+    std::string mHostId;
+    std::string mUsername;
+    std::string mPassword;
+    int mAuthStatus = 999;
+    bool mSubscribeRegistered = false;
+
+    mutable std::recursive_mutex mCallbackLock;
+    std::vector<void*> mOwners;
+    std::vector<std::pair<void*, StatusCallback>> mPendingAuth;
+    std::vector<std::pair<void*, SubscribeCallback>> mSubscribeListeners;
+    std::vector<std::pair<void*, AnnounceCallback>> mUpdateListeners;
+    std::vector<std::pair<void*, TransmitCallback>> mTransmitListeners;
+
+    std::mutex mRateLock;
+    std::vector<std::pair<void*, double>> mPacingRates;
+
+    // Last, so its network threads are gone before anything their callbacks touch
+    CorelinkClient mClient;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SharedCorelinkConnection)
+};
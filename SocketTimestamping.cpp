@@ -0,0 +1,135 @@
+#include "SocketTimestamping.h"
+
+#include "PacketHeader.h"
+
+#include <juce_core/juce_core.h>
+
+#if JUCE_LINUX
+    #include <cerrno>
+    #include <cstring>
+    #include <ctime>
+    #include <linux/errqueue.h>
+    #include <linux/net_tstamp.h>
+    #include <linux/sockios.h>
+    #include <net/if.h>
+    #include <netinet/in.h>
+    #include <sys/ioctl.h>
+    #include <sys/socket.h>
+#endif
+
+namespace SocketTimestamping
+{
+#if JUCE_LINUX
+    namespace
+    {
+        uint64_t toNs(const timespec& time)
+        {
+            return (uint64_t) time.tv_sec * 1000000000ull + (uint64_t) time.tv_nsec;
+        }
+
+        // SCM_TIMESTAMPING carries three stamps: [0] software, [1] unused, [2] raw hardware
+        bool readStamps(const msghdr& message, PacketTimestamp& timestamp)
+        {
+            bool found = false;
+            for (auto* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&message), cmsg))
+            {
+                if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SO_TIMESTAMPING)
+                    continue;
+
+                timespec stamps[3];
+                std::memcpy(stamps, CMSG_DATA(cmsg), sizeof(stamps));
+                const uint64_t softwareNs = toNs(stamps[0]);
+                timestamp.softwareNs = softwareNs > 0 ? realtimeToMonotonicNs(softwareNs) : 0;
+                timestamp.hardwareNs = toNs(stamps[2]);
+                found = softwareNs > 0 || timestamp.hardwareNs > 0;
+            }
+            return found;
+        }
+    }
+
+    unsigned enable(int socket, bool transmit)
+    {
+        unsigned flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        if (transmit)
+            flags |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+
+        // The hardware flags are accepted whether or not the NIC stamps; without it they are just empty
+        const unsigned hardware = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE
+                                  | (transmit ? (unsigned) SOF_TIMESTAMPING_TX_HARDWARE : 0u);
+        unsigned withHardware = flags | hardware;
+        if (setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPING, &withHardware, sizeof(withHardware)) == 0)
+            return SoftwareReceive | HardwareReceive | (transmit ? SoftwareTransmit | HardwareTransmit : 0u);
+        if (setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0)
+            return SoftwareReceive | (transmit ? SoftwareTransmit : 0u);
+        return 0;
+    }
+
+    bool enableHardware(int socket, const char* interfaceName)
+    {
+        hwtstamp_config config {};
+        config.tx_type = HWTSTAMP_TX_ON;
+        config.rx_filter = HWTSTAMP_FILTER_ALL;
+
+        ifreq request {};
+        std::strncpy(request.ifr_name, interfaceName, IFNAMSIZ - 1);
+        request.ifr_data = reinterpret_cast<char*>(&config);
+        return ioctl(socket, SIOCSHWTSTAMP, &request) == 0;
+    }
+
+    bool readReceive(const void* control, size_t controlSize, PacketTimestamp& timestamp)
+    {
+        msghdr message {};
+        message.msg_control = const_cast<void*>(control);
+        message.msg_controllen = controlSize;
+        return readStamps(message, timestamp);
+    }
+
+    bool readTransmit(int socket, uint32_t& sendIndex, PacketTimestamp& timestamp)
+    {
+        // With OPT_TSONLY the error queue returns no payload, only the control data
+        alignas(cmsghdr) char control[TIMESTAMPING_CONTROL_SIZE];
+        msghdr message {};
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        if (recvmsg(socket, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            return false;
+
+        bool hasIndex = false;
+        for (auto* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg))
+        {
+            const bool recvErr = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+                                 || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+            if (!recvErr)
+                continue;
+
+            sock_extended_err error;
+            std::memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+            if (error.ee_errno == ENOMSG && error.ee_origin == SO_EE_ORIGIN_TIMESTAMPING)
+            {
+                sendIndex = error.ee_data;
+                hasIndex = true;
+            }
+        }
+        return hasIndex && readStamps(message, timestamp);
+    }
+
+    uint64_t realtimeToMonotonicNs(uint64_t realtimeNs)
+    {
+        // Bracketing the wall-clock read halves the error of reading the two clocks apart
+        const uint64_t before = getMonotonicTimeNs();
+        timespec realtime;
+        clock_gettime(CLOCK_REALTIME, &realtime);
+        const uint64_t after = getMonotonicTimeNs();
+
+        const int64_t ageNs = (int64_t) (toNs(realtime) - realtimeNs);
+        const uint64_t nowNs = before + (after - before) / 2;
+        return ageNs > 0 && (uint64_t) ageNs < nowNs ? nowNs - (uint64_t) ageNs : nowNs;
+    }
+#else
+    unsigned enable(int, bool) { return 0; }
+    bool enableHardware(int, const char*) { return false; }
+    bool readReceive(const void*, size_t, PacketTimestamp&) { return false; }
+    bool readTransmit(int, uint32_t&, PacketTimestamp&) { return false; }
+    uint64_t realtimeToMonotonicNs(uint64_t) { return getMonotonicTimeNs(); }
+#endif
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define TIMESTAMPING_CONTROL_SIZE 256
+
+/**
+ * @brief Kernel timestamps of one datagram
+ *
+ * softwareNs is taken by the kernel as the datagram passed the network stack and is converted to
+ * the clock of getMonotonicTimeNs(), so it compares directly with user-space stamps. hardwareNs
+ * is taken by the NIC on its own clock: only differences between hardware stamps mean anything.
+ * Either is 0 when it was not taken.
+*/
+struct PacketTimestamp
+{
+    uint64_t softwareNs = 0;
+    uint64_t hardwareNs = 0;
+};
+
+/**
+ * @brief SO_TIMESTAMPING for sockets this plugin owns (Linux only)
+ *
+ * Time stamps taken in a user-space callback include however long the thread took to be
+ * scheduled, which on a busy host looks exactly like network jitter. With SO_TIMESTAMPING the
+ * kernel stamps each received datagram on arrival, and each sent datagram as it leaves, with the
+ * NIC's stamps as well where the driver supports them (see enableHardware()).
+ *
+ * Receive stamps come with the datagram as control data of recvmsg(): pass a control buffer of
+ * TIMESTAMPING_CONTROL_SIZE bytes and hand it to readReceive(). Transmit stamps are queued on the
+ * socket's error queue; readTransmit() collects one at a time, identified by the number of the
+ * send on that socket counting from 0, which is what lets a caller match it with a sequence number.
+ *
+ * Elsewhere every call fails and the caller keeps its user-space stamps.
+*/
+namespace SocketTimestamping
+{
+    enum Capability : unsigned
+    {
+        SoftwareReceive = 1 << 0,
+        SoftwareTransmit = 1 << 1,
+        HardwareReceive = 1 << 2,
+        HardwareTransmit = 1 << 3
+    };
+
+    /** Turns on receive and, if asked, transmit stamps; returns the Capability bits now set, 0 on failure */
+    unsigned enable(int socket, bool transmit);
+
+    /** Switches the NIC behind interfaceName to stamp all packets. Needs CAP_NET_ADMIN */
+    bool enableHardware(int socket, const char* interfaceName);
+
+    /** Reads the stamps out of the control data recvmsg() returned with a datagram */
+    bool readReceive(const void* control, size_t controlSize, PacketTimestamp& timestamp);
+
+    /** Takes one transmit stamp off the error queue without blocking; false when there is none */
+    bool readTransmit(int socket, uint32_t& sendIndex, PacketTimestamp& timestamp);
+
+    /** Converts a CLOCK_REALTIME stamp taken moments ago to the monotonic clock */
+    uint64_t realtimeToMonotonicNs(uint64_t realtimeNs);
+}
@@ -0,0 +1,115 @@
+#include "StreamAnnouncement.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    /** Returns the start of the innermost object around pos, or npos if pos is directly in an array */
+    size_t findObjectStart(const std::string& text, size_t pos)
+    {
+        int depth = 0;
+        for (size_t i = pos; i-- > 0;)
+        {
+            const char c = text[i];
+            if (c == '}' || c == ']')
+                ++depth;
+            else if (c == '{' || c == '[')
+            {
+                if (depth == 0)
+                    return c == '{' ? i : std::string::npos;
+                --depth;
+            }
+        }
+        return std::string::npos;
+    }
+
+    size_t findObjectEnd(const std::string& text, size_t start)
+    {
+        int depth = 0;
+        for (size_t i = start; i < text.size(); ++i)
+        {
+            const char c = text[i];
+            if (c == '{' || c == '[')
+                ++depth;
+            else if ((c == '}' || c == ']') && --depth == 0)
+                return i;
+        }
+        return std::string::npos;
+    }
+
+    bool isInNestedArray(const std::string& text, size_t start, size_t pos)
+    {
+        int depth = 0;
+        for (size_t i = start; i < pos; ++i)
+        {
+            if (text[i] == '[')
+                ++depth;
+            else if (text[i] == ']')
+                --depth;
+        }
+        return depth > 0;
+    }
+
+    /** Reads the number stored under key in text[start, end], with the key quoted plainly or escaped */
+    bool readNumber(const std::string& text, size_t start, size_t end, const char* key, double& value)
+    {
+        const size_t length = std::strlen(key);
+        for (size_t pos = text.find(key, start); pos != std::string::npos && pos < end; pos = text.find(key, pos + 1))
+        {
+            const size_t after = pos + length;
+            if (pos == 0 || text[pos - 1] != '"' || after >= end || (text[after] != '"' && text[after] != '\\'))
+                continue;
+            if (isInNestedArray(text, start, pos))
+                continue;
+
+            size_t i = after;
+            while (i < end && std::strchr("\\\": \t\r\n", text[i]) != nullptr)
+                ++i;
+            char* parsed = nullptr;
+            value = std::strtod(text.c_str() + i, &parsed);
+            return parsed != text.c_str() + i && std::isfinite(value);
+        }
+        return false;
+    }
+}
+
+std::vector<StreamAnnouncement> parseStreamAnnouncements(const std::string& message)
+{
+    std::vector<StreamAnnouncement> streams;
+    for (size_t pos = message.find("\"streamID\""); pos != std::string::npos; pos = message.find("\"streamID\"", pos + 1))
+    {
+        const size_t start = findObjectStart(message, pos);
+        if (start == std::string::npos)
+            continue;
+        const size_t end = findObjectEnd(message, start);
+        if (end == std::string::npos)
+            continue;
+
+        double streamId = 0.0, sampleRate = 0.0, numChannels = 0.0, sampleFormat = 0.0, codec = 0.0;
+        if (!readNumber(message, start, end, "streamID", streamId)
+            || !readNumber(message, start, end, "sample_rate", sampleRate)
+            || !readNumber(message, start, end, "num_channel", numChannels)
+            || !readNumber(message, start, end, "sample_format", sampleFormat)
+            || !readNumber(message, start, end, "codec", codec))
+            continue;
+        if (streamId < 0.0 || sampleRate <= 0.0 || sampleRate > 768000.0 || numChannels < 1.0 || numChannels > 65535.0
+            || sampleFormat < 0.0 || sampleFormat > (double) SampleFormat::Int24 || codec < 0.0 || codec > (double) CodecId::Mdct)
+            continue;
+
+        StreamAnnouncement stream;
+        stream.streamId = (int) streamId;
+        stream.format.sampleRate = sampleRate;
+        stream.format.numChannels = (int) numChannels;
+        stream.format.sampleFormat = (SampleFormat) (int) sampleFormat;
+        stream.format.codec = (CodecId) (int) codec;
+        double bitrate = 0.0, codecDelay = 0.0;
+        if (readNumber(message, start, end, "bitrate", bitrate) && bitrate > 0.0)
+            stream.format.bitrate = (int) bitrate;
+        if (readNumber(message, start, end, "codec_delay", codecDelay) && codecDelay > 0.0)
+            stream.format.codecDelay = (int) codecDelay;
+        streams.push_back(stream);
+    }
+    return streams;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "PacketHeader.h"
+
+/**
+ * @brief A stream whose Corelink meta announces its audio format
+*/
+struct StreamAnnouncement
+{
+    int streamId = -1;
+    StreamFormat format;
+};
+
+/**
+ * @brief Collects the audio streams announced in a Corelink server message
+ *
+ * createSender() puts the fields of the stream's StreamFormat into the stream meta. The server
+ * hands that meta to receivers, both in the stream list of the create_receiver answer and in the
+ * update alert for a stream created later, either as a nested object or as an escaped string.
+ * Every object with a "streamID" is read together with the meta inside it; objects in arrays
+ * nested inside it, such as the stream list around it, are not part of it. Streams without a
+ * valid sample_rate, num_channel, sample_format and codec are skipped.
+*/
+std::vector<StreamAnnouncement> parseStreamAnnouncements(const std::string& message);
@@ -0,0 +1,522 @@
+#include "StreamIngest.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr size_t kWindowWords = INGEST_DUPLICATE_WINDOW / 64;
+
+    // Slot states: only the producer leaves Active and Free, only the consumer leaves Retiring for Free
+    constexpr int kActive = 0;
+    constexpr int kRetiring = 1;
+    constexpr int kFree = 2;
+}
+
+void ReceivedPacket::allocate(size_t maxSize)
+{
+    size = 0;
+    data.assign(maxSize, 0);
+}
+
+/**
+ * @brief Allocates the slots. Must not be called while a producer or consumer is active
+*/
+void ReceivedPacketQueue::prepare(int numPackets, size_t maxPacketSize)
+{
+    size_t capacity = 1;
+    while (capacity < (size_t) std::max(numPackets, 2))
+        capacity <<= 1;
+
+    mSlots.resize(capacity);
+    for (auto& slot : mSlots)
+        slot.allocate(maxPacketSize);
+
+    mMask = capacity - 1;
+    mWriteIndex.store(0, std::memory_order_relaxed);
+    mReadIndex.store(0, std::memory_order_relaxed);
+    mDropped.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Copies one packet into the ring, discarding the oldest when full. Producer thread only
+*/
+bool ReceivedPacketQueue::push(const PacketHeader& header, const uint8_t* packet, size_t size, uint64_t arrivalNs, bool recovered)
+{
+    if (mSlots.empty() || size > mSlots[0].data.size())
+        return false;
+
+    const auto w = mWriteIndex.load(std::memory_order_relaxed);
+    auto r = mReadIndex.load(std::memory_order_acquire);
+
+    if (w - r > mMask)
+    {
+        // If the CAS fails the consumer has just freed a slot, so there is room either way
+        if (mReadIndex.compare_exchange_strong(r, r + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    auto& slot = mSlots[w & mMask];
+    slot.header = header;
+    slot.arrivalNs = arrivalNs;
+    slot.recovered = recovered;
+    slot.size = size;
+    std::memcpy(slot.data.data(), packet, size);
+
+    mWriteIndex.store(w + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Copies the oldest packet into dest. Consumer thread only
+*/
+bool ReceivedPacketQueue::pop(ReceivedPacket& dest)
+{
+    auto r = mReadIndex.load(std::memory_order_acquire);
+
+    for (;;)
+    {
+        if (r == mWriteIndex.load(std::memory_order_acquire))
+            return false;
+
+        const auto& slot = mSlots[r & mMask];
+        dest.header = slot.header;
+        dest.arrivalNs = slot.arrivalNs;
+        dest.recovered = slot.recovered;
+        dest.size = std::min(slot.size, dest.data.size());
+        std::memcpy(dest.data.data(), slot.data.data(), dest.size);
+
+        // A failed CAS means the producer reclaimed this slot while we copied it
+        if (mReadIndex.compare_exchange_strong(r, r + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+            return true;
+    }
+}
+
+/**
+ * @brief Empties the queue. Neither the producer nor the consumer may be using it
+*/
+void ReceivedPacketQueue::clear()
+{
+    mWriteIndex.store(0, std::memory_order_relaxed);
+    mReadIndex.store(0, std::memory_order_relaxed);
+    mDropped.store(0, std::memory_order_relaxed);
+}
+
+size_t ReceivedPacketQueue::getNumReady() const
+{
+    const auto r = mReadIndex.load(std::memory_order_acquire);
+    const auto w = mWriteIndex.load(std::memory_order_acquire);
+    return (size_t) (w - r);
+}
+
+struct StreamIngest::Stream
+{
+    std::atomic<int> sourceStreamId { -1 };
+    std::atomic<int> state { kActive };
+    uint64_t lastArrivalNs = 0;
+    ReceivedPacketQueue queue;
+    PacketReassembler reassembler;
+    std::unique_ptr<FecDecoder> fec;
+    JitterStatistics statistics;
+    JitterStatistics userStatistics;
+
+    bool hasSequence = false;
+    uint64_t highestSequence = 0;
+    uint64_t seen[kWindowWords] = {};
+
+    std::atomic<uint64_t> received { 0 };
+    std::atomic<uint64_t> duplicates { 0 };
+    std::atomic<uint64_t> stale { 0 };
+    std::atomic<uint64_t> invalid { 0 };
+    std::atomic<uint64_t> recovered { 0 };
+    std::atomic<uint64_t> kernelStamped { 0 };
+    std::atomic<uint64_t> restarts { 0 };
+
+    bool isLive() const { return state.load(std::memory_order_acquire) != kFree; }
+    void clearCounters();
+};
+
+void StreamIngest::Stream::clearCounters()
+{
+    hasSequence = false;
+    received.store(0, std::memory_order_relaxed);
+    duplicates.store(0, std::memory_order_relaxed);
+    stale.store(0, std::memory_order_relaxed);
+    invalid.store(0, std::memory_order_relaxed);
+    recovered.store(0, std::memory_order_relaxed);
+    kernelStamped.store(0, std::memory_order_relaxed);
+    restarts.store(0, std::memory_order_relaxed);
+    statistics.reset();
+    userStatistics.reset();
+}
+
+StreamIngest::StreamIngest() = default;
+
+StreamIngest::~StreamIngest() = default;
+
+/**
+ * @brief Sets the largest accepted packet, the per-stream queue length and the number of slots, and forgets all streams
+*/
+void StreamIngest::prepare(size_t maxPacketSize, int queuePackets, int maxStreams)
+{
+    mMaxPacketSize = maxPacketSize;
+    mQueuePackets = queuePackets;
+    mStreams.resize((size_t) std::max(maxStreams, 1));
+    for (auto& stream : mStreams)
+    {
+        if (!stream)
+            stream = std::make_unique<Stream>();
+    }
+    reset();
+}
+
+void StreamIngest::reset()
+{
+    for (auto& stream : mStreams)
+    {
+        stream->sourceStreamId.store(-1, std::memory_order_relaxed);
+        stream->state.store(kActive, std::memory_order_relaxed);
+        stream->fec.reset();
+        stream->clearCounters();
+    }
+    mNumStreams.store(0, std::memory_order_release);
+    mLastStream = 0;
+    mNumUnroutable.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief arrivalNs is the user-space arrival time; kernelArrivalNs the kernel's stamp on the same clock, or 0
+*/
+bool StreamIngest::ingest(int sourceStreamId, const uint8_t* data, size_t size, uint64_t arrivalNs, uint64_t kernelArrivalNs)
+{
+    auto* stream = findOrAddStream(sourceStreamId, arrivalNs);
+    if (stream == nullptr)
+    {
+        mNumUnroutable.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (FragmentHeader::isFragment(data, size))
+    {
+        const uint8_t* message = nullptr;
+        size_t messageSize = 0;
+        if (!stream->reassembler.addFragment(data, size, message, messageSize))
+            return false;
+        data = message;
+        size = messageSize;
+    }
+
+    // A reassembled packet arrived with its last fragment, so that fragment's stamp stands for it
+    const uint64_t userArrivalNs = kernelArrivalNs > 0 ? arrivalNs : 0;
+    if (kernelArrivalNs > 0)
+        arrivalNs = kernelArrivalNs;
+
+    if (FecHeader::isRepair(data, size))
+    {
+        if (!stream->fec)
+        {
+            // The only allocation after a stream's first packet, once per stream that uses FEC
+            stream->fec = std::make_unique<FecDecoder>();
+            stream->fec->prepare(mMaxPacketSize, 2 * FEC_MAX_SOURCE_PACKETS, 4);
+        }
+
+        const int numRecovered = stream->fec->addRepairPacket(data, size);
+        bool queued = false;
+        for (int i = 0; i < numRecovered; ++i)
+        {
+            size_t packetSize = 0;
+            uint64_t sequence = 0;
+            const auto* packet = stream->fec->getRecoveredPacket(i, packetSize, sequence);
+            PacketHeader header;
+            queued |= accept(*stream, packet, packetSize, arrivalNs, userArrivalNs, true, header);
+        }
+        return queued;
+    }
+
+    PacketHeader header;
+    if (!accept(*stream, data, size, arrivalNs, userArrivalNs, false, header))
+        return false;
+
+    if (stream->fec)
+    {
+        const int numRecovered = stream->fec->addSourcePacket(data, size, header.sequence);
+        for (int i = 0; i < numRecovered; ++i)
+        {
+            size_t packetSize = 0;
+            uint64_t sequence = 0;
+            const auto* packet = stream->fec->getRecoveredPacket(i, packetSize, sequence);
+            PacketHeader recoveredHeader;
+            accept(*stream, packet, packetSize, arrivalNs, userArrivalNs, true, recoveredHeader);
+        }
+    }
+    return true;
+}
+
+bool StreamIngest::parseSourceStreamId(const uint8_t* header, size_t size, int& sourceStreamId)
+{
+    static constexpr char key[] = "\"source\"";
+    const size_t keyLength = sizeof(key) - 1;
+    const auto* end = header + size;
+    const auto* found = std::search(header, end, key, key + keyLength);
+    if (found == end)
+        return false;
+
+    const auto* p = found + keyLength;
+    while (p < end && (*p == ' ' || *p == ':' || *p == '"'))
+        ++p;
+
+    int64_t value = 0;
+    const auto* digits = p;
+    while (p < end && *p >= '0' && *p <= '9' && value <= 0x7fffffff)
+        value = value * 10 + (*p++ - '0');
+    if (p == digits || value > 0x7fffffff)
+        return false;
+
+    sourceStreamId = (int) value;
+    return true;
+}
+
+int StreamIngest::getStreamId(int index) const
+{
+    if (index < 0 || index >= getNumStreams() || !mStreams[(size_t) index]->isLive())
+        return -1;
+    return mStreams[(size_t) index]->sourceStreamId.load(std::memory_order_relaxed);
+}
+
+int StreamIngest::findStream(int sourceStreamId) const
+{
+    const int numStreams = getNumStreams();
+    for (int i = 0; i < numStreams; ++i)
+    {
+        const auto& stream = *mStreams[(size_t) i];
+        if (stream.sourceStreamId.load(std::memory_order_relaxed) == sourceStreamId && stream.isLive())
+            return i;
+    }
+    return -1;
+}
+
+bool StreamIngest::pop(int index, ReceivedPacket& dest)
+{
+    if (index < 0 || index >= getNumStreams())
+        return false;
+    // A free slot's queue belongs to the producer until it is handed to the next stream
+    auto& stream = *mStreams[(size_t) index];
+    return stream.isLive() && stream.queue.pop(dest);
+}
+
+bool StreamIngest::releaseRetired(int index)
+{
+    if (index < 0 || index >= getNumStreams())
+        return false;
+    int expected = kRetiring;
+    return mStreams[(size_t) index]->state.compare_exchange_strong(expected, kFree, std::memory_order_acq_rel);
+}
+
+StreamIngest::Counters StreamIngest::getCounters(int index) const
+{
+    Counters counters;
+    if (index < 0 || index >= getNumStreams())
+        return counters;
+
+    const auto& stream = *mStreams[(size_t) index];
+    counters.received = stream.received.load(std::memory_order_relaxed);
+    counters.duplicates = stream.duplicates.load(std::memory_order_relaxed);
+    counters.stale = stream.stale.load(std::memory_order_relaxed);
+    counters.invalid = stream.invalid.load(std::memory_order_relaxed);
+    counters.recovered = stream.recovered.load(std::memory_order_relaxed);
+    counters.dropped = stream.queue.getNumDropped();
+    counters.kernelStamped = stream.kernelStamped.load(std::memory_order_relaxed);
+    counters.restarts = stream.restarts.load(std::memory_order_relaxed);
+    return counters;
+}
+
+/**
+ * @brief Arrival statistics of the stream at index, or nullptr if there is no such stream
+*/
+const JitterStatistics* StreamIngest::getStatistics(int index) const
+{
+    if (index < 0 || index >= getNumStreams())
+        return nullptr;
+    return &mStreams[(size_t) index]->statistics;
+}
+
+/**
+ * @brief Statistics of the same stream from user-space arrival times, over the packets that also had a kernel stamp
+*/
+const JitterStatistics* StreamIngest::getUserStatistics(int index) const
+{
+    if (index < 0 || index >= getNumStreams())
+        return nullptr;
+    return &mStreams[(size_t) index]->userStatistics;
+}
+
+/**
+ * @brief Returns the stream's slot, claiming and allocating one for a new stream. Producer thread only
+*/
+StreamIngest::Stream* StreamIngest::findOrAddStream(int sourceStreamId, uint64_t arrivalNs)
+{
+    const int numStreams = mNumStreams.load(std::memory_order_relaxed);
+
+    // Packets tend to come in runs from the same stream
+    auto* last = mLastStream < numStreams ? mStreams[(size_t) mLastStream].get() : nullptr;
+    if (last != nullptr && last->sourceStreamId.load(std::memory_order_relaxed) == sourceStreamId
+        && last->state.load(std::memory_order_relaxed) == kActive)
+    {
+        last->lastArrivalNs = arrivalNs;
+        return last;
+    }
+
+    for (int i = 0; i < numStreams; ++i)
+    {
+        auto& stream = *mStreams[(size_t) i];
+        if (stream.sourceStreamId.load(std::memory_order_relaxed) != sourceStreamId)
+            continue;
+
+        // A retired slot the consumer has not handed back yet still belongs to this stream
+        int state = kRetiring;
+        if (stream.state.load(std::memory_order_relaxed) == kActive
+            || stream.state.compare_exchange_strong(state, kActive, std::memory_order_acq_rel))
+        {
+            stream.lastArrivalNs = arrivalNs;
+            mLastStream = i;
+            return &stream;
+        }
+    }
+
+    if (mMaxPacketSize == 0)
+        return nullptr;
+    if (numStreams >= (int) mStreams.size())
+        return recycleStream(sourceStreamId, arrivalNs);
+
+    auto& stream = *mStreams[(size_t) numStreams];
+    stream.queue.prepare(mQueuePackets, mMaxPacketSize);
+    stream.reassembler.prepare(INGEST_REASSEMBLY_SLOTS, mMaxPacketSize);
+    stream.statistics.prepare();
+    stream.userStatistics.prepare();
+    stream.sourceStreamId.store(sourceStreamId, std::memory_order_relaxed);
+    stream.state.store(kActive, std::memory_order_relaxed);
+    stream.lastArrivalNs = arrivalNs;
+    // Publishes the prepared slot to consumers
+    mNumStreams.store(numStreams + 1, std::memory_order_release);
+    mLastStream = numStreams;
+    return &stream;
+}
+
+/**
+ * @brief With every slot taken, hands a slot the consumer released to a new stream, and retires
+ * the idle ones so that the consumer can release them. Producer thread only
+*/
+StreamIngest::Stream* StreamIngest::recycleStream(int sourceStreamId, uint64_t arrivalNs)
+{
+    const auto idleNs = (uint64_t) INGEST_IDLE_TIMEOUT_MS * 1000000;
+    Stream* freed = nullptr;
+    for (size_t i = 0; i < mStreams.size(); ++i)
+    {
+        auto& stream = *mStreams[i];
+        const int state = stream.state.load(std::memory_order_acquire);
+        if (state == kFree && freed == nullptr)
+        {
+            freed = &stream;
+            mLastStream = (int) i;
+        }
+        else if (state == kActive && arrivalNs > stream.lastArrivalNs + idleNs)
+        {
+            stream.state.store(kRetiring, std::memory_order_release);
+        }
+    }
+    if (freed == nullptr)
+        return nullptr;
+
+    // The consumer is done with the slot; nothing else touches it until it is published again
+    freed->queue.clear();
+    freed->reassembler.reset();
+    freed->fec.reset();
+    freed->clearCounters();
+    freed->sourceStreamId.store(sourceStreamId, std::memory_order_relaxed);
+    freed->lastArrivalNs = arrivalNs;
+    freed->state.store(kActive, std::memory_order_release);
+    return freed;
+}
+
+/**
+ * @brief Validates, de-duplicates and queues one complete packet; header receives the parsed header
+ *
+ * userArrivalNs is non-zero when arrivalNs is a kernel stamp.
+*/
+bool StreamIngest::accept(Stream& stream, const uint8_t* packet, size_t size, uint64_t arrivalNs, uint64_t userArrivalNs, bool recovered, PacketHeader& header)
+{
+    if (size > mMaxPacketSize || !PacketHeader::decode(packet, size, header))
+    {
+        stream.invalid.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (!markSeen(stream, header.sequence))
+        return false;
+
+    stream.queue.push(header, packet, size, arrivalNs, recovered);
+    (recovered ? stream.recovered : stream.received).fetch_add(1, std::memory_order_relaxed);
+    if (!recovered)
+    {
+        const bool synchronized = (header.flags & PACKET_FLAG_SYNCED_TIME) != 0 && mClock != nullptr && mClock->isSynchronized();
+        stream.statistics.addArrival(header.sendTimeNs, synchronized ? mClock->toReferenceNs(arrivalNs) : arrivalNs, synchronized);
+        if (userArrivalNs > 0)
+        {
+            stream.userStatistics.addArrival(header.sendTimeNs, synchronized ? mClock->toReferenceNs(userArrivalNs) : userArrivalNs, synchronized);
+            stream.kernelStamped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Sliding-window duplicate check over the last INGEST_DUPLICATE_WINDOW sequence numbers
+*/
+bool StreamIngest::markSeen(Stream& stream, uint64_t sequence)
+{
+    auto bit = [](uint64_t s) { return uint64_t(1) << (s % 64); };
+    auto word = [&stream](uint64_t s) -> uint64_t& { return stream.seen[(s / 64) % kWindowWords]; };
+
+    if (stream.hasSequence)
+    {
+        const uint64_t distance = sequence > stream.highestSequence ? sequence - stream.highestSequence : stream.highestSequence - sequence;
+        if (distance >= INGEST_SEQUENCE_RESTART)
+        {
+            stream.restarts.fetch_add(1, std::memory_order_relaxed);
+            stream.hasSequence = false;
+        }
+    }
+
+    if (!stream.hasSequence || sequence > stream.highestSequence)
+    {
+        const uint64_t advance = stream.hasSequence ? sequence - stream.highestSequence : INGEST_DUPLICATE_WINDOW;
+        if (advance >= INGEST_DUPLICATE_WINDOW)
+        {
+            std::fill(std::begin(stream.seen), std::end(stream.seen), 0);
+        }
+        else
+        {
+            for (uint64_t s = stream.highestSequence + 1; s <= sequence; ++s)
+                word(s) &= ~bit(s);
+        }
+        stream.hasSequence = true;
+        stream.highestSequence = sequence;
+        word(sequence) |= bit(sequence);
+        return true;
+    }
+
+    if (stream.highestSequence - sequence >= INGEST_DUPLICATE_WINDOW)
+    {
+        stream.stale.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if ((word(sequence) & bit(sequence)) != 0)
+    {
+        stream.duplicates.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    word(sequence) |= bit(sequence);
+    return true;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ClockSync.h"
+#include "FecCodec.h"
+#include "JitterStatistics.h"
+#include "PacketFragmenter.h"
+#include "PacketHeader.h"
+
+#define INGEST_MAX_STREAMS 64
+#define INGEST_QUEUE_PACKETS 32
+#define INGEST_DUPLICATE_WINDOW 1024
+#define INGEST_REASSEMBLY_SLOTS 4
+#define INGEST_IDLE_TIMEOUT_MS 5000
+// A sequence number this far from the newest one is a restarted sender, not a late or early packet
+#define INGEST_SEQUENCE_RESTART 65536
+
+/**
+ * @brief One validated audio packet as handed to the consumer, preallocated like AudioFrame
+*/
+struct ReceivedPacket
+{
+    PacketHeader header;
+    uint64_t arrivalNs = 0;
+    bool recovered = false;
+    size_t size = 0;
+    std::vector<uint8_t> data;
+
+    void allocate(size_t maxSize);
+    const uint8_t* getPayload() const { return data.data() + PacketHeader::kSize; }
+};
+
+/**
+ * @brief Wait-free single-producer/single-consumer ring of received packets
+ *
+ * Same scheme as AudioFrameRing with a fixed DropOldest policy: for live audio the newest
+ * packet is the one worth keeping when the consumer falls behind.
+*/
+class ReceivedPacketQueue
+{
+public:
+    ReceivedPacketQueue() = default;
+
+    void prepare(int numPackets, size_t maxPacketSize);
+
+    bool push(const PacketHeader& header, const uint8_t* packet, size_t size, uint64_t arrivalNs, bool recovered);
+    bool pop(ReceivedPacket& dest);
+    void clear();
+
+    size_t getNumReady() const;
+    uint64_t getNumDropped() const { return mDropped.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<ReceivedPacket> mSlots;
+    size_t mMask = 0;
+
+    alignas(64) std::atomic<uint64_t> mWriteIndex { 0 };
+    alignas(64) std::atomic<uint64_t> mReadIndex { 0 };
+    std::atomic<uint64_t> mDropped { 0 };
+};
+
+/**
+ * @brief Receive-side ingestion: demultiplexes datagrams by source stream into per-stream queues
+ *
+ * ingest() runs on the network thread and is the only producer. For each datagram it
+ * reassembles fragments, feeds repair packets to the stream's FEC decoder, validates the packet
+ * header, drops duplicates and packets too old to place, stamps the arrival time and queues the
+ * packet for that stream. Packets rebuilt by FEC are queued with recovered set.
+ *
+ * A stream gets a slot the first time it sends; its queue and reassembly buffers are allocated
+ * then, and its FEC decoder when its first repair packet arrives. Nothing is allocated per
+ * packet. Every stream also keeps JitterStatistics over the packets that arrived, not those
+ * rebuilt by FEC, which any thread may read while ingest() runs. With a clock set, packets
+ * stamped on the synchronized time base also give the one-way delay.
+ *
+ * Slots are recycled while running. Once every slot is taken, a new stream retires the slots
+ * that have had no packet for INGEST_IDLE_TIMEOUT_MS. The consumer, which may keep per-slot
+ * state of its own, hands a retired slot back with releaseRetired() after dropping that state,
+ * and the next new stream takes it over; until then a packet from the old stream revives it.
+ * The new stream is unroutable until a slot has been handed back. reset() forgets every stream
+ * at once, but must not run concurrently with ingest() or pop().
+ *
+ * A sequence number INGEST_SEQUENCE_RESTART or more away from the newest one restarts the
+ * duplicate window instead of being judged against it, so a restarted sender, or a single
+ * corrupt sequence number, does not make every later packet look stale.
+ *
+ * When the socket supplies a kernel receive stamp (see SocketTimestamping) it replaces the
+ * user-space arrival time for queueing and statistics, so scheduling delays on the network
+ * thread no longer show up as jitter. The user-space times then go into a second set of
+ * statistics, kept only for such packets, so the two can be compared side by side.
+ *
+ * Consumers iterate the streams with getNumStreams() and pop() and releaseRetired() each from
+ * one thread.
+*/
+class StreamIngest
+{
+public:
+    StreamIngest();
+    ~StreamIngest();
+
+    void prepare(size_t maxPacketSize, int queuePackets = INGEST_QUEUE_PACKETS, int maxStreams = INGEST_MAX_STREAMS);
+    void reset();
+    /** Maps arrival times onto the synchronized time base; must outlive ingestion */
+    void setClock(const ClockSync* clock) { mClock = clock; }
+
+    /** Handles one datagram from sourceStreamId. Returns true if at least one packet was queued */
+    bool ingest(int sourceStreamId, const uint8_t* data, size_t size, uint64_t arrivalNs, uint64_t kernelArrivalNs = 0);
+
+    /** Reads the numeric "source" field of a Corelink data header without allocating */
+    static bool parseSourceStreamId(const uint8_t* header, size_t size, int& sourceStreamId);
+
+    int getNumStreams() const { return mNumStreams.load(std::memory_order_acquire); }
+    int getStreamId(int index) const;
+    int findStream(int sourceStreamId) const;
+    bool pop(int index, ReceivedPacket& dest);
+    /** Consumer: true once for a slot that was retired; it is reused for the next new stream */
+    bool releaseRetired(int index);
+    size_t getMaxPacketSize() const { return mMaxPacketSize; }
+
+    struct Counters
+    {
+        uint64_t received = 0;
+        uint64_t duplicates = 0;
+        uint64_t stale = 0;
+        uint64_t invalid = 0;
+        uint64_t recovered = 0;
+        uint64_t dropped = 0;
+        uint64_t kernelStamped = 0;
+        uint64_t restarts = 0;
+    };
+
+    Counters getCounters(int index) const;
+    const JitterStatistics* getStatistics(int index) const;
+    const JitterStatistics* getUserStatistics(int index) const;
+    uint64_t getNumUnroutable() const { return mNumUnroutable.load(std::memory_order_relaxed); }
+
+private:
+    struct Stream;
+
+    Stream* findOrAddStream(int sourceStreamId, uint64_t arrivalNs);
+    Stream* recycleStream(int sourceStreamId, uint64_t arrivalNs);
+    bool accept(Stream& stream, const uint8_t* packet, size_t size, uint64_t arrivalNs, uint64_t userArrivalNs, bool recovered, PacketHeader& header);
+    bool markSeen(Stream& stream, uint64_t sequence);
+
+    size_t mMaxPacketSize = 0;
+    int mQueuePackets = INGEST_QUEUE_PACKETS;
+    std::vector<std::unique_ptr<Stream>> mStreams;
+    std::atomic<int> mNumStreams { 0 };
+    int mLastStream = 0;
+    const ClockSync* mClock = nullptr;
+    std::atomic<uint64_t> mNumUnroutable { 0 };
+};
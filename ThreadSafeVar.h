@@ -1,6 +1,12 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <mutex>
+#include <type_traits>
 
-template <typename T>
+template <typename T, bool = std::is_trivially_copyable_v<T>>
 class ThreadSafeVar {
 public:
     ThreadSafeVar() : value() {}
@@ -22,9 +28,70 @@ public:
       cv.wait(lock, [&]() { return value == new_value; });
     }
 
+    template <typename Rep, typename Period>
+    bool waitForValueFor(T new_value, std::chrono::duration<Rep, Period> timeout) {
+      std::unique_lock<std::mutex> lock(m);
+      return cv.wait_for(lock, timeout, [&]() { return value == new_value; });
+    }
+
 private:
     T value;
     mutable std::mutex m;
     std::condition_variable cv;
 };
 
+// Trivially copyable values (bool, float, ...) are read on the audio thread, so they live in
+// a std::atomic: get() is a single load and waitForValue() uses atomic::wait. atomic::wait has no
+// timed form, so waitForValueFor() sleeps on a condition variable that set() only signals while
+// such a waiter is registered; set() stays lock-free otherwise.
+template <typename T>
+class ThreadSafeVar<T, true> {
+public:
+    ThreadSafeVar() : value(T()) {}
+    ThreadSafeVar(const T value) : value(value) {}
+
+    T get() const {
+      return value.load(std::memory_order_acquire);
+    }
+
+    void set(const T newValue){
+      value.store(newValue, std::memory_order_seq_cst);
+      value.notify_all();
+      if (timedWaiters.load(std::memory_order_seq_cst) > 0) {
+        // Taking the lock orders this with a waiter between its check and its wait
+        std::lock_guard<std::mutex> lock(m);
+        cv.notify_all();
+      }
+    }
+
+    void waitForValue(T new_value) {
+      T current = value.load(std::memory_order_acquire);
+      while (!(current == new_value)) {
+        value.wait(current, std::memory_order_acquire);
+        current = value.load(std::memory_order_acquire);
+      }
+    }
+
+    // Returns false if the value was not new_value within timeout
+    template <typename Rep, typename Period>
+    bool waitForValueFor(T new_value, std::chrono::duration<Rep, Period> timeout) {
+      if (value.load(std::memory_order_acquire) == new_value)
+        return true;
+      // Registered before the value is checked under the lock, so a set() in between is either
+      // seen by the check or sees the waiter and signals it
+      timedWaiters.fetch_add(1, std::memory_order_seq_cst);
+      bool matched;
+      {
+        std::unique_lock<std::mutex> lock(m);
+        matched = cv.wait_for(lock, timeout, [&]() { return value.load(std::memory_order_seq_cst) == new_value; });
+      }
+      timedWaiters.fetch_sub(1, std::memory_order_relaxed);
+      return matched;
+    }
+
+private:
+    std::atomic<T> value;
+    std::atomic<int> timedWaiters { 0 };
+    std::mutex m;
+    std::condition_variable cv;
+};
@@ -0,0 +1,106 @@
+#include "TimeScaler.h"
+
+#include <algorithm>
+#include <cmath>
+
+void TimeScaler::prepare(int numChannels, double sampleRate)
+{
+    mNumChannels = numChannels;
+    mMinPeriod = (int) std::lround(TSM_MIN_PERIOD_MS * sampleRate / 1000.0);
+    mMaxPeriod = (int) std::lround(TSM_MAX_PERIOD_MS * sampleRate / 1000.0);
+    mWindow = (int) std::lround(TSM_WINDOW_MS * sampleRate / 1000.0);
+    mMono.assign((size_t) (mMaxPeriod + mWindow), 0.0f);
+}
+
+int TimeScaler::compress(float* const* channels, int numSamples, int maxRemove)
+{
+    const int maxLag = std::min({ mMaxPeriod, maxRemove, (numSamples - mWindow) / 2 });
+    if (maxLag < mMinPeriod)
+        return numSamples;
+
+    // The search only looks at the first maxLag + window samples of the mono mix
+    const int length = maxLag + mWindow;
+    const float scale = 1.0f / (float) mNumChannels;
+    for (int i = 0; i < length; ++i)
+    {
+        float sum = 0.0f;
+        for (int ch = 0; ch < mNumChannels; ++ch)
+            sum += channels[ch][i];
+        mMono[(size_t) i] = sum * scale;
+    }
+
+    double reference = 0.0;
+    for (int i = 0; i < mWindow; ++i)
+        reference += (double) mMono[(size_t) i] * mMono[(size_t) i];
+    if (reference <= 1e-12)
+        return numSamples;
+
+    // Every other lag first, then the neighbours of the best one
+    int bestLag = 0;
+    double best = -1.0;
+    for (int lag = mMinPeriod; lag <= maxLag; lag += 2)
+    {
+        double energy = 0.0;
+        const double s = getSimilarity(lag, energy) / std::sqrt(reference * energy + 1e-20);
+        if (s > best)
+        {
+            best = s;
+            bestLag = lag;
+        }
+    }
+    for (int lag : { bestLag - 1, bestLag + 1 })
+    {
+        if (lag < mMinPeriod || lag > maxLag)
+            continue;
+        double energy = 0.0;
+        const double s = getSimilarity(lag, energy) / std::sqrt(reference * energy + 1e-20);
+        if (s > best)
+        {
+            best = s;
+            bestLag = lag;
+        }
+    }
+
+    if (best < TSM_MIN_SIMILARITY)
+        return numSamples;
+
+    // Cross-fade the first period into the second and close the gap
+    for (int ch = 0; ch < mNumChannels; ++ch)
+    {
+        float* x = channels[ch];
+        for (int i = 0; i < bestLag; ++i)
+        {
+            const float w = ((float) i + 0.5f) / (float) bestLag;
+            x[i] = (1.0f - w) * x[i] + w * x[i + bestLag];
+        }
+        std::copy(x + 2 * bestLag, x + numSamples, x + bestLag);
+    }
+    return numSamples - bestLag;
+}
+
+bool TimeScaler::isSilent(const float* const* channels, int numSamples) const
+{
+    for (int ch = 0; ch < mNumChannels; ++ch)
+    {
+        double energy = 0.0;
+        for (int i = 0; i < numSamples; ++i)
+            energy += (double) channels[ch][i] * channels[ch][i];
+        if (energy > (double) TSM_SILENCE_LEVEL * TSM_SILENCE_LEVEL * numSamples)
+            return false;
+    }
+    return true;
+}
+
+double TimeScaler::getSimilarity(int lag, double& energy) const
+{
+    double cross = 0.0;
+    energy = 0.0;
+    const float* a = mMono.data();
+    const float* b = mMono.data() + lag;
+    for (int i = 0; i < mWindow; ++i)
+    {
+        cross += (double) a[i] * b[i];
+        energy += (double) b[i] * b[i];
+    }
+    return cross;
+}
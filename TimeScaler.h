@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#define TSM_MIN_PERIOD_MS 2.5
+#define TSM_MAX_PERIOD_MS 15.0
+#define TSM_WINDOW_MS 5.0
+#define TSM_MIN_SIMILARITY 0.5f
+#define TSM_SILENCE_LEVEL 0.001f
+
+/**
+ * @brief WSOLA-style shortening of buffered audio, used by the playout buffer to catch up
+ *
+ * compress() searches the start of a block for the lag T at which the waveform best repeats
+ * (normalized cross-correlation of a TSM_WINDOW_MS window on the mono mix, first every other
+ * lag and then refined). The first 2T samples are replaced by one T-sample cross-fade between
+ * them, which removes T samples without a discontinuity. Blocks with no lag similar enough are
+ * left alone; silent blocks are better dropped whole, which isSilent() detects.
+ *
+ * Lengthening is the reverse and is done by LossConcealer::extend(), which already repeats the
+ * last period and cross-fades back into the next frame.
+ *
+ * prepare() allocates. compress() does not allocate and costs the same for any content.
+*/
+class TimeScaler
+{
+public:
+    TimeScaler() = default;
+
+    void prepare(int numChannels, double sampleRate);
+
+    /** Removes one matching segment of at most maxRemove samples from the start; returns the new length */
+    int compress(float* const* channels, int numSamples, int maxRemove);
+    /** Samples compress() needs to remove the shortest period, and to consider the longest */
+    int getMinCompressLength() const { return 2 * mMinPeriod + mWindow; }
+    int getMaxCompressLength() const { return 2 * mMaxPeriod + mWindow; }
+
+    bool isSilent(const float* const* channels, int numSamples) const;
+
+private:
+    double getSimilarity(int lag, double& energy) const;
+
+    int mNumChannels = 0;
+    int mMinPeriod = 0;
+    int mMaxPeriod = 0;
+    int mWindow = 0;
+    std::vector<float> mMono;
+};
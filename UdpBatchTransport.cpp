@@ -0,0 +1,360 @@
+#include "UdpBatchTransport.h"
+
+#include "PacketHeader.h"
+#include "SocketTimestamping.h"
+
+#include <juce_core/juce_core.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if JUCE_LINUX
+    #include <cerrno>
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/udp.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+
+    #ifndef UDP_SEGMENT
+        #define UDP_SEGMENT 103
+    #endif
+#endif
+
+namespace
+{
+    constexpr int kMaxGsoSegments = 64;
+}
+
+UdpBatchTransport::UdpBatchTransport()
+{
+    mSendArena = std::make_unique<uint8_t[]>((size_t) UDP_BATCH_PACKETS * UDP_BATCH_MAX_DATAGRAM);
+    mReceiveArena = std::make_unique<uint8_t[]>((size_t) UDP_BATCH_PACKETS * (UDP_BATCH_MAX_DATAGRAM + TIMESTAMPING_CONTROL_SIZE));
+}
+
+UdpBatchTransport::~UdpBatchTransport()
+{
+    close();
+}
+
+#if JUCE_LINUX
+namespace
+{
+    // Tries every address host resolves to until one socket can be set up with setup()
+    template <typename Setup>
+    int openSocket(const std::string& host, int port, int flags, Setup&& setup)
+    {
+        addrinfo hints {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        hints.ai_flags = flags;
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(host.empty() ? nullptr : host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+            return -1;
+
+        int fd = -1;
+        for (auto* address = addresses; address != nullptr && fd < 0; address = address->ai_next)
+        {
+            fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (fd >= 0 && !setup(fd, *address))
+            {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(addresses);
+
+        // A whole batch lands at once; the kernel caps this at net.core.[rw]mem_max
+        if (fd >= 0)
+        {
+            const int bufferBytes = UDP_SOCKET_BUFFER_BYTES;
+            setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferBytes, sizeof(bufferBytes));
+            setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferBytes, sizeof(bufferBytes));
+        }
+        return fd;
+    }
+}
+
+bool UdpBatchTransport::open(const std::string& host, int port, bool useGso)
+{
+    close();
+    mSocket = openSocket(host, port, 0, [](int fd, const addrinfo& address) {
+        return connect(fd, address.ai_addr, address.ai_addrlen) == 0;
+    });
+    if (mSocket < 0)
+        return false;
+
+    // Setting a segment size of 0 succeeds exactly when the kernel knows UDP_SEGMENT
+    int segment = 0;
+    mGso = useGso && setsockopt(mSocket, SOL_UDP, UDP_SEGMENT, &segment, sizeof(segment)) == 0;
+    // The kernel counts sends from here, which is what readTransmitStamps() matches against
+    mTimestamping = SocketTimestamping::enable(mSocket, true);
+    mNumSentMessages = 0;
+    mNumSentDatagrams = 0;
+    return true;
+}
+
+bool UdpBatchTransport::bind(const std::string& host, int port)
+{
+    close();
+    mSocket = openSocket(host, port, AI_PASSIVE, [](int fd, const addrinfo& address) {
+        return ::bind(fd, address.ai_addr, address.ai_addrlen) == 0;
+    });
+    if (mSocket < 0)
+        return false;
+
+    mGso = false;
+    mTimestamping = SocketTimestamping::enable(mSocket, false);
+    return true;
+}
+
+void UdpBatchTransport::close()
+{
+    if (mSocket >= 0)
+        ::close(mSocket);
+    mSocket = -1;
+    mTimestamping = 0;
+    mNumQueued = 0;
+    mSendUsed = 0;
+}
+
+int UdpBatchTransport::getLocalPort() const
+{
+    sockaddr_storage address {};
+    socklen_t length = sizeof(address);
+    if (mSocket < 0 || getsockname(mSocket, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+        return 0;
+    if (address.ss_family == AF_INET6)
+        return ntohs(reinterpret_cast<const sockaddr_in6&>(address).sin6_port);
+    return ntohs(reinterpret_cast<const sockaddr_in&>(address).sin_port);
+}
+
+/**
+ * @brief Sends the queued batch in as few calls as the kernel allows; returns the datagrams sent or -1
+*/
+int UdpBatchTransport::sendBatch(bool gso)
+{
+    mmsghdr messages[UDP_BATCH_PACKETS] = {};
+    iovec vectors[UDP_BATCH_PACKETS];
+    alignas(cmsghdr) uint8_t control[UDP_BATCH_PACKETS][CMSG_SPACE(sizeof(uint16_t))];
+    int datagrams[UDP_BATCH_PACKETS];
+
+    auto sizeOf = [this](int i) { return mOffsets[i + 1] - mOffsets[i]; };
+
+    int numMessages = 0;
+    for (int first = 0; first < mNumQueued; ++numMessages)
+    {
+        // GSO cuts a buffer into segments of one size; only the last may be shorter
+        const size_t segment = sizeOf(first);
+        int end = first + 1;
+        while (gso && end < mNumQueued && end - first < kMaxGsoSegments && sizeOf(end) <= segment
+               && mOffsets[end + 1] - mOffsets[first] <= UDP_GSO_MAX_BYTES)
+        {
+            if (sizeOf(end++) < segment)
+                break;
+        }
+
+        auto& message = messages[numMessages].msg_hdr;
+        vectors[numMessages].iov_base = mSendArena.get() + mOffsets[first];
+        vectors[numMessages].iov_len = mOffsets[end] - mOffsets[first];
+        message.msg_iov = &vectors[numMessages];
+        message.msg_iovlen = 1;
+        datagrams[numMessages] = end - first;
+
+        if (end - first > 1)
+        {
+            message.msg_control = control[numMessages];
+            message.msg_controllen = sizeof(control[numMessages]);
+            auto* cmsg = CMSG_FIRSTHDR(&message);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            const auto segmentSize = (uint16_t) segment;
+            std::memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(segmentSize));
+        }
+        first = end;
+    }
+
+    int sentMessages = 0, sentDatagrams = 0;
+    while (sentMessages < numMessages)
+    {
+        const int result = sendmmsg(mSocket, messages + sentMessages, (unsigned) (numMessages - sentMessages), 0);
+        bump(mSendCalls);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            // Nothing went out: the caller may retry without GSO
+            if (sentMessages == 0)
+                return -1;
+            break;
+        }
+        for (int i = sentMessages; i < sentMessages + result; ++i)
+        {
+            // Each message is one send to the kernel and gets one transmit stamp
+            auto& sent = mSentMessages[mNumSentMessages++ % UDP_TX_STAMP_HISTORY];
+            sent.firstDatagram = mNumSentDatagrams;
+            sent.numDatagrams = datagrams[i];
+            for (int d = 0; d < datagrams[i]; ++d)
+                mSentTags[mNumSentDatagrams++ % UDP_TX_STAMP_HISTORY] = mTags[sentDatagrams + d];
+
+            sentDatagrams += datagrams[i];
+            if (datagrams[i] > 1)
+                bump(mGsoBuffers);
+        }
+        sentMessages += result;
+    }
+    return sentDatagrams;
+}
+
+int UdpBatchTransport::receive(const ReceiveCallback& callback, int timeoutMs)
+{
+    if (mSocket < 0)
+        return -1;
+
+    pollfd waitFor { mSocket, POLLIN, 0 };
+    if (poll(&waitFor, 1, timeoutMs) <= 0)
+        return 0;
+
+    mmsghdr messages[UDP_BATCH_PACKETS] = {};
+    iovec vectors[UDP_BATCH_PACKETS];
+    auto* controls = mReceiveArena.get() + (size_t) UDP_BATCH_PACKETS * UDP_BATCH_MAX_DATAGRAM;
+    for (int i = 0; i < UDP_BATCH_PACKETS; ++i)
+    {
+        vectors[i].iov_base = mReceiveArena.get() + (size_t) i * UDP_BATCH_MAX_DATAGRAM;
+        vectors[i].iov_len = UDP_BATCH_MAX_DATAGRAM;
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        messages[i].msg_hdr.msg_control = controls + (size_t) i * TIMESTAMPING_CONTROL_SIZE;
+        messages[i].msg_hdr.msg_controllen = TIMESTAMPING_CONTROL_SIZE;
+    }
+
+    const int received = recvmmsg(mSocket, messages, UDP_BATCH_PACKETS, MSG_DONTWAIT, nullptr);
+    bump(mReceiveCalls);
+    if (received < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            mErrors.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    // One user-space stamp serves the whole batch; the kernel stamps say when each one came in
+    const uint64_t arrivalNs = getMonotonicTimeNs();
+    for (int i = 0; i < received; ++i)
+    {
+        const auto& message = messages[i].msg_hdr;
+        PacketTimestamp timestamp;
+        SocketTimestamping::readReceive(message.msg_control, message.msg_controllen, timestamp);
+        if ((message.msg_flags & MSG_TRUNC) == 0)
+            callback(static_cast<const uint8_t*>(vectors[i].iov_base), messages[i].msg_len, arrivalNs, timestamp.softwareNs);
+    }
+    bump(mDatagramsReceived, (uint64_t) received);
+    return received;
+}
+#else
+bool UdpBatchTransport::open(const std::string&, int, bool) { return false; }
+bool UdpBatchTransport::bind(const std::string&, int) { return false; }
+void UdpBatchTransport::close() { mSocket = -1; mNumQueued = 0; mSendUsed = 0; }
+int UdpBatchTransport::getLocalPort() const { return 0; }
+int UdpBatchTransport::sendBatch(bool) { return -1; }
+int UdpBatchTransport::receive(const ReceiveCallback&, int) { return -1; }
+#endif
+
+int UdpBatchTransport::readTransmitStamps(const TransmitCallback& callback)
+{
+    if (mSocket < 0 || (mTimestamping & SocketTimestamping::SoftwareTransmit) == 0)
+        return 0;
+
+    int numStamps = 0;
+    uint32_t sendIndex = 0;
+    PacketTimestamp timestamp;
+    while (SocketTimestamping::readTransmit(mSocket, sendIndex, timestamp))
+    {
+        // The kernel's count is 32 bits; it is matched against the most recent sends with that count
+        const uint64_t message = (mNumSentMessages & ~(uint64_t) UINT32_MAX) | sendIndex;
+        const uint64_t index = message < mNumSentMessages ? message : message - ((uint64_t) UINT32_MAX + 1);
+        if (timestamp.softwareNs == 0 || index >= mNumSentMessages || mNumSentMessages - index > UDP_TX_STAMP_HISTORY)
+            continue;
+
+        const auto& sent = mSentMessages[index % UDP_TX_STAMP_HISTORY];
+        for (int d = 0; d < sent.numDatagrams; ++d)
+        {
+            const uint64_t datagram = sent.firstDatagram + (uint64_t) d;
+            const uint64_t tag = mSentTags[datagram % UDP_TX_STAMP_HISTORY];
+            if (mNumSentDatagrams - datagram > UDP_TX_STAMP_HISTORY || tag == UDP_UNTRACKED)
+                continue;
+            callback(tag, timestamp.softwareNs);
+            ++numStamps;
+        }
+    }
+    bump(mTransmitStamps, (uint64_t) numStamps);
+    return numStamps;
+}
+
+/**
+ * @brief Copies prefix and payload into the batch as one datagram, sending the batch first if it is full
+*/
+bool UdpBatchTransport::queue(const uint8_t* prefix, size_t prefixSize, const uint8_t* payload, size_t payloadSize, uint64_t tag)
+{
+    const size_t size = prefixSize + payloadSize;
+    if (mSocket < 0 || size == 0 || size > UDP_BATCH_MAX_DATAGRAM)
+        return false;
+
+    if (mNumQueued == UDP_BATCH_PACKETS)
+        flush();
+
+    auto* dest = mSendArena.get() + mSendUsed;
+    if (prefixSize > 0)
+        std::memcpy(dest, prefix, prefixSize);
+    std::memcpy(dest + prefixSize, payload, payloadSize);
+    mOffsets[mNumQueued] = mSendUsed;
+    mTags[mNumQueued] = tag;
+    mSendUsed += size;
+    mOffsets[++mNumQueued] = mSendUsed;
+    return true;
+}
+
+/**
+ * @brief Sends everything queued. Returns the number of datagrams the kernel took
+*/
+int UdpBatchTransport::flush()
+{
+    if (mNumQueued == 0)
+        return 0;
+
+    int sent = sendBatch(mGso);
+    if (sent < 0 && mGso)
+    {
+        mGso = false;
+        sent = sendBatch(false);
+    }
+    if (sent < mNumQueued)
+        mErrors.fetch_add((uint64_t) (mNumQueued - std::max(sent, 0)), std::memory_order_relaxed);
+    bump(mDatagramsSent, (uint64_t) std::max(sent, 0));
+
+    mNumQueued = 0;
+    mSendUsed = 0;
+    return std::max(sent, 0);
+}
+
+UdpBatchTransport::Counters UdpBatchTransport::getCounters() const
+{
+    Counters counters;
+    counters.datagramsSent = mDatagramsSent.load(std::memory_order_relaxed);
+    counters.sendCalls = mSendCalls.load(std::memory_order_relaxed);
+    counters.gsoBuffers = mGsoBuffers.load(std::memory_order_relaxed);
+    counters.datagramsReceived = mDatagramsReceived.load(std::memory_order_relaxed);
+    counters.receiveCalls = mReceiveCalls.load(std::memory_order_relaxed);
+    counters.errors = mErrors.load(std::memory_order_relaxed);
+    counters.transmitStamps = mTransmitStamps.load(std::memory_order_relaxed);
+    return counters;
+}
+
+/**
+ * @brief Single-writer increment
+*/
+void UdpBatchTransport::bump(std::atomic<uint64_t>& counter, uint64_t amount)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
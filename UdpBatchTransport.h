@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "PathMtuProber.h"
+
+#define UDP_BATCH_PACKETS 64
+#define UDP_BATCH_MAX_DATAGRAM PATH_MTU_MAX
+#define UDP_GSO_MAX_BYTES 65000
+#define UDP_SOCKET_BUFFER_BYTES (4 * 1024 * 1024)
+#define UDP_TX_STAMP_HISTORY 1024
+#define UDP_UNTRACKED UINT64_MAX
+
+// How audio datagrams reach the server; the control plane is always Corelink's
+enum class DataPlane
+{
+    Corelink,
+    UdpBatch
+};
+
+/**
+ * @brief Batched UDP data plane for Linux: sendmmsg/recvmmsg, with UDP GSO where the kernel has it
+ *
+ * queue() copies datagrams into a preallocated batch and flush() hands the whole batch to the
+ * kernel in one sendmmsg() call, so the per-packet cost is a copy rather than a system call.
+ * With GSO on, each run of equally sized datagrams in the batch goes out as one large buffer that
+ * the kernel (or the NIC) cuts into datagrams, so the stack is walked once per run instead of once
+ * per datagram. If the kernel refuses GSO the batch is resent without it and GSO stays off.
+ *
+ * receive() takes up to UDP_BATCH_PACKETS datagrams in one recvmmsg() call, each with its kernel
+ * receive stamp when the socket has SocketTimestamping enabled.
+ *
+ * open() also turns on transmit stamps. A datagram queued with a tag other than UDP_UNTRACKED is
+ * remembered for the last UDP_TX_STAMP_HISTORY send calls, and readTransmitStamps() hands its tag
+ * to the caller with the time the kernel sent it. The kernel stamps a GSO buffer once, so every
+ * datagram in it gets that stamp.
+ *
+ * One thread sends and one thread receives; the counters may be read from anywhere. open(),
+ * bind() and close() must not run concurrently with either. Elsewhere than Linux open() and
+ * bind() fail, and callers keep using the Corelink data path.
+*/
+class UdpBatchTransport
+{
+public:
+    // Called for each received datagram; kernelArrivalNs is 0 without a kernel stamp
+    using ReceiveCallback = std::function<void(const uint8_t* data, size_t size, uint64_t arrivalNs, uint64_t kernelArrivalNs)>;
+    // Called for each tagged datagram the kernel stamped on its way out, on the clock of getMonotonicTimeNs()
+    using TransmitCallback = std::function<void(uint64_t tag, uint64_t kernelSendNs)>;
+
+    UdpBatchTransport();
+    ~UdpBatchTransport();
+
+    /** Connects to the data port at host:port; every datagram is sent there */
+    bool open(const std::string& host, int port, bool useGso = true);
+    /** Listens on host:port, port 0 picking a free one */
+    bool bind(const std::string& host, int port);
+    void close();
+
+    bool isOpen() const { return mSocket >= 0; }
+    int getSocket() const { return mSocket; }
+    int getLocalPort() const;
+    bool isGsoEnabled() const { return mGso; }
+    /** SocketTimestamping::Capability bits of the socket */
+    unsigned getTimestamping() const { return mTimestamping; }
+
+    bool queue(const uint8_t* prefix, size_t prefixSize, const uint8_t* payload, size_t payloadSize, uint64_t tag = UDP_UNTRACKED);
+    int flush();
+    int getNumQueued() const { return mNumQueued; }
+    /** Sending thread: passes on the transmit stamps the kernel has queued so far. Returns how many */
+    int readTransmitStamps(const TransmitCallback& callback);
+
+    int receive(const ReceiveCallback& callback, int timeoutMs);
+
+    struct Counters
+    {
+        uint64_t datagramsSent = 0;
+        uint64_t sendCalls = 0;
+        uint64_t gsoBuffers = 0;
+        uint64_t datagramsReceived = 0;
+        uint64_t receiveCalls = 0;
+        uint64_t errors = 0;
+        uint64_t transmitStamps = 0;
+    };
+
+    Counters getCounters() const;
+
+private:
+    int sendBatch(bool gso);
+    static void bump(std::atomic<uint64_t>& counter, uint64_t amount = 1);
+
+    int mSocket = -1;
+    bool mGso = false;
+    unsigned mTimestamping = 0;
+
+    // Send side: datagrams packed back to back, so a run of them is one contiguous buffer
+    std::unique_ptr<uint8_t[]> mSendArena;
+    size_t mSendUsed = 0;
+    size_t mOffsets[UDP_BATCH_PACKETS + 1] = {};
+    int mNumQueued = 0;
+    uint64_t mTags[UDP_BATCH_PACKETS] = {};
+
+    // Tags of the datagrams of recent send calls, by the kernel's count of sends on the socket
+    struct SentMessage
+    {
+        uint64_t firstDatagram = 0;
+        int numDatagrams = 0;
+    };
+    SentMessage mSentMessages[UDP_TX_STAMP_HISTORY];
+    uint64_t mSentTags[UDP_TX_STAMP_HISTORY] = {};
+    uint64_t mNumSentMessages = 0;
+    uint64_t mNumSentDatagrams = 0;
+
+    // Receive side
+    std::unique_ptr<uint8_t[]> mReceiveArena;
+
+    std::atomic<uint64_t> mDatagramsSent { 0 };
+    std::atomic<uint64_t> mSendCalls { 0 };
+    std::atomic<uint64_t> mGsoBuffers { 0 };
+    std::atomic<uint64_t> mDatagramsReceived { 0 };
+    std::atomic<uint64_t> mReceiveCalls { 0 };
+    std::atomic<uint64_t> mErrors { 0 };
+    std::atomic<uint64_t> mTransmitStamps { 0 };
+};
@@ -0,0 +1,61 @@
+#include <MdctCodec.h>
+#include "catch2/benchmark/catch_benchmark_all.hpp"
+#include "catch2/catch_test_macros.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+TEST_CASE ("MDCT codec performance")
+{
+    const double sampleRate = 48000.0;
+    const int blockSize = 480;
+
+    std::mt19937 rng (11);
+    std::normal_distribution<float> noise (0.0f, 0.01f);
+    std::vector<float> channel ((size_t) sampleRate);
+    for (size_t i = 0; i < channel.size(); ++i)
+        channel[i] = 0.3f * std::sin (2.0f * 3.14159f * 440.0f * (float) i / (float) sampleRate) + noise (rng);
+
+    for (int channelBitrate : { 32000, 64000, 128000 })
+    {
+        // One channel per codec so the cost scales directly to channels per core
+        MdctCodec codec (channelBitrate);
+        codec.prepare (sampleRate, 1, blockSize);
+        std::vector<uint8_t> payload (codec.getMaxEncodedSize (1, blockSize));
+        std::vector<float> decoded ((size_t) blockSize);
+        float* dest[] = { decoded.data() };
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t pos = 0; pos + blockSize <= channel.size(); pos += blockSize)
+        {
+            const float* src[] = { channel.data() + pos };
+            int numEncoded = 0;
+            codec.encode (src, 1, blockSize, payload.data(), payload.size(), numEncoded);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "MDCT " << channelBitrate / 1000 << " kbps: encoding one second of one channel takes "
+                  << elapsed.count() * 1000.0 << " ms, about " << (int) (1.0 / elapsed.count())
+                  << " channels per core in real time" << std::endl;
+
+        const auto suffix = " (" + std::to_string (channelBitrate / 1000) + " kbps, 1 ch x 480)";
+        const float* src[] = { channel.data() };
+
+        BENCHMARK ("Encode" + suffix)
+        {
+            int numEncoded = 0;
+            return codec.encode (src, 1, blockSize, payload.data(), payload.size(), numEncoded);
+        };
+
+        int numEncoded = 0;
+        const auto size = codec.encode (src, 1, blockSize, payload.data(), payload.size(), numEncoded);
+
+        BENCHMARK ("Decode" + suffix)
+        {
+            return codec.decode (payload.data(), size, 1, numEncoded, dest);
+        };
+    }
+}
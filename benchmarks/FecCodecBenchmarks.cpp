@@ -0,0 +1,89 @@
+#include <FecCodec.h>
+#include "catch2/benchmark/catch_benchmark_all.hpp"
+#include "catch2/catch_test_macros.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+TEST_CASE ("FEC codec performance")
+{
+    // A 10 ms, 4-channel float frame plus its header
+    const size_t packetSize = 40 + 4 * 480 * 4;
+    const int numGroups = 200;
+
+    std::mt19937 rng (1);
+    std::vector<std::vector<uint8_t>> packets (64, std::vector<uint8_t> (packetSize));
+    for (auto& packet : packets)
+        for (auto& b : packet)
+            b = (uint8_t) rng();
+
+    for (auto [k, m] : { std::pair { 4, 1 }, std::pair { 8, 1 }, std::pair { 8, 2 }, std::pair { 16, 4 } })
+    {
+        FecEncoder encoder;
+        encoder.prepare (packetSize);
+        encoder.setCode (k, m);
+
+        std::vector<std::vector<uint8_t>> repairs ((size_t) m, std::vector<uint8_t> (encoder.getMaxRepairPacketSize()));
+        uint64_t sequence = 0;
+        const auto encodeStart = std::chrono::steady_clock::now();
+        for (int g = 0; g < numGroups; ++g)
+        {
+            for (int i = 0; i < k; ++i, ++sequence)
+            {
+                const auto& packet = packets[sequence % packets.size()];
+                const int ready = encoder.addPacket (packet.data(), packet.size(), sequence);
+                for (int j = 0; j < ready; ++j)
+                    encoder.writeRepairPacket (j, repairs[(size_t) j].data(), repairs[(size_t) j].size());
+            }
+        }
+        const std::chrono::duration<double> encodeTime = std::chrono::steady_clock::now() - encodeStart;
+
+        // Decode with m packets of every group lost, the worst case the code still recovers
+        FecDecoder decoder;
+        decoder.prepare (packetSize);
+        std::vector<std::vector<std::vector<uint8_t>>> groupRepairs;
+        sequence = 0;
+        encoder.reset();
+        for (int g = 0; g < numGroups; ++g)
+        {
+            for (int i = 0; i < k; ++i, ++sequence)
+            {
+                const auto& packet = packets[sequence % packets.size()];
+                if (encoder.addPacket (packet.data(), packet.size(), sequence) > 0)
+                {
+                    groupRepairs.emplace_back();
+                    for (int j = 0; j < m; ++j)
+                    {
+                        std::vector<uint8_t> repair (encoder.getMaxRepairPacketSize());
+                        repair.resize (encoder.writeRepairPacket (j, repair.data(), repair.size()));
+                        groupRepairs.back().push_back (std::move (repair));
+                    }
+                }
+            }
+        }
+
+        sequence = 0;
+        const auto decodeStart = std::chrono::steady_clock::now();
+        for (int g = 0; g < numGroups; ++g)
+        {
+            for (int i = 0; i < k; ++i, ++sequence)
+            {
+                if (i < m)
+                    continue;
+                const auto& packet = packets[sequence % packets.size()];
+                decoder.addSourcePacket (packet.data(), packet.size(), sequence);
+            }
+            for (const auto& repair : groupRepairs[(size_t) g])
+                decoder.addRepairPacket (repair.data(), repair.size());
+        }
+        const std::chrono::duration<double> decodeTime = std::chrono::steady_clock::now() - decodeStart;
+
+        const double sourceBytes = (double) packetSize * k * numGroups;
+        std::cout << "FEC (" << k << ", " << m << "): encode " << sourceBytes / encodeTime.count() / 1e6
+                  << " MB/s, decode with " << m << " losses per group " << sourceBytes / decodeTime.count() / 1e6
+                  << " MB/s, recovered " << decoder.getNumRecovered() << "/" << numGroups * m << std::endl;
+        CHECK (decoder.getNumRecovered() == (uint64_t) (numGroups * m));
+    }
+}
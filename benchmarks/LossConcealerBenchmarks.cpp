@@ -0,0 +1,47 @@
+#include <LossConcealer.h>
+#include "catch2/benchmark/catch_benchmark_all.hpp"
+#include "catch2/catch_test_macros.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+TEST_CASE ("Loss concealment performance")
+{
+    // Four channels of 10 ms frames; the first concealed frame pays for the pitch search
+    const int numChannels = 4;
+    const int frame = 480;
+    std::mt19937 rng (1);
+    std::normal_distribution<float> noise (0.0f, 0.05f);
+    std::vector<std::vector<float>> input ((size_t) numChannels, std::vector<float> ((size_t) frame));
+    for (auto& channel : input)
+        for (size_t i = 0; i < channel.size(); ++i)
+            channel[i] = 0.5f * std::sin (2.0f * 3.14159265f * 150.0f * (float) i / 48000.0f) + noise (rng);
+
+    std::vector<float*> channels;
+    std::vector<std::vector<float>> output ((size_t) numChannels, std::vector<float> ((size_t) frame));
+    std::vector<float*> dest;
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        channels.push_back (input[(size_t) ch].data());
+        dest.push_back (output[(size_t) ch].data());
+    }
+
+    LossConcealer concealer;
+    concealer.prepare (numChannels, 48000.0, frame);
+    for (int i = 0; i < 4; ++i)
+        concealer.process (channels.data(), frame);
+
+    BENCHMARK ("First concealed frame, 4 channels")
+    {
+        concealer.process (channels.data(), frame);
+        concealer.conceal (dest.data(), frame);
+        return output[0][0];
+    };
+
+    BENCHMARK ("Good frame, 4 channels")
+    {
+        concealer.process (channels.data(), frame);
+        return input[0][0];
+    };
+}
@@ -0,0 +1,103 @@
+#include <LosslessCodec.h>
+#include "catch2/benchmark/catch_benchmark_all.hpp"
+#include "catch2/catch_test_macros.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Rough stand-ins for the material the sender carries: a voiced, bursty signal for speech, a
+    // dense harmonic mix with correlated channels for music, and digital silence
+    std::vector<std::vector<float>> makeSignal (const std::string& kind, int numChannels, int numFrames)
+    {
+        std::mt19937 rng (7);
+        std::normal_distribution<float> noise (0.0f, 1.0f);
+        std::vector<std::vector<float>> channels ((size_t) numChannels, std::vector<float> ((size_t) numFrames));
+
+        for (int i = 0; i < numFrames; ++i)
+        {
+            const float t = (float) i / 48000.0f;
+            float mono = 0.0f;
+
+            if (kind == "speech")
+            {
+                const float envelope = std::max (0.0f, std::sin (2.0f * 3.14159f * 3.0f * t));
+                for (int h = 1; h <= 12; ++h)
+                    mono += std::sin (2.0f * 3.14159f * 140.0f * (float) h * t) / (float) (h * h);
+                mono = 0.4f * envelope * mono + 0.002f * noise (rng);
+            }
+            else if (kind == "music")
+            {
+                for (float f : { 110.0f, 164.8f, 220.0f, 277.2f, 329.6f, 440.0f, 659.3f, 880.0f })
+                    mono += 0.08f * std::sin (2.0f * 3.14159f * f * t);
+                mono += 0.01f * noise (rng);
+            }
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                channels[(size_t) ch][(size_t) i] = kind == "silence" ? 0.0f : mono * (1.0f - 0.1f * (float) ch) + 0.001f * noise (rng);
+        }
+        return channels;
+    }
+}
+
+TEST_CASE ("Lossless codec performance")
+{
+    const int numChannels = 4;
+    const int numFrames = 480;
+    const int numBlocks = 100;
+
+    LosslessCodec codec;
+    codec.prepare (numChannels, numFrames);
+
+    for (const std::string kind : { "speech", "music", "silence" })
+    {
+        auto signal = makeSignal (kind, numChannels, numFrames * numBlocks);
+        std::vector<uint8_t> packet (LosslessCodec::getMaxEncodedSize (numChannels, numFrames, 24));
+
+        for (int bitsPerSample : { 16, 24 })
+        {
+            size_t encodedBytes = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (int block = 0; block < numBlocks; ++block)
+            {
+                std::vector<const float*> ptrs;
+                for (auto& c : signal)
+                    ptrs.push_back (c.data() + block * numFrames);
+                encodedBytes += codec.encode (ptrs.data(), numChannels, numFrames, bitsPerSample, packet.data(), packet.size());
+            }
+
+            const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+            const double numSamples = (double) numChannels * numFrames * numBlocks;
+            const double rawBytes = numSamples * bitsPerSample / 8.0;
+            std::cout << "Lossless " << kind << " " << bitsPerSample << "-bit: compression ratio "
+                      << rawBytes / (double) encodedBytes << ", encode " << elapsed.count() / numSamples << " ns/sample" << std::endl;
+
+            std::vector<const float*> ptrs;
+            for (auto& c : signal)
+                ptrs.push_back (c.data());
+
+            BENCHMARK ("Encode " + kind + " " + std::to_string (bitsPerSample) + "-bit (4 ch x 480)")
+            {
+                return codec.encode (ptrs.data(), numChannels, numFrames, bitsPerSample, packet.data(), packet.size());
+            };
+
+            const auto size = codec.encode (ptrs.data(), numChannels, numFrames, bitsPerSample, packet.data(), packet.size());
+            std::vector<std::vector<float>> decoded ((size_t) numChannels, std::vector<float> (numFrames));
+            std::vector<float*> decodedPtrs;
+            for (auto& c : decoded)
+                decodedPtrs.push_back (c.data());
+
+            BENCHMARK ("Decode " + kind + " " + std::to_string (bitsPerSample) + "-bit (4 ch x 480)")
+            {
+                int decodedChannels = 0, decodedFrames = 0;
+                return codec.decode (packet.data(), size, decodedPtrs.data(), numChannels, numFrames, decodedChannels, decodedFrames);
+            };
+        }
+    }
+}
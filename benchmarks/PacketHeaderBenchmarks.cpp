@@ -0,0 +1,31 @@
+#include <PacketHeader.h>
+#include "catch2/benchmark/catch_benchmark_all.hpp"
+#include "catch2/catch_test_macros.hpp"
+
+TEST_CASE ("Packet header performance")
+{
+    PacketHeader header;
+    header.numChannels = 4;
+    header.sequence = 123456789;
+    header.samplePosition = 987654321;
+    header.sendTimeNs = getMonotonicTimeNs();
+    header.numFrames = 256;
+    header.payloadSize = 4 * 256 * sizeof (float);
+
+    uint8_t buffer[PacketHeader::kSize + 4 * 256 * sizeof (float)] = {};
+
+    BENCHMARK ("Encode")
+    {
+        header.sequence++;
+        return header.encode (buffer, sizeof (buffer));
+    };
+
+    header.encode (buffer, sizeof (buffer));
+
+    BENCHMARK ("Decode")
+    {
+        PacketHeader decoded;
+        PacketHeader::decode (buffer, sizeof (buffer), decoded);
+        return decoded.sequence;
+    };
+}
@@ -0,0 +1,35 @@
+#include <Resampler.h>
+#include <SampleConversion.h>
+#include "catch2/benchmark/catch_benchmark_all.hpp"
+#include "catch2/catch_test_macros.hpp"
+
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+TEST_CASE ("Resampler performance")
+{
+    // One 256-sample block of one channel at a drifting ratio
+    const int numSamples = 256;
+    std::vector<float> input (numSamples * 2);
+    for (size_t i = 0; i < input.size(); ++i)
+        input[i] = 0.5f * std::sin (0.05f * (float) i);
+    std::vector<float> output (numSamples);
+
+    Resampler resampler;
+    resampler.prepare();
+
+    for (auto [isa, name] : { std::pair { SampleConversion::Isa::Scalar, "scalar" },
+                              std::pair { SampleConversion::Isa::Sse2, "SSE2" },
+                              std::pair { SampleConversion::Isa::Avx2, "AVX2" } })
+    {
+        SampleConversion::setIsa (isa);
+        BENCHMARK ("Resample 256 samples, " + std::string (name))
+        {
+            resampler.process (input.data(), 20.3, 1.0002, output.data(), numSamples);
+            return output[0];
+        };
+    }
+    SampleConversion::setIsa (SampleConversion::getBestIsa());
+}
@@ -0,0 +1,69 @@
+#include <SampleConversion.h>
+#include "catch2/benchmark/catch_benchmark_all.hpp"
+#include "catch2/catch_test_macros.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+TEST_CASE ("Sample conversion performance")
+{
+    const int numFrames = 256;
+
+    for (int numChannels : { 2, 4, 8, 32 })
+    {
+        std::vector<std::vector<float>> channels ((size_t) numChannels, std::vector<float> (numFrames));
+        std::vector<const float*> channelPtrs;
+        for (size_t ch = 0; ch < channels.size(); ++ch)
+        {
+            for (int i = 0; i < numFrames; ++i)
+                channels[ch][(size_t) i] = 0.5f * std::sin (0.05f * (float) i * (float) (ch + 1));
+            channelPtrs.push_back (channels[ch].data());
+        }
+
+        std::vector<float> scratch ((size_t) numChannels * numFrames);
+        std::vector<uint8_t> payload ((size_t) numChannels * numFrames * sizeof (float));
+        Dither dither;
+
+        const auto suffix = " (" + std::to_string (numChannels) + " ch)";
+
+        // What sendData did before: planar float32 memcpy per channel
+        BENCHMARK ("Planar memcpy" + suffix)
+        {
+            auto* dest = payload.data();
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                std::memcpy (dest, channelPtrs[(size_t) ch], sizeof (float) * numFrames);
+                dest += sizeof (float) * numFrames;
+            }
+            return payload[0];
+        };
+
+        for (auto isa : { SampleConversion::Isa::Scalar, SampleConversion::Isa::Sse2, SampleConversion::Isa::Avx2 })
+        {
+            SampleConversion::setIsa (isa);
+            if (SampleConversion::getIsa() != isa)
+                continue;
+
+            const std::string isaName = isa == SampleConversion::Isa::Avx2 ? " AVX2" : isa == SampleConversion::Isa::Sse2 ? " SSE2" : " scalar";
+
+            BENCHMARK ("Interleave float32" + isaName + suffix)
+            {
+                return SampleConversion::pack (channelPtrs.data(), numChannels, numFrames, SampleFormat::Float32, nullptr, scratch.data(), payload.data());
+            };
+
+            BENCHMARK ("Pack int16 + TPDF" + isaName + suffix)
+            {
+                return SampleConversion::pack (channelPtrs.data(), numChannels, numFrames, SampleFormat::Int16, &dither, scratch.data(), payload.data());
+            };
+
+            BENCHMARK ("Pack int24 + TPDF" + isaName + suffix)
+            {
+                return SampleConversion::pack (channelPtrs.data(), numChannels, numFrames, SampleFormat::Int24, &dither, scratch.data(), payload.data());
+            };
+        }
+
+        SampleConversion::setIsa (SampleConversion::getBestIsa());
+    }
+}
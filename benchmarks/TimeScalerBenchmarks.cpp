@@ -0,0 +1,37 @@
+#include <TimeScaler.h>
+#include "catch2/benchmark/catch_benchmark_all.hpp"
+#include "catch2/catch_test_macros.hpp"
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+TEST_CASE ("Time-scaling performance")
+{
+    // One compression over the longest search, the most the playout buffer does per block
+    std::mt19937 rng (1);
+    std::normal_distribution<float> noise (0.0f, 0.05f);
+
+    for (int numChannels : { 1, 2, 4 })
+    {
+        TimeScaler scaler;
+        scaler.prepare (numChannels, 48000.0);
+        const int length = scaler.getMaxCompressLength();
+
+        std::vector<std::vector<float>> input ((size_t) numChannels, std::vector<float> ((size_t) length));
+        for (auto& channel : input)
+            for (size_t i = 0; i < channel.size(); ++i)
+                channel[i] = 0.5f * std::sin (2.0f * 3.14159265f * 150.0f * (float) i / 48000.0f) + noise (rng);
+        auto work = input;
+        std::vector<float*> channels;
+        for (auto& channel : work)
+            channels.push_back (channel.data());
+
+        BENCHMARK ("Compress, " + std::to_string (numChannels) + " channels")
+        {
+            work = input;
+            return scaler.compress (channels.data(), length, length);
+        };
+    }
+}
@@ -0,0 +1,110 @@
+#include <UdpBatchTransport.h>
+#include "catch2/benchmark/catch_benchmark_all.hpp"
+#include "catch2/catch_test_macros.hpp"
+
+#if defined(__linux__)
+    #include <atomic>
+    #include <ctime>
+    #include <sys/socket.h>
+    #include <thread>
+    #include <vector>
+
+namespace
+{
+    constexpr size_t kDatagramSize = 1000;
+    constexpr int kBatch = UDP_BATCH_PACKETS;
+
+    // Stands in for the Corelink server: takes whatever arrives on loopback as fast as it can
+    struct LoopbackServer
+    {
+        UdpBatchTransport socket;
+        std::atomic<bool> running { true };
+        std::thread thread;
+
+        LoopbackServer()
+        {
+            if (socket.bind ("127.0.0.1", 0))
+                thread = std::thread ([this] {
+                    while (running.load())
+                        socket.receive ([] (const uint8_t*, size_t, uint64_t, uint64_t) {}, 10);
+                });
+        }
+
+        ~LoopbackServer()
+        {
+            running = false;
+            if (thread.joinable())
+                thread.join();
+        }
+    };
+
+    uint64_t threadCpuNs()
+    {
+        timespec time;
+        clock_gettime (CLOCK_THREAD_CPUTIME_ID, &time);
+        return (uint64_t) time.tv_sec * 1000000000ull + (uint64_t) time.tv_nsec;
+    }
+
+    // The Corelink path: one owned copy and one send() per datagram
+    void sendEach (int fd, const std::vector<uint8_t>& datagram, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            std::vector<uint8_t> copy (datagram);
+            send (fd, copy.data(), copy.size(), 0);
+        }
+    }
+
+    void sendBatched (UdpBatchTransport& transport, const std::vector<uint8_t>& datagram, int count)
+    {
+        for (int i = 0; i < count; ++i)
+            transport.queue (nullptr, 0, datagram.data(), datagram.size());
+        transport.flush();
+    }
+}
+
+TEST_CASE ("UDP data plane performance")
+{
+    LoopbackServer server;
+    UdpBatchTransport perPacket, batched, segmented;
+    if (!server.socket.isOpen()
+        || !perPacket.open ("127.0.0.1", server.socket.getLocalPort(), false)
+        || !batched.open ("127.0.0.1", server.socket.getLocalPort(), false)
+        || !segmented.open ("127.0.0.1", server.socket.getLocalPort(), true))
+    {
+        WARN ("No loopback sockets here");
+        return;
+    }
+    const std::vector<uint8_t> datagram (kDatagramSize, 0x5A);
+
+    BENCHMARK ("64 datagrams, one send() each")
+    {
+        sendEach (perPacket.getSocket(), datagram, kBatch);
+    };
+
+    BENCHMARK ("64 datagrams, one sendmmsg()")
+    {
+        sendBatched (batched, datagram, kBatch);
+    };
+
+    BENCHMARK ("64 datagrams, sendmmsg() with UDP GSO")
+    {
+        sendBatched (segmented, datagram, kBatch);
+    };
+
+    // Packets per second and sender CPU per packet over a longer run of each path
+    constexpr int numPackets = 200000;
+    auto report = [&] (const char* name, auto&& sendAll) {
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t cpuStart = threadCpuNs();
+        for (int sent = 0; sent < numPackets; sent += kBatch)
+            sendAll();
+        const double cpuNs = (double) (threadCpuNs() - cpuStart);
+        const double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+        WARN (name << ": " << (int) (numPackets / seconds) << " packets/s, " << (int) (cpuNs / numPackets) << " ns CPU/packet");
+    };
+    report ("send() per datagram", [&] { sendEach (perPacket.getSocket(), datagram, kBatch); });
+    report ("sendmmsg()", [&] { sendBatched (batched, datagram, kBatch); });
+    report (segmented.isGsoEnabled() ? "sendmmsg() + GSO" : "sendmmsg() (GSO unavailable)", [&] { sendBatched (segmented, datagram, kBatch); });
+}
+#endif
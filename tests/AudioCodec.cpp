@@ -0,0 +1,170 @@
+#include <AudioCodec.h>
+#include <MdctCodec.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+    std::vector<std::vector<float>> makeSignal (int numChannels, int numFrames, bool noisy)
+    {
+        std::mt19937 rng (3);
+        std::normal_distribution<float> noise (0.0f, 0.1f);
+        std::vector<std::vector<float>> channels ((size_t) numChannels, std::vector<float> ((size_t) numFrames));
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < numFrames; ++i)
+                channels[(size_t) ch][(size_t) i] = noisy ? noise (rng)
+                                                          : 0.5f * std::sin (2.0f * 3.14159265f * 1000.0f * (float) (ch + 1) * (float) i / 48000.0f);
+        return channels;
+    }
+
+    // Streams the signal through encode/decode in blocks of blockSize and returns the decoded audio
+    std::vector<std::vector<float>> roundTrip (AudioCodec& codec, const std::vector<std::vector<float>>& input, int blockSize, size_t& totalBytes)
+    {
+        const int numChannels = (int) input.size();
+        const int numFrames = (int) input[0].size();
+        std::vector<std::vector<float>> output ((size_t) numChannels);
+        std::vector<uint8_t> payload (codec.getMaxEncodedSize (numChannels, blockSize));
+        std::vector<std::vector<float>> decoded ((size_t) numChannels, std::vector<float> ((size_t) blockSize + (size_t) codec.getFrameSize()));
+        totalBytes = 0;
+
+        for (int pos = 0; pos + blockSize <= numFrames; pos += blockSize)
+        {
+            std::vector<const float*> src;
+            std::vector<float*> dest;
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                src.push_back (input[(size_t) ch].data() + pos);
+                dest.push_back (decoded[(size_t) ch].data());
+            }
+
+            int numEncoded = 0;
+            const auto size = codec.encode (src.data(), numChannels, blockSize, payload.data(), payload.size(), numEncoded);
+            if (numEncoded == 0)
+                continue;
+
+            REQUIRE (size > 0);
+            totalBytes += size;
+            REQUIRE (codec.decode (payload.data(), size, numChannels, numEncoded, dest.data()));
+            for (int ch = 0; ch < numChannels; ++ch)
+                output[(size_t) ch].insert (output[(size_t) ch].end(), decoded[(size_t) ch].begin(), decoded[(size_t) ch].begin() + numEncoded);
+        }
+        return output;
+    }
+
+    double snrDb (const std::vector<float>& reference, const std::vector<float>& decoded, int delay, int skip)
+    {
+        double signal = 0.0, error = 0.0;
+        for (size_t i = (size_t) (skip + delay); i < decoded.size(); ++i)
+        {
+            const double r = reference[i - (size_t) delay];
+            signal += r * r;
+            error += (decoded[i] - r) * (decoded[i] - r);
+        }
+        return 10.0 * std::log10 (signal / std::max (error, 1e-20));
+    }
+}
+
+TEST_CASE ("Codec factory", "[codec]")
+{
+    StreamFormat format;
+    for (auto id : { CodecId::Pcm, CodecId::Lossless, CodecId::Mdct })
+    {
+        format.codec = id;
+        auto codec = AudioCodec::create (format);
+        REQUIRE (codec != nullptr);
+        CHECK (codec->getId() == id);
+    }
+
+    format.codec = (CodecId) 200;
+    CHECK (AudioCodec::create (format) == nullptr);
+}
+
+TEST_CASE ("PCM and lossless codecs round trip through the interface", "[codec]")
+{
+    const auto input = makeSignal (4, 4800, false);
+
+    for (auto id : { CodecId::Pcm, CodecId::Lossless })
+    {
+        StreamFormat format;
+        format.codec = id;
+        format.sampleFormat = SampleFormat::Int24;
+        auto codec = AudioCodec::create (format);
+        codec->prepare (48000.0, 4, 480);
+        codec->setDitherEnabled (false);
+
+        size_t bytes = 0;
+        const auto output = roundTrip (*codec, input, 480, bytes);
+        CHECK (codec->getAlgorithmicDelay() == 0);
+        for (int ch = 0; ch < 4; ++ch)
+            CHECK (snrDb (input[(size_t) ch], output[(size_t) ch], 0, 0) > 120.0);
+    }
+}
+
+TEST_CASE ("MDCT codec", "[codec]")
+{
+    MdctCodec codec (4 * 128000);
+    codec.prepare (48000.0, 4, 512);
+
+    SECTION ("algorithmic delay is at most 5 ms")
+    {
+        CHECK (codec.getFrameSize() == 120);
+        CHECK (codec.getAlgorithmicDelay() <= 240);
+    }
+
+    SECTION ("reconstructs tones and noise from arbitrary block sizes")
+    {
+        for (int blockSize : { 64, 120, 256, 480, 512 })
+        {
+            codec.reset();
+            const auto input = makeSignal (4, 48000, false);
+            size_t bytes = 0;
+            const auto output = roundTrip (codec, input, blockSize, bytes);
+            for (int ch = 0; ch < 4; ++ch)
+                CHECK (snrDb (input[(size_t) ch], output[(size_t) ch], codec.getDecoderDelay(), 480) > 25.0);
+        }
+
+        codec.reset();
+        const auto noise = makeSignal (4, 48000, true);
+        size_t bytes = 0;
+        const auto output = roundTrip (codec, noise, 480, bytes);
+        for (int ch = 0; ch < 4; ++ch)
+            CHECK (snrDb (noise[(size_t) ch], output[(size_t) ch], codec.getDecoderDelay(), 480) > 10.0);
+    }
+
+    SECTION ("stays within the bitrate")
+    {
+        for (int bitrate : { 4 * 32000, 4 * 64000, 4 * 128000 })
+        {
+            MdctCodec limited (bitrate);
+            limited.prepare (48000.0, 4, 480);
+            const auto noise = makeSignal (4, 48000, true);
+            size_t bytes = 0;
+            roundTrip (limited, noise, 480, bytes);
+            CHECK ((double) bytes * 8.0 <= bitrate * 1.02);
+            CHECK ((double) bytes * 8.0 >= bitrate * 0.8);
+        }
+    }
+
+    SECTION ("rejects payloads that do not match the header")
+    {
+        const auto input = makeSignal (4, 480, false);
+        std::vector<const float*> src;
+        for (auto& c : input)
+            src.push_back (c.data());
+
+        std::vector<uint8_t> payload (codec.getMaxEncodedSize (4, 480));
+        int numEncoded = 0;
+        const auto size = codec.encode (src.data(), 4, 480, payload.data(), payload.size(), numEncoded);
+        REQUIRE (numEncoded == 480);
+
+        std::vector<std::vector<float>> out (4, std::vector<float> (480));
+        std::vector<float*> dest;
+        for (auto& c : out)
+            dest.push_back (c.data());
+        CHECK_FALSE (codec.decode (payload.data(), size, 4, 360, dest.data()));
+        CHECK_FALSE (codec.decode (payload.data(), size / 2, 4, 480, dest.data()));
+    }
+}
@@ -0,0 +1,163 @@
+#include <AudioFrameRing.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Pushes one mono block whose samples all hold value
+    bool pushValue (AudioFrameRing& ring, float value, uint64_t position, int numSamples = 16)
+    {
+        std::vector<float> samples ((size_t) numSamples, value);
+        const float* channels[] = { samples.data() };
+        return ring.push (channels, 1, numSamples, position);
+    }
+}
+
+TEST_CASE ("Frame ring keeps order and drops the newest frame when full", "[framering]")
+{
+    AudioFrameRing ring;
+    ring.prepare (4, 1, 16);
+    ring.setOverflowPolicy (OverflowPolicy::DropNewest);
+
+    AudioFrame frame;
+    frame.allocate (1, 16);
+    CHECK_FALSE (ring.pop (frame));
+
+    for (int i = 0; i < 4; ++i)
+        REQUIRE (pushValue (ring, (float) i, (uint64_t) i));
+    CHECK (ring.getNumReady() == 4);
+
+    CHECK_FALSE (pushValue (ring, 99.0f, 99));
+    CHECK_FALSE (pushValue (ring, 100.0f, 100));
+    CHECK (ring.getNumDropped() == 2);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        REQUIRE (ring.pop (frame));
+        CHECK (frame.samplePosition == (uint64_t) i);
+        CHECK (frame.numSamples == 16);
+        CHECK (frame.getReadPointer (0)[15] == (float) i);
+    }
+    CHECK_FALSE (ring.pop (frame));
+    CHECK (ring.getNumDropped() == 2);
+}
+
+TEST_CASE ("Frame ring reclaims the oldest frame when full", "[framering]")
+{
+    AudioFrameRing ring;
+    ring.prepare (4, 1, 16);
+    ring.setOverflowPolicy (OverflowPolicy::DropOldest);
+
+    for (int i = 0; i < 6; ++i)
+        REQUIRE (pushValue (ring, (float) i, (uint64_t) i));
+    CHECK (ring.getNumDropped() == 2);
+    CHECK (ring.getNumReady() == 4);
+
+    AudioFrame frame;
+    frame.allocate (1, 16);
+    for (int i = 2; i < 6; ++i)
+    {
+        REQUIRE (ring.pop (frame));
+        CHECK (frame.samplePosition == (uint64_t) i);
+    }
+    CHECK_FALSE (ring.pop (frame));
+}
+
+TEST_CASE ("Frames reclaimed while being read are never returned torn", "[framering]")
+{
+    // The producer overruns a small ring as fast as it can, so DropOldest reclaims slots the
+    // consumer is copying. Every frame that comes out must be whole and in order
+    AudioFrameRing ring;
+    ring.prepare (2, 1, 256);
+    ring.setOverflowPolicy (OverflowPolicy::DropOldest);
+
+    constexpr int kFrames = 50000;
+    std::atomic<bool> done { false };
+    uint64_t numPopped = 0;
+    bool torn = false;
+    bool ordered = true;
+
+    std::thread consumer ([&] {
+        AudioFrame frame;
+        frame.allocate (1, 256);
+        int64_t last = -1;
+        for (;;)
+        {
+            const bool finished = done.load();
+            while (ring.pop (frame))
+            {
+                const float* samples = frame.getReadPointer (0);
+                for (int i = 1; i < frame.numSamples; ++i)
+                    torn |= samples[i] != samples[0];
+                torn |= samples[0] != (float) frame.samplePosition;
+                ordered &= (int64_t) frame.samplePosition > last;
+                last = (int64_t) frame.samplePosition;
+                ++numPopped;
+            }
+            if (finished)
+                break;
+        }
+    });
+
+    for (int i = 0; i < kFrames; ++i)
+        pushValue (ring, (float) i, (uint64_t) i, 256);
+    done = true;
+    consumer.join();
+
+    CHECK_FALSE (torn);
+    CHECK (ordered);
+    CHECK (numPopped > 0);
+    // Every frame was either read or counted as dropped
+    CHECK (numPopped + ring.getNumDropped() == (uint64_t) kFrames);
+}
+
+TEST_CASE ("A parked consumer is woken for every frame and by wakeConsumer", "[framering]")
+{
+    // The producer only notifies while the consumer is registered as asleep, so a lost
+    // wake-up would leave the consumer parked with frames ready and hang this test
+    AudioFrameRing ring;
+    ring.prepare (8, 1, 16);
+    ring.setOverflowPolicy (OverflowPolicy::DropNewest);
+
+    constexpr int kFrames = 20000;
+    std::atomic<bool> stop { false };
+    uint64_t numPopped = 0;
+
+    std::thread consumer ([&] {
+        AudioFrame frame;
+        frame.allocate (1, 16);
+        for (;;)
+        {
+            const auto signal = ring.getSignal();
+            if (stop.load() && ring.getNumReady() == 0)
+                break;
+            bool any = false;
+            while (ring.pop (frame))
+            {
+                ++numPopped;
+                any = true;
+            }
+            if (!any)
+                ring.waitForData (signal);
+        }
+    });
+
+    uint64_t numPushed = 0;
+    for (int i = 0; i < kFrames; ++i)
+    {
+        if (pushValue (ring, 1.0f, (uint64_t) i))
+            ++numPushed;
+        // Let the consumer catch up and park now and then
+        if (i % 100 == 0)
+            std::this_thread::sleep_for (std::chrono::microseconds (50));
+    }
+    stop = true;
+    ring.wakeConsumer();
+    consumer.join();
+
+    CHECK (numPopped == numPushed);
+    CHECK (numPushed + ring.getNumDropped() == (uint64_t) kFrames);
+}
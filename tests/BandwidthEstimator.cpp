@@ -0,0 +1,88 @@
+#include <BandwidthEstimator.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+    constexpr uint64_t kMs = 1000000;
+
+    // Trains of trainLength probes every intervalMs through a bottleneck of bytesPerSecond;
+    // extraDelayMs(train) is queuing added on top of a fixed 20 ms round trip
+    template <typename ExtraDelay>
+    void runTrains (BandwidthEstimator& estimator, int firstTrain, int numTrains, int trainLength, size_t size,
+                    double bytesPerSecond, ExtraDelay&& extraDelayMs)
+    {
+        const double spacingNs = (double) size / bytesPerSecond * 1e9;
+        for (int train = firstTrain; train < firstTrain + numTrains; ++train)
+        {
+            const uint64_t sentNs = 1000 * kMs + (uint64_t) train * 5 * kMs;
+            const double delayNs = 20.0 * kMs + extraDelayMs (train) * kMs;
+            for (int i = 0; i < trainLength; ++i)
+            {
+                const auto arrivalNs = sentNs + (uint64_t) std::llround (delayNs + spacingNs * (i + 1));
+                estimator.onProbe (train, size, sentNs, arrivalNs, (double) (arrivalNs - sentNs), arrivalNs);
+            }
+        }
+    }
+}
+
+TEST_CASE ("Bandwidth estimate follows the dispersion of probe trains", "[bandwidth]")
+{
+    BandwidthEstimator estimator;
+    CHECK (estimator.getEstimate().availableBytesPerSecond == 0.0);
+
+    // 8 x 1000 bytes through 2 MB/s: each probe leaves the bottleneck 0.5 ms after the one before
+    runTrains (estimator, 0, 100, 8, 1000, 2.0e6, [] (int) { return 0.0; });
+
+    const auto& estimate = estimator.getEstimate();
+    CHECK (estimate.numTrains == 99);
+    CHECK (std::abs (estimate.dispersionBytesPerSecond - 2.0e6) < 2.0e4);
+    CHECK (estimate.usage == BandwidthUsage::Normal);
+    CHECK (estimate.availableBytesPerSecond > 0.0);
+    CHECK (estimate.availableBytesPerSecond <= estimate.dispersionBytesPerSecond);
+    CHECK (estimate.queuingDelayMs < 0.1);
+}
+
+TEST_CASE ("A growing queue is read as overuse and the estimate backs off", "[bandwidth]")
+{
+    BandwidthEstimator estimator;
+    runTrains (estimator, 0, 50, 8, 1000, 2.0e6, [] (int) { return 0.0; });
+    const double before = estimator.getEstimate().availableBytesPerSecond;
+    REQUIRE (before > 0.0);
+
+    // Every train waits half a millisecond longer than the last
+    runTrains (estimator, 50, 40, 8, 1000, 2.0e6, [] (int train) { return 0.5 * (train - 49); });
+
+    const auto& estimate = estimator.getEstimate();
+    CHECK (estimate.usage == BandwidthUsage::Overuse);
+    CHECK (estimate.delayTrend > 0.0);
+    CHECK (estimate.availableBytesPerSecond < 0.85 * before);
+    CHECK (estimate.queuingDelayMs > 5.0);
+
+    // Once the queue drains again the detector says so
+    runTrains (estimator, 90, 20, 8, 1000, 2.0e6, [] (int train) { return 20.0 - 1.0 * (train - 90); });
+    CHECK (estimator.getEstimate().usage == BandwidthUsage::Underuse);
+}
+
+TEST_CASE ("Steady jitter without a trend is not congestion", "[bandwidth]")
+{
+    BandwidthEstimator estimator;
+    std::mt19937 random (7);
+    std::uniform_real_distribution<double> jitter (0.0, 2.0);
+
+    int overuse = 0;
+    for (int train = 0; train < 400; ++train)
+    {
+        const double extra = jitter (random);
+        runTrains (estimator, train, 1, 4, 1000, 2.0e6, [extra] (int) { return extra; });
+        overuse += estimator.getEstimate().usage == BandwidthUsage::Overuse ? 1 : 0;
+    }
+    CHECK (overuse < 20);
+    CHECK (estimator.getEstimate().availableBytesPerSecond > 0.5 * estimator.getEstimate().dispersionBytesPerSecond);
+
+    estimator.reset();
+    CHECK (estimator.getEstimate().numTrains == 0);
+    CHECK (estimator.getEstimate().availableBytesPerSecond == 0.0);
+}
@@ -0,0 +1,127 @@
+#include <ClockSync.h>
+#include <ProbeEngine.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr uint64_t kMs = 1000000;
+    constexpr uint64_t kSecond = 1000 * kMs;
+
+    // The reference clock runs skewPpm fast and started offsetNs ahead of ours
+    struct RemoteClock
+    {
+        double offsetNs = 0.0;
+        double skewPpm = 0.0;
+
+        uint64_t at (uint64_t localNs) const { return (uint64_t) ((double) localNs + offsetNs + skewPpm * 1e-6 * (double) localNs); }
+    };
+
+    struct Exchange
+    {
+        std::mt19937 rng { 7 };
+        std::exponential_distribution<double> queueing { 1.0 / 2e6 };
+
+        ClockSample run (const RemoteClock& remote, uint64_t originNs, double forwardNs, double reverseNs)
+        {
+            const auto forward = (uint64_t) (forwardNs + queueing (rng));
+            const auto turnaround = (uint64_t) (100000 + queueing (rng) / 4);
+            const auto reverse = (uint64_t) (reverseNs + queueing (rng));
+
+            ClockSample sample;
+            sample.originNs = originNs;
+            sample.receiveNs = remote.at (originNs + forward);
+            sample.transmitNs = remote.at (originNs + forward + turnaround);
+            sample.destinationNs = originNs + forward + turnaround + reverse;
+            return sample;
+        }
+    };
+}
+
+TEST_CASE ("Offset and skew are recovered through queueing noise", "[clock]")
+{
+    const RemoteClock remote { 3.2e9, 80.0 };
+    ClockSync clock;
+    CHECK_FALSE (clock.isSynchronized());
+    CHECK (clock.toReferenceNs (5 * kSecond) == 5 * kSecond);
+
+    Exchange exchange;
+    uint64_t now = 10 * kSecond;
+    REQUIRE (clock.addSample (exchange.run (remote, now, 5e6, 5e6)));
+    CHECK (clock.isSynchronized());
+    // One exchange is already within its own queueing asymmetry
+    CHECK (std::abs ((double) clock.toReferenceNs (now) - (double) remote.at (now)) < 10e6);
+
+    uint64_t lastReference = 0;
+    for (int i = 0; i < 4000; ++i, now += 5 * kMs)
+    {
+        REQUIRE (clock.addSample (exchange.run (remote, now, 5e6, 5e6)));
+        // Corrections are slewed in: the mapped time never runs backwards
+        const uint64_t reference = clock.toReferenceNs (now);
+        if (i > 0)
+            CHECK (reference > lastReference);
+        lastReference = reference;
+    }
+
+    CHECK (clock.getNumSamples() == 4001);
+    CHECK (std::abs (clock.getSkewPpm() - 80.0) < 5.0);
+    CHECK (clock.getMinDelayMs() >= 10.0);
+    CHECK (clock.getMinDelayMs() < 11.0);
+    for (uint64_t t = now; t < now + 2 * kSecond; t += 100 * kMs)
+        CHECK (std::abs ((double) clock.toReferenceNs (t) - (double) remote.at (t)) < 200000.0);
+}
+
+TEST_CASE ("Inconsistent exchanges are rejected and a reference maps to itself", "[clock]")
+{
+    ClockSync clock;
+
+    ClockSample backwards;
+    backwards.originNs = 10 * kMs;
+    backwards.receiveNs = 50 * kMs;
+    backwards.transmitNs = 51 * kMs;
+    backwards.destinationNs = 5 * kMs;
+    CHECK_FALSE (clock.addSample (backwards));
+
+    // The reference took longer to answer than the whole round trip
+    ClockSample slowTurnaround { 10 * kMs, 50 * kMs, 80 * kMs, 20 * kMs };
+    CHECK_FALSE (clock.addSample (slowTurnaround));
+    CHECK_FALSE (clock.isSynchronized());
+
+    clock.setReference (true);
+    CHECK (clock.isSynchronized());
+    CHECK (clock.toReferenceNs (1234) == 1234);
+    CHECK (clock.getOffsetMs() == 0.0);
+}
+
+TEST_CASE ("Stamped probe echoes carry the four timestamps", "[clock]")
+{
+    ProbeEngine engine;
+    ProbeConfig config;
+    config.numProbes = 2;
+    REQUIRE (engine.setConfig (config));
+    engine.start (100 * kMs);
+
+    const uint8_t* data = nullptr;
+    const size_t size = engine.poll (100 * kMs, data);
+    REQUIRE (size == (size_t) config.probeSize);
+
+    std::vector<uint8_t> echo (data, data + size);
+    ClockSample sample;
+    CHECK_FALSE (ProbeEngine::getClockSample (echo.data(), echo.size(), 130 * kMs, sample));
+
+    REQUIRE (ProbeEngine::stampReply (echo.data(), echo.size(), 7000 * kMs, 7001 * kMs));
+    REQUIRE (ProbeEngine::getClockSample (echo.data(), echo.size(), 130 * kMs, sample));
+    CHECK (sample.originNs == 100 * kMs);
+    CHECK (sample.receiveNs == 7000 * kMs);
+    CHECK (sample.transmitNs == 7001 * kMs);
+    CHECK (sample.destinationNs == 130 * kMs);
+    CHECK (sample.getDelayNs() == (int64_t) (29 * kMs));
+    CHECK (sample.getOffsetNs() == (int64_t) (6885 * kMs) + (int64_t) kMs / 2);
+
+    // A stamped echo is still an echo of the run
+    CHECK (engine.onEcho (echo.data(), echo.size(), 130 * kMs));
+    CHECK_FALSE (ProbeEngine::stampReply (echo.data(), PROBE_HEADER_SIZE - 1, 0, 0));
+}
@@ -0,0 +1,50 @@
+#include <DriftEstimator.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+    // Feeds 10 ms packets from a sender whose clock is off by ppm, with up to 20 ms of jitter
+    void feed (DriftEstimator& estimator, double ppm, double seconds, uint64_t startPosition, std::mt19937& rng)
+    {
+        std::uniform_real_distribution<double> jitter (0.0, 0.020 * 48000.0);
+        const double senderRate = 1.0 + ppm * 1e-6;
+        for (uint64_t s = 0; s < (uint64_t) (seconds * 100.0); ++s)
+        {
+            const uint64_t position = startPosition + s * 480;
+            // Local samples elapsed when the sender reached this position, plus transit
+            const double local = (double) (s * 480) / senderRate + 240.0 + jitter (rng);
+            estimator.addPacket (position, local);
+        }
+    }
+}
+
+TEST_CASE ("Drift is estimated for clocks 200 ppm apart", "[drift]")
+{
+    for (double ppm : { 200.0, -200.0, 35.0, 0.0 })
+    {
+        DriftEstimator estimator;
+        estimator.prepare (48000.0);
+        std::mt19937 rng (5);
+        feed (estimator, ppm, 90.0, 123456789, rng);
+
+        REQUIRE (estimator.hasEstimate());
+        CHECK (std::abs (estimator.getDriftPpm() - ppm) < 5.0);
+    }
+}
+
+TEST_CASE ("A restarted sender starts the drift estimate over", "[drift]")
+{
+    DriftEstimator estimator;
+    estimator.prepare (48000.0);
+    std::mt19937 rng (9);
+    feed (estimator, 200.0, 10.0, 0, rng);
+    REQUIRE (estimator.hasEstimate());
+
+    // Positions start from zero again while local time goes on
+    estimator.addPacket (0, 1e7);
+    CHECK_FALSE (estimator.hasEstimate());
+    CHECK (estimator.getRatio() == 1.0);
+}
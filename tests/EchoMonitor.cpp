@@ -0,0 +1,178 @@
+#include <EchoMonitor.h>
+#include <PacketHeader.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr uint64_t kMs = 1000000;
+
+    std::vector<uint8_t> makePacket (uint64_t sequence, size_t payloadSize)
+    {
+        std::vector<uint8_t> packet (PacketHeader::kSize + payloadSize, 0);
+        PacketHeader header;
+        header.numChannels = 2;
+        header.sequence = sequence;
+        header.numFrames = 480;
+        header.payloadSize = (uint32_t) payloadSize;
+        header.encode (packet.data(), packet.size());
+        return packet;
+    }
+}
+
+TEST_CASE ("Echoes give round-trip time, loss and reordering", "[echo]")
+{
+    EchoMonitor monitor;
+    monitor.prepare (2048, 512);
+
+    // Packets every 10 ms come back after 30 ms; 10 and 20 are lost and 51 overtakes 50
+    for (uint64_t s = 0; s < 100; ++s)
+        monitor.onSent (s, s * 10 * kMs);
+    for (uint64_t s = 0; s < 100; ++s)
+    {
+        if (s == 10 || s == 20)
+            continue;
+        const uint64_t echoed = s == 50 ? 51 : s == 51 ? 50 : s;
+        const auto packet = makePacket (echoed, 100);
+        CHECK (monitor.onEcho (packet.data(), packet.size(), echoed * 10 * kMs + 30 * kMs));
+    }
+
+    // Nothing is lost until the timeout has passed
+    CHECK (monitor.getCounters().lost == 0);
+    for (uint64_t s = 100; s < 300; ++s)
+    {
+        monitor.onSent (s, s * 10 * kMs);
+        const auto packet = makePacket (s, 100);
+        monitor.onEcho (packet.data(), packet.size(), s * 10 * kMs + 30 * kMs);
+    }
+
+    const auto counters = monitor.getCounters();
+    CHECK (counters.sent == 300);
+    CHECK (counters.echoed == 298);
+    CHECK (counters.lost == 2);
+    CHECK (counters.reordered == 1);
+    CHECK (counters.late == 0);
+    CHECK (monitor.getLossRate() > 0.0);
+    CHECK (monitor.getReorderRate() > 0.0);
+
+    const auto rtt = monitor.getStatistics().getSummary (StatisticsMetric::RoundTrip);
+    CHECK (rtt.count == 298);
+    CHECK (std::abs (rtt.p50Ms - 30.0) < 1.0);
+    CHECK (monitor.getStatistics().getJitterMs() == 0.0);
+}
+
+TEST_CASE ("Kernel transmit stamps replace the user-space send times", "[echo]")
+{
+    EchoMonitor monitor;
+    monitor.prepare (2048, 512);
+
+    // Each packet waits 2 ms in the plugin before the kernel sends it, every other one is stamped
+    for (uint64_t s = 0; s < 100; ++s)
+    {
+        monitor.onSent (s, s * 10 * kMs);
+        if (s % 2 == 0)
+            monitor.onTransmitted (s, s * 10 * kMs + 2 * kMs);
+        const auto packet = makePacket (s, 100);
+        CHECK (monitor.onEcho (packet.data(), packet.size(), s * 10 * kMs + 30 * kMs));
+    }
+
+    // A stamp for a packet not in its slot, or one that does not fit before the echo, is ignored
+    monitor.onTransmitted (600, 6000 * kMs);
+    monitor.onSent (100, 1000 * kMs);
+    monitor.onTransmitted (100, 1040 * kMs);
+    const auto packet = makePacket (100, 100);
+    CHECK (monitor.onEcho (packet.data(), packet.size(), 1030 * kMs));
+
+    CHECK (monitor.getCounters().kernelStamped == 51);
+    const auto kernel = monitor.getStatistics().getSummary (StatisticsMetric::RoundTrip);
+    CHECK (kernel.count == 101);
+    CHECK (kernel.minMs > 27.9);
+    CHECK (kernel.minMs < 28.1);
+    const auto user = monitor.getUserStatistics().getSummary (StatisticsMetric::RoundTrip);
+    CHECK (user.count == 50);
+    CHECK (std::abs (user.p50Ms - 30.0) < 1.0);
+}
+
+TEST_CASE ("Late, duplicate and foreign echoes", "[echo]")
+{
+    EchoMonitor monitor;
+    monitor.prepare (2048, 512);
+
+    const auto packet = makePacket (0, 100);
+    CHECK_FALSE (monitor.onEcho (packet.data(), packet.size(), 0));
+
+    monitor.onSent (0, 0);
+    monitor.onSent (1, 2000 * kMs);
+    CHECK (monitor.getCounters().lost == 1);
+
+    // Still a round trip, just a late one
+    CHECK (monitor.onEcho (packet.data(), packet.size(), 2100 * kMs));
+    CHECK_FALSE (monitor.onEcho (packet.data(), packet.size(), 2101 * kMs));
+    const auto counters = monitor.getCounters();
+    CHECK (counters.late == 1);
+    CHECK (counters.duplicates == 1);
+    CHECK (counters.echoed == 1);
+
+    // A packet this monitor never sent
+    const auto other = makePacket (7, 100);
+    CHECK_FALSE (monitor.onEcho (other.data(), other.size(), 2200 * kMs));
+    const std::vector<uint8_t> garbage (64, 0xAB);
+    CHECK_FALSE (monitor.onEcho (garbage.data(), garbage.size(), 2200 * kMs));
+}
+
+TEST_CASE ("Fragmented packets count once all fragments are back", "[echo]")
+{
+    EchoMonitor monitor;
+    monitor.prepare (8192, 64);
+    monitor.onSent (3, 0);
+
+    const auto packet = makePacket (3, 3000);
+    const int numFragments = PacketFragmenter::getNumFragments (packet.size(), 1200);
+    REQUIRE (numFragments == 3);
+    for (int i = 0; i < numFragments; ++i)
+    {
+        std::vector<uint8_t> fragment (1200);
+        fragment.resize (PacketFragmenter::writeFragment (packet.data(), packet.size(), 1, i, 1200, fragment.data(), fragment.size()));
+        CHECK (monitor.onEcho (fragment.data(), fragment.size(), 25 * kMs) == (i == numFragments - 1));
+    }
+    CHECK (monitor.getCounters().echoed == 1);
+}
+
+TEST_CASE ("The sender and network threads run concurrently", "[echo]")
+{
+    EchoMonitor monitor;
+    monitor.prepare (2048, 1024);
+
+    constexpr uint64_t numPackets = 20000;
+    std::vector<std::vector<uint8_t>> packets;
+    for (uint64_t s = 0; s < numPackets; ++s)
+        packets.push_back (makePacket (s, 32));
+
+    // Simulated time: packet s is sent at s ms and echoed 5 ms later, every 100th one never
+    std::atomic<uint64_t> sent { 0 };
+    std::thread network ([&] {
+        for (uint64_t s = 0; s < numPackets; ++s)
+        {
+            while (sent.load() <= s)
+                std::this_thread::yield();
+            if (s % 100 != 0)
+                monitor.onEcho (packets[s].data(), packets[s].size(), s * kMs + 5 * kMs);
+        }
+    });
+    for (uint64_t s = 0; s < numPackets; ++s)
+    {
+        monitor.onSent (s, s * kMs);
+        sent.store (s + 1);
+        monitor.getCounters();
+    }
+    network.join();
+    monitor.onSent (numPackets, numPackets * kMs + 2000 * kMs);
+
+    const auto counters = monitor.getCounters();
+    // Echoes that lost the race with the timeout are counted lost and late
+    CHECK (counters.echoed - counters.late + counters.lost == numPackets);
+    CHECK (counters.lost >= numPackets / 100);
+}
@@ -0,0 +1,240 @@
+#include <FecCodec.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+    struct Datagram
+    {
+        bool repair = false;
+        uint64_t sequence = 0;
+        std::vector<uint8_t> bytes;
+    };
+
+    std::vector<std::vector<uint8_t>> makePackets (int count, size_t minSize, size_t maxSize, uint32_t seed)
+    {
+        std::mt19937 rng (seed);
+        std::uniform_int_distribution<size_t> sizes (minSize, maxSize);
+        std::vector<std::vector<uint8_t>> packets ((size_t) count);
+        for (auto& packet : packets)
+        {
+            packet.resize (sizes (rng));
+            for (auto& b : packet)
+                b = (uint8_t) rng();
+        }
+        return packets;
+    }
+
+    std::vector<Datagram> protect (const std::vector<std::vector<uint8_t>>& packets, int k, int m, size_t maxSize)
+    {
+        FecEncoder encoder;
+        encoder.prepare (maxSize);
+        REQUIRE (encoder.setCode (k, m));
+
+        std::vector<Datagram> out;
+        for (size_t s = 0; s < packets.size(); ++s)
+        {
+            const int numRepair = encoder.addPacket (packets[s].data(), packets[s].size(), s);
+            out.push_back ({ false, s, packets[s] });
+            for (int j = 0; j < numRepair; ++j)
+            {
+                Datagram repair { true, s, std::vector<uint8_t> (encoder.getMaxRepairPacketSize()) };
+                repair.bytes.resize (encoder.writeRepairPacket (j, repair.bytes.data(), repair.bytes.size()));
+                REQUIRE (repair.bytes.size() > FecHeader::kSize);
+                out.push_back (std::move (repair));
+            }
+        }
+        return out;
+    }
+
+    /** Feeds the datagrams that survive to a decoder; returns the fraction of packets that never arrive */
+    double deliver (const std::vector<std::vector<uint8_t>>& packets, const std::vector<Datagram>& datagrams,
+                    const std::vector<bool>& lost, size_t maxSize)
+    {
+        FecDecoder decoder;
+        decoder.prepare (maxSize);
+        std::vector<bool> delivered (packets.size(), false);
+
+        for (size_t d = 0; d < datagrams.size(); ++d)
+        {
+            if (lost[d])
+                continue;
+
+            const auto& datagram = datagrams[d];
+            int numRecovered = 0;
+            if (datagram.repair)
+            {
+                numRecovered = decoder.addRepairPacket (datagram.bytes.data(), datagram.bytes.size());
+            }
+            else
+            {
+                delivered[datagram.sequence] = true;
+                numRecovered = decoder.addSourcePacket (datagram.bytes.data(), datagram.bytes.size(), datagram.sequence);
+            }
+
+            for (int r = 0; r < numRecovered; ++r)
+            {
+                size_t size = 0;
+                uint64_t sequence = 0;
+                const uint8_t* packet = decoder.getRecoveredPacket (r, size, sequence);
+                REQUIRE (packet != nullptr);
+                REQUIRE (sequence < packets.size());
+                CHECK_FALSE (delivered[sequence]);
+                REQUIRE (size == packets[sequence].size());
+                CHECK (std::equal (packets[sequence].begin(), packets[sequence].end(), packet));
+                delivered[sequence] = true;
+            }
+        }
+
+        size_t missing = 0;
+        for (bool d : delivered)
+            missing += d ? 0 : 1;
+        return (double) missing / (double) packets.size();
+    }
+
+    std::vector<bool> randomLoss (size_t count, double rate, uint32_t seed)
+    {
+        std::mt19937 rng (seed);
+        std::bernoulli_distribution loss (rate);
+        std::vector<bool> lost (count);
+        for (size_t i = 0; i < count; ++i)
+            lost[i] = loss (rng);
+        return lost;
+    }
+
+    /** Gilbert-Elliott channel: bursts with the given mean length, averaging the given loss rate */
+    std::vector<bool> burstLoss (size_t count, double rate, double meanBurst, uint32_t seed)
+    {
+        std::mt19937 rng (seed);
+        const double leaveBad = 1.0 / meanBurst;
+        const double enterBad = rate * leaveBad / (1.0 - rate);
+        std::bernoulli_distribution toBad (enterBad), toGood (leaveBad);
+        std::vector<bool> lost (count);
+        bool bad = false;
+        for (size_t i = 0; i < count; ++i)
+        {
+            bad = bad ? ! toGood (rng) : toBad (rng);
+            lost[i] = bad;
+        }
+        return lost;
+    }
+
+    double lossRate (const std::vector<Datagram>& datagrams, const std::vector<bool>& lost)
+    {
+        size_t sources = 0, lostSources = 0;
+        for (size_t d = 0; d < datagrams.size(); ++d)
+        {
+            if (datagrams[d].repair)
+                continue;
+            ++sources;
+            lostSources += lost[d] ? 1 : 0;
+        }
+        return (double) lostSources / (double) sources;
+    }
+}
+
+TEST_CASE ("Any k of the k + m packets of a group rebuild the rest", "[fec]")
+{
+    const size_t maxSize = 600;
+    for (auto [k, m] : { std::pair { 4, 1 }, std::pair { 8, 2 }, std::pair { 5, 3 }, std::pair { 16, 4 } })
+    {
+        const auto packets = makePackets (k, 40, maxSize, (uint32_t) (k * 31 + m));
+        const auto datagrams = protect (packets, k, m, maxSize);
+        REQUIRE (datagrams.size() == (size_t) (k + m));
+
+        std::mt19937 rng ((uint32_t) k);
+        for (int trial = 0; trial < 50; ++trial)
+        {
+            // Drop exactly m of the k + m datagrams
+            std::vector<bool> lost (datagrams.size(), false);
+            for (int n = 0; n < m;)
+            {
+                const auto d = rng() % datagrams.size();
+                if (! lost[d])
+                {
+                    lost[d] = true;
+                    ++n;
+                }
+            }
+            CHECK (deliver (packets, datagrams, lost, maxSize) == 0.0);
+        }
+    }
+}
+
+TEST_CASE ("Single parity is plain XOR", "[fec]")
+{
+    for (int i = 0; i < 8; ++i)
+        CHECK (Fec::getCoefficient (8, 0, i) == 1);
+    CHECK (Fec::getCoefficient (8, 1, 3) != 1);
+
+    const auto packets = makePackets (3, 100, 100, 5);
+    const auto datagrams = protect (packets, 3, 1, 100);
+    const auto& parity = datagrams.back().bytes;
+    for (size_t n = 0; n < 100; ++n)
+        CHECK (parity[FecHeader::kSize + 4 + n] == (uint8_t) (packets[0][n] ^ packets[1][n] ^ packets[2][n]));
+}
+
+TEST_CASE ("Residual loss under random and burst loss", "[fec]")
+{
+    const size_t maxSize = 1500;
+    const auto packets = makePackets (20000, 200, maxSize, 11);
+
+    SECTION ("XOR parity over 4 packets, 2% random loss")
+    {
+        const auto datagrams = protect (packets, 4, 1, maxSize);
+        const auto lost = randomLoss (datagrams.size(), 0.02, 1);
+        const double residual = deliver (packets, datagrams, lost, maxSize);
+        CHECK (lossRate (datagrams, lost) > 0.015);
+        CHECK (residual < 0.004);
+    }
+
+    SECTION ("Reed-Solomon (8, 2), 5% random loss")
+    {
+        const auto datagrams = protect (packets, 8, 2, maxSize);
+        const auto lost = randomLoss (datagrams.size(), 0.05, 2);
+        const double residual = deliver (packets, datagrams, lost, maxSize);
+        CHECK (lossRate (datagrams, lost) > 0.04);
+        CHECK (residual < 0.005);
+    }
+
+    SECTION ("Reed-Solomon (8, 3), 5% loss in bursts of 2 on average")
+    {
+        const auto datagrams = protect (packets, 8, 3, maxSize);
+        const auto lost = burstLoss (datagrams.size(), 0.05, 2.0, 3);
+        const double raw = lossRate (datagrams, lost);
+        const double residual = deliver (packets, datagrams, lost, maxSize);
+        CHECK (raw > 0.04);
+        CHECK (residual < raw / 2.5);
+    }
+}
+
+TEST_CASE ("Malformed and stale repair packets are ignored", "[fec]")
+{
+    const size_t maxSize = 300;
+    const auto packets = makePackets (8, 50, maxSize, 9);
+    auto datagrams = protect (packets, 4, 1, maxSize);
+
+    FecDecoder decoder;
+    decoder.prepare (maxSize, 64, 2);
+
+    auto repair = datagrams[4].bytes;
+    REQUIRE (FecHeader::isRepair (repair.data(), repair.size()));
+    CHECK (decoder.addRepairPacket (repair.data(), FecHeader::kSize) == 0);
+    repair[5] = 0;
+    CHECK (decoder.addRepairPacket (repair.data(), repair.size()) == 0);
+    CHECK (decoder.getNumRejected() == 2);
+
+    // A repair packet for a group that fully arrived has nothing to do
+    for (int s = 0; s < 4; ++s)
+        decoder.addSourcePacket (packets[(size_t) s].data(), packets[(size_t) s].size(), (uint64_t) s);
+    CHECK (decoder.addRepairPacket (datagrams[4].bytes.data(), datagrams[4].bytes.size()) == 0);
+
+    // Two packets of the second group lost: too many for one parity packet
+    decoder.addSourcePacket (packets[4].data(), packets[4].size(), 4);
+    decoder.addSourcePacket (packets[7].data(), packets[7].size(), 7);
+    CHECK (decoder.addRepairPacket (datagrams[9].bytes.data(), datagrams[9].bytes.size()) == 0);
+    CHECK (decoder.getNumRecovered() == 0);
+}
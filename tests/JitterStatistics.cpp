@@ -0,0 +1,178 @@
+#include <JitterStatistics.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr uint64_t kMs = 1000000;
+    constexpr uint64_t kSecond = 1000 * kMs;
+
+    bool isNear (double value, double expected, double relative)
+    {
+        return std::abs (value - expected) <= relative * std::abs (expected) + 1e-9;
+    }
+}
+
+TEST_CASE ("Histogram buckets are exact at the bottom and within 3% above", "[statistics]")
+{
+    for (uint32_t v = 0; v < 2 * LatencyHistogram::kSubBuckets; ++v)
+        CHECK (LatencyHistogram::getBucketValue (LatencyHistogram::getBucket (v)) == v);
+
+    std::mt19937 rng (3);
+    for (int i = 0; i < 10000; ++i)
+    {
+        const uint32_t v = rng();
+        const int bucket = LatencyHistogram::getBucket (v);
+        REQUIRE (bucket >= 0);
+        REQUIRE (bucket < LatencyHistogram::kNumBuckets);
+        const double value = LatencyHistogram::getBucketValue (bucket);
+        CHECK (std::abs (value - v) <= 0.03 * v + 1.0);
+    }
+    CHECK (LatencyHistogram::getBucket (UINT32_MAX) == LatencyHistogram::kNumBuckets - 1);
+}
+
+TEST_CASE ("Percentiles track the exact ones", "[statistics]")
+{
+    LatencyHistogram histogram;
+    histogram.prepare (10);
+
+    std::mt19937 rng (5);
+    std::lognormal_distribution<double> delay (std::log (20000.0), 0.5);
+    std::vector<uint32_t> values;
+    for (int i = 0; i < 20000; ++i)
+    {
+        values.push_back ((uint32_t) delay (rng));
+        histogram.add (values.back(), (uint64_t) i * kMs);
+    }
+    std::sort (values.begin(), values.end());
+
+    auto exact = [&values] (double q) { return values[(size_t) std::ceil (q * (double) values.size()) - 1] / 1000.0; };
+    const auto summary = histogram.getSummary();
+    CHECK (summary.count == values.size());
+    CHECK (summary.minMs == values.front() / 1000.0);
+    CHECK (summary.maxMs == values.back() / 1000.0);
+    CHECK (isNear (summary.p50Ms, exact (0.5), 0.03));
+    CHECK (isNear (summary.p95Ms, exact (0.95), 0.03));
+    CHECK (isNear (summary.p99Ms, exact (0.99), 0.03));
+    CHECK (isNear (summary.p999Ms, exact (0.999), 0.03));
+}
+
+TEST_CASE ("The window only covers the last seconds", "[statistics]")
+{
+    LatencyHistogram histogram;
+    histogram.prepare (5);
+
+    // 10 s of 1 ms values, then 3 s of 100 ms values
+    for (uint64_t t = 0; t < 10 * kSecond; t += 10 * kMs)
+        histogram.add (1000, t);
+    for (uint64_t t = 10 * kSecond; t < 13 * kSecond; t += 10 * kMs)
+        histogram.add (100000, t);
+
+    const auto all = histogram.getSummary();
+    CHECK (all.count == 1300);
+    CHECK (isNear (all.p50Ms, 1.0, 1e-9));
+
+    const auto window = histogram.getWindowSummary();
+    CHECK (window.count == 500);
+    CHECK (isNear (window.minMs, 1.0, 1e-9));
+    CHECK (isNear (window.p50Ms, 100.0, 0.03));
+    CHECK (isNear (window.meanMs, 0.4 * 1.0 + 0.6 * 100.0, 1e-9));
+
+    // A long gap empties the window without touching the all-time figures
+    histogram.add (2000, 60 * kSecond);
+    CHECK (histogram.getWindowSummary().count == 1);
+    CHECK (histogram.getSummary().count == 1301);
+}
+
+TEST_CASE ("Jitter follows the RFC 3550 estimator", "[statistics]")
+{
+    JitterStatistics statistics;
+    statistics.prepare();
+
+    // Transit alternates between 10 and 14 ms, so |D| is always 4 ms and J converges to it
+    double reference = 0.0;
+    for (int i = 0; i < 500; ++i)
+    {
+        const uint64_t send = (uint64_t) i * 10 * kMs;
+        const uint64_t transit = (i % 2 == 0 ? 10 : 14) * kMs;
+        statistics.addArrival (send, send + transit);
+        if (i > 0)
+            reference += (4.0 - reference) / 16.0;
+    }
+    CHECK (std::abs (statistics.getJitterMs() - reference) <= 0.001);
+    CHECK (std::abs (statistics.getJitterMs() - 4.0) <= 0.01);
+
+    const auto delay = statistics.getSummary (StatisticsMetric::QueueingDelay);
+    CHECK (delay.count == 500);
+    CHECK (delay.minMs == 0.0);
+    CHECK (isNear (delay.maxMs, 4.0, 1e-9));
+
+    const auto spacing = statistics.getSummary (StatisticsMetric::InterArrival);
+    CHECK (spacing.count == 499);
+    CHECK (isNear (spacing.minMs, 6.0, 1e-9));
+    CHECK (isNear (spacing.maxMs, 14.0, 1e-9));
+    CHECK (isNear (spacing.meanMs, 10.0, 0.01));
+
+    statistics.addRoundTrip (25 * kMs, 5 * kSecond);
+    CHECK (isNear (statistics.getWindowSummary (StatisticsMetric::RoundTrip).p50Ms, 25.0, 0.03));
+
+    statistics.reset();
+    CHECK (statistics.getJitterMs() == 0.0);
+    CHECK (statistics.getSummary (StatisticsMetric::QueueingDelay).count == 0);
+}
+
+TEST_CASE ("Synchronized timestamps give the one-way delay", "[statistics]")
+{
+    JitterStatistics statistics;
+    statistics.prepare();
+
+    // The sender's own clock is far off ours; then both move to a shared time base
+    uint64_t arrival = 1000 * kSecond;
+    for (int i = 0; i < 100; ++i, arrival += 10 * kMs)
+        statistics.addArrival (arrival - 900 * kSecond + (i % 2) * kMs, arrival);
+    const double jitter = statistics.getJitterMs();
+    for (int i = 0; i < 100; ++i, arrival += 10 * kMs)
+        statistics.addArrival (arrival - 8 * kMs, arrival, true);
+
+    const auto delay = statistics.getSummary (StatisticsMetric::OneWayDelay);
+    CHECK (delay.count == 100);
+    CHECK (isNear (delay.p50Ms, 8.0, 0.03));
+    CHECK (isNear (delay.maxMs, 8.0, 1e-9));
+
+    // The switch is not mistaken for a 900 s jump in transit time
+    CHECK (statistics.getJitterMs() <= jitter);
+    CHECK (statistics.getSummary (StatisticsMetric::QueueingDelay).maxMs <= 1.0);
+    CHECK (statistics.getSummary (StatisticsMetric::InterArrival).count == 199);
+}
+
+TEST_CASE ("Summaries can be read while the network thread records", "[statistics]")
+{
+    JitterStatistics statistics;
+    statistics.prepare (2);
+
+    std::atomic<bool> done { false };
+    std::thread writer ([&] {
+        for (uint64_t i = 0; i < 200000; ++i)
+            statistics.addArrival (i * kMs, i * kMs + 5 * kMs + (i % 7) * 100000);
+        done = true;
+    });
+
+    uint64_t lastCount = 0;
+    while (!done)
+    {
+        const auto summary = statistics.getSummary (StatisticsMetric::InterArrival);
+        CHECK (summary.count >= lastCount);
+        if (summary.count > 0)
+            CHECK (summary.p50Ms <= summary.p999Ms);
+        lastCount = summary.count;
+        statistics.getWindowSummary (StatisticsMetric::QueueingDelay);
+    }
+    writer.join();
+    CHECK (statistics.getSummary (StatisticsMetric::InterArrival).count == 199999);
+}
@@ -0,0 +1,204 @@
+#include <LocalStreamRing.h>
+#include <catch2/catch_test_macros.hpp>
+
+#if defined(__linux__)
+    #include <atomic>
+    #include <cstring>
+    #include <thread>
+    #include <unistd.h>
+    #include <vector>
+
+namespace
+{
+    // Shared memory names are global to the host, so tests running in parallel must not collide
+    int testStreamId (int n)
+    {
+        return 1000000000 + (int) (getpid() % 100000) * 10 + n;
+    }
+
+    const uint64_t testScope = LocalStreamRing::makeScope ("127.0.0.1", 20010, "LocalRingTest");
+
+    std::vector<uint8_t> makePacket (uint32_t value, size_t size)
+    {
+        std::vector<uint8_t> packet (size, (uint8_t) value);
+        std::memcpy (packet.data(), &value, sizeof (value));
+        return packet;
+    }
+
+    uint32_t readValue (const uint8_t* packet)
+    {
+        uint32_t value = 0;
+        std::memcpy (&value, packet, sizeof (value));
+        return value;
+    }
+
+    bool isIntact (const uint8_t* packet, size_t size)
+    {
+        for (size_t i = sizeof (uint32_t); i < size; ++i)
+            if (packet[i] != packet[0])
+                return false;
+        return true;
+    }
+}
+
+TEST_CASE ("Local ring delivers packets unchanged to an attached reader", "[localring]")
+{
+    const int streamId = testStreamId (0);
+    LocalStreamRing writer, reader;
+    REQUIRE (writer.create (testScope, streamId, 8, 256));
+    CHECK (writer.isWriter());
+
+    // Nobody listens yet, so nothing is copied
+    CHECK_FALSE (writer.hasReaders());
+    CHECK_FALSE (writer.push (makePacket (1, 100).data(), 100));
+
+    LocalStreamRing missing;
+    CHECK_FALSE (missing.attach (testScope, testStreamId (1)));
+
+    REQUIRE (reader.attach (testScope, streamId));
+    CHECK (writer.hasReaders());
+    CHECK (reader.isWriterAlive());
+    CHECK (reader.getMaxPacketSize() == 256);
+
+    for (uint32_t i = 0; i < 5; ++i)
+        CHECK (writer.push (makePacket (i, 40 + i * 10).data(), 40 + i * 10));
+    CHECK_FALSE (writer.push (makePacket (9, 257).data(), 257));
+
+    uint8_t packet[256];
+    size_t size = 0;
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        REQUIRE (reader.pop (packet, sizeof (packet), size));
+        CHECK (size == 40 + i * 10);
+        CHECK (readValue (packet) == i);
+        CHECK (isIntact (packet, size));
+    }
+    CHECK_FALSE (reader.pop (packet, sizeof (packet), size));
+    CHECK (reader.getNumMissed() == 0);
+
+    reader.close();
+    CHECK_FALSE (writer.hasReaders());
+}
+
+TEST_CASE ("Local ring reader that falls behind skips to the newest packets", "[localring]")
+{
+    const int streamId = testStreamId (2);
+    LocalStreamRing writer, reader;
+    REQUIRE (writer.create (testScope, streamId, 8, 64));
+    REQUIRE (reader.attach (testScope, streamId));
+
+    for (uint32_t i = 0; i < 30; ++i)
+        writer.push (makePacket (i, 64).data(), 64);
+
+    uint8_t packet[64];
+    size_t size = 0;
+    std::vector<uint32_t> received;
+    while (reader.pop (packet, sizeof (packet), size))
+        received.push_back (readValue (packet));
+
+    // The oldest slot is left to the writer, so one ring less one packet survives
+    REQUIRE (received.size() == 7);
+    CHECK (received.front() == 23);
+    CHECK (received.back() == 29);
+    CHECK (reader.getNumMissed() == 23);
+}
+
+TEST_CASE ("Local ring readers see the writer go away", "[localring]")
+{
+    const int streamId = testStreamId (3);
+    LocalStreamRing writer, reader;
+    REQUIRE (writer.create (testScope, streamId, 4, 64));
+    REQUIRE (reader.attach (testScope, streamId));
+
+    writer.close();
+    CHECK_FALSE (reader.isWriterAlive());
+    // The name is gone with the writer
+    LocalStreamRing late;
+    CHECK_FALSE (late.attach (testScope, streamId));
+
+    // A new writer replaces the ring under the same name
+    LocalStreamRing next;
+    REQUIRE (next.create (testScope, streamId, 4, 64));
+    CHECK (late.attach (testScope, streamId));
+}
+
+TEST_CASE ("Local ring names keep servers and workspaces apart", "[localring]")
+{
+    const int streamId = testStreamId (5);
+    const auto otherWorkspace = LocalStreamRing::makeScope ("127.0.0.1", 20010, "OtherWorkspace");
+    const auto otherServer = LocalStreamRing::makeScope ("10.0.0.2", 20010, "LocalRingTest");
+    CHECK (otherWorkspace != testScope);
+    CHECK (otherServer != testScope);
+    CHECK (LocalStreamRing::getName (otherWorkspace, streamId) != LocalStreamRing::getName (testScope, streamId));
+    CHECK (LocalStreamRing::getName (testScope, streamId).size() <= 31);
+
+    // The same stream id on two servers gets two rings, and neither writer replaces the other's
+    LocalStreamRing writer, other;
+    REQUIRE (writer.create (testScope, streamId, 4, 64));
+    REQUIRE (other.create (otherServer, streamId, 4, 64));
+
+    LocalStreamRing reader;
+    REQUIRE (reader.attach (testScope, streamId));
+    REQUIRE (writer.push (makePacket (7, 64).data(), 64));
+    uint8_t packet[64];
+    size_t size = 0;
+    REQUIRE (reader.pop (packet, sizeof (packet), size));
+    CHECK (readValue (packet) == 7);
+
+    // A second writer for a ring whose writer is alive fails instead of unlinking it
+    LocalStreamRing intruder;
+    CHECK_FALSE (intruder.create (testScope, streamId, 4, 64));
+    CHECK (reader.isWriterAlive());
+    LocalStreamRing late;
+    CHECK (late.attach (testScope, streamId));
+}
+
+TEST_CASE ("Local ring hands packets across threads without tearing", "[localring]")
+{
+    const int streamId = testStreamId (4);
+    LocalStreamRing writer, reader;
+    REQUIRE (writer.create (testScope, streamId, LOCAL_RING_SLOTS, 512));
+    REQUIRE (reader.attach (testScope, streamId));
+
+    constexpr uint32_t numPackets = 20000;
+    std::atomic<bool> done { false };
+    std::thread producer ([&] {
+        for (uint32_t i = 0; i < numPackets; ++i)
+        {
+            const auto packet = makePacket (i, 64 + i % 400);
+            writer.push (packet.data(), packet.size());
+            if (i % 64 == 0)
+                std::this_thread::yield();
+        }
+        done = true;
+        writer.wakeReaders();
+    });
+
+    uint8_t packet[512];
+    size_t size = 0;
+    uint64_t received = 0;
+    int64_t last = -1;
+    bool ordered = true, intact = true;
+    for (;;)
+    {
+        const bool finished = done.load();
+        while (reader.pop (packet, sizeof (packet), size))
+        {
+            const auto value = readValue (packet);
+            ordered = ordered && (int64_t) value > last;
+            intact = intact && size == 64 + value % 400 && isIntact (packet, size);
+            last = value;
+            ++received;
+        }
+        if (finished)
+            break;
+        reader.wait (10);
+    }
+    producer.join();
+
+    CHECK (ordered);
+    CHECK (intact);
+    CHECK (last == (int64_t) numPackets - 1);
+    CHECK (received + reader.getNumMissed() == numPackets);
+}
+#endif
@@ -0,0 +1,140 @@
+#include <LossConcealer.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr int kFrame = 480;
+    constexpr double kPi = 3.14159265358979;
+
+    // A voice-like signal: five harmonics of a pitch gliding around 150 Hz, in stereo
+    std::vector<std::vector<float>> makeSignal (int numFrames)
+    {
+        std::vector<std::vector<float>> channels (2, std::vector<float> ((size_t) numFrames * kFrame));
+        double phase = 0.0;
+        for (size_t i = 0; i < channels[0].size(); ++i)
+        {
+            const double pitch = 150.0 + 5.0 * std::sin (2.0 * kPi * 2.0 * (double) i / 48000.0);
+            phase += 2.0 * kPi * pitch / 48000.0;
+            double sample = 0.0;
+            for (int h = 1; h <= 5; ++h)
+                sample += 0.3 / h * std::sin (h * phase);
+            channels[0][i] = (float) sample;
+            channels[1][i] = (float) (0.5 * sample);
+        }
+        return channels;
+    }
+
+    // Runs the signal through the concealer in 10 ms frames, losing each with the given probability
+    double concealedSnrDb (double lossRate, bool conceal, unsigned seed)
+    {
+        const int numFrames = 3000;
+        const auto input = makeSignal (numFrames);
+        LossConcealer concealer;
+        concealer.prepare (2, 48000.0, kFrame);
+
+        std::mt19937 rng (seed);
+        std::bernoulli_distribution lost (lossRate);
+        std::vector<std::vector<float>> frame (2, std::vector<float> (kFrame));
+        float* channels[] = { frame[0].data(), frame[1].data() };
+
+        double signal = 0.0, error = 0.0;
+        for (int f = 0; f < numFrames; ++f)
+        {
+            const bool isLost = f > 10 && lost (rng);
+            for (int ch = 0; ch < 2; ++ch)
+                std::copy_n (input[(size_t) ch].begin() + f * kFrame, kFrame, frame[(size_t) ch].begin());
+
+            if (isLost && conceal)
+                concealer.conceal (channels, kFrame);
+            else if (isLost)
+                for (auto& samples : frame)
+                    std::fill (samples.begin(), samples.end(), 0.0f);
+            else
+                concealer.process (channels, kFrame);
+
+            for (int ch = 0; ch < 2; ++ch)
+                for (int i = 0; i < kFrame; ++i)
+                {
+                    const double reference = input[(size_t) ch][(size_t) (f * kFrame + i)];
+                    signal += reference * reference;
+                    error += (frame[(size_t) ch][(size_t) i] - reference) * (frame[(size_t) ch][(size_t) i] - reference);
+                }
+        }
+        return 10.0 * std::log10 (signal / std::max (error, 1e-20));
+    }
+}
+
+TEST_CASE ("The pitch period of a periodic signal is found", "[plc]")
+{
+    LossConcealer concealer;
+    concealer.prepare (1, 48000.0, kFrame);
+
+    for (double pitch : { 80.0, 150.0, 220.0, 350.0 })
+    {
+        concealer.reset();
+        std::vector<float> samples (kFrame * 4);
+        for (size_t i = 0; i < samples.size(); ++i)
+            samples[i] = (float) (0.5 * std::sin (2.0 * kPi * pitch * (double) i / 48000.0) + 0.2 * std::sin (4.0 * kPi * pitch * (double) i / 48000.0));
+        float* channels[] = { samples.data() };
+        concealer.process (channels, (int) samples.size());
+
+        std::vector<float> out (kFrame);
+        float* dest[] = { out.data() };
+        concealer.conceal (dest, kFrame);
+        CHECK (std::abs (concealer.getPitchPeriod() - 48000.0 / pitch) <= 1.0);
+    }
+}
+
+TEST_CASE ("Concealment beats silence at 1%, 5% and 10% loss", "[plc]")
+{
+    for (double lossRate : { 0.01, 0.05, 0.10 })
+    {
+        const double concealed = concealedSnrDb (lossRate, true, 11);
+        const double silent = concealedSnrDb (lossRate, false, 11);
+        INFO ("loss " << lossRate << ": concealed " << concealed << " dB, silence " << silent << " dB");
+        CHECK (concealed > silent + 10.0);
+    }
+    CHECK (concealedSnrDb (0.01, true, 11) > 35.0);
+    CHECK (concealedSnrDb (0.10, true, 11) > 25.0);
+}
+
+TEST_CASE ("Long gaps fade to silence and recovery is cross-faded", "[plc]")
+{
+    LossConcealer concealer;
+    concealer.prepare (1, 48000.0, kFrame);
+
+    auto input = makeSignal (20)[0];
+    float* channels[] = { input.data() };
+    concealer.process (channels, 10 * kFrame);
+
+    // 100 ms of loss: full level first, silence by the end
+    std::vector<float> out (kFrame);
+    float* dest[] = { out.data() };
+    float firstPeak = 0.0f, lastPeak = 0.0f;
+    for (int f = 0; f < 10; ++f)
+    {
+        concealer.conceal (dest, kFrame);
+        float peak = 0.0f;
+        for (float sample : out)
+            peak = std::max (peak, std::abs (sample));
+        if (f == 0)
+            firstPeak = peak;
+        lastPeak = peak;
+    }
+    CHECK (firstPeak > 0.3f);
+    CHECK (lastPeak == 0.0f);
+    CHECK (concealer.isConcealing());
+
+    // The first good frame starts from the silent concealment and fades in
+    std::vector<float> good (kFrame, 0.5f);
+    float* goodChannels[] = { good.data() };
+    concealer.process (goodChannels, kFrame);
+    CHECK_FALSE (concealer.isConcealing());
+    CHECK (good[0] < 0.01f);
+    CHECK (good[kFrame - 1] == 0.5f);
+}
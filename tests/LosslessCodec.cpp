@@ -0,0 +1,148 @@
+#include <LosslessCodec.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <random>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    using Channels = std::vector<std::vector<int32_t>>;
+
+    Channels makeSignal (const char* kind, int numChannels, int numFrames, int bitsPerSample)
+    {
+        const int32_t maxValue = (1 << (bitsPerSample - 1)) - 1;
+        const int32_t minValue = -maxValue - 1;
+        std::mt19937 rng (1234);
+        std::uniform_int_distribution<int32_t> noise (minValue, maxValue);
+
+        Channels channels ((size_t) numChannels, std::vector<int32_t> ((size_t) numFrames));
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            for (int i = 0; i < numFrames; ++i)
+            {
+                auto& x = channels[(size_t) ch][(size_t) i];
+                const std::string_view k (kind);
+                if (k == "noise")
+                    x = noise (rng);
+                else if (k == "sine")
+                    x = (int32_t) std::lround (0.7 * maxValue * std::sin (0.031 * (i + 1) * (ch + 1)));
+                else if (k == "silence")
+                    x = 0;
+                else if (k == "impulses")
+                    x = i % 37 == ch ? maxValue : 0;
+                else
+                    x = (i + ch) % 2 == 0 ? maxValue : minValue;
+            }
+        }
+        return channels;
+    }
+
+    void checkRoundTrip (LosslessCodec& codec, const Channels& input, int bitsPerSample)
+    {
+        const int numChannels = (int) input.size();
+        const int numFrames = (int) input[0].size();
+
+        std::vector<const int32_t*> inputPtrs;
+        for (auto& c : input)
+            inputPtrs.push_back (c.data());
+
+        std::vector<uint8_t> packet (LosslessCodec::getMaxEncodedSize (numChannels, numFrames, bitsPerSample));
+        const auto size = codec.encode (inputPtrs.data(), numChannels, numFrames, bitsPerSample, packet.data(), packet.size());
+        REQUIRE (size > 0);
+
+        Channels output ((size_t) numChannels, std::vector<int32_t> ((size_t) numFrames));
+        std::vector<int32_t*> outputPtrs;
+        for (auto& c : output)
+            outputPtrs.push_back (c.data());
+
+        int decodedChannels = 0, decodedFrames = 0, decodedBits = 0;
+        REQUIRE (codec.decode (packet.data(), size, outputPtrs.data(), numChannels, numFrames, decodedChannels, decodedFrames, decodedBits));
+        CHECK (decodedChannels == numChannels);
+        CHECK (decodedFrames == numFrames);
+        CHECK (decodedBits == bitsPerSample);
+        CHECK (output == input);
+    }
+}
+
+TEST_CASE ("Lossless codec round trips are bit exact", "[codec]")
+{
+    LosslessCodec codec;
+    codec.prepare (8, 2048);
+
+    for (const char* kind : { "noise", "sine", "silence", "impulses", "fullscale" })
+        for (int bitsPerSample : { 16, 24 })
+            for (int numChannels : { 1, 2, 3, 8 })
+                for (int numFrames : { 1, 2, 7, 120, 480, 1000, 2048 })
+                    checkRoundTrip (codec, makeSignal (kind, numChannels, numFrames, bitsPerSample), bitsPerSample);
+}
+
+TEST_CASE ("Lossless codec compresses predictable signals", "[codec]")
+{
+    LosslessCodec codec;
+    codec.prepare (2, 480);
+
+    auto sine = makeSignal ("sine", 2, 480, 16);
+    const int32_t* ptrs[] = { sine[0].data(), sine[1].data() };
+    std::vector<uint8_t> packet (LosslessCodec::getMaxEncodedSize (2, 480, 16));
+
+    const auto size = codec.encode (ptrs, 2, 480, 16, packet.data(), packet.size());
+    REQUIRE (size > 0);
+    CHECK (size < 2 * 480 * 2 / 2);
+
+    auto silence = makeSignal ("silence", 2, 480, 16);
+    const int32_t* silencePtrs[] = { silence[0].data(), silence[1].data() };
+    CHECK (codec.encode (silencePtrs, 2, 480, 16, packet.data(), packet.size()) < 16);
+}
+
+TEST_CASE ("Lossless codec rejects malformed packets", "[codec]")
+{
+    LosslessCodec codec;
+    codec.prepare (2, 480);
+
+    auto noise = makeSignal ("noise", 2, 480, 16);
+    const int32_t* ptrs[] = { noise[0].data(), noise[1].data() };
+    std::vector<uint8_t> packet (LosslessCodec::getMaxEncodedSize (2, 480, 16));
+    const auto size = codec.encode (ptrs, 2, 480, 16, packet.data(), packet.size());
+    REQUIRE (size > 0);
+
+    std::vector<int32_t> left (480), right (480);
+    int32_t* out[] = { left.data(), right.data() };
+    int numChannels = 0, numFrames = 0, bitsPerSample = 0;
+
+    CHECK_FALSE (codec.decode (packet.data(), size / 2, out, 2, 480, numChannels, numFrames, bitsPerSample));
+    CHECK_FALSE (codec.decode (packet.data(), size, out, 1, 480, numChannels, numFrames, bitsPerSample));
+
+    packet[0] = 0xff;
+    CHECK_FALSE (codec.decode (packet.data(), size, out, 2, 480, numChannels, numFrames, bitsPerSample));
+}
+
+TEST_CASE ("Lossless codec float path matches the quantized input", "[codec]")
+{
+    LosslessCodec codec;
+    codec.prepare (2, 256);
+
+    std::vector<float> left (256), right (256);
+    for (size_t i = 0; i < left.size(); ++i)
+    {
+        left[i] = 0.5f * std::sin (0.05f * (float) i);
+        right[i] = -left[i];
+    }
+    const float* src[] = { left.data(), right.data() };
+
+    std::vector<uint8_t> packet (LosslessCodec::getMaxEncodedSize (2, 256, 24));
+    const auto size = codec.encode (src, 2, 256, 24, packet.data(), packet.size());
+    REQUIRE (size > 0);
+
+    std::vector<float> outLeft (256), outRight (256);
+    float* dest[] = { outLeft.data(), outRight.data() };
+    int numChannels = 0, numFrames = 0;
+    REQUIRE (codec.decode (packet.data(), size, dest, 2, 256, numChannels, numFrames));
+
+    for (size_t i = 0; i < left.size(); ++i)
+    {
+        CHECK (LosslessCodec::quantize (outLeft[i], 24) == LosslessCodec::quantize (left[i], 24));
+        CHECK (LosslessCodec::quantize (outRight[i], 24) == LosslessCodec::quantize (right[i], 24));
+    }
+}
@@ -0,0 +1,158 @@
+#include <PacedSendQueue.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    SendRequest makeRequest (PacketPool& pool, uint32_t value, size_t size, uint64_t deadlineNs = 0)
+    {
+        SendRequest request;
+        request.packet = pool.acquire();
+        std::memcpy (request.packet.data(), &value, sizeof (value));
+        request.packet.setSize (size);
+        request.deadlineNs = deadlineNs;
+        return request;
+    }
+
+    uint32_t readValue (const SendRequest& request)
+    {
+        uint32_t value = 0;
+        std::memcpy (&value, request.packet.data(), sizeof (value));
+        return value;
+    }
+}
+
+TEST_CASE ("Paced queue serves audio before probes", "[pacedqueue]")
+{
+    PacketPool pool;
+    pool.prepare (16, 1500);
+    PacedSendQueue queue;
+    queue.prepare (8);
+
+    REQUIRE (queue.push (SendPriority::Probe, makeRequest (pool, 100, 200)));
+    REQUIRE (queue.push (SendPriority::Audio, makeRequest (pool, 1, 1000)));
+    REQUIRE (queue.push (SendPriority::Probe, makeRequest (pool, 101, 200)));
+    REQUIRE (queue.push (SendPriority::Audio, makeRequest (pool, 2, 1000)));
+    CHECK (queue.getNumReady() == 4);
+    CHECK (queue.getNumAccepted() == 4);
+
+    SendRequest request;
+    uint64_t readyNs = 0;
+    std::vector<uint32_t> order;
+    while (queue.pop (request, 1000, readyNs) == PacedSendQueue::PopResult::Ready)
+        order.push_back (readValue (request));
+
+    CHECK (order == std::vector<uint32_t> { 1, 2, 100, 101 });
+    CHECK (queue.getNumPaced() == 0);
+}
+
+TEST_CASE ("Paced queue drops audio whose deadline passed while queued", "[pacedqueue]")
+{
+    PacketPool pool;
+    pool.prepare (8, 1500);
+    PacedSendQueue queue;
+    queue.prepare (8);
+
+    const uint64_t nowNs = 50000000;
+    REQUIRE (queue.push (SendPriority::Audio, makeRequest (pool, 1, 500, nowNs - 1)));
+    REQUIRE (queue.push (SendPriority::Audio, makeRequest (pool, 2, 500, nowNs + 1)));
+    REQUIRE (queue.push (SendPriority::Audio, makeRequest (pool, 3, 500)));
+
+    SendRequest request;
+    uint64_t readyNs = 0;
+    REQUIRE (queue.pop (request, nowNs, readyNs) == PacedSendQueue::PopResult::Ready);
+    CHECK (readValue (request) == 2);
+    REQUIRE (queue.pop (request, nowNs, readyNs) == PacedSendQueue::PopResult::Ready);
+    CHECK (readValue (request) == 3);
+    CHECK (queue.pop (request, nowNs, readyNs) == PacedSendQueue::PopResult::Empty);
+    CHECK (queue.getNumStale() == 1);
+
+    // The stale packet went straight back to its pool
+    request.packet.reset();
+    CHECK (pool.getNumInUse() == 0);
+}
+
+TEST_CASE ("Paced queue spaces a backlog out at the configured rate", "[pacedqueue]")
+{
+    PacketPool pool;
+    pool.prepare (64, 1500);
+    PacedSendQueue queue;
+    queue.prepare (64);
+
+    // 1000 bytes per ms, so the bucket holds PACING_BURST_MS worth: five 1000-byte packets
+    const double rate = 1000000.0;
+    queue.setRate (rate);
+    const int numPackets = 40;
+    for (int i = 0; i < numPackets; ++i)
+        REQUIRE (queue.push (SendPriority::Audio, makeRequest (pool, (uint32_t) i, 1000)));
+
+    SendRequest request;
+    uint64_t nowNs = 1000000000;
+    const uint64_t startNs = nowNs;
+    int sent = 0, burst = 0;
+    bool inBurst = true;
+    while (sent < numPackets)
+    {
+        uint64_t readyNs = 0;
+        const auto result = queue.pop (request, nowNs, readyNs);
+        if (result == PacedSendQueue::PopResult::Paced)
+        {
+            REQUIRE (readyNs > nowNs);
+            nowNs = readyNs;
+            inBurst = false;
+            continue;
+        }
+        REQUIRE (result == PacedSendQueue::PopResult::Ready);
+        CHECK (readValue (request) == (uint32_t) sent);
+        ++sent;
+        burst += inBurst ? 1 : 0;
+    }
+
+    // The full bucket lets the first packets out together; after that one leaves per ms
+    CHECK (burst == (int) (PACING_BURST_MS) + 1);
+    const double elapsedMs = (double) (nowNs - startNs) / 1e6;
+    CHECK (elapsedMs >= numPackets - PACING_BURST_MS - 1.01);
+    CHECK (elapsedMs <= numPackets - PACING_BURST_MS + 0.01);
+    CHECK (queue.getNumPaced() > 0);
+
+    // Without a rate the same backlog leaves at once
+    queue.setRate (0.0);
+    for (int i = 0; i < 10; ++i)
+        REQUIRE (queue.push (SendPriority::Audio, makeRequest (pool, (uint32_t) i, 1000)));
+    int unpaced = 0;
+    uint64_t readyNs = 0;
+    while (queue.pop (request, nowNs, readyNs) == PacedSendQueue::PopResult::Ready)
+        ++unpaced;
+    CHECK (unpaced == 10);
+}
+
+TEST_CASE ("Paced queue never holds probes or lets them put audio in debt", "[pacedqueue]")
+{
+    PacketPool pool;
+    pool.prepare (32, 1500);
+    PacedSendQueue queue;
+    queue.prepare (32);
+    queue.setRate (1000000.0);
+
+    // A train of eight probes is worth 8 ms at this rate but leaves back to back
+    for (int i = 0; i < 8; ++i)
+        REQUIRE (queue.push (SendPriority::Probe, makeRequest (pool, (uint32_t) (100 + i), 1000)));
+
+    SendRequest request;
+    uint64_t readyNs = 0;
+    const uint64_t nowNs = 1000000000;
+    int probes = 0;
+    while (queue.pop (request, nowNs, readyNs) == PacedSendQueue::PopResult::Ready)
+        ++probes;
+    CHECK (probes == 8);
+    CHECK (queue.getNumPaced() == 0);
+
+    // The probes used up the bucket, so audio waits for it to refill, but only from empty
+    REQUIRE (queue.push (SendPriority::Audio, makeRequest (pool, 1, 1000)));
+    REQUIRE (queue.pop (request, nowNs, readyNs) == PacedSendQueue::PopResult::Ready);
+    REQUIRE (queue.push (SendPriority::Audio, makeRequest (pool, 2, 1000)));
+    REQUIRE (queue.pop (request, nowNs, readyNs) == PacedSendQueue::PopResult::Paced);
+    CHECK (readyNs == nowNs + 1000000);
+}
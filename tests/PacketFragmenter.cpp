@@ -0,0 +1,229 @@
+#include <PacketFragmenter.h>
+#include <PacketHeader.h>
+#include <PathMtuProber.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+    std::vector<uint8_t> makePacket (size_t size, uint32_t seed)
+    {
+        std::vector<uint8_t> packet (size);
+        std::mt19937 rng (seed);
+        for (auto& b : packet)
+            b = (uint8_t) rng();
+        return packet;
+    }
+
+    std::vector<std::vector<uint8_t>> fragment (const std::vector<uint8_t>& packet, uint32_t messageId, size_t maxDatagramSize)
+    {
+        std::vector<std::vector<uint8_t>> fragments;
+        const int count = PacketFragmenter::getNumFragments (packet.size(), maxDatagramSize);
+        for (int i = 0; i < count; ++i)
+        {
+            std::vector<uint8_t> datagram (maxDatagramSize);
+            const auto size = PacketFragmenter::writeFragment (packet.data(), packet.size(), messageId, i, maxDatagramSize, datagram.data(), datagram.size());
+            REQUIRE (size > FragmentHeader::kSize);
+            REQUIRE (size <= maxDatagramSize);
+            datagram.resize (size);
+            fragments.push_back (std::move (datagram));
+        }
+        return fragments;
+    }
+}
+
+TEST_CASE ("Fragment header round-trips and is told apart from a packet header", "[fragment]")
+{
+    FragmentHeader header;
+    header.messageId = 0xdeadbeef;
+    header.index = 3;
+    header.count = 12;
+    header.totalSize = 16424;
+    header.offset = 4116;
+
+    uint8_t buffer[FragmentHeader::kSize];
+    REQUIRE (header.encode (buffer, sizeof (buffer)) == FragmentHeader::kSize);
+    CHECK (header.encode (buffer, sizeof (buffer) - 1) == 0);
+
+    FragmentHeader decoded;
+    REQUIRE (FragmentHeader::decode (buffer, sizeof (buffer), decoded));
+    CHECK (decoded.messageId == header.messageId);
+    CHECK (decoded.index == header.index);
+    CHECK (decoded.count == header.count);
+    CHECK (decoded.totalSize == header.totalSize);
+    CHECK (decoded.offset == header.offset);
+    CHECK_FALSE (FragmentHeader::decode (buffer, sizeof (buffer) - 1, decoded));
+
+    uint8_t packet[PacketHeader::kSize];
+    PacketHeader().encode (packet, sizeof (packet));
+    CHECK_FALSE (FragmentHeader::isFragment (packet, sizeof (packet)));
+    CHECK (FragmentHeader::isFragment (buffer, sizeof (buffer)));
+}
+
+TEST_CASE ("Packets are only split when they exceed the datagram size", "[fragment]")
+{
+    CHECK (PacketFragmenter::getNumFragments (1372, 1372) == 1);
+    CHECK (PacketFragmenter::getNumFragments (1373, 1372) == 2);
+    CHECK (PacketFragmenter::getNumFragments (16424, 1372) == 13);
+    CHECK (PacketFragmenter::getNumFragments (16424, FragmentHeader::kSize + FRAGMENT_MIN_PAYLOAD - 1) == 0);
+
+    const auto packet = makePacket (1373, 1);
+    std::vector<uint8_t> datagram (1372);
+    CHECK (PacketFragmenter::writeFragment (packet.data(), packet.size(), 0, 2, 1372, datagram.data(), datagram.size()) == 0);
+    CHECK (PacketFragmenter::writeFragment (packet.data(), packet.size(), 0, 1, 1372, datagram.data(), 10) == 0);
+}
+
+TEST_CASE ("Reassembly restores packets from fragments in any order", "[fragment]")
+{
+    PacketReassembler reassembler;
+    reassembler.prepare (4, 32768);
+    std::mt19937 rng (7);
+
+    for (uint32_t id = 0; id < 50; ++id)
+    {
+        const auto packet = makePacket (1400 + id * 517, id);
+        auto fragments = fragment (packet, id, 1372);
+        std::shuffle (fragments.begin(), fragments.end(), rng);
+
+        int completed = 0;
+        for (size_t i = 0; i < fragments.size(); ++i)
+        {
+            const uint8_t* message = nullptr;
+            size_t messageSize = 0;
+            if (reassembler.addFragment (fragments[i].data(), fragments[i].size(), message, messageSize))
+            {
+                ++completed;
+                CHECK (i == fragments.size() - 1);
+                REQUIRE (messageSize == packet.size());
+                CHECK (std::equal (packet.begin(), packet.end(), message));
+            }
+        }
+        CHECK (completed == 1);
+    }
+
+    CHECK (reassembler.getNumCompleted() == 50);
+    CHECK (reassembler.getNumPending() == 0);
+    CHECK (reassembler.getNumEvicted() == 0);
+}
+
+TEST_CASE ("Interleaved packets, duplicates and late copies", "[fragment]")
+{
+    PacketReassembler reassembler;
+    reassembler.prepare (4, 32768);
+    const auto a = makePacket (5000, 1);
+    const auto b = makePacket (7000, 2);
+    const auto fa = fragment (a, 10, 1372);
+    const auto fb = fragment (b, 11, 1372);
+
+    const uint8_t* message = nullptr;
+    size_t messageSize = 0;
+    int completed = 0;
+    for (size_t i = 0; i < std::max (fa.size(), fb.size()); ++i)
+    {
+        if (i < fb.size())
+            completed += reassembler.addFragment (fb[i].data(), fb[i].size(), message, messageSize);
+        if (i < fa.size())
+        {
+            completed += reassembler.addFragment (fa[i].data(), fa[i].size(), message, messageSize);
+            // Every fragment of a arrives twice
+            CHECK_FALSE (reassembler.addFragment (fa[i].data(), fa[i].size(), message, messageSize));
+        }
+    }
+
+    CHECK (completed == 2);
+    CHECK (reassembler.getNumCompleted() == 2);
+    // One copy of a's last fragment arrives after a was delivered
+    CHECK (reassembler.getNumDuplicates() == fa.size());
+    CHECK (reassembler.getNumPending() == 0);
+}
+
+TEST_CASE ("Incomplete packets are evicted and memory stays bounded", "[fragment]")
+{
+    PacketReassembler reassembler;
+    reassembler.prepare (3, 32768);
+    const uint8_t* message = nullptr;
+    size_t messageSize = 0;
+
+    for (uint32_t id = 0; id < 20; ++id)
+    {
+        const auto packet = makePacket (6000, id);
+        const auto fragments = fragment (packet, id, 1372);
+        bool delivered = false;
+        for (size_t i = 0; i < fragments.size(); ++i)
+        {
+            // Every other packet loses its second fragment
+            if (id % 2 == 0 && i == 1)
+                continue;
+            delivered |= reassembler.addFragment (fragments[i].data(), fragments[i].size(), message, messageSize);
+        }
+        CHECK (delivered == (id % 2 == 1));
+        CHECK (reassembler.getNumPending() <= 3);
+    }
+
+    CHECK (reassembler.getNumCompleted() == 10);
+    // The lost packets are pushed out by the ones after them; the last two are still pending
+    CHECK (reassembler.getNumEvicted() + (uint64_t) reassembler.getNumPending() == 10);
+}
+
+TEST_CASE ("Malformed fragments are rejected", "[fragment]")
+{
+    PacketReassembler reassembler;
+    reassembler.prepare (2, 4096);
+    const uint8_t* message = nullptr;
+    size_t messageSize = 0;
+
+    auto fragments = fragment (makePacket (5000, 3), 1, 1372);
+    // Larger than the reassembly limit
+    CHECK_FALSE (reassembler.addFragment (fragments[0].data(), fragments[0].size(), message, messageSize));
+
+    fragments = fragment (makePacket (3000, 3), 2, 1372);
+    auto corrupt = fragments[1];
+    corrupt[18] = 0xff;
+    // Offset past the end of the packet
+    CHECK_FALSE (reassembler.addFragment (corrupt.data(), corrupt.size(), message, messageSize));
+    corrupt = fragments[1];
+    corrupt[10] = 9;
+    REQUIRE (reassembler.addFragment (fragments[0].data(), fragments[0].size(), message, messageSize) == false);
+    // Disagrees with the fragment count already seen for this id
+    CHECK_FALSE (reassembler.addFragment (corrupt.data(), corrupt.size(), message, messageSize));
+    CHECK_FALSE (reassembler.addFragment (fragments[1].data(), 5, message, messageSize));
+
+    CHECK (reassembler.getNumRejected() == 4);
+    for (size_t i = 1; i < fragments.size(); ++i)
+        reassembler.addFragment (fragments[i].data(), fragments[i].size(), message, messageSize);
+    CHECK (reassembler.getNumCompleted() == 1);
+}
+
+TEST_CASE ("Path-MTU search converges on the path limit despite probe loss", "[fragment]")
+{
+    for (int pathMtu : { 1280, 1400, 1500, 4000, 9000 })
+    {
+        PathMtuProber prober;
+        prober.start (0);
+        std::mt19937 rng ((uint32_t) pathMtu);
+        int64_t now = 0;
+        int probes = 0;
+
+        while (prober.isProbing() && probes < 200)
+        {
+            if (const int size = prober.poll (now))
+            {
+                ++probes;
+                CHECK (size >= PATH_MTU_MIN);
+                CHECK (size <= PATH_MTU_MAX);
+                // A quarter of the probes that fit are lost anyway
+                if (size <= pathMtu && rng() % 4 != 0)
+                    prober.onProbeEcho (size);
+            }
+            now += 10;
+        }
+
+        CHECK_FALSE (prober.isProbing());
+        CHECK (prober.getPathMtu() <= pathMtu);
+        CHECK (prober.getPathMtu() > pathMtu - PATH_MTU_RESOLUTION);
+        CHECK (prober.getMaxDatagramSize() == (size_t) (prober.getPathMtu() - PATH_MTU_HEADER_OVERHEAD));
+    }
+}
@@ -0,0 +1,47 @@
+#include <PacketHeader.h>
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE ("Packet header", "[packet]")
+{
+    PacketHeader header;
+    header.flags = 3;
+    header.numChannels = 4;
+    header.sampleFormat = SampleFormat::Int24;
+    header.codec = CodecId::Pcm;
+    header.sequence = 0x0123456789abcdefull;
+    header.samplePosition = 0xfedcba9876543210ull;
+    header.sendTimeNs = 42;
+    header.numFrames = 480;
+    header.payloadSize = 16;
+
+    uint8_t buffer[PacketHeader::kSize + 16] = {};
+    REQUIRE (header.encode (buffer, sizeof (buffer)) == PacketHeader::kSize);
+
+    SECTION ("round trip")
+    {
+        PacketHeader decoded;
+        REQUIRE (PacketHeader::decode (buffer, sizeof (buffer), decoded));
+        CHECK (decoded.flags == header.flags);
+        CHECK (decoded.numChannels == header.numChannels);
+        CHECK (decoded.sampleFormat == header.sampleFormat);
+        CHECK (decoded.codec == header.codec);
+        CHECK (decoded.sequence == header.sequence);
+        CHECK (decoded.samplePosition == header.samplePosition);
+        CHECK (decoded.sendTimeNs == header.sendTimeNs);
+        CHECK (decoded.numFrames == header.numFrames);
+        CHECK (decoded.payloadSize == header.payloadSize);
+    }
+
+    SECTION ("rejects truncated payload")
+    {
+        PacketHeader decoded;
+        CHECK_FALSE (PacketHeader::decode (buffer, sizeof (buffer) - 1, decoded));
+    }
+
+    SECTION ("rejects bad magic")
+    {
+        PacketHeader decoded;
+        buffer[0] ^= 0xff;
+        CHECK_FALSE (PacketHeader::decode (buffer, sizeof (buffer), decoded));
+    }
+}
@@ -0,0 +1,175 @@
+#include <PacketPool.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST_CASE ("Pool hands out every packet once and counts exhaustion", "[packetpool]")
+{
+    PacketPool pool;
+    pool.prepare (4, 128);
+    CHECK (pool.getNumPackets() == 4);
+    CHECK (pool.getPacketCapacity() == 128);
+
+    std::vector<PacketHandle> handles;
+    for (int i = 0; i < 4; ++i)
+    {
+        auto packet = pool.acquire();
+        REQUIRE (packet);
+        CHECK (packet.size() == 0);
+        CHECK (packet.capacity() == 128);
+        for (const auto& other : handles)
+            CHECK (other.data() != packet.data());
+        handles.push_back (std::move (packet));
+    }
+    CHECK (pool.getNumInUse() == 4);
+    CHECK (pool.getNumExhausted() == 0);
+
+    CHECK_FALSE (pool.acquire());
+    CHECK_FALSE (pool.acquire());
+    CHECK (pool.getNumExhausted() == 2);
+
+    handles.pop_back();
+    CHECK (pool.getNumInUse() == 3);
+    CHECK (pool.acquire());
+    // The temporary went straight back
+    CHECK (pool.getNumInUse() == 3);
+    handles.clear();
+    CHECK (pool.getNumInUse() == 0);
+}
+
+TEST_CASE ("The high-water mark keeps the most packets in use at once", "[packetpool]")
+{
+    PacketPool pool;
+    pool.prepare (8, 64);
+
+    {
+        auto a = pool.acquire();
+        auto b = pool.acquire();
+        auto c = pool.acquire();
+        CHECK (pool.getHighWaterMark() == 3);
+    }
+    CHECK (pool.getNumInUse() == 0);
+
+    auto d = pool.acquire();
+    CHECK (pool.getHighWaterMark() == 3);
+
+    // prepare() starts the counters over
+    d.reset();
+    pool.prepare (8, 64);
+    CHECK (pool.getHighWaterMark() == 0);
+    CHECK (pool.getNumExhausted() == 0);
+}
+
+TEST_CASE ("Copies share a packet and the last one returns it", "[packetpool]")
+{
+    PacketPool pool;
+    pool.prepare (2, 64);
+
+    auto packet = pool.acquire();
+    REQUIRE (packet);
+    const uint32_t value = 0x12345678;
+    std::memcpy (packet.data(), &value, sizeof (value));
+    packet.setSize (sizeof (value));
+
+    PacketHandle copy = packet;
+    PacketHandle assigned;
+    assigned = copy;
+    CHECK (copy.data() == packet.data());
+    CHECK (assigned.size() == sizeof (value));
+    CHECK (pool.getNumInUse() == 1);
+
+    packet.reset();
+    CHECK_FALSE (packet);
+    CHECK (pool.getNumInUse() == 1);
+    copy.reset();
+    CHECK (pool.getNumInUse() == 1);
+
+    // A move hands the reference on without touching the count
+    PacketHandle moved = std::move (assigned);
+    CHECK_FALSE (assigned);
+    CHECK (pool.getNumInUse() == 1);
+    uint32_t read = 0;
+    std::memcpy (&read, moved.data(), sizeof (read));
+    CHECK (read == value);
+
+    moved.reset();
+    CHECK (pool.getNumInUse() == 0);
+}
+
+TEST_CASE ("Packets acquired on one thread are released on another", "[packetpool]")
+{
+    // The sender thread acquires and the network thread releases, as on the send path
+    PacketPool pool;
+    pool.prepare (16, 64);
+
+    constexpr int kPackets = 200000;
+    constexpr size_t kSlots = 64;
+    std::vector<PacketHandle> handoff (kSlots);
+    std::vector<std::atomic<bool>> full (kSlots);
+    std::atomic<bool> corrupted { false };
+
+    std::thread releaser ([&] {
+        for (int i = 0; i < kPackets; ++i)
+        {
+            const size_t slot = (size_t) i % kSlots;
+            while (!full[slot].load (std::memory_order_acquire))
+                std::this_thread::yield();
+            uint32_t read = 0;
+            std::memcpy (&read, handoff[slot].data(), sizeof (read));
+            if (read != (uint32_t) i)
+                corrupted = true;
+            handoff[slot].reset();
+            full[slot].store (false, std::memory_order_release);
+        }
+    });
+
+    uint64_t numAcquired = 0;
+    for (int i = 0; i < kPackets; ++i)
+    {
+        const size_t slot = (size_t) i % kSlots;
+        while (full[slot].load (std::memory_order_acquire))
+            std::this_thread::yield();
+
+        PacketHandle packet;
+        while (!(packet = pool.acquire()))
+            std::this_thread::yield();
+        const uint32_t value = (uint32_t) i;
+        std::memcpy (packet.data(), &value, sizeof (value));
+        packet.setSize (sizeof (value));
+        ++numAcquired;
+
+        handoff[slot] = std::move (packet);
+        full[slot].store (true, std::memory_order_release);
+    }
+    releaser.join();
+
+    CHECK_FALSE (corrupted);
+    CHECK (numAcquired == (uint64_t) kPackets);
+    CHECK (pool.getNumInUse() == 0);
+    CHECK (pool.getHighWaterMark() <= 16);
+}
+
+TEST_CASE ("A shared pool lives until its last packet comes back", "[packetpool]")
+{
+    auto pool = std::make_shared<PacketPool>();
+    pool->prepare (2, 64);
+    std::weak_ptr<PacketPool> watch = pool;
+
+    auto packet = pool->acquire();
+    REQUIRE (packet);
+    PacketHandle copy = packet;
+
+    // The owner lets go while the packet is still out, as when the sender swaps pools
+    pool.reset();
+    CHECK_FALSE (watch.expired());
+    packet.reset();
+    CHECK_FALSE (watch.expired());
+    CHECK (watch.lock()->getNumInUse() == 1);
+
+    copy.reset();
+    CHECK (watch.expired());
+}
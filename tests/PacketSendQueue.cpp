@@ -0,0 +1,125 @@
+#include <PacketSendQueue.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    PacketHandle makePacket (PacketPool& pool, uint32_t value)
+    {
+        auto packet = pool.acquire();
+        if (packet)
+        {
+            std::memcpy (packet.data(), &value, sizeof (value));
+            packet.setSize (sizeof (value));
+        }
+        return packet;
+    }
+
+    uint32_t readValue (const PacketHandle& packet)
+    {
+        uint32_t value = 0;
+        std::memcpy (&value, packet.data(), sizeof (value));
+        return value;
+    }
+}
+
+TEST_CASE ("Send queue keeps order and rejects packets when full", "[sendqueue]")
+{
+    PacketPool pool;
+    pool.prepare (16, 64);
+    PacketSendQueue queue;
+    queue.prepare (4);
+
+    SendRequest request;
+    CHECK_FALSE (queue.pop (request));
+
+    for (uint32_t i = 0; i < 4; ++i)
+        REQUIRE (queue.push (7, makePacket (pool, i), 1200));
+    CHECK (queue.getNumReady() == 4);
+
+    // The rejected packet goes straight back to its pool
+    CHECK_FALSE (queue.push (7, makePacket (pool, 99), 1200));
+    CHECK (queue.getNumDropped() == 1);
+    CHECK (pool.getNumInUse() == 4);
+
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        REQUIRE (queue.pop (request));
+        CHECK (request.channel == 7);
+        CHECK (request.maxDatagramSize == 1200);
+        CHECK (readValue (request.packet) == i);
+    }
+    CHECK_FALSE (queue.pop (request));
+    request.packet.reset();
+    CHECK (pool.getNumInUse() == 0);
+
+    // Slots are reused lap after lap
+    for (uint32_t i = 0; i < 10; ++i)
+    {
+        REQUIRE (queue.push (1, makePacket (pool, i), 1200));
+        REQUIRE (queue.pop (request));
+        CHECK (readValue (request.packet) == i);
+    }
+}
+
+TEST_CASE ("Many instances feed one sender concurrently", "[sendqueue]")
+{
+    constexpr int numProducers = 8;
+    constexpr uint32_t numPackets = 5000;
+
+    std::vector<std::unique_ptr<PacketPool>> pools;
+    for (int p = 0; p < numProducers; ++p)
+    {
+        pools.push_back (std::make_unique<PacketPool>());
+        pools.back()->prepare (64, 16);
+    }
+    PacketSendQueue queue;
+    queue.prepare (128);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < numProducers; ++p)
+    {
+        producers.emplace_back ([&, p] {
+            for (uint32_t i = 0; i < numPackets;)
+            {
+                auto packet = makePacket (*pools[(size_t) p], i);
+                if (packet && queue.push ((uint64_t) p, std::move (packet), 1200))
+                    ++i;
+                else
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    std::vector<uint32_t> next (numProducers, 0);
+    bool ordered = true;
+    uint64_t total = 0;
+    SendRequest request;
+    while (total < (uint64_t) numProducers * numPackets)
+    {
+        const auto signal = queue.getSignal();
+        if (queue.pop (request))
+        {
+            // Each producer's packets come out in the order it pushed them
+            const auto p = (size_t) request.channel;
+            ordered &= readValue (request.packet) == next[p];
+            next[p] = readValue (request.packet) + 1;
+            request.packet.reset();
+            ++total;
+        }
+        else if (queue.getNumReady() == 0)
+        {
+            queue.waitForData (signal);
+        }
+    }
+    for (auto& producer : producers)
+        producer.join();
+
+    CHECK (ordered);
+    CHECK (queue.getNumReady() == 0);
+    for (auto& pool : pools)
+        CHECK (pool->getNumInUse() == 0);
+}
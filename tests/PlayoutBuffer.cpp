@@ -0,0 +1,212 @@
+#include <PlayoutBuffer.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr int kFrame = 480;
+    constexpr int kBlock = 128;
+    constexpr uint64_t kFrameNs = 10000000;
+
+    StreamFormat makeFormat()
+    {
+        StreamFormat format;
+        format.numChannels = 1;
+        return format;
+    }
+
+    float signalAt (uint64_t position, float level)
+    {
+        return level * (float) std::sin (2.0 * 3.14159265358979 * 100.0 * (double) position / 48000.0);
+    }
+
+    ReceivedPacket makePacket (uint64_t sequence, uint64_t arrivalNs, float level = 0.5f)
+    {
+        ReceivedPacket packet;
+        packet.allocate (PacketHeader::kSize + kFrame * sizeof (float));
+        packet.header.numChannels = 1;
+        packet.header.sequence = sequence;
+        packet.header.samplePosition = sequence * kFrame;
+        packet.header.numFrames = kFrame;
+        packet.header.payloadSize = kFrame * sizeof (float);
+        packet.header.encode (packet.data.data(), packet.data.size());
+        for (int i = 0; i < kFrame; ++i)
+        {
+            const float sample = signalAt (sequence * kFrame + (uint64_t) i, level);
+            std::memcpy (packet.data.data() + PacketHeader::kSize + (size_t) i * sizeof (float), &sample, sizeof (float));
+        }
+        packet.size = packet.data.size();
+        packet.arrivalNs = arrivalNs;
+        return packet;
+    }
+
+    // Sends numPackets 10 ms packets delayed by delayNs(sequence) and plays them in 128-sample blocks.
+    // The sender's clock runs senderPpm fast, the sine has the given level. Returns the largest step between consecutive output samples once playing
+    float simulate (PlayoutBuffer& buffer, uint64_t firstSequence, int numPackets, const std::function<uint64_t (uint64_t)>& delayNs, double senderPpm = 0.0, float level = 0.5f)
+    {
+        const auto sendTime = [senderPpm] (uint64_t s) { return (uint64_t) ((double) (s * kFrameNs) / (1.0 + senderPpm * 1e-6)); };
+        std::vector<ReceivedPacket> packets;
+        for (uint64_t s = firstSequence; s < firstSequence + (uint64_t) numPackets; ++s)
+            packets.push_back (makePacket (s, sendTime (s) + delayNs (s), level));
+        std::stable_sort (packets.begin(), packets.end(), [] (const auto& a, const auto& b) { return a.arrivalNs < b.arrivalNs; });
+
+        float maxStep = 0.0f;
+        std::vector<float> block (kBlock);
+        float* dest[] = { block.data() };
+        float previous = 0.0f;
+        bool started = false;
+        size_t next = 0;
+        const uint64_t blockNs = (uint64_t) kBlock * 1000000000ull / 48000;
+        const uint64_t end = sendTime (firstSequence + (uint64_t) numPackets);
+        for (uint64_t now = sendTime (firstSequence) / blockNs * blockNs; now < end; now += blockNs)
+        {
+            while (next < packets.size() && packets[next].arrivalNs <= now)
+                buffer.insert (packets[next++]);
+
+            buffer.read (dest, 1, kBlock, now);
+            if (!buffer.isPlaying())
+                continue;
+            for (float sample : block)
+            {
+                if (started)
+                    maxStep = std::max (maxStep, std::abs (sample - previous));
+                previous = sample;
+                started = true;
+            }
+        }
+        return maxStep;
+    }
+}
+
+TEST_CASE ("Reordered packets are played back in sequence", "[playout]")
+{
+    PlayoutBuffer buffer;
+    buffer.prepare (makeFormat(), 4096, kFrame, kBlock);
+
+    // Every odd packet is overtaken by the following even one
+    const auto maxStep = simulate (buffer, 0, 500, [] (uint64_t s) { return (s % 2) ? 14000000ull : 2000000ull; });
+
+    CHECK (buffer.getNumPlayedPackets() >= 490);
+    CHECK (buffer.getNumConcealedFrames() == 0);
+    CHECK (buffer.getNumLatePackets() == 0);
+    // A 100 Hz sine moves at most 0.0066 per sample; anything out of order would jump
+    CHECK (maxStep < 0.01f);
+}
+
+TEST_CASE ("Late packets are counted and raise the target delay", "[playout]")
+{
+    PlayoutBuffer buffer;
+    buffer.prepare (makeFormat(), 4096, kFrame, kBlock);
+
+    // Packet 300 is held back for 200 ms
+    simulate (buffer, 0, 300, [] (uint64_t) { return 1000000ull; });
+    REQUIRE (buffer.isPlaying());
+    const double before = buffer.getTargetDelayMs();
+    simulate (buffer, 300, 100, [] (uint64_t s) { return s == 300 ? 200000000ull : 1000000ull; });
+
+    CHECK (buffer.getNumLatePackets() == 1);
+    CHECK (buffer.getNumConcealedFrames() == 1);
+    CHECK (buffer.getTargetDelayMs() >= before);
+
+    // Duplicates and packets in another format are refused
+    const auto duplicate = makePacket (500, 0);
+    CHECK (buffer.insert (duplicate));
+    CHECK_FALSE (buffer.insert (duplicate));
+    auto stereo = makePacket (501, 0);
+    stereo.header.numChannels = 2;
+    CHECK_FALSE (buffer.insert (stereo));
+    auto int16 = makePacket (502, 0);
+    int16.header.sampleFormat = SampleFormat::Int16;
+    CHECK_FALSE (buffer.insert (int16));
+    CHECK (buffer.getNumRejected() == 3);
+}
+
+TEST_CASE ("The delay follows the network jitter and meets the late-rate target", "[playout]")
+{
+    PlayoutBuffer buffer;
+    buffer.prepare (makeFormat(), 4096, kFrame, kBlock);
+    buffer.setMaxLateRate (0.01);
+
+    std::mt19937 rng (7);
+    std::uniform_int_distribution<uint64_t> calm (0, 1000000);
+    std::uniform_int_distribution<uint64_t> rough (0, 30000000);
+
+    simulate (buffer, 0, 3000, [&] (uint64_t) { return 5000000ull + calm (rng); });
+    const double calmTarget = buffer.getTargetDelayMs();
+    CHECK (calmTarget < 10.0);
+    CHECK (buffer.getNumUnderruns() == 0);
+
+    // Let the estimate settle on the rough network before counting
+    simulate (buffer, 3000, 2000, [&] (uint64_t) { return 5000000ull + rough (rng); });
+    const auto lateBefore = buffer.getNumLatePackets();
+    const auto playedBefore = buffer.getNumPlayedPackets();
+    simulate (buffer, 5000, 6000, [&] (uint64_t) { return 5000000ull + rough (rng); });
+
+    const double roughTarget = buffer.getTargetDelayMs();
+    CHECK (roughTarget > calmTarget + 10.0);
+    CHECK (roughTarget < PLAYOUT_MAX_DELAY_MS);
+
+    const double lateRate = (double) (buffer.getNumLatePackets() - lateBefore) / (double) (buffer.getNumPlayedPackets() - playedBefore);
+    CHECK (lateRate < 0.03);
+
+    CHECK (std::abs (buffer.getCurrentDelayMs() - roughTarget) < 15.0);
+
+    simulate (buffer, 11000, 4000, [&] (uint64_t) { return 5000000ull + calm (rng); });
+    CHECK (buffer.getTargetDelayMs() < roughTarget);
+}
+
+TEST_CASE ("Sender clocks 200 ppm off are followed without draining or growing the buffer", "[playout]")
+{
+    for (double ppm : { 200.0, -200.0 })
+    {
+        PlayoutBuffer buffer;
+        buffer.prepare (makeFormat(), 4096, kFrame, kBlock);
+        std::mt19937 rng (3);
+        std::uniform_int_distribution<uint64_t> jitter (0, 2000000);
+
+        // Three minutes; the first 100 packets are lost to priming
+        simulate (buffer, 0, 18000, [&] (uint64_t) { return 5000000ull + jitter (rng); }, ppm);
+
+        // 200 ppm uncompensated would have moved the delay by 36 ms by now
+        CHECK (std::abs (buffer.getDriftPpm() - ppm) < 10.0);
+        CHECK (std::abs (buffer.getCurrentDelayMs() - buffer.getTargetDelayMs()) < 1.5);
+        CHECK (buffer.getCurrentDelayMs() < 10.0);
+        CHECK (buffer.getNumPlayedPackets() + buffer.getNumConcealedFrames() > 17800);
+        CHECK ((double) buffer.getNumLatePackets() / (double) buffer.getNumPlayedPackets() < 0.02);
+    }
+}
+
+TEST_CASE ("Delay left over from a jitter spike is caught up by time-scaling", "[playout]")
+{
+    for (float level : { 0.5f, 0.0f })
+    {
+        PlayoutBuffer buffer;
+        buffer.prepare (makeFormat(), 4096, kFrame, kBlock);
+        std::mt19937 rng (5);
+        std::uniform_int_distribution<uint64_t> calm (0, 1000000);
+        std::uniform_int_distribution<uint64_t> rough (0, 40000000);
+
+        simulate (buffer, 0, 2000, [&] (uint64_t) { return 5000000ull + rough (rng); }, 0.0, level);
+        const auto playedBefore = buffer.getNumPlayedPackets();
+        REQUIRE (buffer.getCurrentDelayMs() > 25.0);
+
+        // At 0.5% faster the resampler alone would need six seconds for 30 ms; at 5% it takes well under one
+        const auto maxStep = simulate (buffer, 2000, 200, [&] (uint64_t) { return 5000000ull + calm (rng); }, 0.0, level);
+        CHECK (buffer.getCurrentDelayMs() < 10.0);
+        // Time-scaling stops at its threshold and leaves the rest to the resampler
+        CHECK (std::abs (buffer.getCurrentDelayMs() - buffer.getTargetDelayMs()) < PLAYOUT_TIME_SCALE_THRESHOLD_MS + 1.0);
+        // Nothing was thrown away to get there
+        CHECK (buffer.getNumPlayedPackets() - playedBefore >= 199);
+        CHECK (maxStep < 0.05f);
+        if (level > 0.0f)
+            CHECK (buffer.getNumCompressions() > 0);
+        else
+            CHECK (buffer.getNumSilentFramesDropped() > 0);
+    }
+}
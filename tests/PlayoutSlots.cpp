@@ -0,0 +1,153 @@
+#include <PlayoutSlots.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <thread>
+
+namespace
+{
+    PacketHeader makeHeader (CodecId codec, SampleFormat sampleFormat, uint16_t numChannels)
+    {
+        PacketHeader header;
+        header.codec = codec;
+        header.sampleFormat = sampleFormat;
+        header.numChannels = numChannels;
+        return header;
+    }
+
+    StreamAnnouncement makeAnnouncement (int streamId, double sampleRate, int bitrate)
+    {
+        StreamAnnouncement stream;
+        stream.streamId = streamId;
+        stream.format.sampleRate = sampleRate;
+        stream.format.numChannels = 2;
+        stream.format.codec = CodecId::Mdct;
+        stream.format.bitrate = bitrate;
+        return stream;
+    }
+}
+
+TEST_CASE ("Without an announcement a stream plays in the format of its packets", "[playout]")
+{
+    PlayoutSlots slots;
+    slots.prepare (2, 48000.0, 4096, 960, 128);
+    const auto header = makeHeader (CodecId::Lossless, SampleFormat::Int24, 1);
+
+    CHECK (slots.find (0, 5, header) == nullptr);
+    CHECK (slots.get (0) == nullptr);
+    slots.update();
+
+    auto* buffer = slots.find (0, 5, header);
+    REQUIRE (buffer != nullptr);
+    CHECK (buffer->getFormat().codec == CodecId::Lossless);
+    CHECK (buffer->getFormat().sampleFormat == SampleFormat::Int24);
+    CHECK (buffer->getFormat().numChannels == 1);
+    CHECK (buffer->getFormat().sampleRate == 48000.0);
+    CHECK (slots.get (1) == nullptr);
+
+    PlayoutSlots::StreamStatus status;
+    REQUIRE (slots.getStatus (0, status));
+    CHECK (status.streamId == 5);
+    CHECK (status.dropped == 1);
+    CHECK (status.format.codec == CodecId::Lossless);
+    REQUIRE (slots.getStatus (1, status));
+    CHECK (status.streamId == -1);
+    CHECK_FALSE (slots.getStatus (2, status));
+
+    // Another stream taking over the slot gets a buffer of its own
+    CHECK (slots.find (0, 6, makeHeader (CodecId::Pcm, SampleFormat::Int16, 2)) == nullptr);
+    CHECK (slots.get (0) == buffer);
+    slots.update();
+    buffer = slots.find (0, 6, makeHeader (CodecId::Pcm, SampleFormat::Int16, 2));
+    REQUIRE (buffer != nullptr);
+    CHECK (buffer->getFormat().sampleFormat == SampleFormat::Int16);
+    CHECK (buffer->getFormat().numChannels == 2);
+}
+
+TEST_CASE ("The announced format sets the rate and bitrate, also for a stream already playing", "[playout]")
+{
+    PlayoutSlots slots;
+    slots.prepare (1, 48000.0, 4096, 960, 128);
+    const auto header = makeHeader (CodecId::Mdct, SampleFormat::Float32, 2);
+
+    slots.announce (makeAnnouncement (5, 48000.0, 64000));
+    slots.find (0, 5, header);
+    slots.update();
+    auto* buffer = slots.find (0, 5, header);
+    REQUIRE (buffer != nullptr);
+    CHECK (buffer->getFormat().bitrate == 64000);
+
+    // A later announcement prepares the buffer again without waiting for a packet
+    slots.announce (makeAnnouncement (5, 48000.0, 128000));
+    buffer = slots.get (0);
+    REQUIRE (buffer != nullptr);
+    CHECK (buffer->getFormat().bitrate == 128000);
+    CHECK (slots.find (0, 5, header) == buffer);
+
+    // Announcements for other streams leave it alone
+    slots.announce (makeAnnouncement (8, 48000.0, 32000));
+    CHECK (slots.get (0) == buffer);
+}
+
+TEST_CASE ("Streams sent at another sample rate are rejected", "[playout]")
+{
+    PlayoutSlots slots;
+    slots.prepare (1, 48000.0, 4096, 960, 128);
+    const auto header = makeHeader (CodecId::Mdct, SampleFormat::Float32, 2);
+
+    slots.announce (makeAnnouncement (5, 44100.0, 64000));
+    for (int i = 0; i < 3; ++i)
+    {
+        CHECK (slots.find (0, 5, header) == nullptr);
+        slots.update();
+    }
+    CHECK (slots.get (0) == nullptr);
+    CHECK (slots.getNumRateMismatches() == 1);
+    PlayoutSlots::StreamStatus status;
+    REQUIRE (slots.getStatus (0, status));
+    CHECK (status.streamId == -1);
+    CHECK (status.dropped == 3);
+}
+
+TEST_CASE ("Buffers are prepared and read on other threads while the audio thread plays", "[playout]")
+{
+    PlayoutSlots slots;
+    slots.prepare (2, 48000.0, 4096, 960, 128);
+
+    std::atomic<bool> done { false };
+    std::thread network ([&] {
+        while (!done.load())
+        {
+            slots.update();
+            std::this_thread::yield();
+        }
+    });
+    // The counters and delays are read from the message thread meanwhile
+    std::thread reader ([&] {
+        PlayoutSlots::StreamStatus status;
+        while (!done.load())
+        {
+            slots.getStatus (0, status);
+            slots.getStatus (1, status);
+        }
+    });
+
+    int found = 0;
+    for (int i = 0; i < 20000; ++i)
+    {
+        // Two streams keep changing format, so buffers keep being replaced
+        const int index = i % 2;
+        const auto header = makeHeader (CodecId::Pcm, (i / 500) % 2 ? SampleFormat::Int16 : SampleFormat::Float32, 2);
+        if (auto* buffer = slots.find (index, 10 + index, header))
+        {
+            CHECK (buffer->getFormat().sampleFormat == header.sampleFormat);
+            ++found;
+        }
+        if (i % 1000 == 0)
+            std::this_thread::sleep_for (std::chrono::milliseconds (1));
+    }
+    done = true;
+    network.join();
+    reader.join();
+    CHECK (found > 0);
+}
@@ -0,0 +1,184 @@
+#include <ProbeEngine.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr uint64_t kMs = 1000000;
+
+    ProbeConfig makeConfig (int numProbes, double toleranceMs)
+    {
+        ProbeConfig config;
+        config.numProbes = numProbes;
+        config.intervalMs = 5.0;
+        config.probeSize = 200;
+        config.minEchoes = 50;
+        config.toleranceMs = toleranceMs;
+        config.window = 50;
+        return config;
+    }
+}
+
+TEST_CASE ("Probes go out at the configured rate from one buffer", "[probe]")
+{
+    ProbeEngine engine;
+    REQUIRE (engine.setConfig (makeConfig (10, 0.0)));
+    engine.start (0);
+
+    const uint8_t* first = nullptr;
+    REQUIRE (engine.poll (0, first) == 200);
+    CHECK (ProbeEngine::isProbe (first, 200));
+    CHECK (engine.getNextDueNs() == 5 * kMs);
+
+    const uint8_t* data = nullptr;
+    CHECK (engine.poll (4 * kMs, data) == 0);
+    CHECK (engine.poll (5 * kMs, data) == 200);
+    CHECK (data == first);
+
+    // A late wakeup sends one probe, not a burst
+    CHECK (engine.poll (30 * kMs, data) == 200);
+    CHECK (engine.poll (30 * kMs, data) == 0);
+    CHECK (engine.getNextDueNs() == 35 * kMs);
+
+    for (uint64_t now = 35 * kMs; engine.getNumSent() < 10; now += 5 * kMs)
+        engine.poll (now, data);
+    CHECK (engine.poll (200 * kMs, data) == 0);
+
+    // Unanswered probes time out and end the run
+    CHECK (engine.isProbing());
+    CHECK (engine.getNextDueNs() == 65 * kMs + (uint64_t) (PROBE_ECHO_TIMEOUT_MS * 1e6));
+    engine.poll (65 * kMs + (uint64_t) (PROBE_ECHO_TIMEOUT_MS * 1e6), data);
+    CHECK (engine.getState() == ProbeState::Finished);
+    CHECK (engine.isDone());
+    CHECK (engine.getNextDueNs() == UINT64_MAX);
+}
+
+TEST_CASE ("Echoes give the round-trip time and jitter; probing stops once it converges", "[probe]")
+{
+    ProbeEngine engine;
+    REQUIRE (engine.setConfig (makeConfig (10000, 0.05)));
+    engine.start (0);
+
+    std::mt19937 rng (4);
+    std::uniform_int_distribution<uint64_t> delay (20 * kMs, 22 * kMs);
+    uint64_t now = 0;
+    const uint8_t* data = nullptr;
+    while (engine.isProbing() && now < 60000 * kMs)
+    {
+        if (const size_t size = engine.poll (now, data))
+        {
+            const std::vector<uint8_t> echo (data, data + size);
+            REQUIRE (engine.onEcho (echo.data(), echo.size(), now + delay (rng)));
+            // Duplicates and foreign datagrams are ignored
+            CHECK_FALSE (engine.onEcho (echo.data(), echo.size(), now + delay (rng)));
+        }
+        now += kMs;
+    }
+
+    CHECK (engine.getState() == ProbeState::Converged);
+    CHECK (engine.getNumSent() < 2000);
+    CHECK (engine.getNumEchoes() == engine.getNumSent());
+    CHECK (engine.getMinRttMs() >= 20.0);
+    CHECK (engine.getMeanRttMs() > 20.5);
+    CHECK (engine.getMeanRttMs() < 21.5);
+    // Uniform over 2 ms: mean absolute difference of two draws is 2/3 ms
+    CHECK (engine.getAverageJitterMs() > 0.5);
+    CHECK (engine.getAverageJitterMs() < 0.8);
+
+    std::vector<uint8_t> foreign (200, 0);
+    CHECK_FALSE (engine.onEcho (foreign.data(), foreign.size(), now));
+}
+
+TEST_CASE ("Echoes from an earlier run are ignored", "[probe]")
+{
+    ProbeEngine engine;
+    REQUIRE (engine.setConfig (makeConfig (10, 0.0)));
+    engine.start (0);
+
+    const uint8_t* data = nullptr;
+    const size_t size = engine.poll (0, data);
+    const std::vector<uint8_t> old (data, data + size);
+
+    engine.start (kMs);
+    engine.poll (kMs, data);
+    CHECK_FALSE (engine.onEcho (old.data(), old.size(), 2 * kMs));
+    CHECK (engine.onEcho (data, size, 2 * kMs));
+    CHECK (engine.getLastRttMs() == 1.0);
+
+    engine.stop();
+    CHECK (engine.getState() == ProbeState::Stopped);
+    CHECK_FALSE (engine.isDone());
+    CHECK (engine.poll (100 * kMs, data) == 0);
+
+    // Invalid configurations are refused and the old one kept
+    auto config = makeConfig (10, 0.0);
+    config.probeSize = PROBE_HEADER_SIZE - 1;
+    CHECK_FALSE (engine.setConfig (config));
+    CHECK (engine.getConfig().probeSize == 200);
+}
+
+TEST_CASE ("Probe trains go out back to back and step through their sizes", "[probe]")
+{
+    auto config = makeConfig (40, 0.0);
+    config.trainLength = 4;
+    config.maxProbeSize = 800;
+    REQUIRE (config.isValid());
+    ProbeEngine engine;
+    REQUIRE (engine.setConfig (config));
+    engine.start (0);
+
+    // A whole train is due at once, then nothing until the next interval
+    const uint8_t* data = nullptr;
+    for (int i = 0; i < 4; ++i)
+        CHECK (engine.poll (0, data) == 200);
+    CHECK (engine.poll (0, data) == 0);
+    CHECK (engine.getNextDueNs() == 5 * kMs);
+
+    CHECK (engine.poll (5 * kMs, data) == 400);
+    CHECK (engine.poll (5 * kMs, data) == 400);
+
+    auto tooLong = config;
+    tooLong.trainLength = PROBE_MAX_TRAIN_LENGTH + 1;
+    CHECK_FALSE (tooLong.isValid());
+    auto tooSmall = config;
+    tooSmall.maxProbeSize = 100;
+    CHECK_FALSE (tooSmall.isValid());
+}
+
+TEST_CASE ("Echoed trains feed the bandwidth estimate", "[probe]")
+{
+    auto config = makeConfig (400, 0.0);
+    config.trainLength = 8;
+    config.probeSize = 1000;
+    ProbeEngine engine;
+    REQUIRE (engine.setConfig (config));
+    engine.start (0);
+
+    // A 1 MB/s bottleneck lets a 1000-byte probe through every millisecond
+    uint64_t now = 0, bottleneckFreeNs = 0;
+    const uint8_t* data = nullptr;
+    while (engine.getNumSent() < 400)
+    {
+        while (const size_t size = engine.poll (now, data))
+        {
+            const std::vector<uint8_t> echo (data, data + size);
+            bottleneckFreeNs = std::max (bottleneckFreeNs, now + 10 * kMs) + kMs;
+            REQUIRE (engine.onEcho (echo.data(), echo.size(), bottleneckFreeNs + 10 * kMs));
+        }
+        now = engine.getNextDueNs();
+    }
+
+    const auto estimate = engine.getBandwidthEstimate();
+    CHECK (estimate.numTrains > 40);
+    CHECK (std::abs (estimate.dispersionBytesPerSecond - 1.0e6) < 1.0e4);
+    CHECK (estimate.availableBytesPerSecond > 0.0);
+    CHECK (estimate.availableBytesPerSecond <= estimate.dispersionBytesPerSecond);
+
+    engine.resetBandwidthEstimate();
+    CHECK (engine.getBandwidthEstimate().numTrains == 0);
+}
@@ -0,0 +1,196 @@
+#include <ProbeStreamHandler.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <PacketHeader.h>
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    constexpr uint64_t kMs = 1000000;
+    constexpr int kOwnStream = 7;
+
+    // One instance's side of the jitter stream
+    struct Instance
+    {
+        explicit Instance (int id) : streamId (id)
+        {
+            statistics.prepare();
+            handler.setReplyCallback ([this] (const uint8_t* data, size_t size) { replies.emplace_back (data, data + size); });
+        }
+
+        int streamId;
+        ProbeEngine engine;
+        PathMtuProber mtuProber;
+        ClockSync clock;
+        JitterStatistics statistics;
+        ProbeStreamHandler handler { engine, mtuProber, clock, statistics };
+        std::vector<std::vector<uint8_t>> replies;
+
+        ProbeRoute receive (int sourceStreamId, const std::vector<uint8_t>& datagram, uint64_t arrivalNs)
+        {
+            return handler.onReceive (streamId, sourceStreamId, datagram.data(), datagram.size(), arrivalNs);
+        }
+    };
+
+    ProbeConfig makeConfig (int numProbes)
+    {
+        ProbeConfig config;
+        config.numProbes = numProbes;
+        config.intervalMs = 5.0;
+        config.probeSize = 200;
+        config.toleranceMs = 0.0;
+        return config;
+    }
+}
+
+TEST_CASE ("Echoes of our own jitter stream reach the probe engine", "[probestream]")
+{
+    ProbeEngine engine;
+    PathMtuProber mtuProber;
+    ClockSync clock;
+    JitterStatistics statistics;
+    statistics.prepare();
+    ProbeStreamHandler handler (engine, mtuProber, clock, statistics);
+
+    REQUIRE (engine.setConfig (makeConfig (4)));
+    engine.start (0);
+    const uint8_t* data = nullptr;
+    const size_t size = engine.poll (0, data);
+    REQUIRE (size == 200);
+    const std::vector<uint8_t> probe (data, data + size);
+
+    // Until the jitter stream exists nothing can be told apart, and other streams are not ours
+    CHECK (handler.onReceive (0, kOwnStream, probe.data(), probe.size(), 2 * kMs) == ProbeRoute::Ignored);
+    CHECK (handler.onReceive (kOwnStream, 9, probe.data(), probe.size(), 2 * kMs) == ProbeRoute::Ignored);
+    CHECK (engine.getNumEchoes() == 0);
+
+    CHECK (handler.onReceive (kOwnStream, kOwnStream, probe.data(), probe.size(), 2 * kMs) == ProbeRoute::Echo);
+    CHECK (engine.getNumEchoes() == 1);
+    CHECK (engine.getLastRttMs() == 2.0);
+    CHECK (statistics.getSummary (StatisticsMetric::RoundTrip).count == 1);
+
+    // A duplicate is not counted twice
+    CHECK (handler.onReceive (kOwnStream, kOwnStream, probe.data(), probe.size(), 3 * kMs) == ProbeRoute::Ignored);
+    CHECK (engine.getNumEchoes() == 1);
+}
+
+TEST_CASE ("Path-MTU probe echoes are told apart by their payload", "[probestream]")
+{
+    ProbeEngine engine;
+    PathMtuProber mtuProber;
+    ClockSync clock;
+    JitterStatistics statistics;
+    statistics.prepare();
+    ProbeStreamHandler handler (engine, mtuProber, clock, statistics);
+
+    mtuProber.start (0);
+    const int probeSize = mtuProber.poll (0);
+    REQUIRE (probeSize == PATH_MTU_DEFAULT);
+
+    std::vector<uint8_t> payload (PathMtuProber::getProbePayloadSize (probeSize));
+    PathMtuProber::writeProbe (payload.data(), payload.size(), probeSize);
+    CHECK (PathMtuProber::readProbe (payload.data(), payload.size()) == probeSize);
+    CHECK_FALSE (ProbeEngine::isProbe (payload.data(), payload.size()));
+    // Truncated on the way, it proves nothing about its size
+    CHECK (PathMtuProber::readProbe (payload.data(), payload.size() - 1) == 0);
+
+    // Another instance's probe of the same size says nothing about our path
+    CHECK (handler.onReceive (kOwnStream, 9, payload.data(), payload.size(), kMs) == ProbeRoute::Ignored);
+    CHECK (mtuProber.getPathMtu() == PATH_MTU_DEFAULT);
+
+    CHECK (handler.onReceive (kOwnStream, kOwnStream, payload.data(), payload.size(), kMs) == ProbeRoute::MtuEcho);
+    CHECK (engine.getNumEchoes() == 0);
+    // The echo moved the search on to a larger size
+    CHECK (mtuProber.poll (kMs / 1000000) > PATH_MTU_DEFAULT);
+}
+
+TEST_CASE ("Instances answer higher ones and synchronize to the lowest", "[probestream]")
+{
+    Instance low (3);
+    Instance high (5);
+    Instance other (8);
+
+    REQUIRE (high.engine.setConfig (makeConfig (100)));
+    REQUIRE (low.engine.setConfig (makeConfig (100)));
+    // The answers are stamped on the real clock, so the probes go out on it too
+    high.engine.start (getMonotonicTimeNs());
+    low.engine.start (getMonotonicTimeNs());
+    const auto poll = [] (ProbeEngine& engine) {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        while ((size = engine.poll (getMonotonicTimeNs(), data)) == 0)
+            ;
+        return std::vector<uint8_t> (data, data + size);
+    };
+
+    for (int i = 0; i < 20; ++i)
+    {
+        // The low instance's probes are not answered by the one synchronizing to it
+        CHECK (high.receive (low.streamId, poll (low.engine), getMonotonicTimeNs()) == ProbeRoute::Ignored);
+        REQUIRE (low.receive (high.streamId, poll (high.engine), getMonotonicTimeNs()) == ProbeRoute::Answered);
+    }
+    CHECK (high.replies.empty());
+    REQUIRE (low.replies.size() == 20);
+
+    // Answering without a lower peer makes the low instance the reference
+    CHECK (low.clock.isSynchronized());
+    CHECK (low.clock.toReferenceNs (1234) == 1234);
+
+    // Answers are delivered to every instance; only the one that probed takes them
+    for (const auto& reply : low.replies)
+    {
+        CHECK (other.receive (low.streamId, reply, getMonotonicTimeNs()) == ProbeRoute::Ignored);
+        CHECK (high.receive (low.streamId, reply, getMonotonicTimeNs()) == ProbeRoute::Reply);
+    }
+    CHECK (high.clock.getNumSamples() == 20);
+    CHECK (high.clock.isSynchronized());
+    // Both clocks are the same one here, so the offset is only the turnaround's asymmetry
+    CHECK (std::abs (high.clock.getOffsetMs()) < 100.0);
+    CHECK (high.statistics.getSummary (StatisticsMetric::OutboundDelay).count > 0);
+    CHECK (other.clock.getNumSamples() == 0);
+
+    // An answer from a higher instance is never taken
+    CHECK (low.receive (high.streamId, low.replies.front(), getMonotonicTimeNs()) == ProbeRoute::Ignored);
+}
+
+TEST_CASE ("Echoes taken on the receive path fill the bandwidth estimate", "[probestream]")
+{
+    // Packet trains go out as the probe thread sends them and come back through the handler,
+    // as the jitter stream receiver delivers them, over a 2 MB/s bottleneck with a 20 ms round trip
+    Instance instance (kOwnStream);
+    auto config = makeConfig (800);
+    config.probeSize = 1000;
+    config.trainLength = 8;
+    REQUIRE (instance.engine.setConfig (config));
+    CHECK (instance.engine.getBandwidthEstimate().availableBytesPerSecond == 0.0);
+
+    constexpr double kBytesPerSecond = 2.0e6;
+    uint64_t now = 1000 * kMs;
+    instance.engine.start (now);
+    std::vector<uint8_t> echo;
+    for (int train = 0; train < 100; ++train, now += 5 * kMs)
+    {
+        const uint8_t* data = nullptr;
+        for (int i = 0; i < config.trainLength; ++i)
+        {
+            const size_t size = instance.engine.poll (now, data);
+            REQUIRE (size == 1000);
+            echo.assign (data, data + size);
+
+            // Other instances' streams share the receiver and must not disturb the estimate
+            CHECK (instance.receive (kOwnStream + 1, std::vector<uint8_t> (16), now) == ProbeRoute::Ignored);
+
+            const auto arrivalNs = now + 20 * kMs + (uint64_t) std::llround ((double) size / kBytesPerSecond * 1e9 * (i + 1));
+            REQUIRE (instance.receive (kOwnStream, echo, arrivalNs) == ProbeRoute::Echo);
+        }
+    }
+
+    const auto estimate = instance.engine.getBandwidthEstimate();
+    CHECK (estimate.numTrains == 99);
+    CHECK (std::abs (estimate.dispersionBytesPerSecond - kBytesPerSecond) < 2.0e4);
+    CHECK (estimate.availableBytesPerSecond > 0.0);
+    CHECK (estimate.availableBytesPerSecond <= estimate.dispersionBytesPerSecond);
+    CHECK (instance.statistics.getSummary (StatisticsMetric::RoundTrip).count == 800);
+}
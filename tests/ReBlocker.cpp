@@ -0,0 +1,110 @@
+#include <ReBlocker.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <random>
+#include <vector>
+
+namespace
+{
+    struct Collected
+    {
+        std::vector<int> lengths;
+        std::vector<uint64_t> positions;
+        std::vector<float> samples;
+    };
+
+    Collected drain (AudioFrameRing& ring)
+    {
+        Collected result;
+        AudioFrame frame;
+        frame.allocate (ring.getMaxChannels(), ring.getMaxSamples());
+        while (ring.pop (frame))
+        {
+            result.lengths.push_back (frame.numSamples);
+            result.positions.push_back (frame.samplePosition);
+            for (int i = 0; i < frame.numSamples; ++i)
+                result.samples.push_back (frame.getReadPointer (1)[i]);
+        }
+        return result;
+    }
+}
+
+TEST_CASE ("Re-blocker emits fixed frames for any host block size", "[reblocker]")
+{
+    const int frameLength = ReBlocker::getFrameLength (48000.0, 2.5);
+    REQUIRE (frameLength == 120);
+    CHECK (ReBlocker::getFrameLength (48000.0, 20.0) == 960);
+
+    AudioFrameRing ring;
+    ring.prepare (4096, 2, 960);
+    ReBlocker reBlocker;
+    reBlocker.prepare (2, 960);
+    reBlocker.setFrameLength (frameLength, ring);
+
+    std::mt19937 rng (5);
+    std::uniform_int_distribution<int> blockSizes (1, 2048);
+    std::vector<float> left (2048), right (2048);
+    uint64_t position = 1000;
+
+    for (int block = 0; block < 200; ++block)
+    {
+        const int numSamples = block % 3 == 0 ? 32 : blockSizes (rng);
+        for (int i = 0; i < numSamples; ++i)
+            right[(size_t) i] = (float) (position + (uint64_t) i);
+
+        const float* channels[] = { left.data(), right.data() };
+        reBlocker.process (channels, 2, numSamples, position, ring);
+        position += (uint64_t) numSamples;
+    }
+
+    const auto frames = drain (ring);
+    REQUIRE_FALSE (frames.lengths.empty());
+    CHECK (ring.getNumDropped() == 0);
+
+    for (size_t i = 0; i < frames.lengths.size(); ++i)
+    {
+        CHECK (frames.lengths[i] == frameLength);
+        CHECK (frames.positions[i] == 1000 + i * (uint64_t) frameLength);
+    }
+
+    // Every sample arrives once, in order, and the remainder is still buffered
+    for (size_t i = 0; i < frames.samples.size(); ++i)
+        REQUIRE (frames.samples[i] == (float) (1000 + i));
+    CHECK (frames.samples.size() + (size_t) reBlocker.getNumBuffered() == position - 1000);
+}
+
+TEST_CASE ("Re-blocker flushes partial frames on interruptions", "[reblocker]")
+{
+    AudioFrameRing ring;
+    ring.prepare (64, 2, 480);
+    ReBlocker reBlocker;
+    reBlocker.prepare (2, 480);
+    reBlocker.setFrameLength (240, ring);
+
+    std::vector<float> left (100, 0.0f), right (100, 1.0f);
+    const float* channels[] = { left.data(), right.data() };
+
+    SECTION ("frame length change")
+    {
+        reBlocker.process (channels, 2, 100, 0, ring);
+        reBlocker.setFrameLength (480, ring);
+        reBlocker.process (channels, 2, 100, 100, ring);
+
+        const auto frames = drain (ring);
+        REQUIRE (frames.lengths == std::vector<int> { 100 });
+        CHECK (reBlocker.getNumBuffered() == 100);
+        CHECK (reBlocker.getFrameLength() == 480);
+    }
+
+    SECTION ("position jump")
+    {
+        reBlocker.process (channels, 2, 100, 0, ring);
+        reBlocker.process (channels, 2, 100, 5000, ring);
+        reBlocker.process (channels, 2, 100, 5100, ring);
+        reBlocker.process (channels, 2, 100, 5200, ring);
+
+        const auto frames = drain (ring);
+        REQUIRE (frames.lengths == std::vector<int> { 100, 240 });
+        CHECK (frames.positions == std::vector<uint64_t> { 0, 5000 });
+    }
+}
@@ -0,0 +1,69 @@
+#include <Resampler.h>
+#include <SampleConversion.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    constexpr double kPi = 3.14159265358979;
+
+    // SNR of a resampled sine against the exact sine at the same positions
+    double resampledSnrDb (const Resampler& resampler, double frequency, double ratio)
+    {
+        std::vector<float> input (8192);
+        for (size_t i = 0; i < input.size(); ++i)
+            input[i] = (float) std::sin (2.0 * kPi * frequency * (double) i / 48000.0);
+
+        const int numSamples = 4096;
+        const double start = 100.25;
+        std::vector<float> output (numSamples);
+        resampler.process (input.data(), start, ratio, output.data(), numSamples);
+
+        double signal = 0.0, error = 0.0;
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const double expected = std::sin (2.0 * kPi * frequency * (start + i * ratio) / 48000.0);
+            signal += expected * expected;
+            error += (output[(size_t) i] - expected) * (output[(size_t) i] - expected);
+        }
+        return 10.0 * std::log10 (signal / error);
+    }
+}
+
+TEST_CASE ("The resampler is transparent across the audio band", "[resampler]")
+{
+    Resampler resampler;
+    resampler.prepare();
+
+    for (double ratio : { 1.0, 1.0002, 0.9998, 1.005, 0.995 })
+    {
+        CHECK (resampledSnrDb (resampler, 440.0, ratio) > 80.0);
+        CHECK (resampledSnrDb (resampler, 5000.0, ratio) > 70.0);
+        CHECK (resampledSnrDb (resampler, 15000.0, ratio) > 50.0);
+    }
+}
+
+TEST_CASE ("Resampler SIMD paths match the scalar path", "[resampler]")
+{
+    Resampler resampler;
+    resampler.prepare();
+
+    std::vector<float> input (2048);
+    for (size_t i = 0; i < input.size(); ++i)
+        input[i] = (float) std::sin ((double) i * 0.37) * 0.8f;
+
+    std::vector<float> scalar (1000), vector (1000);
+    SampleConversion::setIsa (SampleConversion::Isa::Scalar);
+    resampler.process (input.data(), 40.7, 1.0013, scalar.data(), 1000);
+
+    for (auto isa : { SampleConversion::Isa::Sse2, SampleConversion::Isa::Avx2 })
+    {
+        SampleConversion::setIsa (isa);
+        resampler.process (input.data(), 40.7, 1.0013, vector.data(), 1000);
+        for (size_t i = 0; i < scalar.size(); ++i)
+            CHECK (std::abs (vector[i] - scalar[i]) < 1e-5f);
+    }
+    SampleConversion::setIsa (SampleConversion::getBestIsa());
+}
@@ -0,0 +1,85 @@
+#include <SampleConversion.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    std::vector<std::vector<float>> makeSignal (int numChannels, int numFrames)
+    {
+        std::vector<std::vector<float>> channels ((size_t) numChannels, std::vector<float> ((size_t) numFrames));
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < numFrames; ++i)
+                channels[(size_t) ch][(size_t) i] = 0.9f * std::sin (0.01f * (float) (i + 1) * (float) (ch + 1));
+        return channels;
+    }
+
+    std::vector<float*> pointers (std::vector<std::vector<float>>& channels)
+    {
+        std::vector<float*> result;
+        for (auto& c : channels)
+            result.push_back (c.data());
+        return result;
+    }
+}
+
+TEST_CASE ("Sample conversion kernels match the scalar reference", "[conversion]")
+{
+    const auto bestIsa = SampleConversion::getBestIsa();
+
+    for (int numChannels : { 1, 2, 3, 4, 8, 32 })
+    {
+        for (auto format : { SampleFormat::Float32, SampleFormat::Int16, SampleFormat::Int24 })
+        {
+            const int numFrames = 203;
+            auto input = makeSignal (numChannels, numFrames);
+            auto inputPtrs = pointers (input);
+            const auto bytes = (size_t) numChannels * numFrames * SampleConversion::getBytesPerSample (format);
+
+            std::vector<float> scratch ((size_t) numChannels * numFrames);
+            std::vector<uint8_t> reference (bytes), vectorised (bytes);
+
+            SampleConversion::setIsa (SampleConversion::Isa::Scalar);
+            REQUIRE (SampleConversion::pack (inputPtrs.data(), numChannels, numFrames, format, nullptr, scratch.data(), reference.data()) == bytes);
+
+            for (auto isa : { SampleConversion::Isa::Sse2, SampleConversion::Isa::Avx2 })
+            {
+                SampleConversion::setIsa (isa);
+                SampleConversion::pack (inputPtrs.data(), numChannels, numFrames, format, nullptr, scratch.data(), vectorised.data());
+                CHECK (reference == vectorised);
+            }
+            SampleConversion::setIsa (bestIsa);
+
+            auto output = makeSignal (numChannels, numFrames);
+            auto outputPtrs = pointers (output);
+            SampleConversion::unpack (vectorised.data(), numChannels, numFrames, format, scratch.data(), outputPtrs.data());
+
+            const float tolerance = format == SampleFormat::Int16 ? 1.0f / 32768.0f : 1.0f / 8388608.0f;
+            float maxError = 0.0f;
+            for (int ch = 0; ch < numChannels; ++ch)
+                for (int i = 0; i < numFrames; ++i)
+                    maxError = std::max (maxError, std::abs (output[(size_t) ch][(size_t) i] - input[(size_t) ch][(size_t) i]));
+            CHECK (maxError <= tolerance);
+        }
+    }
+}
+
+TEST_CASE ("TPDF dither stays within two LSB", "[conversion]")
+{
+    std::vector<float> input (1000, 0.25f);
+    std::vector<uint8_t> packed (input.size() * 2);
+    std::vector<float> output (input.size());
+
+    Dither dither;
+    SampleConversion::floatToInt16 (input.data(), packed.data(), input.size(), &dither);
+    SampleConversion::int16ToFloat (packed.data(), output.data(), output.size());
+
+    bool anyDifferent = false;
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+        CHECK (std::abs (output[i] - input[i]) <= 2.0f / 32768.0f);
+        anyDifferent = anyDifferent || output[i] != output[0];
+    }
+    CHECK (anyDifferent);
+}
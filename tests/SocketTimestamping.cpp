@@ -0,0 +1,109 @@
+#include <PacketHeader.h>
+#include <SocketTimestamping.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+
+#if defined(__linux__)
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+    #include <sys/socket.h>
+    #include <thread>
+    #include <unistd.h>
+
+namespace
+{
+    constexpr uint64_t kMs = 1000000;
+
+    int openLoopback (sockaddr_in& address)
+    {
+        const int fd = socket (AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0)
+            return -1;
+        address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+        socklen_t length = sizeof (address);
+        if (bind (fd, reinterpret_cast<sockaddr*> (&address), sizeof (address)) != 0
+            || getsockname (fd, reinterpret_cast<sockaddr*> (&address), &length) != 0)
+        {
+            close (fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+TEST_CASE ("Loopback datagrams carry kernel receive and transmit stamps", "[timestamping]")
+{
+    sockaddr_in receiverAddress, senderAddress;
+    const int receiver = openLoopback (receiverAddress);
+    const int sender = openLoopback (senderAddress);
+    if (receiver < 0 || sender < 0)
+    {
+        WARN ("No loopback sockets here");
+        return;
+    }
+
+    CHECK ((SocketTimestamping::enable (receiver, false) & SocketTimestamping::SoftwareReceive) != 0);
+    CHECK ((SocketTimestamping::enable (sender, true) & SocketTimestamping::SoftwareTransmit) != 0);
+
+    uint32_t sendIndex = 99;
+    PacketTimestamp timestamp;
+    CHECK_FALSE (SocketTimestamping::readTransmit (sender, sendIndex, timestamp));
+
+    const uint8_t payload[64] = {};
+    for (int i = 0; i < 2; ++i)
+        REQUIRE (sendto (sender, payload, sizeof (payload), 0, reinterpret_cast<sockaddr*> (&receiverAddress), sizeof (receiverAddress)) == (ssize_t) sizeof (payload));
+    const uint64_t sentNs = getMonotonicTimeNs();
+
+    // Let the datagrams wait in the socket: the kernel stamp must not include the wait
+    std::this_thread::sleep_for (std::chrono::milliseconds (20));
+
+    for (int i = 0; i < 2; ++i)
+    {
+        uint8_t buffer[128];
+        alignas (cmsghdr) uint8_t control[TIMESTAMPING_CONTROL_SIZE];
+        iovec vector { buffer, sizeof (buffer) };
+        msghdr message {};
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof (control);
+        REQUIRE (recvmsg (receiver, &message, 0) == (ssize_t) sizeof (payload));
+        const uint64_t userNs = getMonotonicTimeNs();
+
+        PacketTimestamp received;
+        REQUIRE (SocketTimestamping::readReceive (control, message.msg_controllen, received));
+        CHECK (received.softwareNs <= sentNs + kMs);
+        CHECK (received.softwareNs + 15 * kMs < userNs);
+    }
+
+    // Loopback stamps sends in software; the error queue hands them back in send order
+    for (uint32_t expected = 0; expected < 2; ++expected)
+    {
+        REQUIRE (SocketTimestamping::readTransmit (sender, sendIndex, timestamp));
+        CHECK (sendIndex == expected);
+        CHECK (timestamp.softwareNs > 0);
+        CHECK (timestamp.softwareNs <= sentNs + kMs);
+    }
+    CHECK_FALSE (SocketTimestamping::readTransmit (sender, sendIndex, timestamp));
+
+    close (receiver);
+    close (sender);
+}
+#endif
+
+TEST_CASE ("Control data without stamps is rejected", "[timestamping]")
+{
+    PacketTimestamp timestamp;
+    CHECK_FALSE (SocketTimestamping::readReceive (nullptr, 0, timestamp));
+    CHECK (timestamp.softwareNs == 0);
+    CHECK (timestamp.hardwareNs == 0);
+
+    // A stamp taken now maps to about now
+    const uint64_t now = getMonotonicTimeNs();
+    const uint64_t mapped = SocketTimestamping::realtimeToMonotonicNs ((uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::system_clock::now().time_since_epoch()).count());
+    CHECK (mapped + 1000000 > now);
+    CHECK (mapped < now + 1000000);
+}
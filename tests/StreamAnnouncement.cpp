@@ -0,0 +1,37 @@
+#include <StreamAnnouncement.h>
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE ("Stream formats are read from the meta in a receiver's stream list", "[announce]")
+{
+    // The receiver's own id at the top, the streams in the list with their meta as escaped strings
+    const std::string message = "{\"streamID\":12,\"port\":20012,\"streamList\":["
+        "{\"streamID\":3,\"user\":\"a\",\"meta\":\"{ \\\"username\\\": \\\"a\\\",\\n  \\\"type\\\": \\\"audio\\\",\\n"
+        "  \\\"sample_rate\\\": 44100,\\n  \\\"num_channel\\\": 2,\\n  \\\"sample_format\\\": 1,\\n"
+        "  \\\"codec\\\": 2,\\n  \\\"bitrate\\\": 96000,\\n  \\\"codec_delay\\\": 480 }\"},"
+        "{\"streamID\":4,\"user\":\"b\",\"meta\":{\"type\":\"jitter\"}}]}";
+
+    const auto streams = parseStreamAnnouncements (message);
+    REQUIRE (streams.size() == 1);
+    CHECK (streams[0].streamId == 3);
+    CHECK (streams[0].format.sampleRate == 44100.0);
+    CHECK (streams[0].format.numChannels == 2);
+    CHECK (streams[0].format.sampleFormat == SampleFormat::Int16);
+    CHECK (streams[0].format.codec == CodecId::Mdct);
+    CHECK (streams[0].format.bitrate == 96000);
+    CHECK (streams[0].format.codecDelay == 480);
+}
+
+TEST_CASE ("A stream alert with its meta as an object is read", "[announce]")
+{
+    const std::string message = "{\"function\":\"update\",\"receiverID\":12,\"streamID\":9,"
+        "\"meta\":{\"type\":\"audio\",\"sample_rate\":48000,\"num_channel\":2,\"sample_format\":0,\"codec\":0,\"bitrate\":0,\"codec_delay\":0}}";
+
+    const auto streams = parseStreamAnnouncements (message);
+    REQUIRE (streams.size() == 1);
+    CHECK (streams[0].streamId == 9);
+    CHECK (streams[0].format.codec == CodecId::Pcm);
+    CHECK (streams[0].format.bitrate == 0);
+
+    CHECK (parseStreamAnnouncements ("{\"streamID\":9,\"meta\":{\"sample_rate\":48000,\"num_channel\":2,\"sample_format\":7,\"codec\":0}}").empty());
+    CHECK (parseStreamAnnouncements ("{\"streamID\":9,\"meta\":{\"sample_rate\":48000").empty());
+}
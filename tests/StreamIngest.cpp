@@ -0,0 +1,403 @@
+#include <StreamIngest.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    std::vector<uint8_t> makePacket (uint64_t sequence, size_t payloadSize, uint8_t fill)
+    {
+        std::vector<uint8_t> packet (PacketHeader::kSize + payloadSize, fill);
+        PacketHeader header;
+        header.numChannels = 2;
+        header.sequence = sequence;
+        header.samplePosition = sequence * 480;
+        header.numFrames = 480;
+        header.payloadSize = (uint32_t) payloadSize;
+        header.encode (packet.data(), packet.size());
+        return packet;
+    }
+
+    std::vector<uint64_t> drainSequences (StreamIngest& ingest, int index)
+    {
+        ReceivedPacket packet;
+        packet.allocate (ingest.getMaxPacketSize());
+        std::vector<uint64_t> sequences;
+        while (ingest.pop (index, packet))
+            sequences.push_back (packet.header.sequence);
+        return sequences;
+    }
+}
+
+TEST_CASE ("Ingest demultiplexes streams into their own queues", "[ingest]")
+{
+    StreamIngest ingest;
+    ingest.prepare (4096, 64);
+
+    const int numStreams = 32;
+    for (uint64_t s = 0; s < 20; ++s)
+        for (int id = 0; id < numStreams; ++id)
+        {
+            const auto packet = makePacket (s, 100 + (size_t) id, (uint8_t) id);
+            REQUIRE (ingest.ingest (1000 + id, packet.data(), packet.size(), 5000 + s));
+        }
+
+    REQUIRE (ingest.getNumStreams() == numStreams);
+    for (int id = 0; id < numStreams; ++id)
+    {
+        const int index = ingest.findStream (1000 + id);
+        REQUIRE (index >= 0);
+        CHECK (ingest.getStreamId (index) == 1000 + id);
+
+        ReceivedPacket packet;
+        packet.allocate (4096);
+        for (uint64_t s = 0; s < 20; ++s)
+        {
+            REQUIRE (ingest.pop (index, packet));
+            CHECK (packet.header.sequence == s);
+            CHECK (packet.arrivalNs == 5000 + s);
+            CHECK (packet.size == PacketHeader::kSize + 100 + (size_t) id);
+            CHECK (packet.getPayload()[0] == (uint8_t) id);
+            CHECK_FALSE (packet.recovered);
+        }
+        CHECK_FALSE (ingest.pop (index, packet));
+        CHECK (ingest.getCounters (index).received == 20);
+        CHECK (ingest.getStatistics (index)->getSummary (StatisticsMetric::InterArrival).count == 19);
+    }
+    CHECK (ingest.getStatistics (numStreams) == nullptr);
+}
+
+TEST_CASE ("Duplicates, stale and malformed packets are dropped", "[ingest]")
+{
+    StreamIngest ingest;
+    ingest.prepare (2048, 64);
+
+    for (uint64_t s : { 5, 3, 5, 4, 3, 6 })
+    {
+        const auto packet = makePacket (s, 64, 0);
+        ingest.ingest (7, packet.data(), packet.size(), 0);
+    }
+    CHECK (drainSequences (ingest, 0) == std::vector<uint64_t> { 5, 3, 4, 6 });
+    CHECK (ingest.getCounters (0).duplicates == 2);
+
+    // Too far behind the newest packet to tell whether it was seen
+    const auto far = makePacket (6 + INGEST_DUPLICATE_WINDOW, 64, 0);
+    const auto old = makePacket (6, 64, 0);
+    CHECK (ingest.ingest (7, far.data(), far.size(), 0));
+    CHECK_FALSE (ingest.ingest (7, old.data(), old.size(), 0));
+    CHECK (ingest.getCounters (0).stale == 1);
+
+    auto corrupt = makePacket (9000, 64, 0);
+    corrupt[0] ^= 0xff;
+    CHECK_FALSE (ingest.ingest (7, corrupt.data(), corrupt.size(), 0));
+    auto truncated = makePacket (9001, 64, 0);
+    CHECK_FALSE (ingest.ingest (7, truncated.data(), truncated.size() - 1, 0));
+    const auto oversized = makePacket (9002, 4096, 0);
+    CHECK_FALSE (ingest.ingest (7, oversized.data(), oversized.size(), 0));
+    CHECK (ingest.getCounters (0).invalid == 3);
+}
+
+TEST_CASE ("Fragments are reassembled and FEC losses rebuilt before queueing", "[ingest]")
+{
+    StreamIngest ingest;
+    ingest.prepare (16384, 64);
+
+    FecEncoder encoder;
+    encoder.prepare (16384);
+    encoder.setCode (4, 1);
+
+    std::vector<uint8_t> datagram (16384);
+    for (uint64_t s = 0; s < 8; ++s)
+    {
+        const auto packet = makePacket (s, 6000, (uint8_t) s);
+        const int numRepair = encoder.addPacket (packet.data(), packet.size(), s);
+
+        // Packet 6 is lost; the others go out in 1400-byte fragments, last one first
+        if (s != 6)
+        {
+            const int count = PacketFragmenter::getNumFragments (packet.size(), 1400);
+            for (int i = count - 1; i >= 0; --i)
+            {
+                const auto size = PacketFragmenter::writeFragment (packet.data(), packet.size(), (uint32_t) s, i, 1400, datagram.data(), datagram.size());
+                ingest.ingest (1, datagram.data(), size, s);
+            }
+        }
+
+        for (int j = 0; j < numRepair; ++j)
+        {
+            const auto size = encoder.writeRepairPacket (j, datagram.data(), datagram.size());
+            ingest.ingest (1, datagram.data(), size, s);
+        }
+    }
+
+    ReceivedPacket packet;
+    packet.allocate (16384);
+    std::vector<uint64_t> sequences;
+    while (ingest.pop (0, packet))
+    {
+        sequences.push_back (packet.header.sequence);
+        CHECK (packet.recovered == (packet.header.sequence == 6));
+        CHECK (packet.size == PacketHeader::kSize + 6000);
+        CHECK (packet.getPayload()[5999] == (uint8_t) packet.header.sequence);
+    }
+
+    // The stream's FEC decoder is created by its first repair packet, so 6 is rebuilt from the second group
+    CHECK (sequences == std::vector<uint64_t> { 0, 1, 2, 3, 4, 5, 7, 6 });
+    CHECK (ingest.getCounters (0).recovered == 1);
+}
+
+TEST_CASE ("Streams beyond the slot limit are counted and dropped", "[ingest]")
+{
+    StreamIngest ingest;
+    ingest.prepare (1024, 4);
+    const auto packet = makePacket (0, 16, 0);
+    for (int id = 0; id < INGEST_MAX_STREAMS + 3; ++id)
+        ingest.ingest (id, packet.data(), packet.size(), 0);
+
+    CHECK (ingest.getNumStreams() == INGEST_MAX_STREAMS);
+    CHECK (ingest.getNumUnroutable() == 3);
+
+    // A full queue drops its oldest packet
+    for (uint64_t s = 1; s < 10; ++s)
+    {
+        const auto next = makePacket (s, 16, 0);
+        ingest.ingest (0, next.data(), next.size(), 0);
+    }
+    CHECK (drainSequences (ingest, 0) == std::vector<uint64_t> { 6, 7, 8, 9 });
+    CHECK (ingest.getCounters (0).dropped == 6);
+}
+
+TEST_CASE ("Idle slots are recycled once the consumer releases them", "[ingest]")
+{
+    constexpr uint64_t kSecond = 1000000000;
+    StreamIngest ingest;
+    ingest.prepare (1024, 4, 2);
+    const auto packet = makePacket (0, 16, 0);
+
+    REQUIRE (ingest.ingest (1, packet.data(), packet.size(), 0));
+    REQUIRE (ingest.ingest (2, packet.data(), packet.size(), 0));
+    // Both streams are still live
+    CHECK_FALSE (ingest.ingest (3, packet.data(), packet.size(), kSecond));
+    CHECK_FALSE (ingest.releaseRetired (0));
+
+    // Now both have gone quiet; a new stream retires them, but must wait for the consumer
+    const uint64_t later = (INGEST_IDLE_TIMEOUT_MS / 1000 + 1) * kSecond;
+    CHECK_FALSE (ingest.ingest (3, packet.data(), packet.size(), later));
+    CHECK (ingest.getNumUnroutable() == 2);
+
+    // Stream 2 speaks up again before its slot is released and keeps it
+    const auto next = makePacket (1, 16, 0);
+    REQUIRE (ingest.ingest (2, next.data(), next.size(), later));
+    CHECK_FALSE (ingest.releaseRetired (1));
+
+    REQUIRE (ingest.releaseRetired (0));
+    CHECK_FALSE (ingest.releaseRetired (0));
+    CHECK (ingest.getStreamId (0) == -1);
+    CHECK (ingest.findStream (1) == -1);
+
+    const auto first = makePacket (7, 16, 3);
+    REQUIRE (ingest.ingest (3, first.data(), first.size(), later));
+    CHECK (ingest.getNumStreams() == 2);
+    CHECK (ingest.findStream (3) == 0);
+    CHECK (ingest.findStream (2) == 1);
+    // The slot starts over: none of stream 1's packets or counts carry over
+    CHECK (drainSequences (ingest, 0) == std::vector<uint64_t> { 7 });
+    CHECK (ingest.getCounters (0).received == 1);
+    CHECK (drainSequences (ingest, 1) == std::vector<uint64_t> { 0, 1 });
+}
+
+TEST_CASE ("A sequence number far from the rest restarts the duplicate window", "[ingest]")
+{
+    StreamIngest ingest;
+    ingest.prepare (1024, 64);
+
+    for (uint64_t s = 100000; s < 100010; ++s)
+    {
+        const auto packet = makePacket (s, 16, 0);
+        REQUIRE (ingest.ingest (7, packet.data(), packet.size(), 0));
+    }
+
+    // A sender that restarts from 0 is not stale for the rest of its life
+    for (uint64_t s = 0; s < 5; ++s)
+    {
+        const auto packet = makePacket (s, 16, 0);
+        CHECK (ingest.ingest (7, packet.data(), packet.size(), 0));
+    }
+    CHECK (ingest.getCounters (0).restarts == 1);
+
+    // Nor does one corrupt sequence number stop the packets after it
+    const auto corrupt = makePacket (uint64_t (1) << 60, 16, 0);
+    CHECK (ingest.ingest (7, corrupt.data(), corrupt.size(), 0));
+    const auto after = makePacket (5, 16, 0);
+    CHECK (ingest.ingest (7, after.data(), after.size(), 0));
+    CHECK (ingest.getCounters (0).restarts == 3);
+    CHECK (ingest.getCounters (0).stale == 0);
+
+    // Duplicates within the window are still caught
+    CHECK_FALSE (ingest.ingest (7, after.data(), after.size(), 0));
+    CHECK (ingest.getCounters (0).duplicates == 1);
+}
+
+TEST_CASE ("Corelink source ids are parsed from the data header", "[ingest]")
+{
+    int id = -1;
+    const std::string header = "{\"source\": 1234, \"meta\": {}}";
+    REQUIRE (StreamIngest::parseSourceStreamId ((const uint8_t*) header.data(), header.size(), id));
+    CHECK (id == 1234);
+
+    const std::string quoted = "{\"meta\":{},\"source\":\"77\"}";
+    REQUIRE (StreamIngest::parseSourceStreamId ((const uint8_t*) quoted.data(), quoted.size(), id));
+    CHECK (id == 77);
+
+    const std::string missing = "{\"meta\":{}}";
+    CHECK_FALSE (StreamIngest::parseSourceStreamId ((const uint8_t*) missing.data(), missing.size(), id));
+    const std::string empty = "{\"source\": }";
+    CHECK_FALSE (StreamIngest::parseSourceStreamId ((const uint8_t*) empty.data(), empty.size(), id));
+}
+
+TEST_CASE ("A consumer thread drains 32 streams while the network thread ingests", "[ingest]")
+{
+    StreamIngest ingest;
+    ingest.prepare (1024, 1024);
+    const int numStreams = 32;
+    const uint64_t numPackets = 2000;
+
+    std::thread producer ([&] {
+        for (uint64_t s = 0; s < numPackets; ++s)
+            for (int id = 0; id < numStreams; ++id)
+            {
+                const auto packet = makePacket (s, 32, (uint8_t) id);
+                ingest.ingest (id, packet.data(), packet.size(), s);
+            }
+    });
+
+    std::vector<uint64_t> next (numStreams, 0);
+    std::vector<uint64_t> popped (numStreams, 0);
+    ReceivedPacket packet;
+    packet.allocate (1024);
+    bool ordered = true;
+    uint64_t total = 0;
+    while (total < numPackets * numStreams)
+    {
+        for (int index = 0; index < ingest.getNumStreams(); ++index)
+        {
+            while (ingest.pop (index, packet))
+            {
+                const auto id = (size_t) ingest.getStreamId (index);
+                ordered &= packet.header.sequence >= next[id] && packet.getPayload()[0] == (uint8_t) id;
+                next[id] = packet.header.sequence + 1;
+                ++popped[id];
+                ++total;
+            }
+        }
+
+        // Whatever the consumer could not keep up with was dropped oldest-first
+        uint64_t dropped = 0;
+        for (int index = 0; index < ingest.getNumStreams(); ++index)
+            dropped += ingest.getCounters (index).dropped;
+        if (total + dropped == numPackets * numStreams)
+            break;
+        std::this_thread::yield();
+    }
+    producer.join();
+
+    CHECK (ordered);
+    CHECK (ingest.getNumStreams() == numStreams);
+    for (int index = 0; index < numStreams; ++index)
+        CHECK (ingest.getCounters (index).received == numPackets);
+}
+
+TEST_CASE ("Kernel arrival stamps replace user-space ones and both are kept", "[ingest]")
+{
+    StreamIngest ingest;
+    ingest.prepare (2048, 128);
+
+    // The kernel stamps every packet 5 ms after it was sent; the network thread wakes up to 3 ms later
+    constexpr uint64_t kMs = 1000000;
+    for (uint64_t s = 0; s < 100; ++s)
+    {
+        auto packet = makePacket (s, 100, 0);
+        PacketHeader header;
+        REQUIRE (PacketHeader::decode (packet.data(), packet.size(), header));
+        header.sendTimeNs = s * 10 * kMs;
+        header.encode (packet.data(), packet.size());
+
+        const uint64_t kernelNs = header.sendTimeNs + 5 * kMs;
+        REQUIRE (ingest.ingest (3, packet.data(), packet.size(), kernelNs + (s * 7919 % 3000) * 1000, kernelNs));
+    }
+
+    ReceivedPacket packet;
+    packet.allocate (ingest.getMaxPacketSize());
+    REQUIRE (ingest.pop (0, packet));
+    CHECK (packet.arrivalNs == 5 * kMs);
+    CHECK (ingest.getStatistics (0)->getJitterMs() == 0.0);
+    CHECK (ingest.getUserStatistics (0)->getJitterMs() > 0.5);
+
+    // Without a kernel stamp the user-space time is all there is, and only the main statistics see it
+    const auto plain = makePacket (100, 100, 0);
+    REQUIRE (ingest.ingest (3, plain.data(), plain.size(), 2000 * kMs));
+    CHECK (ingest.getCounters (0).received == 101);
+    CHECK (ingest.getCounters (0).kernelStamped == 100);
+    CHECK (ingest.getStatistics (0)->getSummary (StatisticsMetric::InterArrival).count == 100);
+    CHECK (ingest.getUserStatistics (0)->getSummary (StatisticsMetric::InterArrival).count == 99);
+    CHECK (ingest.getUserStatistics (1) == nullptr);
+}
+
+TEST_CASE ("Slots are recycled while the consumer drains them", "[ingest]")
+{
+    // Streams come and go on a few slots: every packet that comes out belongs to the stream the
+    // slot holds, and the consumer only sees a new stream after it released the old one
+    constexpr uint64_t kMs = 1000000;
+    StreamIngest ingest;
+    ingest.prepare (1024, 8, 4);
+    constexpr int kGenerations = 200;
+    std::atomic<bool> done { false };
+
+    std::thread producer ([&] {
+        uint64_t now = 0;
+        for (int generation = 0; generation < kGenerations; ++generation)
+        {
+            // Each generation is a stream that sends a burst, then goes quiet for good
+            const int id = 1000 + generation;
+            for (uint64_t s = 0; s < 20; ++s)
+            {
+                const auto packet = makePacket (s, 16, (uint8_t) generation);
+                while (!ingest.ingest (id, packet.data(), packet.size(), now) && s == 0)
+                {
+                    now += INGEST_IDLE_TIMEOUT_MS * kMs;
+                    std::this_thread::yield();
+                }
+                now += kMs;
+            }
+        }
+        done = true;
+    });
+
+    ReceivedPacket packet;
+    packet.allocate (1024);
+    bool consistent = true;
+    uint64_t numPopped = 0;
+    for (;;)
+    {
+        const bool finished = done.load();
+        for (int index = 0; index < ingest.getNumStreams(); ++index)
+        {
+            while (ingest.pop (index, packet))
+            {
+                const int id = ingest.getStreamId (index);
+                consistent &= id < 0 || packet.getPayload()[0] == (uint8_t) (id - 1000);
+                ++numPopped;
+            }
+            ingest.releaseRetired (index);
+        }
+        if (finished)
+            break;
+    }
+    producer.join();
+
+    CHECK (consistent);
+    CHECK (numPopped > 0);
+}
@@ -0,0 +1,96 @@
+#include <ThreadSafeVar.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+// std::string takes the mutex and condition variable specialization, bool and int the atomic one
+static_assert (std::is_trivially_copyable_v<int> && !std::is_trivially_copyable_v<std::string>);
+
+TEST_CASE ("Values set are read back", "[threadsafevar]")
+{
+    ThreadSafeVar<bool> flag;
+    CHECK_FALSE (flag.get());
+    flag.set (true);
+    CHECK (flag.get());
+
+    ThreadSafeVar<float> level (0.5f);
+    CHECK (level.get() == 0.5f);
+    level.set (0.25f);
+    CHECK (level.get() == 0.25f);
+
+    ThreadSafeVar<std::string> name ("a");
+    CHECK (name.get() == "a");
+    name.set ("b");
+    CHECK (name.get() == "b");
+}
+
+TEST_CASE ("Timed waits return false once the timeout passes", "[threadsafevar]")
+{
+    using namespace std::chrono;
+
+    ThreadSafeVar<bool> flag (false);
+    auto start = steady_clock::now();
+    CHECK_FALSE (flag.waitForValueFor (true, milliseconds (50)));
+    CHECK (steady_clock::now() - start >= milliseconds (50));
+
+    ThreadSafeVar<std::string> name ("a");
+    start = steady_clock::now();
+    CHECK_FALSE (name.waitForValueFor ("b", milliseconds (50)));
+    CHECK (steady_clock::now() - start >= milliseconds (50));
+
+    // A value that is already there returns at once
+    CHECK (flag.waitForValueFor (false, milliseconds (0)));
+    CHECK (name.waitForValueFor ("a", milliseconds (0)));
+}
+
+TEST_CASE ("Waits return true when another thread sets the value", "[threadsafevar]")
+{
+    using namespace std::chrono;
+
+    ThreadSafeVar<bool> flag (false);
+    ThreadSafeVar<int> counter (0);
+    ThreadSafeVar<std::string> name ("a");
+
+    std::thread setter ([&] {
+        std::this_thread::sleep_for (milliseconds (20));
+        flag.set (true);
+        counter.set (1);
+        name.set ("b");
+    });
+
+    const auto start = steady_clock::now();
+    CHECK (flag.waitForValueFor (true, seconds (10)));
+    CHECK (counter.waitForValueFor (1, seconds (10)));
+    CHECK (name.waitForValueFor ("b", seconds (10)));
+    // Woken by set(), not by the timeout
+    CHECK (steady_clock::now() - start < seconds (5));
+    setter.join();
+
+    std::thread resetter ([&] {
+        std::this_thread::sleep_for (milliseconds (20));
+        flag.set (false);
+    });
+    flag.waitForValue (false);
+    CHECK_FALSE (flag.get());
+    resetter.join();
+}
+
+TEST_CASE ("Timed waiters are not lost to a racing set", "[threadsafevar]")
+{
+    // Each round a setter flips the value while the waiter is between its first check and its
+    // wait; a lost wake-up would only return after the full timeout
+    using namespace std::chrono;
+
+    ThreadSafeVar<int> value (0);
+    const auto start = steady_clock::now();
+    for (int round = 1; round <= 2000; ++round)
+    {
+        std::thread setter ([&value, round] { value.set (round); });
+        const bool matched = value.waitForValueFor (round, seconds (10));
+        setter.join();
+        REQUIRE (matched);
+    }
+    CHECK (steady_clock::now() - start < seconds (10));
+}
@@ -0,0 +1,90 @@
+#include <TimeScaler.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr double kPi = 3.14159265358979;
+
+    // Stereo harmonics of a 160 Hz pitch, a period of 300 samples
+    std::vector<std::vector<float>> makeVoiced (int numSamples)
+    {
+        std::vector<std::vector<float>> channels (2, std::vector<float> ((size_t) numSamples));
+        for (int i = 0; i < numSamples; ++i)
+        {
+            double sample = 0.0;
+            for (int h = 1; h <= 4; ++h)
+                sample += 0.3 / h * std::sin (2.0 * kPi * 160.0 * h * i / 48000.0);
+            channels[0][(size_t) i] = (float) sample;
+            channels[1][(size_t) i] = (float) (-0.5 * sample);
+        }
+        return channels;
+    }
+
+    float maxStep (const std::vector<float>& x, int length)
+    {
+        float step = 0.0f;
+        for (int i = 1; i < length; ++i)
+            step = std::max (step, std::abs (x[(size_t) i] - x[(size_t) i - 1]));
+        return step;
+    }
+}
+
+TEST_CASE ("Compressing a periodic signal removes whole periods without a discontinuity", "[timescale]")
+{
+    TimeScaler scaler;
+    scaler.prepare (2, 48000.0);
+
+    const int length = scaler.getMaxCompressLength() + 480;
+    auto signal = makeVoiced (length);
+    const auto original = signal;
+    float* channels[] = { signal[0].data(), signal[1].data() };
+
+    const int scaled = scaler.compress (channels, length, length);
+    const int removed = length - scaled;
+    REQUIRE (removed > 0);
+    CHECK (removed % 300 == 0);
+
+    // The waveform continues as if a period had never been there
+    for (int ch = 0; ch < 2; ++ch)
+    {
+        CHECK (maxStep (signal[(size_t) ch], scaled) <= maxStep (original[(size_t) ch], length) * 1.01f);
+        for (int i = scaled - 480; i < scaled; ++i)
+            CHECK (signal[(size_t) ch][(size_t) i] == original[(size_t) ch][(size_t) (i + removed)]);
+    }
+
+    // Less room than the shortest period leaves the block alone
+    signal = original;
+    CHECK (scaler.compress (channels, length, 100) == length);
+    CHECK (scaler.compress (channels, scaler.getMinCompressLength() - 1, length) == scaler.getMinCompressLength() - 1);
+}
+
+TEST_CASE ("Noise is not compressed and silence is detected", "[timescale]")
+{
+    TimeScaler scaler;
+    scaler.prepare (1, 48000.0);
+
+    const int length = scaler.getMaxCompressLength();
+    std::mt19937 rng (2);
+    std::normal_distribution<float> noise (0.0f, 0.1f);
+    std::vector<float> signal ((size_t) length);
+    for (auto& sample : signal)
+        sample = noise (rng);
+    const auto original = signal;
+    float* channels[] = { signal.data() };
+
+    CHECK (scaler.compress (channels, length, length) == length);
+    CHECK (signal == original);
+    CHECK_FALSE (scaler.isSilent (channels, length));
+
+    for (auto& sample : signal)
+        sample *= 0.001f;
+    CHECK (scaler.isSilent (channels, length));
+    std::fill (signal.begin(), signal.end(), 0.0f);
+    CHECK (scaler.isSilent (channels, length));
+    CHECK (scaler.compress (channels, length, length) == length);
+}
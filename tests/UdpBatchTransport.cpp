@@ -0,0 +1,131 @@
+#include <PacketHeader.h>
+#include <SocketTimestamping.h>
+#include <UdpBatchTransport.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+TEST_CASE ("Batched datagrams arrive intact and in order over loopback", "[udp]")
+{
+    UdpBatchTransport receiver, sender;
+    if (!receiver.bind ("127.0.0.1", 0) || !sender.open ("127.0.0.1", receiver.getLocalPort()))
+    {
+        WARN ("No loopback sockets here");
+        return;
+    }
+
+    // The receiver drains concurrently, as the stand-in server would
+    std::vector<std::vector<uint8_t>> received;
+    std::atomic<bool> receiving { true };
+    bool stampsOrdered = true;
+    std::thread drain ([&] {
+        auto keep = [&] (const uint8_t* data, size_t size, uint64_t arrivalNs, uint64_t kernelArrivalNs) {
+            stampsOrdered &= kernelArrivalNs <= arrivalNs;
+            received.emplace_back (data, data + size);
+        };
+        while (receiving.load())
+            receiver.receive (keep, 10);
+        while (receiver.receive (keep, 0) > 0) {}
+    });
+
+    // Runs of equal sizes, as a stream's packets are, broken up by a few odd ones
+    const uint8_t prefix[] = { 'C', 'L', 0, 0 };
+    std::vector<std::vector<uint8_t>> payloads;
+    for (int i = 0; i < 150; ++i)
+    {
+        const size_t size = i % 37 == 36 ? 300 : 1000;
+        payloads.emplace_back (size, (uint8_t) i);
+        REQUIRE (sender.queue (prefix, sizeof (prefix), payloads.back().data(), size));
+        if (i % 50 == 49)
+            std::this_thread::sleep_for (std::chrono::milliseconds (20));
+    }
+    sender.flush();
+    CHECK (sender.getNumQueued() == 0);
+
+    for (int attempts = 0; attempts < 100 && receiver.getCounters().datagramsReceived < payloads.size(); ++attempts)
+        std::this_thread::sleep_for (std::chrono::milliseconds (10));
+    receiving = false;
+    drain.join();
+    CHECK (stampsOrdered);
+
+    REQUIRE (received.size() == payloads.size());
+    for (size_t i = 0; i < payloads.size(); ++i)
+    {
+        REQUIRE (received[i].size() == sizeof (prefix) + payloads[i].size());
+        CHECK (std::equal (prefix, prefix + sizeof (prefix), received[i].begin()));
+        CHECK (std::equal (payloads[i].begin(), payloads[i].end(), received[i].begin() + sizeof (prefix)));
+    }
+
+    // A full batch is sent as it fills, so 150 datagrams take a handful of calls
+    const auto counters = sender.getCounters();
+    CHECK (counters.datagramsSent == 150);
+    CHECK (counters.sendCalls <= 6);
+    CHECK (counters.errors == 0);
+    if (sender.isGsoEnabled())
+        CHECK (counters.gsoBuffers > 0);
+    CHECK (receiver.getCounters().datagramsReceived == 150);
+    CHECK (receiver.getCounters().receiveCalls < 150);
+}
+
+TEST_CASE ("Tagged datagrams get the kernel's transmit stamps back", "[udp]")
+{
+    UdpBatchTransport receiver, sender;
+    if (!receiver.bind ("127.0.0.1", 0) || !sender.open ("127.0.0.1", receiver.getLocalPort()))
+    {
+        WARN ("No loopback sockets here");
+        return;
+    }
+    if ((sender.getTimestamping() & SocketTimestamping::SoftwareTransmit) == 0)
+    {
+        WARN ("No transmit stamps here");
+        return;
+    }
+
+    // Equal sizes, so with GSO several datagrams share one send and one stamp; every third is untracked
+    const uint8_t payload[500] = {};
+    std::vector<uint64_t> tagged;
+    const uint64_t beforeNs = getMonotonicTimeNs();
+    for (uint64_t i = 0; i < 200; ++i)
+    {
+        const uint64_t tag = i % 3 == 2 ? UDP_UNTRACKED : 1000 + i;
+        if (tag != UDP_UNTRACKED)
+            tagged.push_back (tag);
+        REQUIRE (sender.queue (nullptr, 0, payload, sizeof (payload), tag));
+    }
+    sender.flush();
+    const uint64_t afterNs = getMonotonicTimeNs();
+
+    std::vector<uint64_t> stamped;
+    bool inRange = true;
+    for (int attempts = 0; attempts < 100 && stamped.size() < tagged.size(); ++attempts)
+    {
+        std::this_thread::sleep_for (std::chrono::milliseconds (5));
+        sender.readTransmitStamps ([&] (uint64_t tag, uint64_t kernelSendNs) {
+            stamped.push_back (tag);
+            // The realtime-to-monotonic conversion may be off by a few microseconds
+            inRange &= kernelSendNs + 1000000 >= beforeNs && kernelSendNs <= afterNs + 1000000;
+        });
+    }
+    std::sort (stamped.begin(), stamped.end());
+    CHECK (stamped == tagged);
+    CHECK (inRange);
+    CHECK (sender.getCounters().transmitStamps == tagged.size());
+    while (receiver.receive ([] (const uint8_t*, size_t, uint64_t, uint64_t) {}, 0) > 0) {}
+}
+#endif
+
+TEST_CASE ("A closed transport refuses datagrams", "[udp]")
+{
+    UdpBatchTransport transport;
+    const uint8_t payload[16] = {};
+    CHECK_FALSE (transport.isOpen());
+    CHECK_FALSE (transport.queue (nullptr, 0, payload, sizeof (payload)));
+    CHECK (transport.flush() == 0);
+
+    std::vector<uint8_t> oversized (UDP_BATCH_MAX_DATAGRAM + 1);
+    CHECK_FALSE (transport.queue (nullptr, 0, oversized.data(), oversized.size()));
+}